@@ -0,0 +1,47 @@
+#ifndef BITLIB_BENCH_COMMON_H
+#define BITLIB_BENCH_COMMON_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+void bench_zorder();
+void bench_search();
+void bench_ops();
+void bench_e2e();
+
+/**
+ * Options of bitlib_bench: the only input distribution to run (NULL for all),
+ * the file to write JSON results to (NULL for none), whether to read hardware
+ * counters and the raw event counting retired uops (0 for none)
+ */
+extern const char *bench_dist;
+extern FILE *bench_json;
+extern int bench_perf;
+extern uint64_t bench_uops;
+
+/**
+ * Start the next record of the JSON array in bench_json
+ */
+void bench_json_next();
+
+/**
+ * xorshift64 pseudo random number generator
+ */
+static inline uint64_t bench_rand(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/**
+ * Processor time in seconds
+ */
+static inline double bench_seconds()
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+#endif //BITLIB_BENCH_COMMON_H
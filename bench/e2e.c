@@ -0,0 +1,418 @@
+#include "morton.h"
+#include "popcount.h"
+#include "compare.h"
+#include "range.h"
+#include "sort.h"
+#include "common.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * End-to-end workloads over synthetic data, run on 1, 2, 4, ... threads up to
+ * the number of cores to show throughput per core and scaling:
+ *
+ * - encode+sort: Morton codes of clustered, LiDAR-like 3D points, sorted by a
+ *   parallel radix sort (a serial split pass, then buckets per thread)
+ * - range query: box queries on the sorted codes through morton3_ranges_64
+ * - hamming top-k: nearest 256 bit fingerprints of a query by Hamming distance
+ * - bitmap and+count: pairwise intersection sizes of bitmaps whose densities
+ *   follow a Zipf distribution, as for posting lists of terms
+ *
+ * The library doesn't start threads; the threads here are the benchmark's.
+ */
+
+#define E2E_POINTS ((size_t)1 << 22)
+/* Morton codes of 10 bit coordinates take 30 bits; radix sorts use whole digits */
+#define E2E_KEYBITS 32
+#define E2E_CLUSTERS 64
+#define E2E_BOXES 1024
+#define E2E_MAXRANGES 64
+#define E2E_FINGERPRINTS ((size_t)1 << 20)
+#define E2E_FPWORDS 4
+#define E2E_FPQUERIES 8
+#define E2E_TOPK 10
+#define E2E_BITMAPS 16
+#define E2E_BITMAPWORDS ((size_t)1 << 18)
+#define E2E_MAXTHREADS 64
+
+static uint64_t *e2e_x, *e2e_y, *e2e_z, *e2e_keys, *e2e_tk, *e2e_boxes;
+static uint32_t *e2e_vals, *e2e_tv;
+static size_t e2e_bounds[257];
+static uint64_t *e2e_fps, *e2e_fpq, *e2e_bitmaps;
+static uint64_t e2e_result[E2E_MAXTHREADS];
+static uint32_t e2e_best[E2E_MAXTHREADS][E2E_FPQUERIES][E2E_TOPK];
+
+/* Wall clock time in seconds; bench_seconds adds up the time of all threads */
+static double e2e_wall()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1e-9 * (double)t.tv_nsec;
+}
+
+/* The share [begin; end) of n items of thread t out of nt */
+static void e2e_slice(size_t n, unsigned t, unsigned nt, size_t *begin, size_t *end)
+{
+    *begin = n * t / nt;
+    *end = n * (t + 1) / nt;
+}
+
+struct e2e_worker {
+    void (*fn)(unsigned t, unsigned nt);
+    unsigned t, nt;
+};
+
+static void *e2e_thread(void *arg)
+{
+    struct e2e_worker *w = (struct e2e_worker *)arg;
+
+    w->fn(w->t, w->nt);
+    return NULL;
+}
+
+/* Run fn(t, nt) on nt threads, the calling thread being thread 0. The share
+ * of a thread that can't be started is run on the calling thread, so the
+ * results stay right even though the timing suffers. */
+static void e2e_parallel(void (*fn)(unsigned t, unsigned nt), unsigned nt)
+{
+    pthread_t threads[E2E_MAXTHREADS];
+    struct e2e_worker w[E2E_MAXTHREADS];
+    int started[E2E_MAXTHREADS];
+    unsigned t;
+
+    for (t = 0; t < nt; ++t) {
+        w[t].fn = fn;
+        w[t].t = t;
+        w[t].nt = nt;
+        started[t] = t > 0 && pthread_create(&threads[t], NULL, e2e_thread, &w[t]) == 0;
+    }
+    fn(0, nt);
+    for (t = 1; t < nt; ++t) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        } else {
+            fn(t, nt);
+        }
+    }
+}
+
+/* A point near one of the cluster centers, or on the ground plane z ~ 0, on a
+ * grid of 1024^3 voxels */
+static void e2e_point(uint64_t *s, const uint64_t (*centers)[3], uint64_t *p)
+{
+    uint64_t r = bench_rand(s);
+    const uint64_t *c = centers[r % E2E_CLUSTERS];
+    unsigned a;
+
+    for (a = 0; a < 3; ++a) {
+        /* The sum of 4 uniform offsets is roughly normal, sigma ~ 9 */
+        int64_t d = 0, v;
+        unsigned k;
+        for (k = 0; k < 4; ++k) {
+            d += (int64_t)(bench_rand(s) >> 60) - 8;
+        }
+        v = (int64_t)c[a] + d;
+        p[a] = v < 0 ? 0 : v > 0x3ff ? 0x3ff : (uint64_t)v;
+    }
+    if ((r >> 32) % 10 < 3) {
+        p[0] = bench_rand(s) >> 54;
+        p[1] = bench_rand(s) >> 54;
+        p[2] = bench_rand(s) >> 62;
+    }
+}
+
+static void e2e_encode(unsigned t, unsigned nt)
+{
+    size_t i, b, e;
+
+    e2e_slice(E2E_POINTS, t, nt, &b, &e);
+    for (i = b; i < e; ++i) {
+        e2e_keys[i] = morton3_64(e2e_x[i], e2e_y[i], e2e_z[i]);
+        e2e_vals[i] = (uint32_t)i;
+    }
+}
+
+static void e2e_sort_buckets(unsigned t, unsigned nt)
+{
+    size_t k, b, e;
+
+    /* Buckets are split by count rather than by points; clustered data makes
+     * some threads finish late, which is part of what this measures. */
+    e2e_slice(256, t, nt, &b, &e);
+    for (k = b; k < e; ++k) {
+        size_t s = e2e_bounds[k], n = e2e_bounds[k + 1] - s;
+        radixsort_64(e2e_tk + s, e2e_tv + s, n, e2e_keys + s, e2e_vals + s, E2E_KEYBITS - 8);
+    }
+}
+
+static size_t e2e_lower_bound(const uint64_t *keys, size_t n, uint64_t x)
+{
+    size_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid] < x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void e2e_query(unsigned t, unsigned nt)
+{
+    uint64_t ranges[2 * E2E_MAXRANGES];
+    size_t q, b, e, r, nr, i, found = 0;
+
+    /* The sorted codes are in e2e_tk after the parallel sort */
+    e2e_slice(E2E_BOXES, t, nt, &b, &e);
+    for (q = b; q < e; ++q) {
+        const uint64_t *box = e2e_boxes + 6 * q;
+        uint64_t lo = morton3_64(box[0], box[1], box[2]), hi = morton3_64(box[3], box[4], box[5]);
+        nr = morton3_ranges_64(box[0], box[1], box[2], box[3], box[4], box[5], 0,
+                               ranges, E2E_MAXRANGES);
+        for (r = 0; r < nr; ++r) {
+            i = e2e_lower_bound(e2e_tk, E2E_POINTS, ranges[2 * r]);
+            for (; i < E2E_POINTS && e2e_tk[i] <= ranges[2 * r + 1]; ++i) {
+                found += morton3_in_box_64(e2e_tk[i], lo, hi);
+            }
+        }
+    }
+    e2e_result[t] = found;
+}
+
+static void e2e_hamming(unsigned t, unsigned nt)
+{
+    uint32_t dist[E2E_FPQUERIES][E2E_TOPK];
+    size_t i, b, e;
+    unsigned q, k, w;
+
+    for (q = 0; q < E2E_FPQUERIES; ++q) {
+        for (k = 0; k < E2E_TOPK; ++k) {
+            dist[q][k] = UINT32_MAX;
+        }
+    }
+    e2e_slice(E2E_FINGERPRINTS, t, nt, &b, &e);
+    for (i = b; i < e; ++i) {
+        const uint64_t *f = e2e_fps + E2E_FPWORDS * i;
+        for (q = 0; q < E2E_FPQUERIES; ++q) {
+            const uint64_t *g = e2e_fpq + E2E_FPWORDS * q;
+            uint32_t d = 0;
+            for (w = 0; w < E2E_FPWORDS; ++w) {
+                d += (uint32_t)popcount_64(f[w] ^ g[w]);
+            }
+            /* Insert into the sorted top k, which rarely changes */
+            if (d < dist[q][E2E_TOPK - 1]) {
+                for (k = E2E_TOPK - 1; k > 0 && dist[q][k - 1] > d; --k) {
+                    dist[q][k] = dist[q][k - 1];
+                }
+                dist[q][k] = d;
+            }
+        }
+    }
+    for (q = 0; q < E2E_FPQUERIES; ++q) {
+        for (k = 0; k < E2E_TOPK; ++k) {
+            e2e_best[t][q][k] = dist[q][k];
+        }
+    }
+}
+
+/* Merge the top k of the threads into that of thread 0, returning the sum of
+ * the distances of the overall top k of all queries */
+static uint64_t e2e_merge_topk(unsigned nt)
+{
+    uint64_t sum = 0;
+    unsigned t, q, k, j;
+
+    for (q = 0; q < E2E_FPQUERIES; ++q) {
+        uint32_t *best = e2e_best[0][q];
+        for (t = 1; t < nt; ++t) {
+            for (j = 0; j < E2E_TOPK && e2e_best[t][q][j] < best[E2E_TOPK - 1]; ++j) {
+                uint32_t d = e2e_best[t][q][j];
+                for (k = E2E_TOPK - 1; k > 0 && best[k - 1] > d; --k) {
+                    best[k] = best[k - 1];
+                }
+                best[k] = d;
+            }
+        }
+        for (k = 0; k < E2E_TOPK; ++k) {
+            sum += best[k];
+        }
+    }
+    return sum;
+}
+
+static void e2e_bitmap(unsigned t, unsigned nt)
+{
+    size_t i, b, e;
+    unsigned p, q;
+    uint64_t count = 0;
+
+    /* Every thread intersects all pairs over its share of the words, so the
+     * words of one slice stay in cache across the pairs. */
+    e2e_slice(E2E_BITMAPWORDS, t, nt, &b, &e);
+    for (p = 0; p < E2E_BITMAPS; ++p) {
+        const uint64_t *x = e2e_bitmaps + p * E2E_BITMAPWORDS;
+        for (q = p + 1; q < E2E_BITMAPS; ++q) {
+            const uint64_t *y = e2e_bitmaps + q * E2E_BITMAPWORDS;
+            for (i = b; i < e; ++i) {
+                count += popcount_64(x[i] & y[i]);
+            }
+        }
+    }
+    e2e_result[t] = count;
+}
+
+static void e2e_data()
+{
+    uint64_t centers[E2E_CLUSTERS][3], s = 0x853c49e6748fea9b, p[3];
+    size_t i, j;
+    unsigned c, a;
+
+    for (c = 0; c < E2E_CLUSTERS; ++c) {
+        for (a = 0; a < 3; ++a) {
+            centers[c][a] = bench_rand(&s) >> 54;
+        }
+    }
+    for (i = 0; i < E2E_POINTS; ++i) {
+        e2e_point(&s, (const uint64_t (*)[3])centers, p);
+        e2e_x[i] = p[0];
+        e2e_y[i] = p[1];
+        e2e_z[i] = p[2];
+    }
+    /* Boxes of side 17 around random points, i.e. around dense areas. The cost
+     * of planning the ranges grows with the surface of the box. */
+    for (i = 0; i < E2E_BOXES; ++i) {
+        size_t k = bench_rand(&s) % E2E_POINTS;
+        uint64_t v[3] = {e2e_x[k], e2e_y[k], e2e_z[k]};
+        for (a = 0; a < 3; ++a) {
+            e2e_boxes[6 * i + a] = v[a] < 8 ? 0 : v[a] - 8;
+            e2e_boxes[6 * i + 3 + a] = v[a] + 8 > 0x3ff ? 0x3ff : v[a] + 8;
+        }
+    }
+    for (i = 0; i < E2E_FINGERPRINTS * E2E_FPWORDS; ++i) {
+        e2e_fps[i] = bench_rand(&s);
+    }
+    for (i = 0; i < E2E_FPQUERIES * E2E_FPWORDS; ++i) {
+        e2e_fpq[i] = bench_rand(&s);
+    }
+    /* Bitmap j has density 1 / 2^(j / 2 + 1), roughly Zipfian over j */
+    for (j = 0; j < E2E_BITMAPS; ++j) {
+        for (i = 0; i < E2E_BITMAPWORDS; ++i) {
+            uint64_t w = ~(uint64_t)0;
+            for (a = 0; a <= j / 2; ++a) {
+                w &= bench_rand(&s);
+            }
+            e2e_bitmaps[j * E2E_BITMAPWORDS + i] = w;
+        }
+    }
+}
+
+static void e2e_report(const char *workload, unsigned nt, double items, double t, double base,
+                       uint64_t check)
+{
+    double rate = items / t, speedup = base > 0.0 ? base / t : 1.0;
+
+    printf("e2e %-16s threads=%-3u %10.3f M/s, %9.3f M/s per thread, speedup %5.2f "
+           "(check %llu)\n", workload, nt, rate * 1e-6, rate * 1e-6 / nt, speedup,
+           (unsigned long long)check);
+    if (bench_json != NULL) {
+        bench_json_next();
+        fprintf(bench_json, "{\"bench\": \"e2e\", \"workload\": \"%s\", \"threads\": %u, "
+                "\"items_per_s\": %.1f, \"items_per_s_per_thread\": %.1f, \"speedup\": %.3f}",
+                workload, nt, rate, rate / nt, speedup);
+    }
+}
+
+static void e2e_free()
+{
+    free(e2e_x);
+    free(e2e_y);
+    free(e2e_z);
+    free(e2e_keys);
+    free(e2e_tk);
+    free(e2e_vals);
+    free(e2e_tv);
+    free(e2e_boxes);
+    free(e2e_fps);
+    free(e2e_fpq);
+    free(e2e_bitmaps);
+}
+
+void bench_e2e()
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned nt, maxt = cores < 1 ? 1 : cores > E2E_MAXTHREADS ? E2E_MAXTHREADS : (unsigned)cores;
+    double base[4] = {0.0, 0.0, 0.0, 0.0}, t0, t;
+    uint64_t check;
+    unsigned i;
+
+    e2e_x = malloc(E2E_POINTS * sizeof(uint64_t));
+    e2e_y = malloc(E2E_POINTS * sizeof(uint64_t));
+    e2e_z = malloc(E2E_POINTS * sizeof(uint64_t));
+    e2e_keys = malloc(E2E_POINTS * sizeof(uint64_t));
+    e2e_tk = malloc(E2E_POINTS * sizeof(uint64_t));
+    e2e_vals = malloc(E2E_POINTS * sizeof(uint32_t));
+    e2e_tv = malloc(E2E_POINTS * sizeof(uint32_t));
+    e2e_boxes = malloc(6 * E2E_BOXES * sizeof(uint64_t));
+    e2e_fps = malloc(E2E_FINGERPRINTS * E2E_FPWORDS * sizeof(uint64_t));
+    e2e_fpq = malloc(E2E_FPQUERIES * E2E_FPWORDS * sizeof(uint64_t));
+    e2e_bitmaps = malloc(E2E_BITMAPS * E2E_BITMAPWORDS * sizeof(uint64_t));
+    if (e2e_x == NULL || e2e_y == NULL || e2e_z == NULL || e2e_keys == NULL || e2e_tk == NULL ||
+        e2e_vals == NULL || e2e_tv == NULL || e2e_boxes == NULL || e2e_fps == NULL ||
+        e2e_fpq == NULL || e2e_bitmaps == NULL) {
+        fprintf(stderr, "e2e: out of memory\n");
+        e2e_free();
+        return;
+    }
+    e2e_data();
+
+    /* 1, 2, 4, ... threads, and all cores */
+    for (nt = 1; nt <= maxt; nt = nt < maxt && 2 * nt > maxt ? maxt : 2 * nt) {
+        t0 = e2e_wall();
+        e2e_parallel(e2e_encode, nt);
+        radixsort_split_64(e2e_keys, e2e_vals, E2E_POINTS, e2e_tk, e2e_tv, E2E_KEYBITS,
+                           e2e_bounds);
+        e2e_parallel(e2e_sort_buckets, nt);
+        t = e2e_wall() - t0;
+        base[0] = nt == 1 ? t : base[0];
+        e2e_report("encode+sort", nt, (double)E2E_POINTS, t, base[0], e2e_tk[E2E_POINTS / 2]);
+
+        t0 = e2e_wall();
+        e2e_parallel(e2e_query, nt);
+        t = e2e_wall() - t0;
+        for (check = 0, i = 0; i < nt; ++i) {
+            check += e2e_result[i];
+        }
+        base[1] = nt == 1 ? t : base[1];
+        e2e_report("range query", nt, (double)E2E_BOXES, t, base[1], check);
+
+        t0 = e2e_wall();
+        e2e_parallel(e2e_hamming, nt);
+        check = e2e_merge_topk(nt);
+        t = e2e_wall() - t0;
+        base[2] = nt == 1 ? t : base[2];
+        e2e_report("hamming top-k", nt, (double)E2E_FINGERPRINTS * E2E_FPQUERIES, t, base[2],
+                   check);
+
+        t0 = e2e_wall();
+        e2e_parallel(e2e_bitmap, nt);
+        t = e2e_wall() - t0;
+        for (check = 0, i = 0; i < nt; ++i) {
+            check += e2e_result[i];
+        }
+        base[3] = nt == 1 ? t : base[3];
+        e2e_report("bitmap and+count", nt,
+                   (double)E2E_BITMAPWORDS * E2E_BITMAPS * (E2E_BITMAPS - 1) / 2, t, base[3],
+                   check);
+        if (nt == maxt) {
+            break;
+        }
+    }
+    e2e_free();
+}
@@ -0,0 +1,82 @@
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const char *bench_dist = NULL;
+FILE *bench_json = NULL;
+int bench_perf = 0;
+uint64_t bench_uops = 0;
+static size_t bench_json_records = 0;
+
+void bench_json_next()
+{
+    fprintf(bench_json, bench_json_records++ ? ",\n  " : "  ");
+}
+
+/*
+ * Usage: bitlib_bench [--dist=sparse|random|dense] [--json=FILE] [--counters]
+ *                     [--uops=EVENT] [NAME...]
+ * Runs the named benchmarks (zorder, search, ops, e2e), or all of them. The
+ * options are parsed in main() only; bench_selected() just skips them.
+ */
+static int bench_selected(int argc, char **argv, const char *name)
+{
+    int i, any = 0;
+
+    for (i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-') {
+            any = 1;
+            if (strcmp(argv[i], name) == 0) {
+                return 1;
+            }
+        }
+    }
+    return !any;
+}
+
+int main(int argc, char **argv) {
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--dist=", 7) == 0) {
+            bench_dist = argv[i] + 7;
+        } else if (strncmp(argv[i], "--json=", 7) == 0) {
+            bench_json = fopen(argv[i] + 7, "w");
+            if (bench_json == NULL) {
+                perror(argv[i] + 7);
+                return 1;
+            }
+            fprintf(bench_json, "[\n");
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            bench_perf = 1;
+        } else if (strncmp(argv[i], "--uops=", 7) == 0) {
+            char *end;
+            bench_uops = strtoull(argv[i] + 7, &end, 0);
+            if (argv[i][7] == '\0' || *end != '\0') {
+                fprintf(stderr, "bad uops event: %s\n", argv[i] + 7);
+                return 1;
+            }
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (bench_selected(argc, argv, "zorder")) {
+        bench_zorder();
+    }
+    if (bench_selected(argc, argv, "search")) {
+        bench_search();
+    }
+    if (bench_selected(argc, argv, "ops")) {
+        bench_ops();
+    }
+    if (bench_selected(argc, argv, "e2e")) {
+        bench_e2e();
+    }
+    if (bench_json != NULL) {
+        fprintf(bench_json, "\n]\n");
+        fclose(bench_json);
+    }
+    return 0;
+}
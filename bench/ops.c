@@ -0,0 +1,319 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "popcount.h"
+#include "shift.h"
+#include "morton.h"
+#include "common.h"
+#include "ops.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * morton_* and invmorton_* are aliases of merge_* and separate_*, so they are
+ * timed under those names.
+ *
+ * With --counters, hardware counters are read around every loop as well, and
+ * the instructions per call of the latency-bound loop, less those of a loop
+ * calling no function, are compared with the op count documented in the
+ * function's Complexity line.
+ */
+
+#ifndef BITLIB_SRC_DIR
+#define BITLIB_SRC_DIR "src"
+#endif
+
+OPS_UNARY(popcount_8, uint8_t)
+OPS_UNARY(popcount_16, uint16_t)
+OPS_UNARY(popcount_32, uint32_t)
+OPS_UNARY(popcount_64, uint64_t)
+OPS_UNARY(popcount_mul_32, uint32_t)
+OPS_UNARY(popcount_mul_64, uint64_t)
+OPS_UNARY(popcount_iter_32, uint32_t)
+OPS_UNARY(popcount_iter_64, uint64_t)
+
+OPS_UNARY(scatter_8, uint8_t)
+OPS_UNARY(scatter_16, uint16_t)
+OPS_UNARY(scatter_32, uint32_t)
+OPS_UNARY(scatter_64, uint64_t)
+OPS_UNARY(scatter3_8, uint8_t)
+OPS_UNARY(scatter3_16, uint16_t)
+OPS_UNARY(scatter3_32, uint32_t)
+OPS_UNARY(scatter3_64, uint64_t)
+OPS_UNARY(gather_8, uint8_t)
+OPS_UNARY(gather_16, uint16_t)
+OPS_UNARY(gather_32, uint32_t)
+OPS_UNARY(gather_64, uint64_t)
+OPS_UNARY(gather3_8, uint8_t)
+OPS_UNARY(gather3_16, uint16_t)
+OPS_UNARY(gather3_32, uint32_t)
+OPS_UNARY(gather3_64, uint64_t)
+
+OPS_BINARY(merge_8, uint8_t)
+OPS_BINARY(merge_nwe_8, uint8_t)
+OPS_BINARY(merge_16, uint16_t)
+OPS_BINARY(merge_nwe_16, uint16_t)
+OPS_BINARY(merge_32, uint32_t)
+OPS_BINARY(merge_nwe_32, uint32_t)
+OPS_BINARY(merge_64, uint64_t)
+OPS_TERNARY(merge3_8, uint8_t)
+OPS_TERNARY(merge3_16, uint16_t)
+OPS_TERNARY(merge3_32, uint32_t)
+OPS_TERNARY(merge3_64, uint64_t)
+OPS_SEPARATE(separate_8, uint8_t)
+OPS_SEPARATE(separate_nwe_8, uint8_t)
+OPS_SEPARATE(separate_16, uint16_t)
+OPS_SEPARATE(separate_nwe_16, uint16_t)
+OPS_SEPARATE(separate_32, uint32_t)
+OPS_SEPARATE(separate_nwe_32, uint32_t)
+OPS_SEPARATE(separate_64, uint64_t)
+OPS_SEPARATE3(separate3_8, uint8_t)
+OPS_SEPARATE3(separate3_16, uint16_t)
+OPS_SEPARATE3(separate3_32, uint32_t)
+OPS_SEPARATE3(separate3_64, uint64_t)
+
+#define OPS_STEPS(d, s)                                                             \
+OPS_UNARY(morton##d##s##_8, uint8_t)                                                \
+OPS_UNARY(morton##d##s##_16, uint16_t)                                              \
+OPS_UNARY(morton##d##s##_32, uint32_t)                                              \
+OPS_UNARY(morton##d##s##_64, uint64_t)
+
+/* The loop overhead, subtracted from the instruction counts */
+#define OPS_NONE(x) (x)
+OPS_UNARY(OPS_NONE, uint64_t)
+
+OPS_STEPS(xm, )
+OPS_STEPS(xp, )
+OPS_STEPS(ym, )
+OPS_STEPS(yp, )
+OPS_STEPS(xm, 3)
+OPS_STEPS(xp, 3)
+OPS_STEPS(ym, 3)
+OPS_STEPS(yp, 3)
+OPS_STEPS(zm, 3)
+OPS_STEPS(zp, 3)
+
+struct ops_entry {
+    const char *name, *family, *flavor;
+    unsigned width;
+    uint64_t mask;
+    ops_kernel run;
+};
+
+#define OPS_ENTRY(f, family, flavor, w, mask) {#f, family, flavor, w, mask, ops_##f}
+#define OPS_STEP_ENTRIES(d, s)                                                      \
+    OPS_ENTRY(morton##d##s##_8, "morton" #d #s, "default", 8, OPS_ALL),             \
+    OPS_ENTRY(morton##d##s##_16, "morton" #d #s, "default", 16, OPS_ALL),           \
+    OPS_ENTRY(morton##d##s##_32, "morton" #d #s, "default", 32, OPS_ALL),           \
+    OPS_ENTRY(morton##d##s##_64, "morton" #d #s, "default", 64, OPS_ALL)
+
+static const struct ops_entry ops_entries[] = {
+    OPS_ENTRY(popcount_8, "popcount", "default", 8, OPS_ALL),
+    OPS_ENTRY(popcount_16, "popcount", "default", 16, OPS_ALL),
+    OPS_ENTRY(popcount_32, "popcount", "default", 32, OPS_ALL),
+    OPS_ENTRY(popcount_mul_32, "popcount", "mul", 32, OPS_ALL),
+    OPS_ENTRY(popcount_iter_32, "popcount", "iter", 32, OPS_ALL),
+    OPS_ENTRY(popcount_64, "popcount", "default", 64, OPS_ALL),
+    OPS_ENTRY(popcount_mul_64, "popcount", "mul", 64, OPS_ALL),
+    OPS_ENTRY(popcount_iter_64, "popcount", "iter", 64, OPS_ALL),
+    OPS_ENTRY(scatter_8, "scatter", "default", 8, OPS_HALF(8)),
+    OPS_ENTRY(scatter_16, "scatter", "default", 16, OPS_HALF(16)),
+    OPS_ENTRY(scatter_32, "scatter", "default", 32, OPS_HALF(32)),
+    OPS_ENTRY(scatter_64, "scatter", "default", 64, OPS_HALF(64)),
+    OPS_ENTRY(scatter3_8, "scatter3", "default", 8, OPS_THIRD(8)),
+    OPS_ENTRY(scatter3_16, "scatter3", "default", 16, OPS_THIRD(16)),
+    OPS_ENTRY(scatter3_32, "scatter3", "default", 32, OPS_THIRD(32)),
+    OPS_ENTRY(scatter3_64, "scatter3", "default", 64, OPS_THIRD(64)),
+    OPS_ENTRY(gather_8, "gather", "default", 8, OPS_ALL),
+    OPS_ENTRY(gather_16, "gather", "default", 16, OPS_ALL),
+    OPS_ENTRY(gather_32, "gather", "default", 32, OPS_ALL),
+    OPS_ENTRY(gather_64, "gather", "default", 64, OPS_ALL),
+    OPS_ENTRY(gather3_8, "gather3", "default", 8, OPS_ALL),
+    OPS_ENTRY(gather3_16, "gather3", "default", 16, OPS_ALL),
+    OPS_ENTRY(gather3_32, "gather3", "default", 32, OPS_ALL),
+    OPS_ENTRY(gather3_64, "gather3", "default", 64, OPS_ALL),
+    OPS_ENTRY(merge_8, "merge", "default", 8, OPS_HALF(8)),
+    OPS_ENTRY(merge_nwe_8, "merge", "nwe", 8, OPS_HALF(8)),
+    OPS_ENTRY(merge_16, "merge", "default", 16, OPS_HALF(16)),
+    OPS_ENTRY(merge_nwe_16, "merge", "nwe", 16, OPS_HALF(16)),
+    OPS_ENTRY(merge_32, "merge", "default", 32, OPS_HALF(32)),
+    OPS_ENTRY(merge_nwe_32, "merge", "nwe", 32, OPS_HALF(32)),
+    OPS_ENTRY(merge_64, "merge", "default", 64, OPS_HALF(64)),
+    OPS_ENTRY(merge3_8, "merge3", "default", 8, OPS_THIRD(8)),
+    OPS_ENTRY(merge3_16, "merge3", "default", 16, OPS_THIRD(16)),
+    OPS_ENTRY(merge3_32, "merge3", "default", 32, OPS_THIRD(32)),
+    OPS_ENTRY(merge3_64, "merge3", "default", 64, OPS_THIRD(64)),
+    OPS_ENTRY(separate_8, "separate", "default", 8, OPS_ALL),
+    OPS_ENTRY(separate_nwe_8, "separate", "nwe", 8, OPS_ALL),
+    OPS_ENTRY(separate_16, "separate", "default", 16, OPS_ALL),
+    OPS_ENTRY(separate_nwe_16, "separate", "nwe", 16, OPS_ALL),
+    OPS_ENTRY(separate_32, "separate", "default", 32, OPS_ALL),
+    OPS_ENTRY(separate_nwe_32, "separate", "nwe", 32, OPS_ALL),
+    OPS_ENTRY(separate_64, "separate", "default", 64, OPS_ALL),
+    OPS_ENTRY(separate3_8, "separate3", "default", 8, OPS_ALL),
+    OPS_ENTRY(separate3_16, "separate3", "default", 16, OPS_ALL),
+    OPS_ENTRY(separate3_32, "separate3", "default", 32, OPS_ALL),
+    OPS_ENTRY(separate3_64, "separate3", "default", 64, OPS_ALL),
+    OPS_STEP_ENTRIES(xm, ),
+    OPS_STEP_ENTRIES(xp, ),
+    OPS_STEP_ENTRIES(ym, ),
+    OPS_STEP_ENTRIES(yp, ),
+    OPS_STEP_ENTRIES(xm, 3),
+    OPS_STEP_ENTRIES(xp, 3),
+    OPS_STEP_ENTRIES(ym, 3),
+    OPS_STEP_ENTRIES(yp, 3),
+    OPS_STEP_ENTRIES(zm, 3),
+    OPS_STEP_ENTRIES(zp, 3),
+};
+
+static const char *const ops_sources[] = {"popcount.h", "shift.h", "morton.h"};
+
+/*
+ * The op count documented for function name: the sum of the counts on the
+ * Complexity line of its doc comment. Returns -1 if the function isn't found
+ * or its count depends on the data ("for each set bit").
+ */
+static double ops_documented(const char *name)
+{
+    static char text[sizeof(ops_sources) / sizeof(ops_sources[0])][1 << 16];
+    static int loaded = 0;
+    char pattern[64], *p, *c, *line, *end;
+    double total = 0.0;
+    size_t f, n;
+
+    if (!loaded) {
+        for (f = 0; f < sizeof(ops_sources) / sizeof(ops_sources[0]); ++f) {
+            FILE *file;
+            snprintf(pattern, sizeof(pattern), "%s/%s", BITLIB_SRC_DIR, ops_sources[f]);
+            file = fopen(pattern, "r");
+            n = file != NULL ? fread(text[f], 1, sizeof(text[f]) - 1, file) : 0;
+            text[f][n] = 0;
+            if (file != NULL) {
+                fclose(file);
+            }
+        }
+        loaded = 1;
+    }
+    snprintf(pattern, sizeof(pattern), " %s(", name);
+    for (f = 0; f < sizeof(ops_sources) / sizeof(ops_sources[0]); ++f) {
+        p = strstr(text[f], pattern);
+        if (p == NULL) {
+            continue;
+        }
+        line = NULL;
+        for (c = strstr(text[f], "Complexity:"); c != NULL && c < p;
+             c = strstr(c + 1, "Complexity:")) {
+            line = c;
+        }
+        if (line == NULL) {
+            return -1.0;
+        }
+        end = strchr(line, '\n');
+        for (c = line; c < end; ++c) {
+            if (strncmp(c, "each", 4) == 0) {
+                return -1.0;
+            }
+            if (*c >= '0' && *c <= '9') {
+                total += (double)strtol(c, &c, 10);
+            }
+        }
+        return total;
+    }
+    return -1.0;
+}
+
+/* A count per call, or - if the counter is unavailable */
+static void ops_print_count(const char *label, double count, double ops)
+{
+    if (count < 0.0) {
+        printf(" %s -", label);
+    } else {
+        printf(" %s %.2f", label, count / ops);
+    }
+}
+
+/* A count per call as JSON, or null if the counter is unavailable */
+static void ops_json_count(const char *key, double count, double ops)
+{
+    if (count < 0.0) {
+        fprintf(bench_json, ", \"%s\": null", key);
+    } else {
+        fprintf(bench_json, ", \"%s\": %.3f", key, count / ops);
+    }
+}
+
+void bench_ops()
+{
+    static uint64_t in[OPS_INPUTS];
+    double ops = (double)OPS_INPUTS * OPS_REPS, documented, instructions, overhead = 0.0, d;
+    struct ops_result lat, thr, base, unused;
+    size_t e;
+    unsigned dist;
+    int diverges;
+
+    if (bench_perf && perf_open(&ops_perf, bench_uops) == 0) {
+        printf("ops: hardware counters are unavailable\n");
+        bench_perf = 0;
+    }
+    ops_counting = bench_perf;
+    for (dist = 0; dist < sizeof(ops_dists) / sizeof(ops_dists[0]); ++dist) {
+        if (bench_dist != NULL && strcmp(bench_dist, ops_dists[dist]) != 0) {
+            continue;
+        }
+        ops_inputs(dist, in);
+        if (bench_perf) {
+            ops_OPS_NONE(in, OPS_ALL, &base, &unused);
+            overhead = base.counts[PERF_INSTRUCTIONS];
+        }
+        for (e = 0; e < sizeof(ops_entries) / sizeof(ops_entries[0]); ++e) {
+            const struct ops_entry *o = &ops_entries[e];
+            o->run(in, o->mask, &lat, &thr);
+            printf("ops %-18s dist=%-6s latency %6.2f ns/op, throughput %6.2f ns/op\n",
+                   o->name, ops_dists[dist], lat.seconds * 1e9 / ops, thr.seconds * 1e9 / ops);
+
+            /* Instructions per call beyond the loop overhead against the
+             * documented op count, with some slack for the calling code */
+            documented = ops_documented(o->name);
+            instructions = lat.counts[PERF_INSTRUCTIONS] >= 0.0 && overhead >= 0.0 ?
+                           (lat.counts[PERF_INSTRUCTIONS] - overhead) / ops : -1.0;
+            d = instructions - documented;
+            diverges = documented >= 0.0 && instructions >= 0.0 &&
+                       (d < 0.0 ? -d : d) > 0.5 * documented + 4.0;
+            if (bench_perf) {
+                printf("   ");
+                ops_print_count("cycles", lat.counts[PERF_CYCLES], ops);
+                ops_print_count("instructions", instructions < 0.0 ? -1.0 : instructions * ops,
+                                ops);
+                ops_print_count("documented", documented < 0.0 ? -1.0 : documented * ops, ops);
+                ops_print_count("branch misses", lat.counts[PERF_BRANCH_MISSES], ops);
+                ops_print_count("uops", lat.counts[PERF_UOPS], ops);
+                printf(" per call%s\n", diverges ? "  DIVERGES" : "");
+            }
+            if (bench_json != NULL) {
+                bench_json_next();
+                fprintf(bench_json, "{\"bench\": \"ops\", \"function\": \"%s\", "
+                        "\"family\": \"%s\", \"flavor\": \"%s\", \"width\": %u, "
+                        "\"dist\": \"%s\", \"latency_ns\": %.3f, \"throughput_ns\": %.3f",
+                        o->name, o->family, o->flavor, o->width, ops_dists[dist],
+                        lat.seconds * 1e9 / ops, thr.seconds * 1e9 / ops);
+                if (bench_perf) {
+                    ops_json_count("cycles", lat.counts[PERF_CYCLES], ops);
+                    ops_json_count("throughput_cycles", thr.counts[PERF_CYCLES], ops);
+                    ops_json_count("instructions", instructions < 0.0 ? -1.0 : instructions * ops,
+                                   ops);
+                    ops_json_count("branch_misses", lat.counts[PERF_BRANCH_MISSES], ops);
+                    ops_json_count("uops", lat.counts[PERF_UOPS], ops);
+                    ops_json_count("documented_ops", documented < 0.0 ? -1.0 : documented * ops,
+                                   ops);
+                    fprintf(bench_json, ", \"diverges\": %s", diverges ? "true" : "false");
+                }
+                fprintf(bench_json, "}");
+            }
+        }
+    }
+    if (bench_perf) {
+        perf_close(&ops_perf);
+    }
+}
@@ -0,0 +1,196 @@
+#ifndef BITLIB_BENCH_OPS_H
+#define BITLIB_BENCH_OPS_H
+
+/*
+ * Timing loops for single functions, shared by the ops benchmark and the
+ * autotuner. Every function is timed twice over the same inputs:
+ * latency-bound, with each call's argument depending on the previous result,
+ * and throughput-bound, with independent calls. Each function gets its own
+ * pair of loops, generated by the macros below, so that it is inlined as in
+ * real use; an indirect call would cost more than most of the functions
+ * themselves. Arguments are masked to the input range of the function (e.g.
+ * the lower half for scatter). With ops_counting set, hardware counters are
+ * read around every loop as well.
+ */
+
+#include "common.h"
+#include "perf.h"
+
+#define OPS_INPUTS (1 << 12)
+#define OPS_REPS 256
+
+#define OPS_ALL 0xffffffffffffffff
+#define OPS_HALF(w) (OPS_ALL >> (64 - (w) / 2))
+#define OPS_THIRD(w) (OPS_ALL >> (64 - (w) / 3))
+
+struct ops_result {
+    double seconds;
+    double counts[PERF_COUNTERS];
+};
+
+typedef void (*ops_kernel)(const uint64_t *in, uint64_t mask, struct ops_result *lat,
+                           struct ops_result *thr);
+
+static volatile uint64_t ops_sink;
+static struct perf_counters ops_perf;
+static int ops_counting = 0;
+static double ops_t0;
+
+static inline void ops_begin(void)
+{
+    if (ops_counting) {
+        perf_start(&ops_perf);
+    }
+    ops_t0 = bench_seconds();
+}
+
+static inline void ops_end(struct ops_result *r)
+{
+    unsigned i;
+
+    r->seconds = bench_seconds() - ops_t0;
+    if (ops_counting) {
+        perf_stop(&ops_perf, r->counts);
+    } else {
+        for (i = 0; i < PERF_COUNTERS; ++i) {
+            r->counts[i] = -1.0;
+        }
+    }
+}
+
+#define OPS_UNARY(f, T)                                                             \
+static void ops_##f(const uint64_t *in, uint64_t mask, struct ops_result *lat,      \
+                    struct ops_result *thr)                                         \
+{                                                                                   \
+    T x = 0, s = 0;                                                                 \
+    size_t i, r;                                                                    \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            x = f((T)((in[i] ^ x) & mask));                                         \
+        }                                                                           \
+    }                                                                               \
+    ops_end(lat);                                                                   \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            s += f((T)((in[i] ^ r) & mask));                                        \
+        }                                                                           \
+    }                                                                               \
+    ops_end(thr);                                                                   \
+    ops_sink = (uint64_t)x + s;                                                     \
+}
+
+#define OPS_BINARY(f, T)                                                            \
+static void ops_##f(const uint64_t *in, uint64_t mask, struct ops_result *lat,      \
+                    struct ops_result *thr)                                         \
+{                                                                                   \
+    T x = 0, s = 0;                                                                 \
+    size_t i, r;                                                                    \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            x = f((T)((in[i] ^ x) & mask), (T)(in[i] >> 32 & mask));                \
+        }                                                                           \
+    }                                                                               \
+    ops_end(lat);                                                                   \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            s += f((T)((in[i] ^ r) & mask), (T)(in[i] >> 32 & mask));               \
+        }                                                                           \
+    }                                                                               \
+    ops_end(thr);                                                                   \
+    ops_sink = (uint64_t)x + s;                                                     \
+}
+
+#define OPS_TERNARY(f, T)                                                           \
+static void ops_##f(const uint64_t *in, uint64_t mask, struct ops_result *lat,      \
+                    struct ops_result *thr)                                         \
+{                                                                                   \
+    T x = 0, s = 0;                                                                 \
+    size_t i, r;                                                                    \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            x = f((T)((in[i] ^ x) & mask), (T)(in[i] >> 21 & mask),                 \
+                  (T)(in[i] >> 42 & mask));                                         \
+        }                                                                           \
+    }                                                                               \
+    ops_end(lat);                                                                   \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            s += f((T)((in[i] ^ r) & mask), (T)(in[i] >> 21 & mask),                \
+                   (T)(in[i] >> 42 & mask));                                        \
+        }                                                                           \
+    }                                                                               \
+    ops_end(thr);                                                                   \
+    ops_sink = (uint64_t)x + s;                                                     \
+}
+
+#define OPS_SEPARATE(f, T)                                                          \
+static void ops_##f(const uint64_t *in, uint64_t mask, struct ops_result *lat,      \
+                    struct ops_result *thr)                                         \
+{                                                                                   \
+    T x = 0, y = 0, s = 0;                                                          \
+    size_t i, r;                                                                    \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            f((T)((in[i] ^ x ^ y) & mask), &x, &y);                                 \
+        }                                                                           \
+    }                                                                               \
+    ops_end(lat);                                                                   \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            T a, b;                                                                 \
+            f((T)((in[i] ^ r) & mask), &a, &b);                                     \
+            s += a ^ b;                                                             \
+        }                                                                           \
+    }                                                                               \
+    ops_end(thr);                                                                   \
+    ops_sink = (uint64_t)(x ^ y) + s;                                               \
+}
+
+#define OPS_SEPARATE3(f, T)                                                         \
+static void ops_##f(const uint64_t *in, uint64_t mask, struct ops_result *lat,      \
+                    struct ops_result *thr)                                         \
+{                                                                                   \
+    T x = 0, y = 0, z = 0, s = 0;                                                   \
+    size_t i, r;                                                                    \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            f((T)((in[i] ^ x ^ y ^ z) & mask), &x, &y, &z);                         \
+        }                                                                           \
+    }                                                                               \
+    ops_end(lat);                                                                   \
+    ops_begin();                                                                    \
+    for (r = 0; r < OPS_REPS; ++r) {                                                \
+        for (i = 0; i < OPS_INPUTS; ++i) {                                          \
+            T a, b, c;                                                              \
+            f((T)((in[i] ^ r) & mask), &a, &b, &c);                                 \
+            s += a ^ b ^ c;                                                         \
+        }                                                                           \
+    }                                                                               \
+    ops_end(thr);                                                                   \
+    ops_sink = (uint64_t)(x ^ y ^ z) + s;                                           \
+}
+
+/* Input distributions: about 1/8 of the bits set, random, about 7/8 set */
+static const char *const ops_dists[] = {"sparse", "random", "dense"};
+
+static inline void ops_inputs(unsigned dist, uint64_t *in)
+{
+    uint64_t s = 0x9e3779b97f4a7c15;
+    size_t i;
+
+    for (i = 0; i < OPS_INPUTS; ++i) {
+        uint64_t a = bench_rand(&s), b = bench_rand(&s), c = bench_rand(&s);
+        in[i] = dist == 0 ? a & b & c : dist == 1 ? a : a | b | c;
+    }
+}
+
+#endif //BITLIB_BENCH_OPS_H
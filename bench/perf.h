@@ -0,0 +1,166 @@
+#ifndef BITLIB_BENCH_PERF_H
+#define BITLIB_BENCH_PERF_H
+
+/*
+ * Hardware counters for the benchmarks through perf_event_open, on Linux only.
+ * Counters count user space only. Where they can't be opened (other systems,
+ * perf_event_paranoid, containers, virtual machines without a PMU), their
+ * values read as -1.
+ *
+ * The counters are opened as one group, so they are scheduled onto the PMU
+ * together and count the same instructions; their ratios (e.g. instructions
+ * per cycle) stay meaningful. If the kernel has to multiplex the group with
+ * other events, the counts are scaled up by the time enabled over the time
+ * running.
+ */
+
+#include <stdint.h>
+
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_BRANCH_MISSES 2
+#define PERF_UOPS 3
+#define PERF_COUNTERS 4
+
+struct perf_counters {
+    int fd[PERF_COUNTERS];
+    int leader;                 /* the first counter opened, or -1 */
+    int slot[PERF_COUNTERS];    /* position of each counter in a group read */
+};
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+
+static inline int perf_open_counter(uint32_t type, uint64_t config, int group)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/*
+ * Open the counters, the first one that can be opened as the group leader.
+ * Retired uops have no generic event, so they are counted with the model
+ * specific raw event uops (e.g. 0x01c2, UOPS_RETIRED.ALL on Intel Skylake),
+ * or not at all if uops is 0. Returns the number of counters opened.
+ */
+static inline int perf_open(struct perf_counters *p, uint64_t uops)
+{
+    static const uint32_t type[PERF_COUNTERS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_RAW
+    };
+    const uint64_t config[PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, uops
+    };
+    int i, count = 0;
+
+    p->leader = -1;
+    for (i = 0; i < PERF_COUNTERS; ++i) {
+        p->fd[i] = -1;
+        p->slot[i] = -1;
+        if (i == PERF_UOPS && uops == 0) {
+            continue;
+        }
+        p->fd[i] = perf_open_counter(type[i], config[i], p->leader);
+        if (p->fd[i] >= 0) {
+            p->leader = p->leader < 0 ? p->fd[i] : p->leader;
+            p->slot[i] = count++;
+        }
+    }
+    return count;
+}
+
+static inline void perf_close(struct perf_counters *p)
+{
+    int i;
+
+    /* Members first, the leader last */
+    for (i = PERF_COUNTERS - 1; i >= 0; --i) {
+        if (p->fd[i] >= 0) {
+            close(p->fd[i]);
+        }
+    }
+}
+
+static inline void perf_start(const struct perf_counters *p)
+{
+    if (p->leader >= 0) {
+        ioctl(p->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(p->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static inline void perf_stop(const struct perf_counters *p, double *values)
+{
+    /* nr, time enabled, time running, then one value per counter */
+    uint64_t buf[3 + PERF_COUNTERS];
+    double scale = 0;
+    int i;
+
+    if (p->leader >= 0) {
+        ioctl(p->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if (read(p->leader, buf, sizeof(buf)) >= (ssize_t)(3 * sizeof(uint64_t)) &&
+            buf[2] > 0) {
+            scale = (double)buf[1] / (double)buf[2];
+        }
+    }
+    for (i = 0; i < PERF_COUNTERS; ++i) {
+        values[i] = -1.0;
+        if (scale > 0 && p->slot[i] >= 0 && (uint64_t)p->slot[i] < buf[0]) {
+            values[i] = (double)buf[3 + p->slot[i]] * scale;
+        }
+    }
+}
+
+#else
+
+static inline int perf_open(struct perf_counters *p, uint64_t uops)
+{
+    int i;
+
+    (void)uops;
+    p->leader = -1;
+    for (i = 0; i < PERF_COUNTERS; ++i) {
+        p->fd[i] = -1;
+        p->slot[i] = -1;
+    }
+    return 0;
+}
+
+static inline void perf_close(struct perf_counters *p)
+{
+    (void)p;
+}
+
+static inline void perf_start(const struct perf_counters *p)
+{
+    (void)p;
+}
+
+static inline void perf_stop(const struct perf_counters *p, double *values)
+{
+    int i;
+
+    (void)p;
+    for (i = 0; i < PERF_COUNTERS; ++i) {
+        values[i] = -1.0;
+    }
+}
+
+#endif
+
+#endif //BITLIB_BENCH_PERF_H
@@ -0,0 +1,112 @@
+#include "search.h"
+#include "morton.h"
+#include "sort.h"
+#include "common.h"
+
+#include <stdlib.h>
+
+#define SEARCH_QUERIES (1 << 20)
+
+/* Plain binary search, the baseline (what std::lower_bound does) */
+static size_t search_binary(const uint64_t *keys, size_t n, uint64_t x)
+{
+    size_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid] < x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void search_report(const char *layout, size_t n, double t, size_t check)
+{
+    printf("search layout=%-16s n=%-9zu %.2f ns/query (check %zu)\n",
+           layout, n, t * 1e9 / SEARCH_QUERIES, check);
+}
+
+static void search_run(size_t n, uint64_t *s)
+{
+    uint64_t *keys = malloc(n * sizeof(uint64_t)), *tk = malloc(n * sizeof(uint64_t));
+    uint32_t *vals = malloc(n * sizeof(uint32_t)), *tv = malloc(n * sizeof(uint32_t));
+    uint64_t *e = malloc((n + 1) * sizeof(uint64_t)), *tree, *xs;
+    size_t *out = malloc(SEARCH_QUERIES * sizeof(size_t)), i, size, check;
+    struct stree t;
+    double t0;
+
+    /* Morton codes of random 2D points, as sorted by a point index */
+    for (i = 0; i < n; ++i) {
+        keys[i] = morton_64(bench_rand(s) >> 40, bench_rand(s) >> 40);
+        vals[i] = (uint32_t)i;
+    }
+    radixsort_64(keys, vals, n, tk, tv, 48);
+    xs = malloc(SEARCH_QUERIES * sizeof(uint64_t));
+    for (i = 0; i < SEARCH_QUERIES; ++i) {
+        xs[i] = morton_64(bench_rand(s) >> 40, bench_rand(s) >> 40);
+    }
+
+    eytzinger_build_64(keys, n, e, 1, n + 1);
+    size = stree_init(&t, n);
+    tree = malloc(size * sizeof(uint64_t));
+    stree_build_64(&t, keys, tree, 0, size);
+
+    check = 0;
+    t0 = bench_seconds();
+    for (i = 0; i < SEARCH_QUERIES; ++i) {
+        check += search_binary(keys, n, xs[i]);
+    }
+    search_report("binary", n, bench_seconds() - t0, check);
+
+    check = 0;
+    t0 = bench_seconds();
+    for (i = 0; i < SEARCH_QUERIES; ++i) {
+        check += eytzinger_lower_bound_64(e, n, xs[i]);
+    }
+    search_report("eytzinger", n, bench_seconds() - t0, check);
+
+    check = 0;
+    t0 = bench_seconds();
+    eytzinger_lower_bound_bulk_64(e, n, xs, SEARCH_QUERIES, out);
+    for (i = 0; i < SEARCH_QUERIES; ++i) {
+        check += out[i];
+    }
+    search_report("eytzinger bulk", n, bench_seconds() - t0, check);
+
+    check = 0;
+    t0 = bench_seconds();
+    for (i = 0; i < SEARCH_QUERIES; ++i) {
+        check += stree_lower_bound_64(&t, tree, xs[i]);
+    }
+    search_report("stree", n, bench_seconds() - t0, check);
+
+    check = 0;
+    t0 = bench_seconds();
+    stree_lower_bound_bulk_64(&t, tree, xs, SEARCH_QUERIES, out);
+    for (i = 0; i < SEARCH_QUERIES; ++i) {
+        check += out[i];
+    }
+    search_report("stree bulk", n, bench_seconds() - t0, check);
+
+    free(keys);
+    free(tk);
+    free(vals);
+    free(tv);
+    free(e);
+    free(tree);
+    free(xs);
+    free(out);
+}
+
+void bench_search()
+{
+    uint64_t s = 0x2545f4914f6cdd1d;
+
+    /* In L1/L2, in L3 and in main memory */
+    search_run((size_t)1 << 10, &s);
+    search_run((size_t)1 << 16, &s);
+    search_run((size_t)1 << 23, &s);
+}
@@ -0,0 +1,157 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "popcount.h"
+#include "shift.h"
+#include "bitscan.h"
+#include "common.h"
+#include "ops.h"
+
+#include <string.h>
+
+/*
+ * bitlib_tune [FILE]
+ *
+ * Times every flavor of the functions that have several (popcount, ctz, merge,
+ * separate) on the build machine and writes FILE (bitlib_tuned.h by default),
+ * which maps the unflavored names to the fastest flavors. A flavor's score is
+ * its latency-bound plus throughput-bound time over the sparse, random and
+ * dense inputs, the best of TUNE_ROUNDS runs.
+ */
+
+#define TUNE_ROUNDS 3
+#define TUNE_MAXFLAVORS 3
+
+OPS_UNARY(popcount_32, uint32_t)
+OPS_UNARY(popcount_mul_32, uint32_t)
+OPS_UNARY(popcount_iter_32, uint32_t)
+OPS_UNARY(popcount_64, uint64_t)
+OPS_UNARY(popcount_mul_64, uint64_t)
+OPS_UNARY(popcount_iter_64, uint64_t)
+OPS_UNARY(ctz_32, uint32_t)
+OPS_UNARY(ctz_mul_32, uint32_t)
+OPS_UNARY(ctz_64, uint64_t)
+OPS_UNARY(ctz_mul_64, uint64_t)
+OPS_BINARY(merge_8, uint8_t)
+OPS_BINARY(merge_nwe_8, uint8_t)
+OPS_BINARY(merge_16, uint16_t)
+OPS_BINARY(merge_nwe_16, uint16_t)
+OPS_BINARY(merge_32, uint32_t)
+OPS_BINARY(merge_nwe_32, uint32_t)
+OPS_SEPARATE(separate_8, uint8_t)
+OPS_SEPARATE(separate_nwe_8, uint8_t)
+OPS_SEPARATE(separate_16, uint16_t)
+OPS_SEPARATE(separate_nwe_16, uint16_t)
+OPS_SEPARATE(separate_32, uint32_t)
+OPS_SEPARATE(separate_nwe_32, uint32_t)
+
+struct tune_flavor {
+    const char *name;
+    ops_kernel run;
+};
+
+/* A function with several flavors; the first one is the unflavored name. */
+struct tune_op {
+    const char *header;
+    uint64_t mask;
+    struct tune_flavor flavors[TUNE_MAXFLAVORS];
+};
+
+#define TUNE_FLAVOR(f) {#f, ops_##f}
+
+static const struct tune_op tune_ops[] = {
+    {"POPCOUNT", OPS_ALL, {TUNE_FLAVOR(popcount_32), TUNE_FLAVOR(popcount_mul_32),
+                           TUNE_FLAVOR(popcount_iter_32)}},
+    {"POPCOUNT", OPS_ALL, {TUNE_FLAVOR(popcount_64), TUNE_FLAVOR(popcount_mul_64),
+                           TUNE_FLAVOR(popcount_iter_64)}},
+    {"BITSCAN", OPS_ALL, {TUNE_FLAVOR(ctz_32), TUNE_FLAVOR(ctz_mul_32)}},
+    {"BITSCAN", OPS_ALL, {TUNE_FLAVOR(ctz_64), TUNE_FLAVOR(ctz_mul_64)}},
+    {"SHIFT", OPS_HALF(8), {TUNE_FLAVOR(merge_8), TUNE_FLAVOR(merge_nwe_8)}},
+    {"SHIFT", OPS_HALF(16), {TUNE_FLAVOR(merge_16), TUNE_FLAVOR(merge_nwe_16)}},
+    {"SHIFT", OPS_HALF(32), {TUNE_FLAVOR(merge_32), TUNE_FLAVOR(merge_nwe_32)}},
+    {"SHIFT", OPS_ALL, {TUNE_FLAVOR(separate_8), TUNE_FLAVOR(separate_nwe_8)}},
+    {"SHIFT", OPS_ALL, {TUNE_FLAVOR(separate_16), TUNE_FLAVOR(separate_nwe_16)}},
+    {"SHIFT", OPS_ALL, {TUNE_FLAVOR(separate_32), TUNE_FLAVOR(separate_nwe_32)}},
+};
+
+static const char *const tune_headers[] = {"POPCOUNT", "BITSCAN", "SHIFT"};
+
+#define TUNE_NOPS (sizeof(tune_ops) / sizeof(tune_ops[0]))
+
+/* The score of flavor f of op o in ns per call */
+static double tune_score(const struct tune_op *o, unsigned f, uint64_t (*in)[OPS_INPUTS])
+{
+    struct ops_result lat, thr;
+    double total = 0.0, best;
+    unsigned dist, round;
+
+    for (dist = 0; dist < sizeof(ops_dists) / sizeof(ops_dists[0]); ++dist) {
+        best = -1.0;
+        for (round = 0; round < TUNE_ROUNDS; ++round) {
+            o->flavors[f].run(in[dist], o->mask, &lat, &thr);
+            if (best < 0.0 || lat.seconds + thr.seconds < best) {
+                best = lat.seconds + thr.seconds;
+            }
+        }
+        total += best;
+    }
+    return total * 1e9 / ((double)OPS_INPUTS * OPS_REPS);
+}
+
+int main(int argc, char **argv)
+{
+    static uint64_t in[sizeof(ops_dists) / sizeof(ops_dists[0])][OPS_INPUTS];
+    const char *path = argc > 1 ? argv[1] : "bitlib_tuned.h";
+    unsigned winner[TUNE_NOPS], f, dist;
+    double score[TUNE_NOPS][TUNE_MAXFLAVORS];
+    size_t o, h;
+    FILE *out;
+
+    for (dist = 0; dist < sizeof(ops_dists) / sizeof(ops_dists[0]); ++dist) {
+        ops_inputs(dist, in[dist]);
+    }
+    for (o = 0; o < TUNE_NOPS; ++o) {
+        winner[o] = 0;
+        for (f = 0; f < TUNE_MAXFLAVORS && tune_ops[o].flavors[f].name != NULL; ++f) {
+            score[o][f] = tune_score(&tune_ops[o], f, in);
+            printf("tune %-18s %8.2f ns\n", tune_ops[o].flavors[f].name, score[o][f]);
+            if (score[o][f] < score[o][winner[o]]) {
+                winner[o] = f;
+            }
+        }
+    }
+
+    out = fopen(path, "w");
+    if (out == NULL) {
+        perror(path);
+        return 1;
+    }
+    fprintf(out, "/**\n"
+                 " * Generated by bitlib_tune: the fastest flavor of every function that has\n"
+                 " * several, as measured on the machine it ran on. Build with\n"
+                 " * -DBITLIB_TUNED='\"bitlib_tuned.h\"' to make the unflavored names refer to\n"
+                 " * them. Each section is applied at the end of its header.\n"
+                 " */\n");
+    for (h = 0; h < sizeof(tune_headers) / sizeof(tune_headers[0]); ++h) {
+        fprintf(out, "\n#if defined(BITLIB_%s_DONE) && !defined(BITLIB_TUNED_%s)\n"
+                     "#define BITLIB_TUNED_%s\n",
+                tune_headers[h], tune_headers[h], tune_headers[h]);
+        for (o = 0; o < TUNE_NOPS; ++o) {
+            const struct tune_flavor *fl = tune_ops[o].flavors;
+            if (strcmp(tune_ops[o].header, tune_headers[h]) != 0) {
+                continue;
+            }
+            if (winner[o] == 0) {
+                fprintf(out, "/* %s: unflavored, %.2f ns */\n", fl[0].name, score[o][0]);
+            } else {
+                fprintf(out, "#define %s %s /* %.2f ns, unflavored %.2f ns */\n", fl[0].name,
+                        fl[winner[o]].name, score[o][winner[o]], score[o][0]);
+            }
+        }
+        fprintf(out, "#endif\n");
+    }
+    fclose(out);
+    printf("tune: wrote %s\n", path);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "zorder.h"
+#include "sort.h"
+#include "common.h"
+
+#include <stdlib.h>
+
+#define ZORDER_ROWS (1 << 20)
+#define ZORDER_BLOCK 4096
+#define ZORDER_BLOCKS (ZORDER_ROWS / ZORDER_BLOCK)
+#define ZORDER_COLS 3
+
+struct zorder_filter {
+    const char *name;
+    double lo[ZORDER_COLS], hi[ZORDER_COLS];
+};
+
+/* Filters as fractions of each column's value range; [0; 1] means unfiltered. */
+static const struct zorder_filter zorder_filters[] = {
+    {"int 1%", {0.50, 0.00, 0.00}, {0.51, 1.00, 1.00}},
+    {"float 1%", {0.00, 0.20, 0.00}, {1.00, 0.21, 1.00}},
+    {"string 1%", {0.00, 0.00, 0.70}, {1.00, 1.00, 0.71}},
+    {"int+float 10%", {0.30, 0.60, 0.00}, {0.40, 0.70, 1.00}},
+    {"all 20%", {0.10, 0.40, 0.70}, {0.30, 0.60, 0.90}},
+};
+
+/* Value of the float column at the given fraction of its range */
+static float zorder_float(double frac)
+{
+    return (float)(frac * 1000.0);
+}
+
+/* Key of the value at the given fraction of the value range of column c */
+static uint32_t zorder_key(unsigned c, double frac)
+{
+    uint32_t v;
+    char str[4];
+
+    switch (c) {
+    case 0:
+        return zkey_i32((int32_t)(frac * 2000000) - 1000000);
+    case 1:
+        return zkey_f32(zorder_float(frac));
+    default:
+        v = (uint32_t)(frac * (26.0 * 26 * 26 * 26 - 1));
+        str[3] = 'a' + (char)(v % 26);
+        str[2] = 'a' + (char)(v / 26 % 26);
+        str[1] = 'a' + (char)(v / 676 % 26);
+        str[0] = 'a' + (char)(v / 17576 % 26);
+        return zkey_prefix_32(str, 4);
+    }
+}
+
+static void zorder_report(const char *layout, uint32_t *const *cols, const uint32_t *rows)
+{
+    static uint32_t min[ZORDER_COLS][ZORDER_BLOCKS], max[ZORDER_COLS][ZORDER_BLOCKS];
+    const uint32_t *mins[ZORDER_COLS], *maxs[ZORDER_COLS];
+    uint32_t qlo[ZORDER_COLS], qhi[ZORDER_COLS];
+    uint64_t mask[(ZORDER_BLOCKS + 63) / 64];
+    size_t f, scan;
+    unsigned c;
+
+    for (c = 0; c < ZORDER_COLS; ++c) {
+        zonemap_build_32(cols[c], rows, ZORDER_ROWS, ZORDER_BLOCK, min[c], max[c]);
+        mins[c] = min[c];
+        maxs[c] = max[c];
+    }
+    for (f = 0; f < sizeof(zorder_filters) / sizeof(zorder_filters[0]); ++f) {
+        for (c = 0; c < ZORDER_COLS; ++c) {
+            qlo[c] = zorder_key(c, zorder_filters[f].lo[c]);
+            qhi[c] = zorder_key(c, zorder_filters[f].hi[c]);
+        }
+        scan = zonemap_filter_32(mins, maxs, ZORDER_COLS, ZORDER_BLOCKS, qlo, qhi, mask);
+        printf("zorder layout=%-8s filter=%-14s blocks=%d skipped=%zu (%.1f%%)\n",
+               layout, zorder_filters[f].name, ZORDER_BLOCKS, ZORDER_BLOCKS - scan,
+               100.0 * (ZORDER_BLOCKS - scan) / ZORDER_BLOCKS);
+    }
+}
+
+static void zorder_free(uint32_t **cols, uint32_t **stretched, uint32_t *rows, uint32_t *tv,
+                        uint64_t *keys, uint64_t *tk)
+{
+    unsigned c;
+
+    for (c = 0; c < ZORDER_COLS; ++c) {
+        free(cols[c]);
+        free(stretched[c]);
+    }
+    free(rows);
+    free(tv);
+    free(keys);
+    free(tk);
+}
+
+void bench_zorder()
+{
+    uint32_t *cols[ZORDER_COLS], *stretched[ZORDER_COLS], *rows, *tv;
+    unsigned bits = zkey_bits(ZORDER_COLS);
+    uint64_t *keys, *tk, s = 0x853c49e6748fea9b;
+    uint32_t lo[ZORDER_COLS], hi[ZORDER_COLS];
+    double t0, t1, t2;
+    unsigned c;
+    size_t i;
+    int ok;
+
+    rows = malloc(ZORDER_ROWS * sizeof(uint32_t));
+    tv = malloc(ZORDER_ROWS * sizeof(uint32_t));
+    keys = malloc(ZORDER_ROWS * sizeof(uint64_t));
+    tk = malloc(ZORDER_ROWS * sizeof(uint64_t));
+    ok = rows != NULL && tv != NULL && keys != NULL && tk != NULL;
+    for (c = 0; c < ZORDER_COLS; ++c) {
+        cols[c] = malloc(ZORDER_ROWS * sizeof(uint32_t));
+        stretched[c] = malloc(ZORDER_ROWS * sizeof(uint32_t));
+        ok = ok && cols[c] != NULL && stretched[c] != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "zorder: out of memory\n");
+        zorder_free(cols, stretched, rows, tv, keys, tk);
+        return;
+    }
+
+    /* An int, a float and a string column, all uncorrelated */
+    for (i = 0; i < ZORDER_ROWS; ++i) {
+        double f = (double)(bench_rand(&s) >> 11) / 9007199254740992.0;
+        cols[0][i] = zorder_key(0, (double)(bench_rand(&s) >> 11) / 9007199254740992.0);
+        cols[1][i] = zorder_key(1, f);
+        stretched[1][i] = zkey_range_f64(zorder_float(f), 0.0, 1000.0, bits);
+        cols[2][i] = zorder_key(2, (double)(bench_rand(&s) >> 11) / 9007199254740992.0);
+    }
+    for (c = 0; c < ZORDER_COLS; ++c) {
+        zkey_minmax_32(cols[c], ZORDER_ROWS, lo + c, hi + c);
+    }
+
+    for (i = 0; i < ZORDER_ROWS; ++i) {
+        rows[i] = (uint32_t)i;
+    }
+    zorder_report("insert", cols, NULL);
+
+    /* Linear order: sort by the first column only */
+    for (i = 0; i < ZORDER_ROWS; ++i) {
+        keys[i] = cols[0][i];
+        rows[i] = (uint32_t)i;
+    }
+    radixsort_64(keys, rows, ZORDER_ROWS, tk, tv, 32);
+    zorder_report("linear", cols, rows);
+
+    for (i = 0; i < ZORDER_ROWS; ++i) {
+        rows[i] = (uint32_t)i;
+    }
+    t0 = bench_seconds();
+    for (i = 0; i < ZORDER_ROWS; ++i) {
+        stretched[0][i] = zkey_range_32(cols[0][i], lo[0], hi[0], bits);
+        stretched[2][i] = zkey_range_32(cols[2][i], lo[2], hi[2], bits);
+    }
+    zkey_build_64((const uint32_t *const *)stretched, ZORDER_COLS, ZORDER_ROWS, keys);
+    t1 = bench_seconds();
+    radixsort_64(keys, rows, ZORDER_ROWS, tk, tv, 64);
+    t2 = bench_seconds();
+    printf("zorder rows=%d build=%.2f ns/row sort=%.2f ns/row\n", ZORDER_ROWS,
+           (t1 - t0) * 1e9 / ZORDER_ROWS, (t2 - t1) * 1e9 / ZORDER_ROWS);
+    zorder_report("zorder", cols, rows);
+    zorder_free(cols, stretched, rows, tv, keys, tk);
+}
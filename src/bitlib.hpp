@@ -0,0 +1,606 @@
+/**
+ * C++20 interface to the Hamming weight, interleaving and Morton code
+ * functions. Every function is a template over the unsigned integer type of
+ * its operands and picks the C function of the matching width, so code doesn't
+ * have to change when a typedef does.
+ *
+ * The functions are constexpr. During constant evaluation they run portable
+ * versions of the same algorithms, so lookup tables and constant codes can be
+ * computed at compile time. At run time popcount, merge, separate and the
+ * Morton code functions call the C functions, including the flavors chosen by
+ * bitlib_tune (BITLIB_TUNED) and the hooks of BITLIB_PROFILE; the span
+ * overloads for std::uint32_t and std::uint64_t call the array kernels of
+ * bulk.h. The neighbor steps are a handful of bit ops on the code and are the
+ * same at compile and run time.
+ *
+ * Function families in this file:
+ * popcount: Hamming weight of a value, or of a span of values
+ * merge, merge3, morton, morton3: interleave 2 or 3 values, or spans of them
+ * separate, separate3, invmorton, invmorton3: deinterleave a value, or a span
+ * mortonxm, mortonxp, mortonym, mortonyp: 2D neighbor steps
+ * mortonxm3, mortonxp3, mortonym3, mortonyp3, mortonzm3, mortonzp3: 3D
+ *     neighbor steps
+ * morton_in_box, morton3_in_box: box test of a span of codes into a bitmask
+ */
+
+#ifndef BITLIB_HPP
+#define BITLIB_HPP
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "popcount.h"
+#include "shift.h"
+#include "morton.h"
+#include "compare.h"
+
+/* The bulk_args initializers of bulk.h leave the unused members out, which is
+ * plain C but draws -Wmissing-field-initializers from C++ compilers */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#include "bulk.h"
+#pragma GCC diagnostic pop
+
+namespace bitlib {
+
+/**
+ * The operand types: unsigned integers of 8, 16, 32 or 64 bits.
+ */
+template <class T>
+concept word = std::unsigned_integral<T> && !std::same_as<T, bool> &&
+               (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+namespace detail {
+
+/* The masks of the coordinates of 2D and 3D Morton codes of type T */
+template <word T> inline constexpr T x2 = T(0x5555555555555555);
+template <word T> inline constexpr T y2 = T(0xaaaaaaaaaaaaaaaa);
+template <word T> inline constexpr T x3 = T(0x9249249249249249);
+template <word T> inline constexpr T y3 = T(0x9249249249249249 << 1);
+template <word T> inline constexpr T z3 = T(0x9249249249249249 << 2);
+
+/* Whether the span overloads for T can call the array kernels of bulk.h */
+template <class T>
+concept bulk = std::same_as<T, std::uint32_t> || std::same_as<T, std::uint64_t>;
+
+/* Portable versions of the 64 bit C functions; narrower types are zero
+ * extended and the results truncated */
+constexpr std::uint64_t popcount(std::uint64_t x)
+{
+    x -= (x >> 1) & 0x5555555555555555;
+    x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+    return (x * 0x0101010101010101) >> 56;
+}
+
+constexpr std::uint64_t scatter(std::uint64_t x)
+{
+    x &= 0x00000000ffffffff;
+    x = (x | (x << 16)) & 0x0000ffff0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0f;
+    x = (x | (x << 2)) & 0x3333333333333333;
+    x = (x | (x << 1)) & 0x5555555555555555;
+    return x;
+}
+
+constexpr std::uint64_t gather(std::uint64_t x)
+{
+    x &= 0x5555555555555555;
+    x = (x | (x >> 1)) & 0x3333333333333333;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0f;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ff;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffff;
+    x = (x | (x >> 16)) & 0x00000000ffffffff;
+    return x;
+}
+
+constexpr std::uint64_t scatter3(std::uint64_t x)
+{
+    x &= 0x00000000003fffff;
+    x = (x | (x << 32)) & 0xffff000000ffffff;
+    x = (x | (x << 16)) & 0x0fff000fff000fff;
+    x = (x | (x << 8)) & 0xf03f03f03f03f03f;
+    x = (x | (x << 4)) & 0x71c71c71c71c71c7;
+    x = (x | (x << 2)) & 0x9249249249249249;
+    return x;
+}
+
+constexpr std::uint64_t gather3(std::uint64_t x)
+{
+    x &= 0x9249249249249249;
+    x = (x | (x >> 2)) & 0x71c71c71c71c71c7;
+    x = (x | (x >> 4)) & 0xf03f03f03f03f03f;
+    x = (x | (x >> 8)) & 0x0fff000fff000fff;
+    x = (x | (x >> 16)) & 0xffff000000ffffff;
+    x = (x | (x >> 32)) & 0x0000ffffffffffff;
+    return x;
+}
+
+/* The Morton code of the neighbor one step down or up the axis of mask m */
+template <word T>
+constexpr T step_down(T code, T m)
+{
+    return T((((code & m) - 1) & m) | (code & T(~m)));
+}
+
+template <word T>
+constexpr T step_up(T code, T m)
+{
+    return T((((code | T(~m)) + 1) & m) | (code & T(~m)));
+}
+
+} // namespace detail
+
+/**
+ * Calculate the Hamming weight of x.
+ *
+ * Complexity: that of popcount_8, popcount_16, popcount_32 or popcount_64
+ */
+template <word T>
+constexpr T popcount(T x) noexcept
+{
+    if (std::is_constant_evaluated()) {
+        return T(detail::popcount(x));
+    }
+    if constexpr (sizeof(T) == 1) {
+        return T(::popcount_8(x));
+    } else if constexpr (sizeof(T) == 2) {
+        return T(::popcount_16(x));
+    } else if constexpr (sizeof(T) == 4) {
+        return T(::popcount_32(x));
+    } else {
+        return T(::popcount_64(x));
+    }
+}
+
+/**
+ * Calculate the total Hamming weight of the values in xs, e.g. the size of a
+ * bitmap. Spans of std::uint64_t go to popcount_bulk_64.
+ *
+ * Complexity: xs.size() times that of popcount
+ */
+template <word T>
+constexpr std::size_t popcount(std::span<const T> xs) noexcept
+{
+    std::size_t count = 0;
+
+    if constexpr (std::same_as<T, std::uint64_t>) {
+        if (!std::is_constant_evaluated()) {
+            return std::size_t(::popcount_bulk_64(xs.data(), xs.size()));
+        }
+    }
+    for (T x : xs) {
+        count += popcount(x);
+    }
+    return count;
+}
+
+/**
+ * Interleave the lower halves of x and y; the bits of x take up the odd, the
+ * bits of y the even positions. The upper halves must be 0.
+ *
+ * Complexity: that of merge_8, merge_16, merge_32 or merge_64
+ */
+template <word T>
+constexpr T merge(T x, T y) noexcept
+{
+    if (std::is_constant_evaluated()) {
+        return T(detail::scatter(x) | (detail::scatter(y) << 1));
+    }
+    if constexpr (sizeof(T) == 1) {
+        return T(::merge_8(x, y));
+    } else if constexpr (sizeof(T) == 2) {
+        return T(::merge_16(x, y));
+    } else if constexpr (sizeof(T) == 4) {
+        return T(::merge_32(x, y));
+    } else {
+        return T(::merge_64(x, y));
+    }
+}
+
+/**
+ * Interleave x, y and z; the bits of each take up the first, second and third
+ * positions of every triad respectively. See merge3_8, merge3_16, merge3_32 and
+ * merge3_64 for the number of bits used of each, the upper bits must be 0.
+ *
+ * Complexity: that of merge3_8, merge3_16, merge3_32 or merge3_64
+ */
+template <word T>
+constexpr T merge3(T x, T y, T z) noexcept
+{
+    if (std::is_constant_evaluated()) {
+        return T(detail::scatter3(x) | (detail::scatter3(y) << 1) | (detail::scatter3(z) << 2));
+    }
+    if constexpr (sizeof(T) == 1) {
+        return T(::merge3_8(x, y, z));
+    } else if constexpr (sizeof(T) == 2) {
+        return T(::merge3_16(x, y, z));
+    } else if constexpr (sizeof(T) == 4) {
+        return T(::merge3_32(x, y, z));
+    } else {
+        return T(::merge3_64(x, y, z));
+    }
+}
+
+/**
+ * Split n into its odd bits (first) and its even bits (second).
+ *
+ * Complexity: that of separate_8, separate_16, separate_32 or separate_64
+ */
+template <word T>
+constexpr std::pair<T, T> separate(T n) noexcept
+{
+    if (std::is_constant_evaluated()) {
+        return {T(detail::gather(n)), T(detail::gather(std::uint64_t(n) >> 1))};
+    }
+    if constexpr (sizeof(T) == 1) {
+        std::uint8_t x, y;
+        ::separate_8(n, &x, &y);
+        return {x, y};
+    } else if constexpr (sizeof(T) == 2) {
+        std::uint16_t x, y;
+        ::separate_16(n, &x, &y);
+        return {x, y};
+    } else if constexpr (sizeof(T) == 4) {
+        std::uint32_t x, y;
+        ::separate_32(n, &x, &y);
+        return {x, y};
+    } else {
+        std::uint64_t x, y;
+        ::separate_64(n, &x, &y);
+        return {T(x), T(y)};
+    }
+}
+
+/**
+ * Split n into the first, second and third bits of its triads.
+ *
+ * Complexity: that of separate3_8, separate3_16, separate3_32 or separate3_64
+ */
+template <word T>
+constexpr std::array<T, 3> separate3(T n) noexcept
+{
+    if (std::is_constant_evaluated()) {
+        std::uint64_t m = n;
+        return {T(detail::gather3(m)), T(detail::gather3(m >> 1)), T(detail::gather3(m >> 2))};
+    }
+    if constexpr (sizeof(T) == 1) {
+        std::uint8_t x, y, z;
+        ::separate3_8(n, &x, &y, &z);
+        return {x, y, z};
+    } else if constexpr (sizeof(T) == 2) {
+        std::uint16_t x, y, z;
+        ::separate3_16(n, &x, &y, &z);
+        return {x, y, z};
+    } else if constexpr (sizeof(T) == 4) {
+        std::uint32_t x, y, z;
+        ::separate3_32(n, &x, &y, &z);
+        return {x, y, z};
+    } else {
+        std::uint64_t x, y, z;
+        ::separate3_64(n, &x, &y, &z);
+        return {T(x), T(y), T(z)};
+    }
+}
+
+/**
+ * Calculate a 2D Morton code. Identical to merge.
+ */
+template <word T>
+constexpr T morton(T x, T y) noexcept
+{
+    return merge(x, y);
+}
+
+/**
+ * Calculate a 3D Morton code. Identical to merge3.
+ */
+template <word T>
+constexpr T morton3(T x, T y, T z) noexcept
+{
+    return merge3(x, y, z);
+}
+
+/**
+ * Invert a 2D Morton code into {x, y}. Identical to separate.
+ */
+template <word T>
+constexpr std::pair<T, T> invmorton(T m) noexcept
+{
+    return separate(m);
+}
+
+/**
+ * Invert a 3D Morton code into {x, y, z}. Identical to separate3.
+ */
+template <word T>
+constexpr std::array<T, 3> invmorton3(T m) noexcept
+{
+    return separate3(m);
+}
+
+/**
+ * Calculate the 2D Morton codes of the points (x[i]; y[i]) into out, which
+ * must be at least as long as x. y must be at least as long as x. Spans of
+ * std::uint32_t and std::uint64_t go to morton_bulk_32 and morton_bulk_64.
+ *
+ * Complexity: x.size() times that of morton
+ */
+template <word T>
+constexpr void morton(std::span<const T> x, std::span<const T> y, std::span<T> out) noexcept
+{
+    if constexpr (detail::bulk<T>) {
+        if (!std::is_constant_evaluated()) {
+            if constexpr (sizeof(T) == 4) {
+                ::morton_bulk_32(x.data(), y.data(), x.size(), out.data());
+            } else {
+                ::morton_bulk_64(x.data(), y.data(), x.size(), out.data());
+            }
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        out[i] = morton(x[i], y[i]);
+    }
+}
+
+/**
+ * Calculate the 3D Morton codes of the points (x[i]; y[i]; z[i]) into out,
+ * which must be at least as long as x. y and z must be at least as long as x.
+ * Spans of std::uint32_t and std::uint64_t go to morton3_bulk_32 and
+ * morton3_bulk_64.
+ *
+ * Complexity: x.size() times that of morton3
+ */
+template <word T>
+constexpr void morton3(std::span<const T> x, std::span<const T> y, std::span<const T> z,
+                       std::span<T> out) noexcept
+{
+    if constexpr (detail::bulk<T>) {
+        if (!std::is_constant_evaluated()) {
+            if constexpr (sizeof(T) == 4) {
+                ::morton3_bulk_32(x.data(), y.data(), z.data(), x.size(), out.data());
+            } else {
+                ::morton3_bulk_64(x.data(), y.data(), z.data(), x.size(), out.data());
+            }
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        out[i] = morton3(x[i], y[i], z[i]);
+    }
+}
+
+/**
+ * Invert the 2D Morton codes m into x and y, which must be at least as long as
+ * m. Spans of std::uint32_t and std::uint64_t go to invmorton_bulk_32 and
+ * invmorton_bulk_64.
+ *
+ * Complexity: m.size() times that of invmorton
+ */
+template <word T>
+constexpr void invmorton(std::span<const T> m, std::span<T> x, std::span<T> y) noexcept
+{
+    if constexpr (detail::bulk<T>) {
+        if (!std::is_constant_evaluated()) {
+            if constexpr (sizeof(T) == 4) {
+                ::invmorton_bulk_32(m.data(), m.size(), x.data(), y.data());
+            } else {
+                ::invmorton_bulk_64(m.data(), m.size(), x.data(), y.data());
+            }
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        auto [a, b] = invmorton(m[i]);
+        x[i] = a;
+        y[i] = b;
+    }
+}
+
+/**
+ * Invert the 3D Morton codes m into x, y and z, which must be at least as long
+ * as m. Spans of std::uint32_t and std::uint64_t go to invmorton3_bulk_32 and
+ * invmorton3_bulk_64.
+ *
+ * Complexity: m.size() times that of invmorton3
+ */
+template <word T>
+constexpr void invmorton3(std::span<const T> m, std::span<T> x, std::span<T> y,
+                          std::span<T> z) noexcept
+{
+    if constexpr (detail::bulk<T>) {
+        if (!std::is_constant_evaluated()) {
+            if constexpr (sizeof(T) == 4) {
+                ::invmorton3_bulk_32(m.data(), m.size(), x.data(), y.data(), z.data());
+            } else {
+                ::invmorton3_bulk_64(m.data(), m.size(), x.data(), y.data(), z.data());
+            }
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        auto [a, b, c] = invmorton3(m[i]);
+        x[i] = a;
+        y[i] = b;
+        z[i] = c;
+    }
+}
+
+/**
+ * Calculate the 2D Morton code of the left (x-1; y) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonxm(T m) noexcept
+{
+    return detail::step_down(m, detail::x2<T>);
+}
+
+/**
+ * Calculate the 2D Morton code of the right (x+1; y) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonxp(T m) noexcept
+{
+    return detail::step_up(m, detail::x2<T>);
+}
+
+/**
+ * Calculate the 2D Morton code of the top (x; y-1) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonym(T m) noexcept
+{
+    return detail::step_down(m, detail::y2<T>);
+}
+
+/**
+ * Calculate the 2D Morton code of the bottom (x; y+1) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonyp(T m) noexcept
+{
+    return detail::step_up(m, detail::y2<T>);
+}
+
+/**
+ * Calculate the 3D Morton code of the left (x-1; y; z) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonxm3(T m) noexcept
+{
+    return detail::step_down(m, detail::x3<T>);
+}
+
+/**
+ * Calculate the 3D Morton code of the right (x+1; y; z) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonxp3(T m) noexcept
+{
+    return detail::step_up(m, detail::x3<T>);
+}
+
+/**
+ * Calculate the 3D Morton code of the top (x; y-1; z) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonym3(T m) noexcept
+{
+    return detail::step_down(m, detail::y3<T>);
+}
+
+/**
+ * Calculate the 3D Morton code of the bottom (x; y+1; z) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonyp3(T m) noexcept
+{
+    return detail::step_up(m, detail::y3<T>);
+}
+
+/**
+ * Calculate the 3D Morton code of the back (x; y; z-1) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonzm3(T m) noexcept
+{
+    return detail::step_down(m, detail::z3<T>);
+}
+
+/**
+ * Calculate the 3D Morton code of the front (x; y; z+1) neighbor of m.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+template <word T>
+constexpr T mortonzp3(T m) noexcept
+{
+    return detail::step_up(m, detail::z3<T>);
+}
+
+/**
+ * Test the 2D Morton codes m against the box spanned by lo and hi into the
+ * bitmask mask, as morton_in_box_bulk_32 and morton_in_box_bulk_64 do. mask
+ * must have room for (m.size() + 63) / 64 words.
+ *
+ * Complexity: m.size() times that of morton_in_box_32 or morton_in_box_64
+ */
+template <word T>
+    requires(sizeof(T) == 4 || sizeof(T) == 8)
+void morton_in_box(std::span<const T> m, T lo, T hi, std::span<std::uint64_t> mask) noexcept
+{
+    if constexpr (std::same_as<T, std::uint32_t>) {
+        ::morton_in_box_bulk_32(m.data(), m.size(), lo, hi, mask.data());
+    } else if constexpr (std::same_as<T, std::uint64_t>) {
+        ::morton_in_box_bulk_64(m.data(), m.size(), lo, hi, mask.data());
+    } else {
+        /* Same width, different type, e.g. unsigned long long */
+        for (std::size_t i = 0; i < m.size(); i += 64) {
+            std::uint64_t word = 0;
+            for (std::size_t j = 0; j < 64 && i + j < m.size(); ++j) {
+                int in = sizeof(T) == 4 ? ::morton_in_box_32(m[i + j], lo, hi)
+                                        : ::morton_in_box_64(m[i + j], lo, hi);
+                word |= std::uint64_t(in) << j;
+            }
+            mask[i / 64] = word;
+        }
+    }
+}
+
+/**
+ * Test the 3D Morton codes m against the box spanned by lo and hi into the
+ * bitmask mask, as morton3_in_box_bulk_32 and morton3_in_box_bulk_64 do. mask
+ * must have room for (m.size() + 63) / 64 words.
+ *
+ * Complexity: m.size() times that of morton3_in_box_32 or morton3_in_box_64
+ */
+template <word T>
+    requires(sizeof(T) == 4 || sizeof(T) == 8)
+void morton3_in_box(std::span<const T> m, T lo, T hi, std::span<std::uint64_t> mask) noexcept
+{
+    if constexpr (std::same_as<T, std::uint32_t>) {
+        ::morton3_in_box_bulk_32(m.data(), m.size(), lo, hi, mask.data());
+    } else if constexpr (std::same_as<T, std::uint64_t>) {
+        ::morton3_in_box_bulk_64(m.data(), m.size(), lo, hi, mask.data());
+    } else {
+        /* Same width, different type, e.g. unsigned long long */
+        for (std::size_t i = 0; i < m.size(); i += 64) {
+            std::uint64_t word = 0;
+            for (std::size_t j = 0; j < 64 && i + j < m.size(); ++j) {
+                int in = sizeof(T) == 4 ? ::morton3_in_box_32(m[i + j], lo, hi)
+                                        : ::morton3_in_box_64(m[i + j], lo, hi);
+                word |= std::uint64_t(in) << j;
+            }
+            mask[i / 64] = word;
+        }
+    }
+}
+
+} // namespace bitlib
+
+#endif //BITLIB_HPP
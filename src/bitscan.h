@@ -0,0 +1,140 @@
+/**
+ * Functions for locating set bits in a bit string.
+ *
+ * Function families in this file:
+ * ctz: count the trailing zero bits (the index of the lowest set bit)
+ * bsr: index of the highest set bit (the integer base 2 logarithm)
+ */
+
+#ifndef BITLIB_BITSCAN_H
+#define BITLIB_BITSCAN_H
+
+#include <stdint.h>
+#include "profile.h"
+
+/**
+ * Count the trailing zero bits of x. x must not be 0 or the result is
+ * undefined.
+ *
+ * Complexity: 10 bit ops, 5 add/subs, 4 compare, 4 branch
+ */
+static inline uint32_t ctz_32(uint32_t x)
+{
+    uint32_t n = 0;
+
+    PROFILE_CALL(ctz_32, x, x == 0);
+    if ((x & 0x0000ffff) == 0) { n += 16; x >>= 16; }
+    if ((x & 0x000000ff) == 0) { n += 8; x >>= 8; }
+    if ((x & 0x0000000f) == 0) { n += 4; x >>= 4; }
+    if ((x & 0x00000003) == 0) { n += 2; x >>= 2; }
+    return n + ((x & 1) ^ 1);
+}
+
+/**
+ * Count the trailing zero bits of x. x must not be 0 or the result is
+ * undefined.
+ *
+ * Complexity: 12 bit ops, 6 add/subs, 5 compare, 5 branch
+ */
+static inline uint64_t ctz_64(uint64_t x)
+{
+    uint64_t n = 0;
+
+    PROFILE_CALL(ctz_64, x, x == 0);
+    if ((x & 0x00000000ffffffff) == 0) { n += 32; x >>= 32; }
+    if ((x & 0x000000000000ffff) == 0) { n += 16; x >>= 16; }
+    if ((x & 0x00000000000000ff) == 0) { n += 8; x >>= 8; }
+    if ((x & 0x000000000000000f) == 0) { n += 4; x >>= 4; }
+    if ((x & 0x0000000000000003) == 0) { n += 2; x >>= 2; }
+    return n + ((x & 1) ^ 1);
+}
+
+/**
+ * Count the trailing zero bits of x. x must not be 0 or the result is
+ * undefined.
+ *
+ * This function isolates the lowest set bit and multiplies it by a de Bruijn
+ * sequence, which puts a unique pattern into the top 5 bits. It avoids the
+ * branches of ctz_32 at the cost of a multiplication and a table lookup.
+ *
+ * Complexity: 2 bit ops, 1 add/subs, 1 multiply
+ */
+static inline uint32_t ctz_mul_32(uint32_t x)
+{
+    static const uint8_t table[32] = {
+         0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+        31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+    };
+
+    PROFILE_CALL(ctz_mul_32, x, x == 0);
+    return table[((x & (0 - x)) * 0x077cb531) >> 27];
+}
+
+/**
+ * Count the trailing zero bits of x. x must not be 0 or the result is
+ * undefined.
+ *
+ * This function isolates the lowest set bit and multiplies it by a de Bruijn
+ * sequence, which puts a unique pattern into the top 6 bits. It avoids the
+ * branches of ctz_64 at the cost of a multiplication and a table lookup.
+ *
+ * Complexity: 2 bit ops, 1 add/subs, 1 multiply
+ */
+static inline uint64_t ctz_mul_64(uint64_t x)
+{
+    static const uint8_t table[64] = {
+         0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+    };
+
+    PROFILE_CALL(ctz_mul_64, x, x == 0);
+    return table[((x & (0 - x)) * 0x03f79d71b4cb0a89) >> 58];
+}
+
+/**
+ * Find the index of the highest set bit of x, i.e. floor(log2(x)). x must not
+ * be 0 or the result is undefined.
+ *
+ * Complexity: 8 bit ops, 4 add/subs, 4 compare, 4 branch
+ */
+static inline uint32_t bsr_32(uint32_t x)
+{
+    uint32_t n = 0;
+
+    PROFILE_CALL(bsr_32, x, x == 0);
+    if ((x & 0xffff0000) != 0) { n += 16; x >>= 16; }
+    if ((x & 0x0000ff00) != 0) { n += 8; x >>= 8; }
+    if ((x & 0x000000f0) != 0) { n += 4; x >>= 4; }
+    if ((x & 0x0000000c) != 0) { n += 2; x >>= 2; }
+    return n + (x >> 1);
+}
+
+/**
+ * Find the index of the highest set bit of x, i.e. floor(log2(x)). x must not
+ * be 0 or the result is undefined.
+ *
+ * Complexity: 10 bit ops, 5 add/subs, 5 compare, 5 branch
+ */
+static inline uint64_t bsr_64(uint64_t x)
+{
+    uint64_t n = 0;
+
+    PROFILE_CALL(bsr_64, x, x == 0);
+    if ((x & 0xffffffff00000000) != 0) { n += 32; x >>= 32; }
+    if ((x & 0x00000000ffff0000) != 0) { n += 16; x >>= 16; }
+    if ((x & 0x000000000000ff00) != 0) { n += 8; x >>= 8; }
+    if ((x & 0x00000000000000f0) != 0) { n += 4; x >>= 4; }
+    if ((x & 0x000000000000000c) != 0) { n += 2; x >>= 2; }
+    return n + (x >> 1);
+}
+
+/* Let a header written by bitlib_tune remap the unflavored names above to the
+ * fastest flavors on the build machine */
+#define BITLIB_BITSCAN_DONE
+#ifdef BITLIB_TUNED
+#include BITLIB_TUNED
+#endif
+
+#endif //BITLIB_BITSCAN_H
@@ -0,0 +1,715 @@
+/**
+ * An out-of-core store for volumes that don't fit into memory. The volume is
+ * stored in Z-order: the voxel (x; y; z) has the global code
+ * morton3_64(x, y, z), whose high bits select the brick (a cube of 2^bits
+ * voxels per axis) and whose low bits the voxel inside it. Brick k is stored at
+ * byte offset k * brick size, so bricks that are close in space are close in
+ * the file. A bounded cache of bricks is kept in caller-provided memory with
+ * least-recently-used replacement, pinning and write-back of dirty bricks.
+ *
+ * Bricks are prefetched through a queue that is filled by sequential
+ * read-ahead along the Z-curve and by bstore_prefetch, and emptied by
+ * bstore_pump, which the caller runs when convenient: between computation
+ * steps, or on an I/O thread of its own. The library doesn't start threads,
+ * but built with -DBITLIB_EXEC_THREADS (and -pthread) a store has a lock, and
+ * bstore_pump can run on one thread while others access bricks. bstore_pump
+ * reads bricks without holding the lock; a brick that is being loaded is
+ * pinned, and accesses to it wait until the read is done. I/O goes through a
+ * pair of callbacks, with a stdio implementation provided.
+ *
+ * Function families in this file:
+ * bstore_size, bstore_init, bstore_destroy: set up a store in caller-provided
+ *     memory
+ * bstore_stdio_read, bstore_stdio_write: I/O callbacks for a stdio FILE
+ * bstore_get, bstore_pin, bstore_unpin, bstore_mark: access cached bricks
+ * bstore_voxel, bstore_neighbor: access voxels by global code
+ * bstore_prefetch, bstore_pump: queue bricks and load them ahead of time
+ * bstore_flush: write back dirty bricks
+ */
+
+#ifndef BITLIB_BSTORE_H
+#define BITLIB_BSTORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "morton.h"
+
+#ifdef BITLIB_EXEC_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#else
+#include <limits.h>
+#endif
+
+/**
+ * Marks an unused slot in the brick table and the LRU list.
+ */
+#define BSTORE_NONE ((size_t)-1)
+
+/**
+ * Flags of a slot: the brick has been modified, or is being read by
+ * bstore_pump
+ */
+#define BSTORE_DIRTY 1
+#define BSTORE_LOADING 2
+
+/**
+ * I/O callbacks of a brick store. Both transfer size bytes at the given file
+ * offset and return 1 on success or 0 on failure. read must fill the parts of
+ * buf that lie beyond the end of the file with zeros. With
+ * BITLIB_EXEC_THREADS, bstore_pump calls read while other threads may call
+ * read or write, so the callbacks must be safe to run concurrently.
+ */
+struct bstore_io {
+    int (*read)(void *ctx, uint64_t offset, void *buf, size_t size);
+    int (*write)(void *ctx, uint64_t offset, const void *buf, size_t size);
+    void *ctx;
+};
+
+/**
+ * A brick store. All arrays point into the memory passed to bstore_init.
+ */
+struct bstore {
+    struct bstore_io io;
+    unsigned shift;        /* 3 * bits: global code bits inside a brick */
+    size_t voxel;          /* bytes per voxel */
+    size_t brick;          /* bytes per brick */
+    uint64_t nbricks;      /* bricks in the volume */
+    size_t nslots;         /* cached bricks */
+    uint8_t *data;         /* nslots bricks */
+    uint64_t *id;          /* brick held by each slot */
+    uint32_t *pins;        /* pin count of each slot */
+    uint8_t *dirty;        /* BSTORE_DIRTY and BSTORE_LOADING flags of each slot */
+    size_t *prev, *next;   /* LRU list, most recently used first */
+    size_t head, tail;
+    size_t *table;         /* hash table of occupied slots, by brick */
+    size_t tmask;
+    uint64_t *queue;       /* ring buffer of bricks to prefetch */
+    size_t qcap, qhead, qcount;
+    size_t readahead;      /* bricks queued after a sequential miss */
+    uint64_t last;         /* brick of the last miss */
+    uint64_t hits, misses, reads, writes;
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t loaded; /* signalled when bstore_pump finishes a read */
+#endif
+};
+
+/* Seek f to offset, which may need more than a long on POSIX systems */
+static inline int bstore_stdio_seek(FILE *f, uint64_t offset)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    off_t o = (off_t)offset;
+
+    return o >= 0 && (uint64_t)o == offset && fseeko(f, o, SEEK_SET) == 0;
+#else
+    return offset <= LONG_MAX && fseek(f, (long)offset, SEEK_SET) == 0;
+#endif
+}
+
+/**
+ * Read callback for a stdio FILE opened for reading (and writing, if bricks
+ * are modified). On POSIX systems offsets may take 64 bits (as far as off_t
+ * allows), and the seek and the transfer run under the lock of the FILE, so
+ * the callbacks are safe to run concurrently; elsewhere offsets must fit into
+ * a long.
+ */
+static inline int bstore_stdio_read(void *ctx, uint64_t offset, void *buf, size_t size)
+{
+    FILE *f = (FILE *)ctx;
+    size_t got = 0;
+    int ok;
+
+#if defined(__unix__) || defined(__APPLE__)
+    flockfile(f);
+#endif
+    ok = bstore_stdio_seek(f, offset);
+    if (ok) {
+        got = fread(buf, 1, size, f);
+        ok = got == size || !ferror(f);
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    funlockfile(f);
+#endif
+    if (ok) {
+        memset((uint8_t *)buf + got, 0, size - got);
+    }
+    return ok;
+}
+
+/**
+ * Write callback for a stdio FILE opened for reading and writing. See
+ * bstore_stdio_read for the offsets.
+ */
+static inline int bstore_stdio_write(void *ctx, uint64_t offset, const void *buf, size_t size)
+{
+    FILE *f = (FILE *)ctx;
+    int ok;
+
+#if defined(__unix__) || defined(__APPLE__)
+    flockfile(f);
+#endif
+    ok = bstore_stdio_seek(f, offset) && fwrite(buf, 1, size, f) == size;
+#if defined(__unix__) || defined(__APPLE__)
+    funlockfile(f);
+#endif
+    return ok;
+}
+
+/**
+ * Calculate the size of the hash table of a store with nslots slots.
+ *
+ * Complexity: O(log nslots)
+ */
+static inline size_t bstore_table_size(size_t nslots)
+{
+    size_t t = 2;
+
+    while (t < 2 * nslots) {
+        t <<= 1;
+    }
+    return t;
+}
+
+/**
+ * Calculate the number of bytes of memory bstore_init needs for a store of
+ * nslots cached bricks of 2^bits voxels per axis, voxel bytes per voxel and a
+ * prefetch queue of qcap bricks.
+ *
+ * Complexity: O(log nslots)
+ */
+static inline size_t bstore_size(unsigned bits, size_t voxel, size_t nslots, size_t qcap)
+{
+    size_t brick = ((voxel << (3 * bits)) + 7) & ~(size_t)7;
+
+    return nslots * (brick + 8 + 4 + 2 * sizeof(size_t) + 1) +
+           bstore_table_size(nslots) * sizeof(size_t) + 8 * qcap;
+}
+
+/**
+ * Set up the store s in the size bytes of memory at mem (see bstore_size),
+ * which must be 8 byte aligned. Bricks have 2^bits voxels per axis (bits at
+ * most 7) of voxel bytes each; the volume has nbricks bricks, i.e. the global
+ * codes below nbricks << (3 * bits). After a miss on the brick following the
+ * previous miss, the next readahead bricks are queued for prefetching. Returns
+ * 1 on success, or 0 if the memory is too small or nslots is 0. Call
+ * bstore_destroy when the store isn't needed any more.
+ *
+ * Complexity: O(nslots)
+ */
+static inline int bstore_init(struct bstore *s, struct bstore_io io, unsigned bits, size_t voxel,
+                              uint64_t nbricks, size_t nslots, size_t qcap, size_t readahead,
+                              void *mem, size_t size)
+{
+    uint8_t *p = (uint8_t *)mem;
+    size_t i, tsize = bstore_table_size(nslots);
+
+    if (nslots == 0 || size < bstore_size(bits, voxel, nslots, qcap)) {
+        return 0;
+    }
+    s->io = io;
+    s->shift = 3 * bits;
+    s->voxel = voxel;
+    s->brick = ((voxel << (3 * bits)) + 7) & ~(size_t)7;
+    s->nbricks = nbricks;
+    s->nslots = nslots;
+
+    /* 8 byte members first, so no padding is needed before the narrower ones. */
+    s->data = p;
+    p += nslots * s->brick;
+    s->id = (uint64_t *)p;
+    p += 8 * nslots;
+    s->queue = (uint64_t *)p;
+    p += 8 * qcap;
+    s->prev = (size_t *)p;
+    p += nslots * sizeof(size_t);
+    s->next = (size_t *)p;
+    p += nslots * sizeof(size_t);
+    s->table = (size_t *)p;
+    p += tsize * sizeof(size_t);
+    s->pins = (uint32_t *)p;
+    p += 4 * nslots;
+    s->dirty = p;
+
+    s->tmask = tsize - 1;
+    for (i = 0; i < tsize; ++i) {
+        s->table[i] = BSTORE_NONE;
+    }
+    /* All slots start out free, linked in index order. */
+    for (i = 0; i < nslots; ++i) {
+        s->id[i] = UINT64_MAX;
+        s->pins[i] = 0;
+        s->dirty[i] = 0;
+        s->prev[i] = i == 0 ? BSTORE_NONE : i - 1;
+        s->next[i] = i + 1 == nslots ? BSTORE_NONE : i + 1;
+    }
+    s->head = 0;
+    s->tail = nslots - 1;
+    s->qcap = qcap;
+    s->qhead = 0;
+    s->qcount = 0;
+    s->readahead = readahead;
+    s->last = UINT64_MAX;
+    s->hits = s->misses = s->reads = s->writes = 0;
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->loaded, NULL);
+#endif
+    return 1;
+}
+
+/**
+ * Release the resources of a store other than its memory, i.e. its lock with
+ * BITLIB_EXEC_THREADS. Dirty bricks aren't written back; see bstore_flush.
+ *
+ * Complexity: O(1)
+ */
+static inline void bstore_destroy(struct bstore *s)
+{
+#ifdef BITLIB_EXEC_THREADS
+    pthread_cond_destroy(&s->loaded);
+    pthread_mutex_destroy(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static inline void bstore_lock(struct bstore *s)
+{
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_lock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static inline void bstore_unlock(struct bstore *s)
+{
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_unlock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+/**
+ * Calculate the home position of brick k in the hash table.
+ *
+ * Complexity: 2 bit ops, 1 multiply
+ */
+static inline size_t bstore_hash(const struct bstore *s, uint64_t k)
+{
+    return (size_t)((k * 0x9e3779b97f4a7c15) >> 32) & s->tmask;
+}
+
+/**
+ * Find the slot holding brick k, or BSTORE_NONE if it isn't cached.
+ *
+ * Complexity: O(1) expected
+ */
+static inline size_t bstore_lookup(const struct bstore *s, uint64_t k)
+{
+    size_t i = bstore_hash(s, k);
+
+    while (s->table[i] != BSTORE_NONE) {
+        if (s->id[s->table[i]] == k) {
+            return s->table[i];
+        }
+        i = (i + 1) & s->tmask;
+    }
+    return BSTORE_NONE;
+}
+
+/**
+ * Remove the brick in slot from the hash table. Later entries of the probe
+ * sequence are shifted back, so no tombstones are needed.
+ *
+ * Complexity: O(1) expected
+ */
+static inline void bstore_unlink(struct bstore *s, size_t slot)
+{
+    size_t i = bstore_hash(s, s->id[slot]), j;
+
+    while (s->table[i] != slot) {
+        i = (i + 1) & s->tmask;
+    }
+    for (j = (i + 1) & s->tmask; s->table[j] != BSTORE_NONE; j = (j + 1) & s->tmask) {
+        size_t h = bstore_hash(s, s->id[s->table[j]]);
+        if (((j - h) & s->tmask) >= ((j - i) & s->tmask)) {
+            s->table[i] = s->table[j];
+            i = j;
+        }
+    }
+    s->table[i] = BSTORE_NONE;
+}
+
+/* The slot holding brick k like bstore_lookup, after waiting for bstore_pump
+ * to finish reading it; the lock must be held */
+static inline size_t bstore_ready(struct bstore *s, uint64_t k)
+{
+    size_t slot = bstore_lookup(s, k);
+
+#ifdef BITLIB_EXEC_THREADS
+    while (slot != BSTORE_NONE && (s->dirty[slot] & BSTORE_LOADING)) {
+        pthread_cond_wait(&s->loaded, &s->lock);
+        slot = bstore_lookup(s, k);
+    }
+#endif
+    return slot;
+}
+
+/**
+ * Move slot to the front of the LRU list.
+ *
+ * Complexity: O(1)
+ */
+static inline void bstore_touch(struct bstore *s, size_t slot)
+{
+    if (s->head == slot) {
+        return;
+    }
+    s->next[s->prev[slot]] = s->next[slot];
+    if (s->next[slot] != BSTORE_NONE) {
+        s->prev[s->next[slot]] = s->prev[slot];
+    } else {
+        s->tail = s->prev[slot];
+    }
+    s->prev[slot] = BSTORE_NONE;
+    s->next[slot] = s->head;
+    s->prev[s->head] = slot;
+    s->head = slot;
+}
+
+/**
+ * Write the brick in slot back to the file if it is dirty. Returns 1 on
+ * success or 0 if the write failed, in which case the brick stays dirty.
+ *
+ * Complexity: 1 write of a brick
+ */
+static inline int bstore_writeback(struct bstore *s, size_t slot)
+{
+    if (!(s->dirty[slot] & BSTORE_DIRTY)) {
+        return 1;
+    }
+    if (!s->io.write(s->io.ctx, s->id[slot] * s->brick, s->data + slot * s->brick, s->brick)) {
+        return 0;
+    }
+    s->dirty[slot] = 0;
+    ++s->writes;
+    return 1;
+}
+
+/**
+ * Take the least recently used unpinned slot for brick k, writing back the
+ * brick it held if that is dirty, and enter k into the hash table; the data
+ * is still to be read. Returns the slot, or BSTORE_NONE if every slot is
+ * pinned or the write failed.
+ *
+ * Complexity: O(nslots) worst case, at most 1 write of a brick
+ */
+static inline size_t bstore_claim(struct bstore *s, uint64_t k)
+{
+    size_t slot = s->tail, i;
+
+    while (slot != BSTORE_NONE && s->pins[slot] != 0) {
+        slot = s->prev[slot];
+    }
+    if (slot == BSTORE_NONE || !bstore_writeback(s, slot)) {
+        return BSTORE_NONE;
+    }
+    if (s->id[slot] != UINT64_MAX) {
+        bstore_unlink(s, slot);
+    }
+    s->id[slot] = k;
+    for (i = bstore_hash(s, k); s->table[i] != BSTORE_NONE; i = (i + 1) & s->tmask) {
+    }
+    s->table[i] = slot;
+    return slot;
+}
+
+/**
+ * Finish loading the brick claimed for slot: on success count the read and
+ * make it the most recently used brick, on failure free the slot again.
+ *
+ * Complexity: O(1) expected
+ */
+static inline void bstore_loaded(struct bstore *s, size_t slot, int ok)
+{
+    if (ok) {
+        ++s->reads;
+        bstore_touch(s, slot);
+    } else {
+        bstore_unlink(s, slot);
+        s->id[slot] = UINT64_MAX;
+    }
+}
+
+/**
+ * Load brick k into the least recently used unpinned slot (see bstore_claim).
+ * Returns the slot, or BSTORE_NONE if every slot is pinned or the I/O failed.
+ *
+ * Complexity: O(nslots) worst case, 1 read and at most 1 write of a brick
+ */
+static inline size_t bstore_load(struct bstore *s, uint64_t k)
+{
+    size_t slot = bstore_claim(s, k);
+    int ok;
+
+    if (slot == BSTORE_NONE) {
+        return BSTORE_NONE;
+    }
+    ok = s->io.read(s->io.ctx, k * s->brick, s->data + slot * s->brick, s->brick);
+    bstore_loaded(s, slot, ok);
+    return ok ? slot : BSTORE_NONE;
+}
+
+/* bstore_prefetch with the lock held */
+static inline int bstore_queue(struct bstore *s, uint64_t k)
+{
+    if (k >= s->nbricks || s->qcount == s->qcap || bstore_lookup(s, k) != BSTORE_NONE) {
+        return 0;
+    }
+    s->queue[(s->qhead + s->qcount) % s->qcap] = k;
+    ++s->qcount;
+    return 1;
+}
+
+/**
+ * Queue brick k for prefetching, unless it is outside of the volume, already
+ * cached or the queue is full. Returns 1 if the brick was queued.
+ *
+ * Complexity: O(1) expected
+ */
+static inline int bstore_prefetch(struct bstore *s, uint64_t k)
+{
+    int queued;
+
+    bstore_lock(s);
+    queued = bstore_queue(s, k);
+    bstore_unlock(s);
+    return queued;
+}
+
+/**
+ * Load up to max queued bricks into the cache. Bricks that have been loaded in
+ * the meantime are skipped without counting against max. Returns the number of
+ * bricks loaded. The reads run without the lock, so with BITLIB_EXEC_THREADS
+ * other threads keep accessing cached bricks meanwhile.
+ *
+ * Complexity: at most max reads and writes of a brick
+ */
+static inline size_t bstore_pump(struct bstore *s, size_t max)
+{
+    size_t loaded = 0;
+
+    bstore_lock(s);
+    while (loaded < max && s->qcount > 0) {
+        uint64_t k = s->queue[s->qhead];
+        size_t slot;
+        int ok;
+
+        s->qhead = (s->qhead + 1) % s->qcap;
+        --s->qcount;
+        if (bstore_lookup(s, k) != BSTORE_NONE) {
+            continue;
+        }
+        slot = bstore_claim(s, k);
+        if (slot == BSTORE_NONE) {
+            break;
+        }
+        /* The pin keeps the slot from being evicted and the flag makes
+         * accesses to k wait until the data is there. */
+        ++s->pins[slot];
+        s->dirty[slot] = BSTORE_LOADING;
+        bstore_unlock(s);
+        ok = s->io.read(s->io.ctx, k * s->brick, s->data + slot * s->brick, s->brick);
+        bstore_lock(s);
+        --s->pins[slot];
+        s->dirty[slot] = 0;
+        bstore_loaded(s, slot, ok);
+#ifdef BITLIB_EXEC_THREADS
+        pthread_cond_broadcast(&s->loaded);
+#endif
+        if (!ok) {
+            break;
+        }
+        ++loaded;
+    }
+    bstore_unlock(s);
+    return loaded;
+}
+
+/* The slot of brick k, loaded on a miss, with the lock held; pins is added
+ * to its pin count and flags to its flags */
+static inline size_t bstore_access(struct bstore *s, uint64_t k, uint32_t pins, uint8_t flags)
+{
+    size_t slot = bstore_ready(s, k), i;
+
+    if (slot != BSTORE_NONE) {
+        ++s->hits;
+        bstore_touch(s, slot);
+    } else {
+        ++s->misses;
+        slot = bstore_load(s, k);
+        if (slot == BSTORE_NONE) {
+            return BSTORE_NONE;
+        }
+        if (k == s->last + 1) {
+            for (i = 1; i <= s->readahead; ++i) {
+                bstore_queue(s, k + i);
+            }
+        }
+        s->last = k;
+    }
+    s->pins[slot] += pins;
+    s->dirty[slot] |= flags;
+    return slot;
+}
+
+/**
+ * Access brick k (less than s->nbricks), loading it on a miss. A miss on the
+ * brick directly after the previous miss queues the next s->readahead bricks
+ * for prefetching. Returns the brick's voxels, stored in Morton order, or NULL
+ * if every slot is pinned or the I/O failed. The pointer stays valid until
+ * the brick is evicted, which pinning prevents; while bstore_pump runs on
+ * another thread, only pinned bricks are safe to use.
+ *
+ * Complexity: O(1) expected on a hit, see bstore_load on a miss
+ */
+static inline uint8_t *bstore_get(struct bstore *s, uint64_t k)
+{
+    size_t slot;
+
+    bstore_lock(s);
+    slot = bstore_access(s, k, 0, 0);
+    bstore_unlock(s);
+    return slot == BSTORE_NONE ? NULL : s->data + slot * s->brick;
+}
+
+/**
+ * Access brick k like bstore_get and pin it, so it isn't evicted until
+ * bstore_unpin is called as many times as it was pinned.
+ *
+ * Complexity: see bstore_get
+ */
+static inline uint8_t *bstore_pin(struct bstore *s, uint64_t k)
+{
+    size_t slot;
+
+    bstore_lock(s);
+    slot = bstore_access(s, k, 1, 0);
+    bstore_unlock(s);
+    return slot == BSTORE_NONE ? NULL : s->data + slot * s->brick;
+}
+
+/**
+ * Release a pin of the cached brick k.
+ *
+ * Complexity: O(1) expected
+ */
+static inline void bstore_unpin(struct bstore *s, uint64_t k)
+{
+    size_t slot;
+
+    bstore_lock(s);
+    slot = bstore_ready(s, k);
+    if (slot != BSTORE_NONE && s->pins[slot] > 0) {
+        --s->pins[slot];
+    }
+    bstore_unlock(s);
+}
+
+/**
+ * Mark the cached brick k as modified, so it is written back before it is
+ * evicted and by bstore_flush.
+ *
+ * Complexity: O(1) expected
+ */
+static inline void bstore_mark(struct bstore *s, uint64_t k)
+{
+    size_t slot;
+
+    bstore_lock(s);
+    slot = bstore_ready(s, k);
+    if (slot != BSTORE_NONE) {
+        s->dirty[slot] |= BSTORE_DIRTY;
+    }
+    bstore_unlock(s);
+}
+
+/**
+ * Access the voxel with global code m, loading its brick if needed. If write
+ * is nonzero the brick is marked as modified. Returns NULL if m is outside of
+ * the volume or the brick can't be loaded. See bstore_get for how long the
+ * pointer stays valid.
+ *
+ * Complexity: 2 bit ops, 1 multiply, 1 compare and bstore_get
+ */
+static inline uint8_t *bstore_voxel_64(struct bstore *s, uint64_t m, int write)
+{
+    uint64_t k = m >> s->shift;
+    size_t slot;
+
+    if (k >= s->nbricks) {
+        return NULL;
+    }
+    bstore_lock(s);
+    slot = bstore_access(s, k, 0, write ? BSTORE_DIRTY : 0);
+    bstore_unlock(s);
+    if (slot == BSTORE_NONE) {
+        return NULL;
+    }
+    return s->data + slot * s->brick + (size_t)(m & (((uint64_t)1 << s->shift) - 1)) * s->voxel;
+}
+
+/**
+ * Access the face neighbor of the voxel with global code m, in the direction
+ * -x, +x, -y, +y, -z, +z (0 to 5). The neighbor's code is written to n. The
+ * step is the Morton neighbor step on the global code, so it crosses brick
+ * boundaries without special cases. Returns NULL if the neighbor is outside of
+ * the volume (stepping below 0 wraps to a code past its end) or its brick can't
+ * be loaded; see bstore_voxel_64 for write.
+ *
+ * Complexity: 7 bit ops, 2 add/subs and bstore_voxel_64
+ */
+static inline uint8_t *bstore_neighbor_64(struct bstore *s, uint64_t m, unsigned dir, int write,
+                                          uint64_t *n)
+{
+    switch (dir) {
+    case 0: m = mortonxm3_64(m); break;
+    case 1: m = mortonxp3_64(m); break;
+    case 2: m = mortonym3_64(m); break;
+    case 3: m = mortonyp3_64(m); break;
+    case 4: m = mortonzm3_64(m); break;
+    default: m = mortonzp3_64(m); break;
+    }
+    *n = m;
+    return bstore_voxel_64(s, m, write);
+}
+
+/**
+ * Write back all dirty bricks. Returns 1 on success or 0 if a write failed.
+ *
+ * Complexity: O(nslots) and the writes
+ */
+static inline int bstore_flush(struct bstore *s)
+{
+    size_t i;
+    int ok = 1;
+
+    bstore_lock(s);
+    for (i = 0; i < s->nslots; ++i) {
+        if (s->id[i] != UINT64_MAX) {
+            ok &= bstore_writeback(s, i);
+        }
+    }
+    bstore_unlock(s);
+    return ok;
+}
+
+#endif //BITLIB_BSTORE_H
@@ -0,0 +1,253 @@
+/**
+ * Aligned buffers for the array kernels. The kernels work on any memory the
+ * caller provides; buffers from here are aligned to a cache line (or more) for
+ * vectorized loops, and large ones are put on huge pages to save TLB misses
+ * when arrays span gigabytes.
+ *
+ * On Linux, buffers of at least BUFFER_HUGE_MIN bytes are mapped with mmap and
+ * marked with madvise(MADV_HUGEPAGE) for transparent huge pages, or taken from
+ * the reserved huge pages (MAP_HUGETLB) if BUFFER_HUGETLB is asked for and some
+ * are available. Smaller buffers, and all buffers elsewhere, come from malloc.
+ *
+ * Pages are placed on the NUMA node of the thread that touches them first.
+ * buffer_touch zeroes a buffer on an executor, so that with exec_pool every
+ * thread first touches the part of the arrays that the _ex kernels give it.
+ *
+ * Function families in this file:
+ * buffer_alloc, buffer_free: aligned buffers, on huge pages if large
+ * buffer_touch: first-touch initialization on an executor
+ * arena_init, arena_alloc, arena_reset, arena_destroy: aligned bump allocation
+ *     of several arrays from one buffer
+ */
+
+#ifndef BITLIB_BUFFER_H
+#define BITLIB_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "exec.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+/* MAP_ANONYMOUS is missing in strict ISO modes; buffers then come from malloc */
+#ifdef MAP_ANONYMOUS
+#define BUFFER_MMAP
+#endif
+#endif
+
+/**
+ * The default alignment: a cache line, which also suits 512 bit vectors.
+ */
+#define BUFFER_ALIGN 64
+
+/**
+ * The size of a huge page, which large buffers are rounded up to.
+ */
+#define BUFFER_HUGE_PAGE ((size_t)1 << 21)
+
+/**
+ * The size from which buffers are mapped on huge pages. Define it before
+ * including this header to change it.
+ */
+#ifndef BUFFER_HUGE_MIN
+#define BUFFER_HUGE_MIN BUFFER_HUGE_PAGE
+#endif
+
+/**
+ * Flags of buffer_alloc: try reserved huge pages (MAP_HUGETLB) first, or never
+ * use huge pages
+ */
+#define BUFFER_HUGETLB 1
+#define BUFFER_NOHUGE 2
+
+/**
+ * Where the memory of a buffer came from
+ */
+enum buffer_kind {
+    BUFFER_NONE, BUFFER_HEAP, BUFFER_PAGES, BUFFER_THP, BUFFER_HUGETLB_PAGES
+};
+
+/**
+ * A buffer of size bytes at data. base and mapped describe the underlying
+ * allocation.
+ */
+struct buffer {
+    void *data;
+    size_t size;
+    void *base;
+    size_t mapped;
+    enum buffer_kind kind;
+};
+
+/**
+ * Allocate a buffer of size bytes whose start is a multiple of align (a power
+ * of 2; 0 means BUFFER_ALIGN). Returns 1 on success, or 0 if there isn't enough
+ * memory. The contents are undefined until written; see buffer_touch.
+ *
+ * Complexity: 1 allocation
+ */
+static inline int buffer_alloc(struct buffer *b, size_t size, size_t align, unsigned flags)
+{
+    align = align ? align : BUFFER_ALIGN;
+    b->data = b->base = NULL;
+    b->size = size;
+    b->mapped = 0;
+    b->kind = BUFFER_NONE;
+
+#ifdef BUFFER_MMAP
+    /* Mappings start on a page, which covers any alignment up to a page; a
+     * huge page covers anything up to its size */
+    if (size >= BUFFER_HUGE_MIN && size <= SIZE_MAX - 2 * BUFFER_HUGE_PAGE &&
+        !(flags & BUFFER_NOHUGE) && align <= BUFFER_HUGE_PAGE) {
+        size_t len = (size + BUFFER_HUGE_PAGE - 1) & ~(BUFFER_HUGE_PAGE - 1);
+        void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (flags & BUFFER_HUGETLB) {
+            p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                     -1, 0);
+            b->kind = BUFFER_HUGETLB_PAGES;
+        }
+#endif
+        if (p == MAP_FAILED) {
+            /* Over-map by a huge page, so that the buffer can start on one */
+            size_t lead;
+            char *q = (char *)mmap(NULL, len + BUFFER_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (q == (char *)MAP_FAILED) {
+                return 0;
+            }
+            lead = (BUFFER_HUGE_PAGE - (uintptr_t)q % BUFFER_HUGE_PAGE) % BUFFER_HUGE_PAGE;
+            if (lead > 0) {
+                munmap(q, lead);
+            }
+            munmap(q + lead + len, BUFFER_HUGE_PAGE - lead);
+            p = q + lead;
+            b->kind = BUFFER_PAGES;
+#ifdef MADV_HUGEPAGE
+            if (madvise(p, len, MADV_HUGEPAGE) == 0) {
+                b->kind = BUFFER_THP;
+            }
+#endif
+        }
+        b->data = b->base = p;
+        b->mapped = len;
+        return 1;
+    }
+#else
+    (void)flags;
+#endif
+
+    b->base = size <= SIZE_MAX - align ? malloc(size + align) : NULL;
+    if (b->base == NULL) {
+        return 0;
+    }
+    b->data = (char *)b->base + (align - (uintptr_t)b->base % align) % align;
+    b->kind = BUFFER_HEAP;
+    return 1;
+}
+
+/**
+ * Free a buffer.
+ *
+ * Complexity: 1 deallocation
+ */
+static inline void buffer_free(struct buffer *b)
+{
+#ifdef BUFFER_MMAP
+    if (b->mapped > 0) {
+        munmap(b->base, b->mapped);
+    } else
+#endif
+    {
+        free(b->base);
+    }
+    b->data = b->base = NULL;
+    b->size = b->mapped = 0;
+    b->kind = BUFFER_NONE;
+}
+
+static inline void buffer_touch_task(void *arg, size_t begin, size_t end)
+{
+    struct buffer *b = (struct buffer *)arg;
+    size_t first = begin * BUFFER_HUGE_PAGE, last = end * BUFFER_HUGE_PAGE;
+
+    memset((char *)b->data + first, 0, (last < b->size ? last : b->size) - first);
+}
+
+/**
+ * Zero a buffer in chunks of huge pages on the executor e, so that each page
+ * is first touched, and thus placed, by a thread of e. With exec_pool, thread
+ * t touches the t-th slice of the buffer, which is the slice of the arrays it
+ * gets from the _ex kernels.
+ *
+ * Complexity: O(size)
+ */
+static inline void buffer_touch(struct exec *e, struct buffer *b)
+{
+    exec_for(e, buffer_touch_task, b, (b->size + BUFFER_HUGE_PAGE - 1) / BUFFER_HUGE_PAGE, 1);
+}
+
+/**
+ * An arena hands out aligned pieces of one buffer, e.g. the input, output and
+ * scratch arrays of a pipeline, and frees them all at once.
+ */
+struct arena {
+    struct buffer buf;
+    size_t used;
+};
+
+/**
+ * Create an arena of size bytes. See buffer_alloc for the flags. Returns 1 on
+ * success, or 0 if there isn't enough memory.
+ *
+ * Complexity: 1 allocation
+ */
+static inline int arena_init(struct arena *a, size_t size, unsigned flags)
+{
+    a->used = 0;
+    return buffer_alloc(&a->buf, size, BUFFER_ALIGN, flags);
+}
+
+/**
+ * Take size bytes aligned to align (a power of 2 up to BUFFER_ALIGN; 0 means
+ * BUFFER_ALIGN) from the arena. Returns NULL if the arena is full.
+ *
+ * Complexity: 3 add/subs, 1 bit ops, 2 compare
+ */
+static inline void *arena_alloc(struct arena *a, size_t size, size_t align)
+{
+    size_t start;
+
+    align = align ? align : BUFFER_ALIGN;
+    start = (a->used + align - 1) & ~(align - 1);
+    if (start > a->buf.size || size > a->buf.size - start) {
+        return NULL;
+    }
+    a->used = start + size;
+    return (char *)a->buf.data + start;
+}
+
+/**
+ * Free everything taken from the arena.
+ *
+ * Complexity: constant
+ */
+static inline void arena_reset(struct arena *a)
+{
+    a->used = 0;
+}
+
+/**
+ * Free the memory of the arena.
+ *
+ * Complexity: 1 deallocation
+ */
+static inline void arena_destroy(struct arena *a)
+{
+    buffer_free(&a->buf);
+    a->used = 0;
+}
+
+#endif //BITLIB_BUFFER_H
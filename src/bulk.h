@@ -0,0 +1,1602 @@
+/**
+ * Array kernels and their parallel (_ex) variants, which split the work of a
+ * call over an executor (see exec.h). Passing NULL as the executor runs an _ex
+ * kernel serially on the calling thread, with the same results.
+ *
+ * The chunk size of every _ex kernel follows from the operation count of the
+ * kernel per item (exec_grain), so cheap kernels such as popcount_bulk get
+ * large chunks and range planning gets a box or a few per chunk.
+ *
+ * Function families in this file:
+ * popcount_bulk: total Hamming weight of an array
+ * morton_bulk, morton3_bulk: Morton codes of arrays of coordinates
+ * invmorton_bulk, invmorton3_bulk: coordinates of arrays of Morton codes
+ * morton_neighbors_bulk, morton3_neighbors_bulk: face neighbors of codes
+ * invmorton_seq_ex, invmorton3_seq_ex: parallel decoding of runs of codes
+ * morton_in_box_bulk_ex, morton3_in_box_bulk_ex: parallel box tests
+ * geohash_encode_bulk_ex, geohash_decode_bulk_ex: parallel geohash coding
+ * tile_key_bulk_ex, tile_xy_bulk_ex, quadkey_format_bulk_ex: parallel tile
+ *     key coding
+ * morton_ranges_bulk_ex, morton3_ranges_bulk_ex: parallel range planning
+ * eytzinger_build_ex, stree_build_ex: parallel construction of search layouts
+ * eytzinger_lower_bound_bulk_ex, stree_lower_bound_bulk_ex: parallel search
+ * radixsort_ex: parallel radix sort
+ * octree_balance_ex: partitioned parallel 2:1 balance
+ * voxel_downsample_ex: parallel voxel grid filter
+ * pic_deposit_cic_ex, pic_deposit_tsc_ex: parallel particle deposition
+ * pic_gather_cic_ex, pic_gather_tsc_ex: parallel interpolation
+ * zkey_build_ex: parallel Z-order key building
+ */
+
+#ifndef BITLIB_BULK_H
+#define BITLIB_BULK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "exec.h"
+#include "popcount.h"
+#include "morton.h"
+#include "compare.h"
+#include "cursor.h"
+#include "geohash.h"
+#include "quadkey.h"
+#include "range.h"
+#include "search.h"
+#include "sort.h"
+#include "octree.h"
+#include "voxel.h"
+#include "pic.h"
+#include "zorder.h"
+
+/* The parameters of a bulk call, shared by the chunks of its task */
+struct bulk_args {
+    const void *in[3];
+    void *out[6];
+    const void *ctx;
+    uint64_t a, b;
+    size_t n, count;
+};
+
+/**
+ * Calculate the total Hamming weight of the n words of x.
+ *
+ * Complexity: n times popcount_64
+ */
+static inline uint64_t popcount_bulk_64(const uint64_t *x, size_t n)
+{
+    uint64_t count = 0;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        count += popcount_64(x[i]);
+    }
+    return count;
+}
+
+static inline void popcount_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+    uint64_t count = popcount_bulk_64((const uint64_t *)p->in[0] + begin, end - begin);
+
+    __atomic_fetch_add(&p->a, count, __ATOMIC_RELAXED);
+}
+
+/**
+ * Calculate the total Hamming weight of the n words of x on the executor e.
+ *
+ * Complexity: n times popcount_64
+ */
+static inline uint64_t popcount_bulk_ex_64(struct exec *e, const uint64_t *x, size_t n)
+{
+    struct bulk_args p = {.in = {x}};
+
+    exec_for(e, popcount_bulk_task, &p, n, exec_grain(16, 1));
+    return p.a;
+}
+
+/**
+ * Calculate the 2D Morton codes of the n points (x[i]; y[i]) into m.
+ *
+ * Complexity: n times morton_32
+ */
+static inline void morton_bulk_32(const uint32_t *x, const uint32_t *y, size_t n, uint32_t *m)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        m[i] = morton_32(x[i], y[i]);
+    }
+}
+
+/**
+ * Calculate the 2D Morton codes of the n points (x[i]; y[i]) into m.
+ *
+ * Complexity: n times morton_64
+ */
+static inline void morton_bulk_64(const uint64_t *x, const uint64_t *y, size_t n, uint64_t *m)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        m[i] = morton_64(x[i], y[i]);
+    }
+}
+
+/**
+ * Calculate the 3D Morton codes of the n points (x[i]; y[i]; z[i]) into m.
+ *
+ * Complexity: n times morton3_32
+ */
+static inline void morton3_bulk_32(const uint32_t *x, const uint32_t *y, const uint32_t *z,
+                                   size_t n, uint32_t *m)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        m[i] = morton3_32(x[i], y[i], z[i]);
+    }
+}
+
+/**
+ * Calculate the 3D Morton codes of the n points (x[i]; y[i]; z[i]) into m.
+ *
+ * Complexity: n times morton3_64
+ */
+static inline void morton3_bulk_64(const uint64_t *x, const uint64_t *y, const uint64_t *z,
+                                   size_t n, uint64_t *m)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        m[i] = morton3_64(x[i], y[i], z[i]);
+    }
+}
+
+/**
+ * Place the coordinates of the n 2D Morton codes m into x and y.
+ *
+ * Complexity: n times invmorton_32
+ */
+static inline void invmorton_bulk_32(const uint32_t *m, size_t n, uint32_t *x, uint32_t *y)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        invmorton_32(m[i], x + i, y + i);
+    }
+}
+
+/**
+ * Place the coordinates of the n 2D Morton codes m into x and y.
+ *
+ * Complexity: n times invmorton_64
+ */
+static inline void invmorton_bulk_64(const uint64_t *m, size_t n, uint64_t *x, uint64_t *y)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        invmorton_64(m[i], x + i, y + i);
+    }
+}
+
+/**
+ * Place the coordinates of the n 3D Morton codes m into x, y and z.
+ *
+ * Complexity: n times invmorton3_32
+ */
+static inline void invmorton3_bulk_32(const uint32_t *m, size_t n, uint32_t *x, uint32_t *y,
+                                      uint32_t *z)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        invmorton3_32(m[i], x + i, y + i, z + i);
+    }
+}
+
+/**
+ * Place the coordinates of the n 3D Morton codes m into x, y and z.
+ *
+ * Complexity: n times invmorton3_64
+ */
+static inline void invmorton3_bulk_64(const uint64_t *m, size_t n, uint64_t *x, uint64_t *y,
+                                      uint64_t *z)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        invmorton3_64(m[i], x + i, y + i, z + i);
+    }
+}
+
+/**
+ * Calculate the 4 face neighbors of the n 2D Morton codes m into nb, in the
+ * order x-1, x+1, y-1, y+1, so nb needs room for 4 * n codes. Neighbors wrap
+ * around at the borders of the code space.
+ *
+ * Complexity: n times mortonxm_64, mortonxp_64, mortonym_64 and mortonyp_64
+ */
+static inline void morton_neighbors_bulk_64(const uint64_t *m, size_t n, uint64_t *nb)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        nb[4 * i] = mortonxm_64(m[i]);
+        nb[4 * i + 1] = mortonxp_64(m[i]);
+        nb[4 * i + 2] = mortonym_64(m[i]);
+        nb[4 * i + 3] = mortonyp_64(m[i]);
+    }
+}
+
+/**
+ * Calculate the 6 face neighbors of the n 3D Morton codes m into nb, in the
+ * order x-1, x+1, y-1, y+1, z-1, z+1, so nb needs room for 6 * n codes.
+ * Neighbors wrap around at the borders of the code space.
+ *
+ * Complexity: n times the 6 3D neighbor steps
+ */
+static inline void morton3_neighbors_bulk_64(const uint64_t *m, size_t n, uint64_t *nb)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        nb[6 * i] = mortonxm3_64(m[i]);
+        nb[6 * i + 1] = mortonxp3_64(m[i]);
+        nb[6 * i + 2] = mortonym3_64(m[i]);
+        nb[6 * i + 3] = mortonyp3_64(m[i]);
+        nb[6 * i + 4] = mortonzm3_64(m[i]);
+        nb[6 * i + 5] = mortonzp3_64(m[i]);
+    }
+}
+
+static inline void morton_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton_bulk_32((const uint32_t *)p->in[0] + begin, (const uint32_t *)p->in[1] + begin,
+                   end - begin, (uint32_t *)p->out[0] + begin);
+}
+
+static inline void morton_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton_bulk_64((const uint64_t *)p->in[0] + begin, (const uint64_t *)p->in[1] + begin,
+                   end - begin, (uint64_t *)p->out[0] + begin);
+}
+
+static inline void morton3_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton3_bulk_32((const uint32_t *)p->in[0] + begin, (const uint32_t *)p->in[1] + begin,
+                    (const uint32_t *)p->in[2] + begin, end - begin,
+                    (uint32_t *)p->out[0] + begin);
+}
+
+static inline void morton3_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton3_bulk_64((const uint64_t *)p->in[0] + begin, (const uint64_t *)p->in[1] + begin,
+                    (const uint64_t *)p->in[2] + begin, end - begin,
+                    (uint64_t *)p->out[0] + begin);
+}
+
+static inline void invmorton_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton_bulk_32((const uint32_t *)p->in[0] + begin, end - begin,
+                      (uint32_t *)p->out[0] + begin, (uint32_t *)p->out[1] + begin);
+}
+
+static inline void invmorton_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton_bulk_64((const uint64_t *)p->in[0] + begin, end - begin,
+                      (uint64_t *)p->out[0] + begin, (uint64_t *)p->out[1] + begin);
+}
+
+static inline void invmorton3_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton3_bulk_32((const uint32_t *)p->in[0] + begin, end - begin,
+                       (uint32_t *)p->out[0] + begin, (uint32_t *)p->out[1] + begin,
+                       (uint32_t *)p->out[2] + begin);
+}
+
+static inline void invmorton3_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton3_bulk_64((const uint64_t *)p->in[0] + begin, end - begin,
+                       (uint64_t *)p->out[0] + begin, (uint64_t *)p->out[1] + begin,
+                       (uint64_t *)p->out[2] + begin);
+}
+
+static inline void morton_neighbors_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton_neighbors_bulk_64((const uint64_t *)p->in[0] + begin, end - begin,
+                             (uint64_t *)p->out[0] + 4 * begin);
+}
+
+static inline void morton3_neighbors_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton3_neighbors_bulk_64((const uint64_t *)p->in[0] + begin, end - begin,
+                              (uint64_t *)p->out[0] + 6 * begin);
+}
+
+/**
+ * morton_bulk_32 on the executor e.
+ *
+ * Complexity: n times morton_32
+ */
+static inline void morton_bulk_ex_32(struct exec *e, const uint32_t *x, const uint32_t *y,
+                                     size_t n, uint32_t *m)
+{
+    struct bulk_args p = {.in = {x, y}, .out = {m}};
+
+    exec_for(e, morton_bulk_task_32, &p, n, exec_grain(16, 8));
+}
+
+/**
+ * morton_bulk_64 on the executor e.
+ *
+ * Complexity: n times morton_64
+ */
+static inline void morton_bulk_ex_64(struct exec *e, const uint64_t *x, const uint64_t *y,
+                                     size_t n, uint64_t *m)
+{
+    struct bulk_args p = {.in = {x, y}, .out = {m}};
+
+    exec_for(e, morton_bulk_task_64, &p, n, exec_grain(32, 8));
+}
+
+/**
+ * morton3_bulk_32 on the executor e.
+ *
+ * Complexity: n times morton3_32
+ */
+static inline void morton3_bulk_ex_32(struct exec *e, const uint32_t *x, const uint32_t *y,
+                                      const uint32_t *z, size_t n, uint32_t *m)
+{
+    struct bulk_args p = {.in = {x, y, z}, .out = {m}};
+
+    exec_for(e, morton3_bulk_task_32, &p, n, exec_grain(40, 8));
+}
+
+/**
+ * morton3_bulk_64 on the executor e.
+ *
+ * Complexity: n times morton3_64
+ */
+static inline void morton3_bulk_ex_64(struct exec *e, const uint64_t *x, const uint64_t *y,
+                                      const uint64_t *z, size_t n, uint64_t *m)
+{
+    struct bulk_args p = {.in = {x, y, z}, .out = {m}};
+
+    exec_for(e, morton3_bulk_task_64, &p, n, exec_grain(49, 8));
+}
+
+/**
+ * invmorton_bulk_32 on the executor e.
+ *
+ * Complexity: n times invmorton_32
+ */
+static inline void invmorton_bulk_ex_32(struct exec *e, const uint32_t *m, size_t n,
+                                        uint32_t *x, uint32_t *y)
+{
+    struct bulk_args p = {.in = {m}, .out = {x, y}};
+
+    exec_for(e, invmorton_bulk_task_32, &p, n, exec_grain(20, 8));
+}
+
+/**
+ * invmorton_bulk_64 on the executor e.
+ *
+ * Complexity: n times invmorton_64
+ */
+static inline void invmorton_bulk_ex_64(struct exec *e, const uint64_t *m, size_t n,
+                                        uint64_t *x, uint64_t *y)
+{
+    struct bulk_args p = {.in = {m}, .out = {x, y}};
+
+    exec_for(e, invmorton_bulk_task_64, &p, n, exec_grain(33, 8));
+}
+
+/**
+ * invmorton3_bulk_32 on the executor e.
+ *
+ * Complexity: n times invmorton3_32
+ */
+static inline void invmorton3_bulk_ex_32(struct exec *e, const uint32_t *m, size_t n,
+                                         uint32_t *x, uint32_t *y, uint32_t *z)
+{
+    struct bulk_args p = {.in = {m}, .out = {x, y, z}};
+
+    exec_for(e, invmorton3_bulk_task_32, &p, n, exec_grain(40, 8));
+}
+
+/**
+ * invmorton3_bulk_64 on the executor e.
+ *
+ * Complexity: n times invmorton3_64
+ */
+static inline void invmorton3_bulk_ex_64(struct exec *e, const uint64_t *m, size_t n,
+                                         uint64_t *x, uint64_t *y, uint64_t *z)
+{
+    struct bulk_args p = {.in = {m}, .out = {x, y, z}};
+
+    exec_for(e, invmorton3_bulk_task_64, &p, n, exec_grain(51, 8));
+}
+
+/**
+ * morton_neighbors_bulk_64 on the executor e.
+ *
+ * Complexity: n times mortonxm_64, mortonxp_64, mortonym_64 and mortonyp_64
+ */
+static inline void morton_neighbors_bulk_ex_64(struct exec *e, const uint64_t *m, size_t n,
+                                               uint64_t *nb)
+{
+    struct bulk_args p = {.in = {m}, .out = {nb}};
+
+    exec_for(e, morton_neighbors_bulk_task_64, &p, n, exec_grain(20, 8));
+}
+
+/**
+ * morton3_neighbors_bulk_64 on the executor e.
+ *
+ * Complexity: n times the 6 3D neighbor steps
+ */
+static inline void morton3_neighbors_bulk_ex_64(struct exec *e, const uint64_t *m, size_t n,
+                                                uint64_t *nb)
+{
+    struct bulk_args p = {.in = {m}, .out = {nb}};
+
+    exec_for(e, morton3_neighbors_bulk_task_64, &p, n, exec_grain(30, 8));
+}
+
+/* Every chunk of a run seeks to its own first code, first + begin */
+static inline void invmorton_seq_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton_seq_32((uint32_t)(p->a + begin), end - begin, (uint32_t *)p->out[0] + begin,
+                     (uint32_t *)p->out[1] + begin);
+}
+
+static inline void invmorton_seq_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton_seq_64(p->a + begin, end - begin, (uint64_t *)p->out[0] + begin,
+                     (uint64_t *)p->out[1] + begin);
+}
+
+static inline void invmorton3_seq_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton3_seq_32((uint32_t)(p->a + begin), end - begin, (uint32_t *)p->out[0] + begin,
+                      (uint32_t *)p->out[1] + begin, (uint32_t *)p->out[2] + begin);
+}
+
+static inline void invmorton3_seq_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    invmorton3_seq_64(p->a + begin, end - begin, (uint64_t *)p->out[0] + begin,
+                      (uint64_t *)p->out[1] + begin, (uint64_t *)p->out[2] + begin);
+}
+
+/**
+ * invmorton_seq_32 on the executor e. Each chunk fully decodes its first code
+ * and steps through the rest with mortonnext_32.
+ *
+ * Complexity: n times mortonnext_32, plus invmorton_32 per chunk
+ */
+static inline void invmorton_seq_ex_32(struct exec *e, uint32_t first, size_t n,
+                                       uint32_t *x, uint32_t *y)
+{
+    struct bulk_args p = {.out = {x, y}, .a = first};
+
+    exec_for(e, invmorton_seq_task_32, &p, n, exec_grain(8, 8));
+}
+
+/**
+ * invmorton_seq_64 on the executor e. See invmorton_seq_ex_32.
+ *
+ * Complexity: n times mortonnext_64, plus invmorton_64 per chunk
+ */
+static inline void invmorton_seq_ex_64(struct exec *e, uint64_t first, size_t n,
+                                       uint64_t *x, uint64_t *y)
+{
+    struct bulk_args p = {.out = {x, y}, .a = first};
+
+    exec_for(e, invmorton_seq_task_64, &p, n, exec_grain(8, 8));
+}
+
+/**
+ * invmorton3_seq_32 on the executor e. See invmorton_seq_ex_32.
+ *
+ * Complexity: n times mortonnext3_32, plus invmorton3_32 per chunk
+ */
+static inline void invmorton3_seq_ex_32(struct exec *e, uint32_t first, size_t n,
+                                        uint32_t *x, uint32_t *y, uint32_t *z)
+{
+    struct bulk_args p = {.out = {x, y, z}, .a = first};
+
+    exec_for(e, invmorton3_seq_task_32, &p, n, exec_grain(10, 8));
+}
+
+/**
+ * invmorton3_seq_64 on the executor e. See invmorton_seq_ex_32.
+ *
+ * Complexity: n times mortonnext3_64, plus invmorton3_64 per chunk
+ */
+static inline void invmorton3_seq_ex_64(struct exec *e, uint64_t first, size_t n,
+                                        uint64_t *x, uint64_t *y, uint64_t *z)
+{
+    struct bulk_args p = {.out = {x, y, z}, .a = first};
+
+    exec_for(e, invmorton3_seq_task_64, &p, n, exec_grain(10, 8));
+}
+
+/* The box tests write one mask word per 64 codes, so their tasks run over
+ * blocks of 64 codes rather than codes */
+static inline void morton_in_box_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+    size_t last = 64 * end < p->n ? 64 * end : p->n;
+
+    morton_in_box_bulk_32((const uint32_t *)p->in[0] + 64 * begin, last - 64 * begin,
+                          (uint32_t)p->a, (uint32_t)p->b, (uint64_t *)p->out[0] + begin);
+}
+
+static inline void morton_in_box_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+    size_t last = 64 * end < p->n ? 64 * end : p->n;
+
+    morton_in_box_bulk_64((const uint64_t *)p->in[0] + 64 * begin, last - 64 * begin, p->a,
+                          p->b, (uint64_t *)p->out[0] + begin);
+}
+
+static inline void morton3_in_box_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+    size_t last = 64 * end < p->n ? 64 * end : p->n;
+
+    morton3_in_box_bulk_32((const uint32_t *)p->in[0] + 64 * begin, last - 64 * begin,
+                           (uint32_t)p->a, (uint32_t)p->b, (uint64_t *)p->out[0] + begin);
+}
+
+static inline void morton3_in_box_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+    size_t last = 64 * end < p->n ? 64 * end : p->n;
+
+    morton3_in_box_bulk_64((const uint64_t *)p->in[0] + 64 * begin, last - 64 * begin, p->a,
+                           p->b, (uint64_t *)p->out[0] + begin);
+}
+
+/**
+ * morton_in_box_bulk_32 on the executor e.
+ *
+ * Complexity: n times morton_in_box_32
+ */
+static inline void morton_in_box_bulk_ex_32(struct exec *e, const uint32_t *m, size_t n,
+                                            uint32_t lo, uint32_t hi, uint64_t *mask)
+{
+    struct bulk_args p = {.in = {m}, .out = {mask}, .a = lo, .b = hi, .n = n};
+
+    exec_for(e, morton_in_box_bulk_task_32, &p, (n + 63) / 64, exec_grain(64 * 12, 1));
+}
+
+/**
+ * morton_in_box_bulk_64 on the executor e.
+ *
+ * Complexity: n times morton_in_box_64
+ */
+static inline void morton_in_box_bulk_ex_64(struct exec *e, const uint64_t *m, size_t n,
+                                            uint64_t lo, uint64_t hi, uint64_t *mask)
+{
+    struct bulk_args p = {.in = {m}, .out = {mask}, .a = lo, .b = hi, .n = n};
+
+    exec_for(e, morton_in_box_bulk_task_64, &p, (n + 63) / 64, exec_grain(64 * 12, 1));
+}
+
+/**
+ * morton3_in_box_bulk_32 on the executor e.
+ *
+ * Complexity: n times morton3_in_box_32
+ */
+static inline void morton3_in_box_bulk_ex_32(struct exec *e, const uint32_t *m, size_t n,
+                                             uint32_t lo, uint32_t hi, uint64_t *mask)
+{
+    struct bulk_args p = {.in = {m}, .out = {mask}, .a = lo, .b = hi, .n = n};
+
+    exec_for(e, morton3_in_box_bulk_task_32, &p, (n + 63) / 64, exec_grain(64 * 18, 1));
+}
+
+/**
+ * morton3_in_box_bulk_64 on the executor e.
+ *
+ * Complexity: n times morton3_in_box_64
+ */
+static inline void morton3_in_box_bulk_ex_64(struct exec *e, const uint64_t *m, size_t n,
+                                             uint64_t lo, uint64_t hi, uint64_t *mask)
+{
+    struct bulk_args p = {.in = {m}, .out = {mask}, .a = lo, .b = hi, .n = n};
+
+    exec_for(e, morton3_in_box_bulk_task_64, &p, (n + 63) / 64, exec_grain(64 * 18, 1));
+}
+
+static inline void geohash_encode_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    geohash_encode_bulk_64((const double *)p->in[0] + begin, (const double *)p->in[1] + begin,
+                           end - begin, (unsigned)p->a, (uint64_t *)p->out[0] + begin);
+}
+
+static inline void geohash_decode_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    geohash_decode_bulk_64((const uint64_t *)p->in[0] + begin, end - begin, (unsigned)p->a,
+                           (double *)p->out[0] + begin, (double *)p->out[1] + begin);
+}
+
+/**
+ * geohash_encode_bulk_64 on the executor e.
+ *
+ * Complexity: n times geohash_encode_64
+ */
+static inline void geohash_encode_bulk_ex_64(struct exec *e, const double *lat,
+                                             const double *lon, size_t n, unsigned bits,
+                                             uint64_t *codes)
+{
+    struct bulk_args p = {.in = {lat, lon}, .out = {codes}, .a = bits};
+
+    exec_for(e, geohash_encode_bulk_task, &p, n, exec_grain(40, 8));
+}
+
+/**
+ * geohash_decode_bulk_64 on the executor e.
+ *
+ * Complexity: n times geohash_decode_64
+ */
+static inline void geohash_decode_bulk_ex_64(struct exec *e, const uint64_t *codes, size_t n,
+                                             unsigned bits, double *lat, double *lon)
+{
+    struct bulk_args p = {.in = {codes}, .out = {lat, lon}, .a = bits};
+
+    exec_for(e, geohash_decode_bulk_task, &p, n, exec_grain(43, 8));
+}
+
+static inline void tile_key_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    tile_key_bulk_64((unsigned)p->a, (const uint64_t *)p->in[0] + begin,
+                     (const uint64_t *)p->in[1] + begin, end - begin,
+                     (uint64_t *)p->out[0] + begin);
+}
+
+static inline void tile_xy_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    tile_xy_bulk_64((const uint64_t *)p->in[0] + begin, end - begin,
+                    (uint64_t *)p->out[0] + begin, (uint64_t *)p->out[1] + begin);
+}
+
+static inline void quadkey_format_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    quadkey_format_bulk_64((const uint64_t *)p->in[0] + begin, end - begin, (unsigned)p->a,
+                           (char *)p->out[0] + begin * p->a);
+}
+
+/**
+ * tile_key_bulk_64 on the executor e.
+ *
+ * Complexity: n times tile_key_64
+ */
+static inline void tile_key_bulk_ex_64(struct exec *e, unsigned z, const uint64_t *x,
+                                       const uint64_t *y, size_t n, uint64_t *keys)
+{
+    struct bulk_args p = {.in = {x, y}, .out = {keys}, .a = z};
+
+    exec_for(e, tile_key_bulk_task, &p, n, exec_grain(33, 8));
+}
+
+/**
+ * tile_xy_bulk_64 on the executor e.
+ *
+ * Complexity: n times tile_xy_64
+ */
+static inline void tile_xy_bulk_ex_64(struct exec *e, const uint64_t *keys, size_t n,
+                                      uint64_t *x, uint64_t *y)
+{
+    struct bulk_args p = {.in = {keys}, .out = {x, y}};
+
+    exec_for(e, tile_xy_bulk_task, &p, n, exec_grain(60, 8));
+}
+
+/**
+ * quadkey_format_bulk_64 on the executor e.
+ *
+ * Complexity: n times quadkey_format_64 without tile_zoom_64
+ */
+static inline void quadkey_format_bulk_ex_64(struct exec *e, const uint64_t *keys, size_t n,
+                                             unsigned z, char *s)
+{
+    struct bulk_args p = {.in = {keys}, .out = {s}, .a = z};
+
+    exec_for(e, quadkey_format_bulk_task, &p, n, exec_grain(4 * (z + 1), 8));
+}
+
+/* An estimate of the operations of a range walk with the given budget */
+static inline size_t range_walk_ops(size_t maxranges)
+{
+    return maxranges < EXEC_CHUNK_OPS ? 256 * maxranges : 256 * (size_t)EXEC_CHUNK_OPS;
+}
+
+static inline void morton_ranges_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton_ranges_bulk_64((const uint64_t *)p->in[0] + 4 * begin, end - begin, p->a,
+                          (uint64_t *)p->out[0] + 2 * p->count * begin, p->count,
+                          (size_t *)p->out[1] + begin);
+}
+
+static inline void morton3_ranges_bulk_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    morton3_ranges_bulk_64((const uint64_t *)p->in[0] + 6 * begin, end - begin, p->a,
+                           (uint64_t *)p->out[0] + 2 * p->count * begin, p->count,
+                           (size_t *)p->out[1] + begin);
+}
+
+/**
+ * morton_ranges_bulk_64 on the executor e. The walk for a box is bounded by
+ * maxranges, so chunks hold a number of boxes that follows from it.
+ *
+ * Complexity: n times the complexity of morton_ranges_64
+ */
+static inline size_t morton_ranges_bulk_ex_64(struct exec *e, const uint64_t *boxes, size_t n,
+                                              uint64_t gap, uint64_t *ranges, size_t maxranges,
+                                              size_t *counts)
+{
+    struct bulk_args p = {.in = {boxes}, .out = {ranges, counts}, .a = gap, .n = n,
+                          .count = maxranges};
+    size_t i, total = 0;
+
+    exec_for(e, morton_ranges_bulk_task, &p, n, exec_grain(range_walk_ops(maxranges), 1));
+    for (i = 0; i < n; ++i) {
+        total += counts[i];
+    }
+    return total;
+}
+
+/**
+ * morton3_ranges_bulk_64 on the executor e. The walk for a box is bounded by
+ * maxranges, so chunks hold a number of boxes that follows from it.
+ *
+ * Complexity: n times the complexity of morton3_ranges_64
+ */
+static inline size_t morton3_ranges_bulk_ex_64(struct exec *e, const uint64_t *boxes, size_t n,
+                                               uint64_t gap, uint64_t *ranges, size_t maxranges,
+                                               size_t *counts)
+{
+    struct bulk_args p = {.in = {boxes}, .out = {ranges, counts}, .a = gap, .n = n,
+                          .count = maxranges};
+    size_t i, total = 0;
+
+    exec_for(e, morton3_ranges_bulk_task, &p, n, exec_grain(range_walk_ops(maxranges), 1));
+    for (i = 0; i < n; ++i) {
+        total += counts[i];
+    }
+    return total;
+}
+
+/* Eytzinger entries start at 1, so chunk [begin; end) fills [begin + 1; end + 1) */
+static inline void eytzinger_build_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    eytzinger_build_32((const uint32_t *)p->in[0], p->count, (uint32_t *)p->out[0], begin + 1,
+                       end + 1);
+}
+
+static inline void eytzinger_build_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    eytzinger_build_64((const uint64_t *)p->in[0], p->count, (uint64_t *)p->out[0], begin + 1,
+                       end + 1);
+}
+
+static inline void stree_build_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    stree_build_32((const struct stree *)p->ctx, (const uint32_t *)p->in[0],
+                   (uint32_t *)p->out[0], begin, end);
+}
+
+static inline void stree_build_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    stree_build_64((const struct stree *)p->ctx, (const uint64_t *)p->in[0],
+                   (uint64_t *)p->out[0], begin, end);
+}
+
+/**
+ * Build the Eytzinger layout tree of the n sorted keys on the executor e, every
+ * chunk filling its own range of entries (see eytzinger_build_32).
+ *
+ * Complexity: O(n)
+ */
+static inline void eytzinger_build_ex_32(struct exec *e, const uint32_t *sorted, size_t n,
+                                         uint32_t *tree)
+{
+    struct bulk_args p = {.in = {sorted}, .out = {tree}, .count = n};
+
+    exec_for(e, eytzinger_build_task_32, &p, n, exec_grain(24, 16));
+}
+
+/**
+ * Build the Eytzinger layout tree of the n sorted keys on the executor e. See
+ * eytzinger_build_ex_32.
+ *
+ * Complexity: O(n)
+ */
+static inline void eytzinger_build_ex_64(struct exec *e, const uint64_t *sorted, size_t n,
+                                         uint64_t *tree)
+{
+    struct bulk_args p = {.in = {sorted}, .out = {tree}, .count = n};
+
+    exec_for(e, eytzinger_build_task_64, &p, n, exec_grain(24, 8));
+}
+
+/**
+ * Build the S-tree tree with the layout t from the t->n sorted keys on the
+ * executor e, every chunk filling its own range of entries. size is the size
+ * returned by stree_init (see stree_build_32).
+ *
+ * Complexity: O(size * t->height)
+ */
+static inline void stree_build_ex_32(struct exec *e, const struct stree *t,
+                                     const uint32_t *sorted, uint32_t *tree, size_t size)
+{
+    struct bulk_args p = {.in = {sorted}, .out = {tree}, .ctx = t};
+
+    exec_for(e, stree_build_task_32, &p, size, exec_grain(8 + 8 * t->height, STREE_B));
+}
+
+/**
+ * Build the S-tree tree with the layout t from the t->n sorted keys on the
+ * executor e. See stree_build_ex_32.
+ *
+ * Complexity: O(size * t->height)
+ */
+static inline void stree_build_ex_64(struct exec *e, const struct stree *t,
+                                     const uint64_t *sorted, uint64_t *tree, size_t size)
+{
+    struct bulk_args p = {.in = {sorted}, .out = {tree}, .ctx = t};
+
+    exec_for(e, stree_build_task_64, &p, size, exec_grain(8 + 8 * t->height, STREE_B));
+}
+
+static inline void eytzinger_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    eytzinger_lower_bound_bulk_32((const uint32_t *)p->ctx, p->count,
+                                  (const uint32_t *)p->in[0] + begin, end - begin,
+                                  (size_t *)p->out[0] + begin);
+}
+
+static inline void eytzinger_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    eytzinger_lower_bound_bulk_64((const uint64_t *)p->ctx, p->count,
+                                  (const uint64_t *)p->in[0] + begin, end - begin,
+                                  (size_t *)p->out[0] + begin);
+}
+
+static inline void stree_bulk_task_32(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    stree_lower_bound_bulk_32((const struct stree *)p->ctx, (const uint32_t *)p->in[1],
+                              (const uint32_t *)p->in[0] + begin, end - begin,
+                              (size_t *)p->out[0] + begin);
+}
+
+static inline void stree_bulk_task_64(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    stree_lower_bound_bulk_64((const struct stree *)p->ctx, (const uint64_t *)p->in[1],
+                              (const uint64_t *)p->in[0] + begin, end - begin,
+                              (size_t *)p->out[0] + begin);
+}
+
+/**
+ * eytzinger_lower_bound_bulk_32 on the executor e. Chunks hold whole batches
+ * of SEARCH_BATCH queries.
+ *
+ * Complexity: O(m * log n)
+ */
+static inline void eytzinger_lower_bound_bulk_ex_32(struct exec *e, const uint32_t *tree,
+                                                    size_t n, const uint32_t *xs, size_t m,
+                                                    size_t *out)
+{
+    struct bulk_args p = {.in = {xs}, .out = {out}, .ctx = tree, .n = m, .count = n};
+
+    exec_for(e, eytzinger_bulk_task_32, &p, m, exec_grain(256, SEARCH_BATCH));
+}
+
+/**
+ * eytzinger_lower_bound_bulk_64 on the executor e. Chunks hold whole batches
+ * of SEARCH_BATCH queries.
+ *
+ * Complexity: O(m * log n)
+ */
+static inline void eytzinger_lower_bound_bulk_ex_64(struct exec *e, const uint64_t *tree,
+                                                    size_t n, const uint64_t *xs, size_t m,
+                                                    size_t *out)
+{
+    struct bulk_args p = {.in = {xs}, .out = {out}, .ctx = tree, .n = m, .count = n};
+
+    exec_for(e, eytzinger_bulk_task_64, &p, m, exec_grain(256, SEARCH_BATCH));
+}
+
+/**
+ * stree_lower_bound_bulk_32 on the executor e. Chunks hold whole batches of
+ * SEARCH_BATCH queries.
+ *
+ * Complexity: m times stree_lower_bound_32
+ */
+static inline void stree_lower_bound_bulk_ex_32(struct exec *e, const struct stree *t,
+                                                const uint32_t *tree, const uint32_t *xs,
+                                                size_t m, size_t *out)
+{
+    struct bulk_args p = {.in = {xs, tree}, .out = {out}, .ctx = t, .n = m};
+
+    exec_for(e, stree_bulk_task_32, &p, m, exec_grain(256, SEARCH_BATCH));
+}
+
+/**
+ * stree_lower_bound_bulk_64 on the executor e. Chunks hold whole batches of
+ * SEARCH_BATCH queries.
+ *
+ * Complexity: m times stree_lower_bound_64
+ */
+static inline void stree_lower_bound_bulk_ex_64(struct exec *e, const struct stree *t,
+                                                const uint64_t *tree, const uint64_t *xs,
+                                                size_t m, size_t *out)
+{
+    struct bulk_args p = {.in = {xs, tree}, .out = {out}, .ctx = t, .n = m};
+
+    exec_for(e, stree_bulk_task_64, &p, m, exec_grain(256, SEARCH_BATCH));
+}
+
+/**
+ * The number of blocks radixsort_ex_64 splits its input into for the
+ * partitioning pass, which bounds the parallelism of that pass.
+ */
+#define RADIXSORT_EX_BLOCKS 64
+
+/* The state of a radixsort_ex_64 call: per block the OR and AND of the keys,
+ * then the digit counts, which turn into the scatter offsets */
+struct radixsort_ex_args {
+    uint64_t *keys, *tk;
+    uint32_t *vals, *tv;
+    size_t n, block;
+    uint64_t mask;
+    unsigned shift;
+    uint64_t any[RADIXSORT_EX_BLOCKS], all[RADIXSORT_EX_BLOCKS];
+    size_t count[RADIXSORT_EX_BLOCKS][256];
+    size_t bounds[257];
+};
+
+static inline void radixsort_ex_scan_task(void *arg, size_t begin, size_t end)
+{
+    struct radixsort_ex_args *p = (struct radixsort_ex_args *)arg;
+    size_t b, i;
+
+    for (b = begin; b < end; ++b) {
+        size_t last = (b + 1) * p->block < p->n ? (b + 1) * p->block : p->n;
+        uint64_t any = 0, all = p->mask;
+        for (i = b * p->block; i < last; ++i) {
+            any |= p->keys[i];
+            all &= p->keys[i];
+        }
+        p->any[b] = any & p->mask;
+        p->all[b] = all;
+    }
+}
+
+static inline void radixsort_ex_count_task(void *arg, size_t begin, size_t end)
+{
+    struct radixsort_ex_args *p = (struct radixsort_ex_args *)arg;
+    size_t b, i;
+
+    for (b = begin; b < end; ++b) {
+        size_t last = (b + 1) * p->block < p->n ? (b + 1) * p->block : p->n;
+        for (i = 0; i < 256; ++i) {
+            p->count[b][i] = 0;
+        }
+        for (i = b * p->block; i < last; ++i) {
+            ++p->count[b][(p->keys[i] >> p->shift) & 0xff];
+        }
+    }
+}
+
+static inline void radixsort_ex_scatter_task(void *arg, size_t begin, size_t end)
+{
+    struct radixsort_ex_args *p = (struct radixsort_ex_args *)arg;
+    size_t b, i;
+
+    for (b = begin; b < end; ++b) {
+        size_t last = (b + 1) * p->block < p->n ? (b + 1) * p->block : p->n;
+        for (i = b * p->block; i < last; ++i) {
+            size_t d = p->count[b][(p->keys[i] >> p->shift) & 0xff]++;
+            p->tk[d] = p->keys[i];
+            p->tv[d] = p->vals[i];
+        }
+    }
+}
+
+static inline void radixsort_ex_bucket_task(void *arg, size_t begin, size_t end)
+{
+    struct radixsort_ex_args *p = (struct radixsort_ex_args *)arg;
+    size_t b, lo, len;
+
+    for (b = begin; b < end; ++b) {
+        lo = p->bounds[b];
+        len = p->bounds[b + 1] - lo;
+        radixsort_64(p->tk + lo, p->tv + lo, len, p->keys + lo, p->vals + lo, p->shift);
+        memcpy(p->keys + lo, p->tk + lo, len * sizeof(uint64_t));
+        memcpy(p->vals + lo, p->tv + lo, len * sizeof(uint32_t));
+    }
+}
+
+/* Partition the n keys and values into the buckets of p->bounds in tk and tv
+ * by the highest digit of their lowest bits (a multiple of 8, not 0) in which
+ * they differ, the digit at p->shift. Returns 0, and moves nothing, if the keys
+ * agree in all of those bits. */
+static inline int radixsort_ex_partition(struct exec *e, struct radixsort_ex_args *p,
+                                         uint64_t *keys, uint32_t *vals, size_t n,
+                                         uint64_t *tk, uint32_t *tv, unsigned bits)
+{
+    size_t grain = exec_grain(8, 1), nblocks, b, d, sum = 0;
+    uint64_t any = 0, all;
+
+    nblocks = (n + grain - 1) / grain;
+    nblocks = nblocks < RADIXSORT_EX_BLOCKS ? nblocks : RADIXSORT_EX_BLOCKS;
+    p->keys = keys;
+    p->vals = vals;
+    p->tk = tk;
+    p->tv = tv;
+    p->n = n;
+    p->block = (n + nblocks - 1) / nblocks;
+    p->mask = bits >= 64 ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+    all = p->mask;
+
+    exec_for(e, radixsort_ex_scan_task, p, nblocks, 1);
+    for (b = 0; b < nblocks; ++b) {
+        any |= p->any[b];
+        all &= p->all[b];
+    }
+    if (any == all) {
+        return 0;
+    }
+    /* The digits above the highest differing one are the same in every key */
+    p->shift = 0;
+    while ((any ^ all) >> p->shift >> 8 != 0) {
+        p->shift += 8;
+    }
+
+    exec_for(e, radixsort_ex_count_task, p, nblocks, 1);
+    for (d = 0; d < 256; ++d) {
+        p->bounds[d] = sum;
+        for (b = 0; b < nblocks; ++b) {
+            size_t c = p->count[b][d];
+            p->count[b][d] = sum;
+            sum += c;
+        }
+    }
+    p->bounds[256] = sum;
+    exec_for(e, radixsort_ex_scatter_task, p, nblocks, 1);
+    return 1;
+}
+
+/**
+ * radixsort_64 on the executor e, with the same result. The keys are
+ * partitioned by the highest digit in which they differ, and the 256 buckets
+ * are then sorted independently, one chunk each. The partitioning pass counts
+ * and scatters up to RADIXSORT_EX_BLOCKS blocks of keys in parallel. The call
+ * keeps about 130 KiB of state on the stack.
+ *
+ * Complexity: O(n * bits / 8)
+ */
+static inline void radixsort_ex_64(struct exec *e, uint64_t *keys, uint32_t *vals, size_t n,
+                                   uint64_t *tk, uint32_t *tv, unsigned bits)
+{
+    struct radixsort_ex_args p;
+
+    bits = (bits + 7) / 8 * 8;
+    if (e == NULL || n < 2 * exec_grain(8, 1) || bits == 0) {
+        radixsort_64(keys, vals, n, tk, tv, bits);
+    } else if (radixsort_ex_partition(e, &p, keys, vals, n, tk, tv, bits)) {
+        exec_for(e, radixsort_ex_bucket_task, &p, 256, 1);
+    }
+}
+
+/**
+ * The maximum number of code ranges octree_balance_ex_64 splits a tree into.
+ */
+#define OCTREE_EX_PARTS 64
+
+/* The state of an octree_balance_ex_64 call. List i of a merge round starts at
+ * start[i] in the half of scratch that src points to. */
+struct octree_ex_args {
+    const uint64_t *keys;
+    size_t n, parts, half, width;
+    uint64_t *src, *dst;
+    int failed;
+    size_t start[OCTREE_EX_PARTS + 1], len[OCTREE_EX_PARTS];
+};
+
+static inline void octree_balance_ex_closure_task(void *arg, size_t begin, size_t end)
+{
+    struct octree_ex_args *p = (struct octree_ex_args *)arg;
+    size_t i;
+
+    for (i = begin; i < end; ++i) {
+        size_t first = p->n * i / p->parts, last = p->n * (i + 1) / p->parts;
+        p->len[i] = octree_closure_64(p->keys + first, last - first, p->src + p->start[i],
+                                      p->start[i + 1] - p->start[i]);
+        if (p->len[i] == 0) {
+            __atomic_store_n(&p->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static inline void octree_balance_ex_merge_task(void *arg, size_t begin, size_t end)
+{
+    struct octree_ex_args *p = (struct octree_ex_args *)arg;
+    size_t j;
+
+    for (j = begin; j < end; ++j) {
+        size_t a = 2 * p->width * j, b = a + p->width;
+        if (b < p->parts) {
+            p->len[a] = octree_merge_64(p->src + p->start[a], p->len[a], p->src + p->start[b],
+                                        p->len[b], p->dst + p->start[a]);
+        } else {
+            memcpy(p->dst + p->start[a], p->src + p->start[a], p->len[a] * sizeof(uint64_t));
+        }
+    }
+}
+
+/**
+ * octree_balance_64 on the executor e, with the same result. The sorted
+ * leaves are split into up to OCTREE_EX_PARTS contiguous code ranges whose
+ * closures are computed in parallel, each in its share of half of scratch.
+ * Closures of neighboring ranges overlap only near their common boundary and
+ * in shared ancestors; they are merged pairwise, in parallel rounds, between
+ * the two halves of scratch, and the merged closure is refined into out on
+ * the calling thread. Returns the number of leaves written, or 0 if cap is
+ * too small or the closure of a range doesn't fit into its share of
+ * scratch_cap / 2.
+ *
+ * Complexity: O(OCTREE_MAXLEVEL * m + m log m) where m is the closure size
+ */
+static inline size_t octree_balance_ex_64(struct exec *e, const uint64_t *keys, size_t n,
+                                          uint64_t *scratch, size_t scratch_cap,
+                                          uint64_t *out, size_t cap)
+{
+    struct octree_ex_args p;
+    size_t grain = exec_grain(8 * OCTREE_MAXLEVEL, 1), i;
+    uint64_t *t;
+
+    p.parts = (n + grain - 1) / grain;
+    p.parts = p.parts < OCTREE_EX_PARTS ? p.parts : OCTREE_EX_PARTS;
+    if (e == NULL || p.parts < 2) {
+        return octree_balance_64(keys, n, scratch, scratch_cap, out, cap);
+    }
+    p.keys = keys;
+    p.n = n;
+    p.half = scratch_cap / 2;
+    p.src = scratch;
+    p.dst = scratch + p.half;
+    p.failed = 0;
+    /* The ranges hold the same number of keys (give or take one), and get the
+     * same share of scratch */
+    for (i = 0; i < p.parts; ++i) {
+        p.start[i] = p.half / p.parts * i;
+    }
+    p.start[p.parts] = p.half;
+
+    exec_for(e, octree_balance_ex_closure_task, &p, p.parts, 1);
+    if (p.failed) {
+        return 0;
+    }
+    for (p.width = 1; p.width < p.parts; p.width *= 2) {
+        exec_for(e, octree_balance_ex_merge_task, &p, (p.parts + 2 * p.width - 1) / (2 * p.width),
+                 1);
+        t = p.src;
+        p.src = p.dst;
+        p.dst = t;
+    }
+    return octree_refine_64(p.src, p.len[0], out, cap);
+}
+
+/* The state of a voxel_downsample_ex_64 call. runs holds the number of voxels
+ * of every bucket of the sort, then the index of its first voxel. */
+struct voxel_ex_args {
+    struct radixsort_ex_args sort;
+    const float *x, *y, *z, *origin;
+    float inv;
+    int mode;
+    uint64_t *keys;
+    uint32_t *idx, *rep;
+    size_t *starts;
+    float *ox, *oy, *oz;
+    size_t runs[256];
+};
+
+static inline void voxel_keys_ex_task(void *arg, size_t begin, size_t end)
+{
+    struct voxel_ex_args *p = (struct voxel_ex_args *)arg;
+    size_t i;
+
+    for (i = begin; i < end; ++i) {
+        p->keys[i] = morton3_64(voxel_index(p->x[i], p->origin[0], p->inv),
+                                voxel_index(p->y[i], p->origin[1], p->inv),
+                                voxel_index(p->z[i], p->origin[2], p->inv));
+        p->idx[i] = (uint32_t)i;
+    }
+}
+
+static inline void voxel_sort_ex_task(void *arg, size_t begin, size_t end)
+{
+    struct voxel_ex_args *p = (struct voxel_ex_args *)arg;
+    size_t b, i, lo, hi, count;
+
+    radixsort_ex_bucket_task(&p->sort, begin, end);
+    for (b = begin; b < end; ++b) {
+        lo = p->sort.bounds[b];
+        hi = p->sort.bounds[b + 1];
+        for (i = lo, count = 0; i < hi; ++i) {
+            count += i == lo || p->keys[i] != p->keys[i - 1];
+        }
+        p->runs[b] = count;
+    }
+}
+
+static inline void voxel_starts_ex_task(void *arg, size_t begin, size_t end)
+{
+    struct voxel_ex_args *p = (struct voxel_ex_args *)arg;
+    size_t b, i, r;
+
+    for (b = begin; b < end; ++b) {
+        r = p->runs[b];
+        for (i = p->sort.bounds[b]; i < p->sort.bounds[b + 1]; ++i) {
+            if (i == p->sort.bounds[b] || p->keys[i] != p->keys[i - 1]) {
+                p->starts[r++] = i;
+            }
+        }
+    }
+}
+
+static inline void voxel_reduce_ex_task(void *arg, size_t begin, size_t end)
+{
+    struct voxel_ex_args *p = (struct voxel_ex_args *)arg;
+    const size_t *starts = p->starts + begin;
+    size_t r, count = end - begin;
+
+    if (p->mode == VOXEL_CENTROID) {
+        voxel_first(p->idx, starts, count, p->rep + begin);
+        voxel_centroid(p->x, p->y, p->z, p->idx, starts, count, p->ox + begin, p->oy + begin,
+                       p->oz + begin);
+        return;
+    }
+    if (p->mode == VOXEL_MEDOID) {
+        voxel_medoid(p->x, p->y, p->z, p->idx, starts, count, p->rep + begin);
+    } else {
+        voxel_first(p->idx, starts, count, p->rep + begin);
+    }
+    for (r = begin; r < end; ++r) {
+        p->ox[r] = p->x[p->rep[r]];
+        p->oy[r] = p->y[p->rep[r]];
+        p->oz[r] = p->z[p->rep[r]];
+    }
+}
+
+/**
+ * voxel_downsample_64 on the executor e, with the same results. The keys are
+ * computed in chunks of points and partitioned by their highest differing
+ * digit as in radixsort_ex_64. Voxels never span two buckets of the
+ * partition, so every bucket is sorted and split into runs independently, and
+ * the representatives are then selected in chunks of voxels. The call keeps
+ * about 135 KiB of state on the stack.
+ *
+ * Complexity: O(n)
+ */
+static inline size_t voxel_downsample_ex_64(struct exec *e, const float *x, const float *y,
+                                            const float *z, size_t n, const float *origin,
+                                            float size, int mode, uint64_t *keys,
+                                            uint32_t *idx, uint64_t *tk, uint32_t *tv,
+                                            size_t *starts, float *ox, float *oy, float *oz,
+                                            uint32_t *rep)
+{
+    struct voxel_ex_args p;
+    size_t count = 0, b, c;
+
+    if (e == NULL || n < 2 * exec_grain(8, 1)) {
+        return voxel_downsample_64(x, y, z, n, origin, size, mode, keys, idx, tk, tv, starts,
+                                   ox, oy, oz, rep);
+    }
+    p.x = x;
+    p.y = y;
+    p.z = z;
+    p.origin = origin;
+    p.inv = 1.0f / size;
+    p.mode = mode;
+    p.keys = keys;
+    p.idx = idx;
+    p.rep = rep;
+    p.starts = starts;
+    p.ox = ox;
+    p.oy = oy;
+    p.oz = oz;
+
+    exec_for(e, voxel_keys_ex_task, &p, n, exec_grain(64, 1));
+    if (radixsort_ex_partition(e, &p.sort, keys, idx, n, tk, tv, 64)) {
+        exec_for(e, voxel_sort_ex_task, &p, 256, 1);
+        for (b = 0; b < 256; ++b) {
+            c = p.runs[b];
+            p.runs[b] = count;
+            count += c;
+        }
+        starts[count] = n;
+        exec_for(e, voxel_starts_ex_task, &p, 256, 1);
+    } else {
+        /* All points share one voxel */
+        count = voxel_runs_64(keys, n, 0, starts);
+    }
+    exec_for(e, voxel_reduce_ex_task, &p, count, exec_grain(32, 1));
+    return count;
+}
+
+/**
+ * The maximum number of code ranges the particles of a pic_deposit_cic_ex_32
+ * or pic_deposit_tsc_ex_32 call are split into.
+ */
+#define PIC_EX_PARTS 64
+
+/* The state of a parallel deposition. Part i owns the node codes
+ * [bounds[i]; bounds[i + 1]) and has deposited its particles up to done[i]. */
+struct pic_ex_args {
+    const float *x, *y, *z, *q;
+    size_t n, parts;
+    unsigned level;
+    int tsc;
+    float *grid;
+    struct pic_seam *seams;
+    uint32_t bounds[PIC_EX_PARTS + 1];
+    size_t done[PIC_EX_PARTS];
+};
+
+static inline void pic_deposit_ex_task(void *arg, size_t begin, size_t end)
+{
+    struct pic_ex_args *p = (struct pic_ex_args *)arg;
+    size_t i, first, last;
+
+    for (i = begin; i < end; ++i) {
+        first = p->done[i];
+        last = p->n * (i + 1) / p->parts;
+        if (p->tsc) {
+            p->done[i] += pic_deposit_tsc_32(p->x + first, p->y + first, p->z + first,
+                                             p->q + first, last - first, p->level, p->bounds[i],
+                                             p->bounds[i + 1], p->grid, p->seams + i);
+        } else {
+            p->done[i] += pic_deposit_cic_32(p->x + first, p->y + first, p->z + first,
+                                             p->q + first, last - first, p->level, p->bounds[i],
+                                             p->bounds[i + 1], p->grid, p->seams + i);
+        }
+    }
+}
+
+/* The driver of pic_deposit_cic_ex_32 and pic_deposit_tsc_ex_32 */
+static inline void pic_deposit_ex_32(struct exec *e, const float *x, const float *y,
+                                     const float *z, const float *q, size_t n, unsigned level,
+                                     float *grid, struct pic_seam *seams, size_t nseams, int tsc)
+{
+    struct pic_ex_args p;
+    uint32_t mask = ((uint32_t)1 << (3 * level)) - 1;
+    size_t grain = exec_grain(tsc ? 256 : 96, 1), i, left;
+
+    p.parts = (n + grain - 1) / grain;
+    p.parts = p.parts < nseams ? p.parts : nseams;
+    p.parts = p.parts < PIC_EX_PARTS ? p.parts : PIC_EX_PARTS;
+    for (i = 0; i < p.parts; ++i) {
+        if (seams[i].cap < (tsc ? 27u : 8u)) {
+            p.parts = 0;
+        }
+    }
+    if (e == NULL || p.parts < 2) {
+        if (tsc) {
+            pic_deposit_tsc_32(x, y, z, q, n, level, 0, 0, grid, NULL);
+        } else {
+            pic_deposit_cic_32(x, y, z, q, n, level, 0, 0, grid, NULL);
+        }
+        return;
+    }
+    p.x = x;
+    p.y = y;
+    p.z = z;
+    p.q = q;
+    p.n = n;
+    p.level = level;
+    p.tsc = tsc;
+    p.grid = grid;
+    p.seams = seams;
+    /* A part owns the codes from the cell of its first particle on. The bounds
+     * are kept ascending, so that the ranges are disjoint even if the particles
+     * aren't sorted. */
+    p.bounds[0] = 0;
+    for (i = 1; i < p.parts; ++i) {
+        size_t first = n * i / p.parts;
+        uint32_t c = morton3_32((uint32_t)(x[first] + (tsc ? 0.5f : 0.0f)),
+                                (uint32_t)(y[first] + (tsc ? 0.5f : 0.0f)),
+                                (uint32_t)(z[first] + (tsc ? 0.5f : 0.0f))) & mask;
+        p.bounds[i] = c > p.bounds[i - 1] ? c : p.bounds[i - 1];
+    }
+    p.bounds[p.parts] = mask + 1;
+    for (i = 0; i < p.parts; ++i) {
+        p.done[i] = n * i / p.parts;
+        seams[i].count = 0;
+    }
+
+    /* Parts stop when their seam fills up; the seams are applied in between */
+    do {
+        exec_for(e, pic_deposit_ex_task, &p, p.parts, 1);
+        left = 0;
+        for (i = 0; i < p.parts; ++i) {
+            pic_seam_apply(seams + i, grid);
+            left += p.done[i] < n * (i + 1) / p.parts;
+        }
+    } while (left > 0);
+}
+
+/**
+ * pic_deposit_cic_32 of all n particles on the executor e, without atomics.
+ * The particles, which should be sorted by pic_keys_32, are split into up to
+ * nseams (at most PIC_EX_PARTS) parts, each of which owns the code range of
+ * its particles and deposits onto the nodes of that range directly. Updates
+ * of other nodes go to the part's seam buffer (seams[i], with room for at
+ * least 8 updates), and the seams are applied on the calling thread whenever
+ * one fills up and at the end. The sums can differ from the serial result in
+ * the last bits, since seam updates are added in a different order.
+ *
+ * Complexity: that of pic_deposit_cic_32, plus the seam updates
+ */
+static inline void pic_deposit_cic_ex_32(struct exec *e, const float *x, const float *y,
+                                         const float *z, const float *q, size_t n,
+                                         unsigned level, float *grid, struct pic_seam *seams,
+                                         size_t nseams)
+{
+    pic_deposit_ex_32(e, x, y, z, q, n, level, grid, seams, nseams, 0);
+}
+
+/**
+ * pic_deposit_tsc_32 of all n particles on the executor e. See
+ * pic_deposit_cic_ex_32; the seam buffers need room for at least 27 updates.
+ *
+ * Complexity: that of pic_deposit_tsc_32, plus the seam updates
+ */
+static inline void pic_deposit_tsc_ex_32(struct exec *e, const float *x, const float *y,
+                                         const float *z, const float *q, size_t n,
+                                         unsigned level, float *grid, struct pic_seam *seams,
+                                         size_t nseams)
+{
+    pic_deposit_ex_32(e, x, y, z, q, n, level, grid, seams, nseams, 1);
+}
+
+static inline void pic_gather_cic_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    pic_gather_cic_32((const float *)p->in[0] + begin, (const float *)p->in[1] + begin,
+                      (const float *)p->in[2] + begin, end - begin, (unsigned)p->a,
+                      (const float *)p->ctx, (float *)p->out[0] + begin);
+}
+
+static inline void pic_gather_tsc_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+
+    pic_gather_tsc_32((const float *)p->in[0] + begin, (const float *)p->in[1] + begin,
+                      (const float *)p->in[2] + begin, end - begin, (unsigned)p->a,
+                      (const float *)p->ctx, (float *)p->out[0] + begin);
+}
+
+/**
+ * pic_gather_cic_32 on the executor e. Chunks hold whole batches of PIC_CHUNK
+ * particles.
+ *
+ * Complexity: that of pic_gather_cic_32
+ */
+static inline void pic_gather_cic_ex_32(struct exec *e, const float *x, const float *y,
+                                        const float *z, size_t n, unsigned level,
+                                        const float *grid, float *out)
+{
+    struct bulk_args p = {.in = {x, y, z}, .out = {out}, .ctx = grid, .a = level};
+
+    exec_for(e, pic_gather_cic_task, &p, n, exec_grain(64, PIC_CHUNK));
+}
+
+/**
+ * pic_gather_tsc_32 on the executor e. Chunks hold whole batches of PIC_CHUNK
+ * particles.
+ *
+ * Complexity: that of pic_gather_tsc_32
+ */
+static inline void pic_gather_tsc_ex_32(struct exec *e, const float *x, const float *y,
+                                        const float *z, size_t n, unsigned level,
+                                        const float *grid, float *out)
+{
+    struct bulk_args p = {.in = {x, y, z}, .out = {out}, .ctx = grid, .a = level};
+
+    exec_for(e, pic_gather_tsc_task, &p, n, exec_grain(128, PIC_CHUNK));
+}
+
+static inline void zkey_build_task(void *arg, size_t begin, size_t end)
+{
+    struct bulk_args *p = (struct bulk_args *)arg;
+    const uint32_t *const *cols = (const uint32_t *const *)p->ctx;
+    const uint32_t *part[64];
+    unsigned c;
+
+    for (c = 0; c < p->a; ++c) {
+        part[c] = cols[c] + begin;
+    }
+    zkey_build_64(part, (unsigned)p->a, end - begin, (uint64_t *)p->out[0] + begin);
+}
+
+/**
+ * zkey_build_64 on the executor e, in chunks of rows.
+ *
+ * Complexity: O(n * k)
+ */
+static inline void zkey_build_ex_64(struct exec *e, const uint32_t *const *cols, unsigned k,
+                                    size_t n, uint64_t *keys)
+{
+    struct bulk_args p = {.out = {keys}, .ctx = cols, .a = k};
+
+    exec_for(e, zkey_build_task, &p, n, exec_grain(64 + 2 * (size_t)k, 1));
+}
+
+#endif //BITLIB_BULK_H
@@ -0,0 +1,675 @@
+/**
+ * Predicates and per-axis arithmetic evaluated directly on Morton codes. Masking
+ * a code with the bits of one axis keeps the order of that coordinate, so
+ * comparisons, component-wise minimums and box tests need no decoding.
+ *
+ * Function families in this file:
+ * mortonxlt, mortonylt, mortonxlt3, mortonylt3, mortonzlt3: per-axis less than
+ * mortonxle, mortonyle, mortonxle3, mortonyle3, mortonzle3: per-axis less than
+ *     or equal
+ * mortonmin, mortonmin3: component-wise minimum of two points
+ * mortonmax, mortonmax3: component-wise maximum of two points
+ * morton_in_box, morton3_in_box: test whether a code lies inside a box
+ * morton_in_box_bulk, morton3_in_box_bulk: box test of an array into a bitmask
+ * mortonbigmin, mortonbigmin3: next code inside a box (BIGMIN)
+ * mortonlitmax, mortonlitmax3: previous code inside a box (LITMAX)
+ */
+
+#ifndef BITLIB_COMPARE_H
+#define BITLIB_COMPARE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Decide whether the x coordinate of 2D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxlt_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x55555555) < (b & 0x55555555);
+}
+
+/**
+ * Decide whether the x coordinate of 2D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxle_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x55555555) <= (b & 0x55555555);
+}
+
+/**
+ * Decide whether the y coordinate of 2D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonylt_32(uint32_t a, uint32_t b)
+{
+    return (a & 0xaaaaaaaa) < (b & 0xaaaaaaaa);
+}
+
+/**
+ * Decide whether the y coordinate of 2D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonyle_32(uint32_t a, uint32_t b)
+{
+    return (a & 0xaaaaaaaa) <= (b & 0xaaaaaaaa);
+}
+
+/**
+ * Decide whether the x coordinate of 2D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxlt_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x5555555555555555) < (b & 0x5555555555555555);
+}
+
+/**
+ * Decide whether the x coordinate of 2D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxle_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x5555555555555555) <= (b & 0x5555555555555555);
+}
+
+/**
+ * Decide whether the y coordinate of 2D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonylt_64(uint64_t a, uint64_t b)
+{
+    return (a & 0xaaaaaaaaaaaaaaaa) < (b & 0xaaaaaaaaaaaaaaaa);
+}
+
+/**
+ * Decide whether the y coordinate of 2D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonyle_64(uint64_t a, uint64_t b)
+{
+    return (a & 0xaaaaaaaaaaaaaaaa) <= (b & 0xaaaaaaaaaaaaaaaa);
+}
+
+/**
+ * Decide whether the x coordinate of 3D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxlt3_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x49249249) < (b & 0x49249249);
+}
+
+/**
+ * Decide whether the x coordinate of 3D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxle3_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x49249249) <= (b & 0x49249249);
+}
+
+/**
+ * Decide whether the y coordinate of 3D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonylt3_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x92492492) < (b & 0x92492492);
+}
+
+/**
+ * Decide whether the y coordinate of 3D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonyle3_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x92492492) <= (b & 0x92492492);
+}
+
+/**
+ * Decide whether the z coordinate of 3D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonzlt3_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x24924924) < (b & 0x24924924);
+}
+
+/**
+ * Decide whether the z coordinate of 3D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonzle3_32(uint32_t a, uint32_t b)
+{
+    return (a & 0x24924924) <= (b & 0x24924924);
+}
+
+/**
+ * Decide whether the x coordinate of 3D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxlt3_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x9249249249249249) < (b & 0x9249249249249249);
+}
+
+/**
+ * Decide whether the x coordinate of 3D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonxle3_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x9249249249249249) <= (b & 0x9249249249249249);
+}
+
+/**
+ * Decide whether the y coordinate of 3D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonylt3_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x2492492492492492) < (b & 0x2492492492492492);
+}
+
+/**
+ * Decide whether the y coordinate of 3D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonyle3_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x2492492492492492) <= (b & 0x2492492492492492);
+}
+
+/**
+ * Decide whether the z coordinate of 3D Morton code a is less than that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonzlt3_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x4924924924924924) < (b & 0x4924924924924924);
+}
+
+/**
+ * Decide whether the z coordinate of 3D Morton code a is less than or equal to that of
+ * b, without decoding either code.
+ *
+ * Complexity: 2 bit ops, 1 compare
+ */
+static inline int mortonzle3_64(uint64_t a, uint64_t b)
+{
+    return (a & 0x4924924924924924) <= (b & 0x4924924924924924);
+}
+
+/**
+ * Calculate the 2D Morton code of the component-wise minimum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 5 bit ops, 2 compare
+ */
+static inline uint32_t mortonmin_32(uint32_t a, uint32_t b)
+{
+    uint32_t ax = a & 0x55555555, bx = b & 0x55555555;
+    uint32_t ay = a & 0xaaaaaaaa, by = b & 0xaaaaaaaa;
+    return (ax < bx ? ax : bx) |
+           (ay < by ? ay : by);
+}
+
+/**
+ * Calculate the 2D Morton code of the component-wise maximum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 5 bit ops, 2 compare
+ */
+static inline uint32_t mortonmax_32(uint32_t a, uint32_t b)
+{
+    uint32_t ax = a & 0x55555555, bx = b & 0x55555555;
+    uint32_t ay = a & 0xaaaaaaaa, by = b & 0xaaaaaaaa;
+    return (ax > bx ? ax : bx) |
+           (ay > by ? ay : by);
+}
+
+/**
+ * Calculate the 2D Morton code of the component-wise minimum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 5 bit ops, 2 compare
+ */
+static inline uint64_t mortonmin_64(uint64_t a, uint64_t b)
+{
+    uint64_t ax = a & 0x5555555555555555, bx = b & 0x5555555555555555;
+    uint64_t ay = a & 0xaaaaaaaaaaaaaaaa, by = b & 0xaaaaaaaaaaaaaaaa;
+    return (ax < bx ? ax : bx) |
+           (ay < by ? ay : by);
+}
+
+/**
+ * Calculate the 2D Morton code of the component-wise maximum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 5 bit ops, 2 compare
+ */
+static inline uint64_t mortonmax_64(uint64_t a, uint64_t b)
+{
+    uint64_t ax = a & 0x5555555555555555, bx = b & 0x5555555555555555;
+    uint64_t ay = a & 0xaaaaaaaaaaaaaaaa, by = b & 0xaaaaaaaaaaaaaaaa;
+    return (ax > bx ? ax : bx) |
+           (ay > by ? ay : by);
+}
+
+/**
+ * Calculate the 3D Morton code of the component-wise minimum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 8 bit ops, 3 compare
+ */
+static inline uint32_t mortonmin3_32(uint32_t a, uint32_t b)
+{
+    uint32_t ax = a & 0x49249249, bx = b & 0x49249249;
+    uint32_t ay = a & 0x92492492, by = b & 0x92492492;
+    uint32_t az = a & 0x24924924, bz = b & 0x24924924;
+    return (ax < bx ? ax : bx) |
+           (ay < by ? ay : by) |
+           (az < bz ? az : bz);
+}
+
+/**
+ * Calculate the 3D Morton code of the component-wise maximum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 8 bit ops, 3 compare
+ */
+static inline uint32_t mortonmax3_32(uint32_t a, uint32_t b)
+{
+    uint32_t ax = a & 0x49249249, bx = b & 0x49249249;
+    uint32_t ay = a & 0x92492492, by = b & 0x92492492;
+    uint32_t az = a & 0x24924924, bz = b & 0x24924924;
+    return (ax > bx ? ax : bx) |
+           (ay > by ? ay : by) |
+           (az > bz ? az : bz);
+}
+
+/**
+ * Calculate the 3D Morton code of the component-wise minimum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 8 bit ops, 3 compare
+ */
+static inline uint64_t mortonmin3_64(uint64_t a, uint64_t b)
+{
+    uint64_t ax = a & 0x9249249249249249, bx = b & 0x9249249249249249;
+    uint64_t ay = a & 0x2492492492492492, by = b & 0x2492492492492492;
+    uint64_t az = a & 0x4924924924924924, bz = b & 0x4924924924924924;
+    return (ax < bx ? ax : bx) |
+           (ay < by ? ay : by) |
+           (az < bz ? az : bz);
+}
+
+/**
+ * Calculate the 3D Morton code of the component-wise maximum of the points
+ * encoded by a and b, without decoding either code.
+ *
+ * Complexity: 8 bit ops, 3 compare
+ */
+static inline uint64_t mortonmax3_64(uint64_t a, uint64_t b)
+{
+    uint64_t ax = a & 0x9249249249249249, bx = b & 0x9249249249249249;
+    uint64_t ay = a & 0x2492492492492492, by = b & 0x2492492492492492;
+    uint64_t az = a & 0x4924924924924924, bz = b & 0x4924924924924924;
+    return (ax > bx ? ax : bx) |
+           (ay > by ? ay : by) |
+           (az > bz ? az : bz);
+}
+
+/**
+ * Decide whether the 2D Morton code m lies inside the box spanned by the codes
+ * lo = morton_32(xmin, ymin) and hi = morton_32(xmax, ymax), bounds inclusive,
+ * without decoding m. Masking out the other coordinates keeps the order of the
+ * remaining one, so every axis is checked with two plain integer comparisons.
+ * The comparisons are combined without branches.
+ *
+ * Complexity: 9 bit ops, 4 compare
+ */
+static inline int morton_in_box_32(uint32_t m, uint32_t lo, uint32_t hi)
+{
+    uint32_t x = m & 0x55555555, y = m & 0xaaaaaaaa;
+    return (x >= (lo & 0x55555555)) & (x <= (hi & 0x55555555)) &
+           (y >= (lo & 0xaaaaaaaa)) & (y <= (hi & 0xaaaaaaaa));
+}
+
+/**
+ * Decide whether the 2D Morton code m lies inside the box spanned by the codes
+ * lo = morton_64(xmin, ymin) and hi = morton_64(xmax, ymax), bounds inclusive.
+ * See morton_in_box_32.
+ *
+ * Complexity: 9 bit ops, 4 compare
+ */
+static inline int morton_in_box_64(uint64_t m, uint64_t lo, uint64_t hi)
+{
+    uint64_t x = m & 0x5555555555555555, y = m & 0xaaaaaaaaaaaaaaaa;
+    return (x >= (lo & 0x5555555555555555)) & (x <= (hi & 0x5555555555555555)) &
+           (y >= (lo & 0xaaaaaaaaaaaaaaaa)) & (y <= (hi & 0xaaaaaaaaaaaaaaaa));
+}
+
+/**
+ * Decide whether the 3D Morton code m lies inside the box spanned by the codes
+ * lo = morton3_32(xmin, ymin, zmin) and hi = morton3_32(xmax, ymax, zmax),
+ * bounds inclusive. See morton_in_box_32.
+ *
+ * Complexity: 14 bit ops, 6 compare
+ */
+static inline int morton3_in_box_32(uint32_t m, uint32_t lo, uint32_t hi)
+{
+    uint32_t x = m & 0x49249249, y = m & 0x92492492, z = m & 0x24924924;
+    return (x >= (lo & 0x49249249)) & (x <= (hi & 0x49249249)) &
+           (y >= (lo & 0x92492492)) & (y <= (hi & 0x92492492)) &
+           (z >= (lo & 0x24924924)) & (z <= (hi & 0x24924924));
+}
+
+/**
+ * Decide whether the 3D Morton code m lies inside the box spanned by the codes
+ * lo = morton3_64(xmin, ymin, zmin) and hi = morton3_64(xmax, ymax, zmax),
+ * bounds inclusive. See morton_in_box_32.
+ *
+ * Complexity: 14 bit ops, 6 compare
+ */
+static inline int morton3_in_box_64(uint64_t m, uint64_t lo, uint64_t hi)
+{
+    uint64_t x = m & 0x9249249249249249, y = m & 0x2492492492492492, z = m & 0x4924924924924924;
+    return (x >= (lo & 0x9249249249249249)) & (x <= (hi & 0x9249249249249249)) &
+           (y >= (lo & 0x2492492492492492)) & (y <= (hi & 0x2492492492492492)) &
+           (z >= (lo & 0x4924924924924924)) & (z <= (hi & 0x4924924924924924));
+}
+
+/**
+ * Test n 2D Morton codes against the box spanned by lo and hi (see
+ * morton_in_box_32). Bit i % 64 of mask[i / 64] is set if m[i] is inside the box;
+ * mask must have room for (n + 63) / 64 words and unused bits of the last word
+ * are cleared.
+ *
+ * The inner loop is branch-free and has a fixed trip count, so compilers turn
+ * it into vector code when a SIMD instruction set (e.g. AVX2) is enabled.
+ *
+ * Complexity: n times morton_in_box_32
+ */
+static inline void morton_in_box_bulk_32(const uint32_t *m, size_t n,
+                                          uint32_t lo, uint32_t hi, uint64_t *mask)
+{
+    size_t i, j;
+    uint64_t word;
+
+    for (i = 0; i + 64 <= n; i += 64) {
+        word = 0;
+        for (j = 0; j < 64; ++j) {
+            word |= (uint64_t)morton_in_box_32(m[i + j], lo, hi) << j;
+        }
+        mask[i / 64] = word;
+    }
+    if (i < n) {
+        word = 0;
+        for (j = 0; i < n; ++i, ++j) {
+            word |= (uint64_t)morton_in_box_32(m[i], lo, hi) << j;
+        }
+        mask[n / 64] = word;
+    }
+}
+
+/**
+ * Test n 2D Morton codes against the box spanned by lo and hi (see
+ * morton_in_box_64). Bit i % 64 of mask[i / 64] is set if m[i] is inside the box;
+ * mask must have room for (n + 63) / 64 words and unused bits of the last word
+ * are cleared.
+ *
+ * The inner loop is branch-free and has a fixed trip count, so compilers turn
+ * it into vector code when a SIMD instruction set (e.g. AVX2) is enabled.
+ *
+ * Complexity: n times morton_in_box_64
+ */
+static inline void morton_in_box_bulk_64(const uint64_t *m, size_t n,
+                                          uint64_t lo, uint64_t hi, uint64_t *mask)
+{
+    size_t i, j;
+    uint64_t word;
+
+    for (i = 0; i + 64 <= n; i += 64) {
+        word = 0;
+        for (j = 0; j < 64; ++j) {
+            word |= (uint64_t)morton_in_box_64(m[i + j], lo, hi) << j;
+        }
+        mask[i / 64] = word;
+    }
+    if (i < n) {
+        word = 0;
+        for (j = 0; i < n; ++i, ++j) {
+            word |= (uint64_t)morton_in_box_64(m[i], lo, hi) << j;
+        }
+        mask[n / 64] = word;
+    }
+}
+
+/**
+ * Test n 3D Morton codes against the box spanned by lo and hi (see
+ * morton3_in_box_32). Bit i % 64 of mask[i / 64] is set if m[i] is inside the box;
+ * mask must have room for (n + 63) / 64 words and unused bits of the last word
+ * are cleared.
+ *
+ * The inner loop is branch-free and has a fixed trip count, so compilers turn
+ * it into vector code when a SIMD instruction set (e.g. AVX2) is enabled.
+ *
+ * Complexity: n times morton3_in_box_32
+ */
+static inline void morton3_in_box_bulk_32(const uint32_t *m, size_t n,
+                                          uint32_t lo, uint32_t hi, uint64_t *mask)
+{
+    size_t i, j;
+    uint64_t word;
+
+    for (i = 0; i + 64 <= n; i += 64) {
+        word = 0;
+        for (j = 0; j < 64; ++j) {
+            word |= (uint64_t)morton3_in_box_32(m[i + j], lo, hi) << j;
+        }
+        mask[i / 64] = word;
+    }
+    if (i < n) {
+        word = 0;
+        for (j = 0; i < n; ++i, ++j) {
+            word |= (uint64_t)morton3_in_box_32(m[i], lo, hi) << j;
+        }
+        mask[n / 64] = word;
+    }
+}
+
+/**
+ * Test n 3D Morton codes against the box spanned by lo and hi (see
+ * morton3_in_box_64). Bit i % 64 of mask[i / 64] is set if m[i] is inside the box;
+ * mask must have room for (n + 63) / 64 words and unused bits of the last word
+ * are cleared.
+ *
+ * The inner loop is branch-free and has a fixed trip count, so compilers turn
+ * it into vector code when a SIMD instruction set (e.g. AVX2) is enabled.
+ *
+ * Complexity: n times morton3_in_box_64
+ */
+static inline void morton3_in_box_bulk_64(const uint64_t *m, size_t n,
+                                          uint64_t lo, uint64_t hi, uint64_t *mask)
+{
+    size_t i, j;
+    uint64_t word;
+
+    for (i = 0; i + 64 <= n; i += 64) {
+        word = 0;
+        for (j = 0; j < 64; ++j) {
+            word |= (uint64_t)morton3_in_box_64(m[i + j], lo, hi) << j;
+        }
+        mask[i / 64] = word;
+    }
+    if (i < n) {
+        word = 0;
+        for (j = 0; i < n; ++i, ++j) {
+            word |= (uint64_t)morton3_in_box_64(m[i], lo, hi) << j;
+        }
+        mask[n / 64] = word;
+    }
+}
+
+/**
+ * Find the smallest 2D Morton code greater than z that lies inside the box
+ * spanned by the codes lo and hi (see morton_in_box_64). Returns 0 if there is
+ * no such code. This is the BIGMIN operation of Tropf and Herzog: scanning a
+ * Morton-sorted array for a box, it skips the whole run of codes after z that
+ * falls outside of the box.
+ *
+ * Complexity: 8 bit ops, 1 add/subs, 3 compare, 4 branch per bit
+ */
+static inline uint64_t mortonbigmin_64(uint64_t z, uint64_t lo, uint64_t hi)
+{
+    uint64_t bigmin = 0, bit = (uint64_t)1 << 63, dim = 0xaaaaaaaaaaaaaaaa;
+
+    for (; bit != 0; bit >>= 1, dim >>= 1) {
+        uint64_t below = (bit - 1) & dim;
+        int zb = (z & bit) != 0, lb = (lo & bit) != 0, hb = (hi & bit) != 0;
+
+        if (!zb && !lb && hb) {
+            bigmin = (lo | bit) & ~below;
+            hi = (hi & ~bit) | below;
+        } else if (!zb && lb) {
+            return lo;
+        } else if (zb && !hb) {
+            return bigmin;
+        } else if (zb && !lb) {
+            lo = (lo | bit) & ~below;
+        }
+    }
+    return bigmin;
+}
+
+/**
+ * Find the largest 2D Morton code less than z that lies inside the box spanned
+ * by the codes lo and hi (see morton_in_box_64). Returns UINT64_MAX if there is
+ * no such code. This is the LITMAX operation of Tropf and Herzog, the mirror
+ * image of mortonbigmin_64.
+ *
+ * Complexity: 8 bit ops, 1 add/subs, 3 compare, 4 branch per bit
+ */
+static inline uint64_t mortonlitmax_64(uint64_t z, uint64_t lo, uint64_t hi)
+{
+    uint64_t litmax = UINT64_MAX, bit = (uint64_t)1 << 63, dim = 0xaaaaaaaaaaaaaaaa;
+
+    for (; bit != 0; bit >>= 1, dim >>= 1) {
+        uint64_t below = (bit - 1) & dim;
+        int zb = (z & bit) != 0, lb = (lo & bit) != 0, hb = (hi & bit) != 0;
+
+        if (!zb && !lb && hb) {
+            hi = (hi & ~bit) | below;
+        } else if (!zb && lb) {
+            return litmax;
+        } else if (zb && !hb) {
+            return hi;
+        } else if (zb && !lb) {
+            litmax = (hi & ~bit) | below;
+            lo = (lo | bit) & ~below;
+        }
+    }
+    return litmax;
+}
+
+/**
+ * Find the smallest 3D Morton code greater than z that lies inside the box
+ * spanned by the codes lo and hi (see morton3_in_box_64). Returns 0 if there is
+ * no such code. See mortonbigmin_64.
+ *
+ * Complexity: 8 bit ops, 1 add/subs, 3 compare, 4 branch per bit
+ */
+static inline uint64_t mortonbigmin3_64(uint64_t z, uint64_t lo, uint64_t hi)
+{
+    uint64_t bigmin = 0, bit = (uint64_t)1 << 63, dim = 0x9249249249249249;
+
+    for (; bit != 0; bit >>= 1, dim >>= 1) {
+        uint64_t below = (bit - 1) & dim;
+        int zb = (z & bit) != 0, lb = (lo & bit) != 0, hb = (hi & bit) != 0;
+
+        if (!zb && !lb && hb) {
+            bigmin = (lo | bit) & ~below;
+            hi = (hi & ~bit) | below;
+        } else if (!zb && lb) {
+            return lo;
+        } else if (zb && !hb) {
+            return bigmin;
+        } else if (zb && !lb) {
+            lo = (lo | bit) & ~below;
+        }
+    }
+    return bigmin;
+}
+
+/**
+ * Find the largest 3D Morton code less than z that lies inside the box spanned
+ * by the codes lo and hi (see morton3_in_box_64). Returns UINT64_MAX if there
+ * is no such code. See mortonlitmax_64.
+ *
+ * Complexity: 8 bit ops, 1 add/subs, 3 compare, 4 branch per bit
+ */
+static inline uint64_t mortonlitmax3_64(uint64_t z, uint64_t lo, uint64_t hi)
+{
+    uint64_t litmax = UINT64_MAX, bit = (uint64_t)1 << 63, dim = 0x9249249249249249;
+
+    for (; bit != 0; bit >>= 1, dim >>= 1) {
+        uint64_t below = (bit - 1) & dim;
+        int zb = (z & bit) != 0, lb = (lo & bit) != 0, hb = (hi & bit) != 0;
+
+        if (!zb && !lb && hb) {
+            hi = (hi & ~bit) | below;
+        } else if (!zb && lb) {
+            return litmax;
+        } else if (zb && !hb) {
+            return hi;
+        } else if (zb && !lb) {
+            litmax = (hi & ~bit) | below;
+            lo = (lo | bit) & ~below;
+        }
+    }
+    return litmax;
+}
+
+#endif //BITLIB_COMPARE_H
@@ -0,0 +1,191 @@
+/**
+ * Tools for walking Morton codes in order while keeping track of the decoded
+ * coordinates. Incrementing a code flips its trailing one bits and the zero
+ * bit above them; the flipped bits of each coordinate form a low mask whose
+ * length follows from the number of trailing zeros of the new code. Updating
+ * the coordinates this way costs a handful of operations, compared to the
+ * 20-50 of a full invmorton/invmorton3.
+ *
+ * Function families in this file:
+ * mortonnext, mortonnext3: step to the next 2D or 3D code, updating (x; y[; z])
+ * invmorton_seq, invmorton3_seq: decode a run of consecutive codes
+ */
+
+#ifndef BITLIB_CURSOR_H
+#define BITLIB_CURSOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "bitscan.h"
+#include "morton.h"
+
+/**
+ * Return m + 1 and update x and y from the coordinates of m to those of m + 1.
+ * m must be less than UINT32_MAX, or the result is undefined. To start or to
+ * seek to an arbitrary code, decode it once with invmorton_32.
+ *
+ * Complexity: 8 bit ops, 5 add/subs, 1 multiply
+ */
+static inline uint32_t mortonnext_32(uint32_t m, uint32_t *x, uint32_t *y)
+{
+    uint32_t k = ctz_mul_32(++m);
+    *x ^= ((uint32_t)2 << (k >> 1)) - 1;
+    *y ^= ((uint32_t)1 << ((k + 1) >> 1)) - 1;
+    return m;
+}
+
+/**
+ * Return m + 1 and update x and y from the coordinates of m to those of m + 1.
+ * m must be less than UINT64_MAX, or the result is undefined. To start or to
+ * seek to an arbitrary code, decode it once with invmorton_64.
+ *
+ * Complexity: 8 bit ops, 5 add/subs, 1 multiply
+ */
+static inline uint64_t mortonnext_64(uint64_t m, uint64_t *x, uint64_t *y)
+{
+    uint64_t k = ctz_mul_64(++m);
+    *x ^= ((uint64_t)2 << (k >> 1)) - 1;
+    *y ^= ((uint64_t)1 << ((k + 1) >> 1)) - 1;
+    return m;
+}
+
+/**
+ * Return m + 1 and update x, y and z from the coordinates of m to those of
+ * m + 1. m must be less than UINT32_MAX, or the result is undefined. To start or
+ * to seek to an arbitrary code, decode it once with invmorton3_32.
+ *
+ * Complexity: 8 bit ops, 7 add/subs, 1 multiply, 3 divisions by a constant
+ */
+static inline uint32_t mortonnext3_32(uint32_t m, uint32_t *x, uint32_t *y, uint32_t *z)
+{
+    uint32_t k = ctz_mul_32(++m);
+    *x ^= ((uint32_t)2 << (k / 3)) - 1;
+    *y ^= ((uint32_t)1 << ((k + 2) / 3)) - 1;
+    *z ^= ((uint32_t)1 << ((k + 1) / 3)) - 1;
+    return m;
+}
+
+/**
+ * Return m + 1 and update x, y and z from the coordinates of m to those of
+ * m + 1. m must be less than UINT64_MAX, or the result is undefined. To start or
+ * to seek to an arbitrary code, decode it once with invmorton3_64.
+ *
+ * Complexity: 8 bit ops, 7 add/subs, 1 multiply, 3 divisions by a constant
+ */
+static inline uint64_t mortonnext3_64(uint64_t m, uint64_t *x, uint64_t *y, uint64_t *z)
+{
+    uint64_t k = ctz_mul_64(++m);
+    *x ^= ((uint64_t)2 << (k / 3)) - 1;
+    *y ^= ((uint64_t)1 << ((k + 2) / 3)) - 1;
+    *z ^= ((uint64_t)1 << ((k + 1) / 3)) - 1;
+    return m;
+}
+
+/**
+ * Decode the n consecutive 2D Morton codes starting at first into the arrays x
+ * and y. first + n - 1 must not overflow. Only the first code is fully
+ * decoded, the rest are reached with mortonnext_32.
+ *
+ * The run can be split into chunks that are decoded independently, since every
+ * chunk seeks to its own first code; invmorton_seq_ex_32 in bulk.h does this
+ * on an executor.
+ *
+ * Complexity: invmorton_32 once, then n - 1 times mortonnext_32
+ */
+static inline void invmorton_seq_32(uint32_t first, size_t n, uint32_t *x, uint32_t *y)
+{
+    uint32_t m = first, cx, cy;
+    size_t i;
+
+    if (n == 0) {
+        return;
+    }
+    invmorton_32(m, &cx, &cy);
+    x[0] = cx;
+    y[0] = cy;
+    for (i = 1; i < n; ++i) {
+        m = mortonnext_32(m, &cx, &cy);
+        x[i] = cx;
+        y[i] = cy;
+    }
+}
+
+/**
+ * Decode the n consecutive 2D Morton codes starting at first into the arrays x
+ * and y. first + n - 1 must not overflow. See invmorton_seq_32.
+ *
+ * Complexity: invmorton_64 once, then n - 1 times mortonnext_64
+ */
+static inline void invmorton_seq_64(uint64_t first, size_t n, uint64_t *x, uint64_t *y)
+{
+    uint64_t m = first, cx, cy;
+    size_t i;
+
+    if (n == 0) {
+        return;
+    }
+    invmorton_64(m, &cx, &cy);
+    x[0] = cx;
+    y[0] = cy;
+    for (i = 1; i < n; ++i) {
+        m = mortonnext_64(m, &cx, &cy);
+        x[i] = cx;
+        y[i] = cy;
+    }
+}
+
+/**
+ * Decode the n consecutive 3D Morton codes starting at first into the arrays
+ * x, y and z. first + n - 1 must not overflow. See invmorton_seq_32.
+ *
+ * Complexity: invmorton3_32 once, then n - 1 times mortonnext3_32
+ */
+static inline void invmorton3_seq_32(uint32_t first, size_t n,
+                                     uint32_t *x, uint32_t *y, uint32_t *z)
+{
+    uint32_t m = first, cx, cy, cz;
+    size_t i;
+
+    if (n == 0) {
+        return;
+    }
+    invmorton3_32(m, &cx, &cy, &cz);
+    x[0] = cx;
+    y[0] = cy;
+    z[0] = cz;
+    for (i = 1; i < n; ++i) {
+        m = mortonnext3_32(m, &cx, &cy, &cz);
+        x[i] = cx;
+        y[i] = cy;
+        z[i] = cz;
+    }
+}
+
+/**
+ * Decode the n consecutive 3D Morton codes starting at first into the arrays
+ * x, y and z. first + n - 1 must not overflow. See invmorton_seq_32.
+ *
+ * Complexity: invmorton3_64 once, then n - 1 times mortonnext3_64
+ */
+static inline void invmorton3_seq_64(uint64_t first, size_t n,
+                                     uint64_t *x, uint64_t *y, uint64_t *z)
+{
+    uint64_t m = first, cx, cy, cz;
+    size_t i;
+
+    if (n == 0) {
+        return;
+    }
+    invmorton3_64(m, &cx, &cy, &cz);
+    x[0] = cx;
+    y[0] = cy;
+    z[0] = cz;
+    for (i = 1; i < n; ++i) {
+        m = mortonnext3_64(m, &cx, &cy, &cz);
+        x[i] = cx;
+        y[i] = cy;
+        z[i] = cz;
+    }
+}
+
+#endif //BITLIB_CURSOR_H
@@ -0,0 +1,364 @@
+/**
+ * Dirty region tracking over Morton codes (morton_64 or morton3_64), for
+ * passes that only need to recompute what changed since they last ran. The
+ * tracker is a hierarchical bitmap: level 0 has a bit per code, and every bit
+ * of level l + 1 tells whether a 64 bit word of level l has any bit set, up to
+ * a single word at the top. Marking sets one bit per level, and both finding
+ * the next dirty code and clearing skip clean regions 64^l codes at a time, so
+ * they cost time proportional to the dirty words rather than the grid size.
+ *
+ * Since aligned blocks of 4^k (2D) or 8^k (3D) codes are squares or cubes of
+ * the grid, iterating dirty blocks in code order (dirty_next_block_64) yields
+ * the dirty tiles of a coarser grid, e.g. the texels of a mipmap level to
+ * rebuild. Regions grow by a stencil radius with dirty_dilate_64 and
+ * dirty_dilate3_64, which walk the neighbors of every dirty code with Morton
+ * neighbor steps.
+ *
+ * All memory is provided by the caller.
+ *
+ * Function families in this file:
+ * dirty_size, dirty_init: set up a tracker in caller-provided memory
+ * dirty_mark, dirty_mark_range: mark codes as dirty
+ * dirty_test, dirty_any: query marks
+ * dirty_next, dirty_next_block: iterate dirty codes and blocks in code order
+ * dirty_clear: clear all marks
+ * dirty_dilate, dirty_dilate3: grow the dirty region by a stencil radius
+ * dirty_coarsen: mark the blocks of a coarser grid that contain dirty codes
+ */
+
+#ifndef BITLIB_DIRTY_H
+#define BITLIB_DIRTY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "morton.h"
+#include "bitscan.h"
+
+/**
+ * The largest number of levels of a tracker, enough for 60 bit codes.
+ */
+#define DIRTY_MAXLEVELS 10
+
+/**
+ * The largest stencil radius of dirty_dilate_64 and dirty_dilate3_64.
+ */
+#define DIRTY_MAXRADIUS 16
+
+/**
+ * A dirty tracker for codes of bits bits. Level l has words[l] words at
+ * level[l], which point into the memory passed to dirty_init.
+ */
+struct dirty {
+    unsigned bits, nlevels;
+    uint64_t *level[DIRTY_MAXLEVELS];
+    size_t words[DIRTY_MAXLEVELS];
+};
+
+/**
+ * Calculate the number of bytes of memory dirty_init needs for codes of bits
+ * bits (at most 60).
+ *
+ * Complexity: O(bits)
+ */
+static inline size_t dirty_size(unsigned bits)
+{
+    size_t words = bits > 6 ? (size_t)1 << (bits - 6) : 1, total = words;
+
+    while (words > 1) {
+        words = (words + 63) / 64;
+        total += words;
+    }
+    return total * sizeof(uint64_t);
+}
+
+/**
+ * Set up the tracker d for codes of bits bits (1 to 60) in the size bytes of
+ * memory at mem (see dirty_size), which must be 8 byte aligned, with all codes
+ * clean. Returns 1 on success, or 0 if bits is out of range or the memory is
+ * too small.
+ *
+ * Complexity: O(2^bits / 64)
+ */
+static inline int dirty_init(struct dirty *d, unsigned bits, void *mem, size_t size)
+{
+    size_t words = bits > 6 ? (size_t)1 << (bits - 6) : 1;
+    uint64_t *p = (uint64_t *)mem;
+
+    if (bits == 0 || bits > 60 || size < dirty_size(bits)) {
+        return 0;
+    }
+    memset(mem, 0, dirty_size(bits));
+    d->bits = bits;
+    d->nlevels = 0;
+    for (;;) {
+        d->level[d->nlevels] = p;
+        d->words[d->nlevels] = words;
+        ++d->nlevels;
+        p += words;
+        if (words == 1) {
+            return 1;
+        }
+        words = (words + 63) / 64;
+    }
+}
+
+/**
+ * Mark code m as dirty.
+ *
+ * Complexity: O(bits / 6)
+ */
+static inline void dirty_mark_64(struct dirty *d, uint64_t m)
+{
+    unsigned l;
+
+    for (l = 0; l < d->nlevels; ++l) {
+        d->level[l][m >> 6] |= (uint64_t)1 << (m & 63);
+        m >>= 6;
+    }
+}
+
+/**
+ * Mark the codes in [lo; hi) as dirty, e.g. an aligned block of a coarser
+ * grid.
+ *
+ * Complexity: O((hi - lo) / 64 + bits / 6)
+ */
+static inline void dirty_mark_range_64(struct dirty *d, uint64_t lo, uint64_t hi)
+{
+    unsigned l;
+
+    if (lo >= hi) {
+        return;
+    }
+    for (l = 0; l < d->nlevels; ++l) {
+        uint64_t *w = d->level[l];
+        uint64_t first = lo >> 6, last = (hi - 1) >> 6, i;
+        uint64_t head = ~(uint64_t)0 << (lo & 63), tail = ~(uint64_t)0 >> (63 - ((hi - 1) & 63));
+
+        if (first == last) {
+            w[first] |= head & tail;
+        } else {
+            w[first] |= head;
+            for (i = first + 1; i < last; ++i) {
+                w[i] = ~(uint64_t)0;
+            }
+            w[last] |= tail;
+        }
+        lo = first;
+        hi = last + 1;
+    }
+}
+
+/**
+ * Check whether code m is dirty.
+ *
+ * Complexity: 3 bit ops
+ */
+static inline int dirty_test_64(const struct dirty *d, uint64_t m)
+{
+    return (int)(d->level[0][m >> 6] >> (m & 63) & 1);
+}
+
+/**
+ * Check whether any code is dirty.
+ *
+ * Complexity: 1 compare
+ */
+static inline int dirty_any(const struct dirty *d)
+{
+    return d->level[d->nlevels - 1][0] != 0;
+}
+
+/**
+ * Find the first dirty code at or after m, writing it to out. Returns 1 if
+ * there is one and 0 otherwise.
+ *
+ * Complexity: O(bits / 6) ctz_64
+ */
+static inline int dirty_next_64(const struct dirty *d, uint64_t m, uint64_t *out)
+{
+    uint64_t i = m, w, word;
+    unsigned l = 0;
+
+    if (m >> d->bits) {
+        return 0;
+    }
+    /* Up until a word has a set bit at or after position i */
+    for (;;) {
+        w = i >> 6;
+        if (w >= d->words[l]) {
+            return 0;
+        }
+        word = d->level[l][w] & ~(uint64_t)0 << (i & 63);
+        if (word != 0) {
+            i = (w << 6) + ctz_64(word);
+            break;
+        }
+        if (++l == d->nlevels) {
+            return 0;
+        }
+        i = w + 1;
+    }
+    /* Down along the lowest set bits */
+    while (l > 0) {
+        --l;
+        i = (i << 6) + ctz_64(d->level[l][i]);
+    }
+    *out = i;
+    return 1;
+}
+
+/**
+ * Find the first dirty block of 2^shift codes that ends after m, writing its
+ * index (its first code >> shift) to block. With shift a multiple of 2 (2D) or
+ * 3 (3D), blocks are the cells of a coarser grid. Iterate the dirty blocks as
+ *
+ *     for (m = 0; dirty_next_block_64(d, m, shift, &b); m = (b + 1) << shift)
+ *
+ * Returns 1 if there is a dirty block and 0 otherwise.
+ *
+ * Complexity: dirty_next_64
+ */
+static inline int dirty_next_block_64(const struct dirty *d, uint64_t m, unsigned shift,
+                                      uint64_t *block)
+{
+    uint64_t c;
+
+    if (!dirty_next_64(d, m, &c)) {
+        return 0;
+    }
+    *block = c >> shift;
+    return 1;
+}
+
+/**
+ * Clear word w of level l and the words of the levels below it that its bits
+ * mark.
+ *
+ * Complexity: O(dirty words below)
+ */
+static inline void dirty_clear_word(struct dirty *d, unsigned l, uint64_t w)
+{
+    uint64_t word = d->level[l][w];
+
+    d->level[l][w] = 0;
+    if (l == 0) {
+        return;
+    }
+    while (word != 0) {
+        dirty_clear_word(d, l - 1, (w << 6) + ctz_64(word));
+        word &= word - 1;
+    }
+}
+
+/**
+ * Mark all codes as clean. Only the words with dirty bits are touched, so
+ * clearing a few dirty cells of a huge grid is cheap.
+ *
+ * Complexity: O(dirty words)
+ */
+static inline void dirty_clear(struct dirty *d)
+{
+    dirty_clear_word(d, d->nlevels - 1, 0);
+}
+
+/**
+ * Collect the x bits of the codes up to r steps left and right of m, stopping
+ * at the edges of the grid. Writes the first to out and returns the number of
+ * codes. xmask selects the axis bits of the grid, and xm, xp step along it.
+ *
+ * Complexity: O(r)
+ */
+static inline unsigned dirty_axis_64(uint64_t m, unsigned r, uint64_t xmask,
+                                     uint64_t (*xm)(uint64_t), uint64_t (*xp)(uint64_t),
+                                     uint64_t *out)
+{
+    uint64_t c = m;
+    unsigned i, count = 0;
+
+    for (i = 0; i < r && (c & xmask) != 0; ++i) {
+        c = xm(c);
+    }
+    for (;;) {
+        out[count++] = c & xmask;
+        if (count > i + r || (c & xmask) == xmask) {
+            return count;
+        }
+        c = xp(c);
+    }
+}
+
+/**
+ * Mark in dst every code within Chebyshev distance r (at most DIRTY_MAXRADIUS)
+ * of a dirty code of src, for a 2D grid of morton_64 codes of src->bits bits
+ * (an even number). The region is clipped at the grid edges. dst must have the
+ * same bits as src and is not cleared first. Each dirty code costs (2r + 1)^2
+ * marks, so dilate after coarsening when regions are large.
+ *
+ * Complexity: O(dirty codes * r^2)
+ */
+static inline void dirty_dilate_64(const struct dirty *src, unsigned r, struct dirty *dst)
+{
+    uint64_t grid = ~(uint64_t)0 >> (64 - src->bits);
+    uint64_t xs[2 * DIRTY_MAXRADIUS + 1], ys[2 * DIRTY_MAXRADIUS + 1], m;
+    unsigned nx, ny, a, b;
+
+    for (m = 0; dirty_next_64(src, m, &m); ++m) {
+        nx = dirty_axis_64(m, r, grid & 0x5555555555555555, mortonxm_64, mortonxp_64, xs);
+        ny = dirty_axis_64(m, r, grid & 0xaaaaaaaaaaaaaaaa, mortonym_64, mortonyp_64, ys);
+        for (b = 0; b < ny; ++b) {
+            for (a = 0; a < nx; ++a) {
+                dirty_mark_64(dst, xs[a] | ys[b]);
+            }
+        }
+    }
+}
+
+/**
+ * Mark in dst every code within Chebyshev distance r (at most DIRTY_MAXRADIUS)
+ * of a dirty code of src, for a 3D grid of morton3_64 codes of src->bits bits
+ * (a multiple of 3). See dirty_dilate_64.
+ *
+ * Complexity: O(dirty codes * r^3)
+ */
+static inline void dirty_dilate3_64(const struct dirty *src, unsigned r, struct dirty *dst)
+{
+    uint64_t grid = ~(uint64_t)0 >> (64 - src->bits);
+    uint64_t xs[2 * DIRTY_MAXRADIUS + 1], ys[2 * DIRTY_MAXRADIUS + 1];
+    uint64_t zs[2 * DIRTY_MAXRADIUS + 1], m;
+    unsigned nx, ny, nz, a, b, c;
+
+    for (m = 0; dirty_next_64(src, m, &m); ++m) {
+        nx = dirty_axis_64(m, r, grid & 0x9249249249249249, mortonxm3_64, mortonxp3_64, xs);
+        ny = dirty_axis_64(m, r, grid & 0x2492492492492492, mortonym3_64, mortonyp3_64, ys);
+        nz = dirty_axis_64(m, r, grid & 0x4924924924924924, mortonzm3_64, mortonzp3_64, zs);
+        for (c = 0; c < nz; ++c) {
+            for (b = 0; b < ny; ++b) {
+                for (a = 0; a < nx; ++a) {
+                    dirty_mark_64(dst, xs[a] | ys[b] | zs[c]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Mark in dst the blocks of 2^shift codes of src that contain a dirty code,
+ * i.e. the dirty cells of a grid coarser by shift / 2 (2D) or shift / 3 (3D)
+ * levels, such as the next mipmap level. dst needs src->bits - shift bits and
+ * is not cleared first.
+ *
+ * Complexity: O(dirty blocks * bits / 6)
+ */
+static inline void dirty_coarsen_64(const struct dirty *src, unsigned shift, struct dirty *dst)
+{
+    uint64_t m = 0, b;
+
+    while (dirty_next_block_64(src, m, shift, &b)) {
+        dirty_mark_64(dst, b);
+        m = (b + 1) << shift;
+    }
+}
+
+#endif //BITLIB_DIRTY_H
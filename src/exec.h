@@ -0,0 +1,298 @@
+/**
+ * Executors for the bulk kernels, so that array operations can run on threads
+ * that are shared between calls instead of each call starting its own.
+ *
+ * An executor runs a task over the items [0; n) of a call in chunks. The _ex
+ * kernels of bulk.h take an executor as their first argument; NULL runs the
+ * kernel serially on the calling thread, which is what the library does on its
+ * own. Applications can plug in their own scheduler by filling in struct exec,
+ * or build with -DBITLIB_EXEC_THREADS (and -pthread) to get exec_pool, a pool
+ * of POSIX threads that stay warm between calls.
+ *
+ * exec_pool splits the chunks of a call evenly between its threads, in order,
+ * so thread t works on the same part of the arrays in every call; data that
+ * thread t touched first stays on its NUMA node. A thread that runs out of
+ * chunks steals the back half of the chunks of another thread. Chunk sizes
+ * come from the cost of the kernel (see exec_grain), so that scheduling is
+ * cheap compared with the work of a chunk.
+ *
+ * Function families in this file:
+ * exec_grain: chunk size for a kernel of a given cost per item
+ * exec_for: run a task over a range, on an executor or serially
+ * exec_pool_init, exec_pool_destroy: work-stealing thread pool
+ */
+
+#ifndef BITLIB_EXEC_H
+#define BITLIB_EXEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * The number of operations per chunk that exec_grain aims for.
+ */
+#define EXEC_CHUNK_OPS 32768
+
+/**
+ * A task processes the items [begin; end) of a call; arg holds its
+ * parameters.
+ */
+typedef void (*exec_task)(void *arg, size_t begin, size_t end);
+
+/**
+ * An executor. run calls task on disjoint chunks covering [0; n), each but the
+ * last of grain items, and returns when all of them are done. Chunks may run
+ * in any order and at the same time.
+ */
+struct exec {
+    void (*run)(struct exec *e, exec_task task, void *arg, size_t n, size_t grain);
+};
+
+/**
+ * Calculate a chunk size for a kernel that performs ops operations per item,
+ * rounded up to a multiple of align (a power of 2), which is at least 1.
+ *
+ * Complexity: 1 multiply, 3 add/subs, 2 bit ops, 2 compare
+ */
+static inline size_t exec_grain(size_t ops, size_t align)
+{
+    size_t grain = EXEC_CHUNK_OPS / (ops > 0 ? ops : 1);
+
+    grain = grain > 0 ? grain : 1;
+    return (grain + align - 1) & ~(align - 1);
+}
+
+/**
+ * Run task over [0; n) in chunks of grain items on the executor e, or in one
+ * piece on the calling thread if e is NULL or n fits into one chunk.
+ *
+ * Complexity: that of the task, plus the scheduling of e
+ */
+static inline void exec_for(struct exec *e, exec_task task, void *arg, size_t n, size_t grain)
+{
+    if (n == 0) {
+        return;
+    }
+    if (e == NULL || n <= grain) {
+        task(arg, 0, n);
+    } else {
+        e->run(e, task, arg, n, grain);
+    }
+}
+
+#ifdef BITLIB_EXEC_THREADS
+
+#include <pthread.h>
+
+/**
+ * The maximum number of threads of a pool, the calling thread included.
+ */
+#define EXEC_MAXTHREADS 64
+
+/* The chunks [lo; hi) left to a thread, packed as hi << 32 | lo, on a cache
+ * line of its own since the owner and thieves update it */
+struct exec_range {
+    uint64_t chunks;
+    char pad[56];
+};
+
+/**
+ * A work-stealing thread pool. exec must stay the first member, so that a
+ * pool can be passed to the _ex kernels as &pool->exec. One call runs at a
+ * time; concurrent calls wait for each other.
+ */
+struct exec_pool {
+    struct exec exec;
+    unsigned nthreads;
+    pthread_t thread[EXEC_MAXTHREADS];
+    pthread_mutex_t lock, call;
+    pthread_cond_t wake, done;
+    unsigned generation, busy, stop;
+    exec_task task;
+    void *arg;
+    size_t n, grain;
+    struct exec_range range[EXEC_MAXTHREADS];
+};
+
+struct exec_worker {
+    struct exec_pool *pool;
+    unsigned index;
+};
+
+/* Take the first chunk of thread w's range */
+static inline int exec_pool_take(struct exec_pool *p, unsigned w, size_t *chunk)
+{
+    uint64_t r = __atomic_load_n(&p->range[w].chunks, __ATOMIC_ACQUIRE);
+
+    while ((r & 0xffffffff) < (r >> 32)) {
+        if (__atomic_compare_exchange_n(&p->range[w].chunks, &r, r + 1, 0, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            *chunk = (size_t)(r & 0xffffffff);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Move the back half of the chunks of another thread to thread w, whose range
+ * is empty. Returns 0 if there is nothing left to steal. */
+static inline int exec_pool_steal(struct exec_pool *p, unsigned w)
+{
+    unsigned i, v;
+
+    for (i = 1; i < p->nthreads; ++i) {
+        uint64_t r, lo, hi, mid;
+        v = (w + i) % p->nthreads;
+        r = __atomic_load_n(&p->range[v].chunks, __ATOMIC_ACQUIRE);
+        for (;;) {
+            lo = r & 0xffffffff;
+            hi = r >> 32;
+            if (lo >= hi) {
+                break;
+            }
+            mid = lo + (hi - lo) / 2;
+            if (__atomic_compare_exchange_n(&p->range[v].chunks, &r, mid << 32 | lo, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&p->range[w].chunks, hi << 32 | mid, __ATOMIC_RELEASE);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static inline void exec_pool_work(struct exec_pool *p, unsigned w)
+{
+    size_t chunk, begin;
+
+    do {
+        while (exec_pool_take(p, w, &chunk)) {
+            begin = chunk * p->grain;
+            p->task(p->arg, begin, p->n - begin < p->grain ? p->n : begin + p->grain);
+        }
+    } while (exec_pool_steal(p, w));
+}
+
+static inline void *exec_pool_thread(void *arg)
+{
+    struct exec_worker *self = (struct exec_worker *)arg;
+    struct exec_pool *p = self->pool;
+    unsigned w = self->index, seen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->generation == seen && !p->stop) {
+            pthread_cond_wait(&p->wake, &p->lock);
+        }
+        if (p->stop) {
+            break;
+        }
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+        exec_pool_work(p, w);
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0) {
+            pthread_cond_signal(&p->done);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static inline void exec_pool_run(struct exec *e, exec_task task, void *arg, size_t n,
+                                 size_t grain)
+{
+    struct exec_pool *p = (struct exec_pool *)e;
+    uint64_t nchunks, t;
+
+    /* Chunk indices must fit into 32 bits */
+    if ((n - 1) / grain >= 0xffffffff) {
+        grain = (n - 1) / 0xfffffffe + 1;
+    }
+    nchunks = (n - 1) / grain + 1;
+
+    pthread_mutex_lock(&p->call);
+    pthread_mutex_lock(&p->lock);
+    p->task = task;
+    p->arg = arg;
+    p->n = n;
+    p->grain = grain;
+    for (t = 0; t < p->nthreads; ++t) {
+        uint64_t lo = nchunks * t / p->nthreads, hi = nchunks * (t + 1) / p->nthreads;
+        __atomic_store_n(&p->range[t].chunks, hi << 32 | lo, __ATOMIC_RELAXED);
+    }
+    p->busy = p->nthreads - 1;
+    ++p->generation;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+
+    exec_pool_work(p, 0);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->busy > 0) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    pthread_mutex_unlock(&p->call);
+}
+
+/**
+ * Start a pool of nthreads threads, the calling thread of every call included,
+ * so nthreads - 1 threads are started. workers must have room for nthreads
+ * entries and stay valid until exec_pool_destroy. nthreads is clamped to
+ * [1; EXEC_MAXTHREADS]. Returns 0 if not all threads could be started; the pool
+ * then works with the ones that could and must still be destroyed.
+ *
+ * Complexity: nthreads thread starts
+ */
+static inline int exec_pool_init(struct exec_pool *p, unsigned nthreads,
+                                 struct exec_worker *workers)
+{
+    unsigned t;
+
+    nthreads = nthreads < 1 ? 1 : nthreads > EXEC_MAXTHREADS ? EXEC_MAXTHREADS : nthreads;
+    p->exec.run = exec_pool_run;
+    p->nthreads = 1;
+    p->generation = 0;
+    p->busy = 0;
+    p->stop = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_mutex_init(&p->call, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    for (t = 1; t < nthreads; ++t) {
+        workers[t].pool = p;
+        workers[t].index = t;
+        if (pthread_create(&p->thread[t], NULL, exec_pool_thread, &workers[t]) != 0) {
+            break;
+        }
+        p->nthreads = t + 1;
+    }
+    return p->nthreads == nthreads;
+}
+
+/**
+ * Stop the threads of a pool.
+ *
+ * Complexity: nthreads thread joins
+ */
+static inline void exec_pool_destroy(struct exec_pool *p)
+{
+    unsigned t;
+
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (t = 1; t < p->nthreads; ++t) {
+        pthread_join(p->thread[t], NULL);
+    }
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->done);
+    pthread_mutex_destroy(&p->lock);
+    pthread_mutex_destroy(&p->call);
+}
+
+#endif
+
+#endif //BITLIB_EXEC_H
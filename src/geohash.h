@@ -0,0 +1,244 @@
+/**
+ * Tools for working with geohashes. A geohash is a 2D Morton code of quantized
+ * longitude and latitude, with the first (most significant) bit taken from the
+ * longitude, written in a base32 alphabet. Integer geohashes of b bits are
+ * handled here as the top b bits of the full 64 bit interleave, right-aligned,
+ * so a string of n characters corresponds to a code of 5 * n bits.
+ *
+ * Function families in this file:
+ * geohash_encode, geohash_decode: convert between coordinates and integer codes
+ * geohash_encode_bulk, geohash_decode_bulk: the same for arrays
+ * geohash_char, geohash_value: convert between 5 bit values and base32 digits
+ * geohash_format, geohash_parse: convert between integer codes and strings
+ * geohash_neighbor: code of an adjacent cell
+ * geohash_cover: cover a bounding box with ranges of integer codes
+ */
+
+#ifndef BITLIB_GEOHASH_H
+#define BITLIB_GEOHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton.h"
+#include "range.h"
+
+/**
+ * Quantize v from [lo; lo + span) to a 32 bit integer, clamping values outside
+ * of the range. The result has the bits a bisection of the range would
+ * produce. NaN quantizes to 0.
+ *
+ * Complexity: 1 add/subs, 2 multiply, 2 compare
+ */
+static inline uint64_t geohash_quantize(double v, double lo, double span)
+{
+    double q = (v - lo) * (4294967296.0 / span);
+    /* Converting NaN to an integer is undefined, so it takes the first branch */
+    q = !(q > 0) ? 0 : q;
+    q = q > 4294967295.0 ? 4294967295.0 : q;
+    return (uint64_t)q;
+}
+
+/**
+ * Calculate the integer geohash of bits bits (1 to 64) of the point (lat; lon)
+ * given in degrees.
+ *
+ * Complexity: geohash_quantize twice, 33 bit ops
+ */
+static inline uint64_t geohash_encode_64(double lat, double lon, unsigned bits)
+{
+    uint64_t m = morton_64(geohash_quantize(lat, -90.0, 180.0),
+                           geohash_quantize(lon, -180.0, 360.0));
+    return m >> (64 - bits);
+}
+
+/**
+ * Place the center of the cell of the integer geohash code of bits bits (1 to
+ * 64) into lat and lon, in degrees.
+ *
+ * Complexity: 35 bit ops, 4 add/subs, 4 multiply
+ */
+static inline void geohash_decode_64(uint64_t code, unsigned bits, double *lat, double *lon)
+{
+    uint64_t qlat, qlon;
+    unsigned latbits = bits / 2, lonbits = bits - bits / 2;
+
+    separate_64(code << (64 - bits), &qlat, &qlon);
+    *lat = ((double)qlat + 2147483648.0 / (double)((uint64_t)1 << latbits)) *
+           (180.0 / 4294967296.0) - 90.0;
+    *lon = ((double)qlon + 2147483648.0 / (double)((uint64_t)1 << lonbits)) *
+           (360.0 / 4294967296.0) - 180.0;
+}
+
+/**
+ * Calculate the integer geohashes of bits bits of the n points (lat[i];
+ * lon[i]) into codes.
+ *
+ * The loop is branch-free, so compilers can vectorize the quantization and the
+ * interleave when a SIMD instruction set is enabled.
+ *
+ * Complexity: n times geohash_encode_64
+ */
+static inline void geohash_encode_bulk_64(const double *lat, const double *lon, size_t n,
+                                          unsigned bits, uint64_t *codes)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        codes[i] = geohash_encode_64(lat[i], lon[i], bits);
+    }
+}
+
+/**
+ * Place the cell centers of the n integer geohashes of bits bits into lat and
+ * lon.
+ *
+ * Complexity: n times geohash_decode_64
+ */
+static inline void geohash_decode_bulk_64(const uint64_t *codes, size_t n, unsigned bits,
+                                          double *lat, double *lon)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        geohash_decode_64(codes[i], bits, lat + i, lon + i);
+    }
+}
+
+/**
+ * Calculate the base32 digit of the 5 bit value v. The alphabet is the digits
+ * followed by the lowercase letters without a, i, l and o; the skips are added
+ * with comparisons instead of a table lookup.
+ *
+ * Complexity: 5 add/subs, 1 multiply, 4 compare
+ */
+static inline char geohash_char(unsigned v)
+{
+    return (char)('0' + v + (v > 9) * ('b' - '0' - 10) + (v > 16) + (v > 18) + (v > 20));
+}
+
+/**
+ * Calculate the 5 bit value of the base32 digit c, or -1 if c isn't a valid
+ * (lowercase) digit.
+ *
+ * Complexity: 5 add/subs, 9 compare, 2 branch
+ */
+static inline int geohash_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c < 'b' || c > 'z' || c == 'i' || c == 'l' || c == 'o') {
+        return -1;
+    }
+    return c - 'b' + 10 - (c > 'i') - (c > 'l') - (c > 'o');
+}
+
+/**
+ * Write the integer geohash code of 5 * chars bits (chars at most 12) as chars
+ * base32 digits to s. No terminating zero is written.
+ *
+ * Complexity: chars times geohash_char
+ */
+static inline void geohash_format_64(uint64_t code, unsigned chars, char *s)
+{
+    unsigned i;
+
+    for (i = chars; i-- > 0;) {
+        s[i] = geohash_char((unsigned)(code & 0x1f));
+        code >>= 5;
+    }
+}
+
+/**
+ * Parse the geohash string s of len characters (at most 12) into the integer
+ * code of 5 * len bits. Returns 1 on success, or 0 if s contains an invalid
+ * digit, in which case code is left untouched.
+ *
+ * Complexity: len times geohash_value
+ */
+static inline int geohash_parse_64(const char *s, size_t len, uint64_t *code)
+{
+    uint64_t m = 0;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        int v = geohash_value(s[i]);
+        if (v < 0) {
+            return 0;
+        }
+        m = (m << 5) | (uint64_t)v;
+    }
+    *code = m;
+    return 1;
+}
+
+/**
+ * Calculate the integer geohash of the cell adjacent to code (of bits bits) in
+ * the given direction: 0 west, 1 east, 2 south, 3 north. The neighbor is
+ * written to n and 1 is returned. Longitude wraps around the antimeridian;
+ * stepping over a pole returns 0 and leaves n untouched.
+ *
+ * Which of the interleaved axes holds the longitude depends on the parity of
+ * bits, and the step is the matching Morton neighbor step.
+ *
+ * Complexity: 8 bit ops, 2 add/subs, 2 compare, 3 branch
+ */
+static inline int geohash_neighbor_64(uint64_t code, unsigned bits, unsigned dir, uint64_t *n)
+{
+    uint64_t mask = bits == 64 ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+    int lon_odd = bits % 2 == 0;
+    uint64_t latmask = (lon_odd ? 0x5555555555555555 : 0xaaaaaaaaaaaaaaaa) & mask;
+    uint64_t m;
+
+    switch (dir) {
+    case 0:
+        m = lon_odd ? mortonym_64(code) : mortonxm_64(code);
+        break;
+    case 1:
+        m = lon_odd ? mortonyp_64(code) : mortonxp_64(code);
+        break;
+    case 2:
+        if ((code & latmask) == 0) {
+            return 0;
+        }
+        m = lon_odd ? mortonxm_64(code) : mortonym_64(code);
+        break;
+    default:
+        if ((code & latmask) == latmask) {
+            return 0;
+        }
+        m = lon_odd ? mortonxp_64(code) : mortonyp_64(code);
+        break;
+    }
+    *n = m & mask;
+    return 1;
+}
+
+/**
+ * Cover the bounding box [latmin; latmax] x [lonmin; lonmax] (degrees) with
+ * ranges of integer geohashes of bits bits (1 to 64). Every range [lo; hi] is
+ * a set of consecutive codes, i.e. of geohash prefixes that can be scanned in
+ * a sorted index. See morton_ranges_64 for gap, ranges and maxranges. The box
+ * must not cross the antimeridian (lonmin <= lonmax); split it in two if it
+ * does.
+ *
+ * Complexity: the complexity of morton_ranges_64
+ */
+static inline size_t geohash_cover_64(double latmin, double lonmin, double latmax, double lonmax,
+                                      unsigned bits, uint64_t gap, uint64_t *ranges,
+                                      size_t maxranges)
+{
+    unsigned latshift = 32 - bits / 2, lonshift = 32 - (bits - bits / 2);
+    uint64_t lat0 = geohash_quantize(latmin, -90.0, 180.0) >> latshift;
+    uint64_t lat1 = geohash_quantize(latmax, -90.0, 180.0) >> latshift;
+    uint64_t lon0 = geohash_quantize(lonmin, -180.0, 360.0) >> lonshift;
+    uint64_t lon1 = geohash_quantize(lonmax, -180.0, 360.0) >> lonshift;
+
+    /* With an even number of bits the latitude takes the lowest bit. */
+    if (bits % 2 == 0) {
+        return morton_ranges_64(lat0, lon0, lat1, lon1, gap, ranges, maxranges);
+    }
+    return morton_ranges_64(lon0, lat0, lon1, lat1, gap, ranges, maxranges);
+}
+
+#endif //BITLIB_GEOHASH_H
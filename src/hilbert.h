@@ -0,0 +1,80 @@
+/**
+ * Tools for working with 2D Hilbert curve indices. Like the Z-order curve, the
+ * Hilbert curve maps a square grid onto a line while keeping nearby points
+ * close, but consecutive indices are always edge neighbors, which gives better
+ * locality at the cost of a more expensive (per-bit) conversion.
+ *
+ * Function families in this file:
+ * hilbert: calculate the Hilbert index of a point
+ * invhilbert: invert a Hilbert index
+ */
+
+#ifndef BITLIB_HILBERT_H
+#define BITLIB_HILBERT_H
+
+#include <stdint.h>
+
+/**
+ * Calculate the index of (x; y) on the Hilbert curve that fills a square grid
+ * of 2^order x 2^order cells. order must be at most 32 and the coordinates
+ * must be less than 2^order, or the result is undefined.
+ *
+ * Complexity: 10 bit ops, 3 add/subs, 1 multiply, 2 compare, 3 branch per bit
+ */
+static inline uint64_t hilbert_64(uint64_t x, uint64_t y, unsigned order)
+{
+    uint64_t d = 0, s, rx, ry, t;
+
+    for (s = order ? (uint64_t)1 << (order - 1) : 0; s > 0; s >>= 1) {
+        rx = (x & s) != 0;
+        ry = (y & s) != 0;
+        d += s * s * ((3 * rx) ^ ry);
+        /* Rotate the quadrant into the orientation of the next level. */
+        if (ry == 0) {
+            if (rx == 1) {
+                x = (s - 1) & ~x;
+                y = (s - 1) & ~y;
+            }
+            t = x;
+            x = y;
+            y = t;
+        }
+        x &= s - 1;
+        y &= s - 1;
+    }
+    return d;
+}
+
+/**
+ * Place the coordinates of Hilbert index d on the curve that fills a square grid
+ * of 2^order x 2^order cells into x and y. order must be at most 32.
+ *
+ * Complexity: 8 bit ops, 4 add/subs, 2 compare, 3 branch per bit
+ */
+static inline void invhilbert_64(uint64_t d, unsigned order, uint64_t *x, uint64_t *y)
+{
+    uint64_t s, rx, ry, t, cx = 0, cy = 0;
+    unsigned i;
+
+    for (i = 0; i < order; ++i) {
+        s = (uint64_t)1 << i;
+        rx = 1 & (d >> 1);
+        ry = 1 & (d ^ rx);
+        if (ry == 0) {
+            if (rx == 1) {
+                cx = s - 1 - cx;
+                cy = s - 1 - cy;
+            }
+            t = cx;
+            cx = cy;
+            cy = t;
+        }
+        cx += s * rx;
+        cy += s * ry;
+        d >>= 2;
+    }
+    *x = cx;
+    *y = cy;
+}
+
+#endif //BITLIB_HILBERT_H
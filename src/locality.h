@@ -0,0 +1,324 @@
+/**
+ * Measuring the locality of a data layout on an access trace. A trace of grid
+ * cells is mapped through an ordering (row-major, Morton or Hilbert) to memory
+ * addresses, and a reuse analyzer collects the histogram of reuse distances:
+ * the number of distinct blocks (cache lines or pages) touched between two
+ * accesses to the same block. An access misses a fully associative LRU cache
+ * of C blocks exactly when its reuse distance is at least C, so one histogram
+ * gives the miss rates of caches and TLBs of every size.
+ *
+ * To handle traces of billions of accesses in bounded memory, the analyzer
+ * samples blocks by a hash of their address (spatial sampling, as in SHARDS):
+ * at a sampling rate of 1/2^k only the sampled blocks are tracked, and their
+ * distances and counts are scaled by 2^k. When the table of tracked blocks
+ * fills up, k grows by one and the blocks that are no longer sampled are
+ * dropped. All memory is provided by the caller.
+ *
+ * Analyzers are independent, so different orderings or block sizes can be
+ * analyzed on different threads (see exec.h), and reuse_merge adds up the
+ * results of analyzers that saw different parts of a trace.
+ *
+ * Function families in this file:
+ * locality_index, locality_index3: position of a grid cell in an ordering
+ * reuse_size, reuse_init: set up a reuse analyzer in caller-provided memory
+ * reuse_access: record an access
+ * reuse_miss_rate: miss rate of a fully associative LRU cache
+ * reuse_merge: add up the results of two analyzers
+ */
+
+#ifndef BITLIB_LOCALITY_H
+#define BITLIB_LOCALITY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "morton.h"
+#include "hilbert.h"
+#include "bitscan.h"
+#include "sort.h"
+
+/**
+ * Orderings of the cells of a grid
+ */
+enum locality_order {
+    LOCALITY_ROWMAJOR, LOCALITY_MORTON, LOCALITY_HILBERT, LOCALITY_NORDERS
+};
+
+/**
+ * The number of buckets of a reuse distance histogram. Bucket 0 counts
+ * distance 0, bucket b > 0 the distances in [2^(b-1); 2^b).
+ */
+#define REUSE_BUCKETS 64
+
+/**
+ * The number of hash bits that blocks are sampled by, so the sampling rate is
+ * at least 1/2^REUSE_SAMPLE_BITS.
+ */
+#define REUSE_SAMPLE_BITS 24
+
+/**
+ * Calculate the position of the cell (x; y) of a 2^bits x 2^bits grid in the
+ * given ordering. Row-major order runs along x first. bits must be at most 32.
+ *
+ * Complexity: that of morton_64 or hilbert_64, or 1 bit ops for row-major
+ */
+static inline uint64_t locality_index_64(enum locality_order o, uint64_t x, uint64_t y,
+                                         unsigned bits)
+{
+    switch (o) {
+    case LOCALITY_MORTON:
+        return morton_64(x, y);
+    case LOCALITY_HILBERT:
+        return hilbert_64(x, y, bits);
+    default:
+        return y << bits | x;
+    }
+}
+
+/**
+ * Calculate the position of the cell (x; y; z) of a 2^bits x 2^bits x 2^bits
+ * grid in the given ordering. bits must be at most 21. There is no 3D Hilbert
+ * curve in the library, so LOCALITY_HILBERT isn't supported and gives the
+ * row-major position.
+ *
+ * Complexity: that of morton3_64, or 2 bit ops for row-major
+ */
+static inline uint64_t locality_index3_64(enum locality_order o, uint64_t x, uint64_t y,
+                                          uint64_t z, unsigned bits)
+{
+    if (o == LOCALITY_MORTON) {
+        return morton3_64(x, y, z);
+    }
+    return (z << bits | y) << bits | x;
+}
+
+/**
+ * A reuse analyzer. Blocks are tracked in an open addressing table of tsize
+ * slots (blocks holds block + 1, 0 for empty slots) with the time of their
+ * last sampled access, and a Fenwick tree over times marks the last access of
+ * every tracked block, so the distance of an access is a count of marks.
+ * Times run up to 2 * tsize, after which they are renumbered.
+ */
+struct reuse {
+    unsigned shift;                 /* log2 of the block size */
+    unsigned rshift;                /* log2 of 1 / the sampling rate */
+    size_t tsize, live, now;
+    uint64_t *blocks, *last;
+    uint64_t *scratch, *skeys, *tkeys;
+    uint32_t *svals, *tvals, *tree;
+    uint64_t hist[REUSE_BUCKETS];   /* scaled counts per distance bucket */
+    uint64_t cold;                  /* scaled first accesses */
+    uint64_t weighted;              /* scaled sampled accesses */
+    uint64_t accesses;              /* all accesses */
+};
+
+/**
+ * Calculate the number of bytes of memory reuse_init needs for a table of
+ * tsize blocks.
+ *
+ * Complexity: 2 multiply, 2 add/subs
+ */
+static inline size_t reuse_size(size_t tsize)
+{
+    return 5 * sizeof(uint64_t) * tsize + 2 * sizeof(uint32_t) * tsize +
+           sizeof(uint32_t) * (2 * tsize + 1);
+}
+
+/**
+ * Set up the analyzer r for blocks of 2^shift bytes that tracks up to 3/4 of
+ * tsize blocks (a power of 2, at least 4) in the size bytes of memory at mem
+ * (see reuse_size), which must be 8 byte aligned. Sampling starts at a rate of
+ * 1/2^rshift (0 to REUSE_SAMPLE_BITS); 0 measures exactly as long as the
+ * blocks of the trace fit into the table. Returns 1 on success, or 0 if a
+ * parameter is out of range or the memory is too small.
+ *
+ * Complexity: O(tsize)
+ */
+static inline int reuse_init(struct reuse *r, unsigned shift, unsigned rshift, size_t tsize,
+                             void *mem, size_t size)
+{
+    uint64_t *p = (uint64_t *)mem;
+
+    if (shift > 63 || rshift > REUSE_SAMPLE_BITS || tsize < 4 || (tsize & (tsize - 1)) != 0 ||
+        tsize > (size_t)1 << 30 || size < reuse_size(tsize)) {
+        return 0;
+    }
+    memset(mem, 0, reuse_size(tsize));
+    memset(r, 0, sizeof(*r));
+    r->shift = shift;
+    r->rshift = rshift;
+    r->tsize = tsize;
+    r->blocks = p;
+    r->last = p + tsize;
+    r->scratch = p + 2 * tsize;
+    r->skeys = p + 3 * tsize;
+    r->tkeys = p + 4 * tsize;
+    r->svals = (uint32_t *)(p + 5 * tsize);
+    r->tvals = r->svals + tsize;
+    r->tree = r->tvals + tsize;
+    return 1;
+}
+
+/* Whether a block is sampled at the current rate */
+static inline int reuse_sampled(const struct reuse *r, uint64_t block)
+{
+    uint64_t h = (block * 0x9e3779b97f4a7c15) >> (64 - REUSE_SAMPLE_BITS);
+    return h >> (REUSE_SAMPLE_BITS - r->rshift) == 0;
+}
+
+/* The slot of key, or the empty slot where it goes */
+static inline size_t reuse_find(const struct reuse *r, uint64_t key)
+{
+    uint64_t h = key ^ (key >> 31);
+    size_t slot;
+
+    h *= 0xbf58476d1ce4e5b9;
+    slot = (size_t)(h ^ (h >> 29)) & (r->tsize - 1);
+    while (r->blocks[slot] != 0 && r->blocks[slot] != key) {
+        slot = (slot + 1) & (r->tsize - 1);
+    }
+    return slot;
+}
+
+/* Add delta (modulo 2^32) at time t of the Fenwick tree */
+static inline void reuse_add(struct reuse *r, size_t t, uint32_t delta)
+{
+    for (++t; t <= 2 * r->tsize; t += t & (~t + 1)) {
+        r->tree[t] += delta;
+    }
+}
+
+/* The number of marks at times before t */
+static inline uint64_t reuse_count(const struct reuse *r, size_t t)
+{
+    uint64_t sum = 0;
+
+    for (; t > 0; t -= t & (~t + 1)) {
+        sum += r->tree[t];
+    }
+    return sum;
+}
+
+/* Drop the blocks that aren't sampled any more and renumber the times of the
+ * others to 0, 1, ... in the order of their last accesses */
+static inline void reuse_rebuild(struct reuse *r)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < r->tsize; ++i) {
+        if (r->blocks[i] != 0 && reuse_sampled(r, r->blocks[i] - 1)) {
+            r->scratch[n] = r->blocks[i];
+            r->skeys[n] = r->last[i];
+            r->svals[n] = (uint32_t)n;
+            ++n;
+        }
+        r->blocks[i] = 0;
+    }
+    radixsort_64(r->skeys, r->svals, n, r->tkeys, r->tvals, 64);
+    memset(r->tree, 0, (2 * r->tsize + 1) * sizeof(uint32_t));
+    for (i = 0; i < n; ++i) {
+        uint64_t key = r->scratch[r->svals[i]];
+        size_t slot = reuse_find(r, key);
+        r->blocks[slot] = key;
+        r->last[slot] = i;
+        reuse_add(r, i, 1);
+    }
+    r->live = n;
+    r->now = n;
+}
+
+/**
+ * Record an access to the byte at address addr (less than 2^64 - 1).
+ *
+ * Complexity: O(log tsize) for sampled blocks, plus O(tsize) every tsize
+ *     sampled accesses and when the sampling rate drops
+ */
+static inline void reuse_access_64(struct reuse *r, uint64_t addr)
+{
+    uint64_t block = addr >> r->shift, key = block + 1, weight, d;
+    size_t slot;
+
+    ++r->accesses;
+    if (!reuse_sampled(r, block)) {
+        return;
+    }
+    slot = reuse_find(r, key);
+    if (r->blocks[slot] != key && 4 * (r->live + 1) > 3 * r->tsize) {
+        if (r->rshift < REUSE_SAMPLE_BITS) {
+            ++r->rshift;
+            reuse_rebuild(r);
+        }
+        if (!reuse_sampled(r, block) || 4 * (r->live + 1) > 3 * r->tsize) {
+            return;
+        }
+        slot = reuse_find(r, key);
+    }
+
+    weight = (uint64_t)1 << r->rshift;
+    r->weighted += weight;
+    if (r->blocks[slot] == key) {
+        size_t t = (size_t)r->last[slot];
+        unsigned b;
+        d = (reuse_count(r, r->now) - reuse_count(r, t + 1)) << r->rshift;
+        b = d == 0 ? 0 : (unsigned)bsr_64(d) + 1;
+        r->hist[b < REUSE_BUCKETS ? b : REUSE_BUCKETS - 1] += weight;
+        reuse_add(r, t, (uint32_t)-1);
+    } else {
+        r->cold += weight;
+        r->blocks[slot] = key;
+        ++r->live;
+    }
+    reuse_add(r, r->now, 1);
+    r->last[slot] = r->now;
+    if (++r->now == 2 * r->tsize) {
+        reuse_rebuild(r);
+    }
+}
+
+/**
+ * Estimate the miss rate of a fully associative LRU cache of the given number
+ * of blocks over the accesses so far, first accesses included. Distances are
+ * assumed to be spread evenly within a histogram bucket.
+ *
+ * Complexity: O(REUSE_BUCKETS)
+ */
+static inline double reuse_miss_rate(const struct reuse *r, uint64_t blocks)
+{
+    double misses = (double)r->cold, c = (double)blocks, lo, hi;
+    unsigned b;
+
+    if (r->weighted == 0) {
+        return 0;
+    }
+    for (b = 0; b < REUSE_BUCKETS; ++b) {
+        lo = b == 0 ? 0 : (double)((uint64_t)1 << (b - 1));
+        hi = b == 0 ? 1 : 2 * lo;
+        if (lo >= c) {
+            misses += (double)r->hist[b];
+        } else if (hi > c) {
+            misses += (double)r->hist[b] * (hi - c) / (hi - lo);
+        }
+    }
+    return misses / (double)r->weighted;
+}
+
+/**
+ * Add the histogram and counts of src to dst, e.g. for analyzers that saw
+ * different segments of a trace. Reuses across segments are counted as first
+ * accesses.
+ *
+ * Complexity: O(REUSE_BUCKETS)
+ */
+static inline void reuse_merge(struct reuse *dst, const struct reuse *src)
+{
+    unsigned b;
+
+    for (b = 0; b < REUSE_BUCKETS; ++b) {
+        dst->hist[b] += src->hist[b];
+    }
+    dst->cold += src->cold;
+    dst->weighted += src->weighted;
+    dst->accesses += src->accesses;
+}
+
+#endif //BITLIB_LOCALITY_H
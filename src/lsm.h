@@ -0,0 +1,714 @@
+/**
+ * A log-structured merge index of Morton codes (morton_64 or morton3_64) with
+ * 32 bit payloads, for point sets that receive a steady stream of inserts
+ * while being queried. Inserts go to an unsorted buffer, which is radix sorted
+ * into a run when it fills up. Runs are organized in tiers: level i holds up to
+ * fanout runs of at most buffer * fanout^i entries, and compacting a level
+ * merges all of its runs into a single run of the next level with a k-way
+ * merge. Every entry is thus rewritten once per level, and a query searches
+ * at most fanout runs per level. The index is append-only; there are no
+ * deletes or updates. All memory is provided by the caller.
+ *
+ * By default all work happens on the calling thread: compaction runs when a
+ * flush finds level 0 full, or ahead of time when the caller runs
+ * lsm_compact, e.g. between batches of inserts. Built with
+ * -DBITLIB_EXEC_THREADS (and -pthread), an index has a lock, and
+ * lsm_compactor_start moves flushes and compactions to a thread of their own.
+ * A full buffer is then frozen and inserts go on into a second one, while the
+ * compactor sorts the frozen buffer into a run and merges the frozen runs of
+ * full levels; merges run without the lock, and their results are swapped in
+ * under it, so queries see every entry exactly once. Inserts only wait when
+ * both buffers are full.
+ *
+ * Function families in this file:
+ * lsm_size, lsm_init, lsm_destroy: set up an index in caller-provided memory
+ * lsm_insert: add an entry
+ * lsm_flush: turn the buffer into a run
+ * lsm_merge: k-way merge of sorted runs
+ * lsm_compact: merge the runs of a level into the next one
+ * lsm_compactor_start, lsm_compactor_stop: flush and compact on a thread
+ * lsm_query, lsm_query3: find the entries inside a 2D or 3D box
+ * lsm_write_amplification, lsm_fanout: cost metrics
+ */
+
+#ifndef BITLIB_LSM_H
+#define BITLIB_LSM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton.h"
+#include "compare.h"
+#include "sort.h"
+
+#ifdef BITLIB_EXEC_THREADS
+#include <pthread.h>
+#endif
+
+/**
+ * The largest number of levels of an index.
+ */
+#define LSM_MAXLEVELS 16
+
+/**
+ * The largest fanout, i.e. number of runs per level, of an index.
+ */
+#define LSM_MAXFANOUT 16
+
+/**
+ * An LSM index. All arrays point into the memory passed to lsm_init. Run j of
+ * level i starts at keys[i] + j * runcap[i] and holds len[i][j] entries.
+ */
+struct lsm {
+    size_t buffer, fanout;
+    unsigned nlevels, bits;
+    uint64_t *bkeys;                           /* insert buffer */
+    uint32_t *bvals;
+    size_t bcount;
+    uint64_t *fkeys;                           /* frozen buffer */
+    uint32_t *fvals;
+    size_t fcount;
+    uint64_t *tkeys;                           /* sort scratch */
+    uint32_t *tvals;
+    uint64_t *keys[LSM_MAXLEVELS];             /* runs of every level */
+    uint32_t *vals[LSM_MAXLEVELS];
+    size_t runcap[LSM_MAXLEVELS];
+    size_t nruns[LSM_MAXLEVELS];
+    size_t len[LSM_MAXLEVELS][LSM_MAXFANOUT];
+    uint64_t inserted;                         /* entries inserted */
+    uint64_t written;                          /* entries written to runs */
+    uint64_t queries;                          /* queries answered */
+    uint64_t searched;                         /* runs searched by queries */
+    int background;                            /* the compactor is running */
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;                 /* to and from the compactor */
+    pthread_t thread;
+    unsigned requested;                        /* levels to compact, by bit */
+    unsigned refused;                          /* levels that couldn't be */
+    int stop, failed;
+#endif
+};
+
+/**
+ * Calculate the number of entries of all runs of an index with the given
+ * buffer size, fanout and number of levels.
+ *
+ * Complexity: O(nlevels)
+ */
+static inline size_t lsm_entries(size_t buffer, size_t fanout, unsigned nlevels)
+{
+    size_t total = 0, runcap = buffer;
+    unsigned i;
+
+    for (i = 0; i < nlevels; ++i) {
+        total += fanout * runcap;
+        runcap *= fanout;
+    }
+    return total;
+}
+
+/**
+ * Calculate the number of bytes of memory lsm_init needs for an index with the
+ * given buffer size (in entries), fanout and number of levels.
+ *
+ * Complexity: O(nlevels)
+ */
+static inline size_t lsm_size(size_t buffer, size_t fanout, unsigned nlevels)
+{
+    return 12 * (3 * buffer + lsm_entries(buffer, fanout, nlevels));
+}
+
+/**
+ * Set up the index s in the size bytes of memory at mem (see lsm_size), which
+ * must be 8 byte aligned. Inserts are buffered buffer at a time; every level
+ * holds up to fanout runs (2 to LSM_MAXFANOUT) and there are nlevels levels
+ * (1 to LSM_MAXLEVELS), so the index holds up to lsm_entries(buffer, fanout,
+ * nlevels) entries. Keys are sorted by their lowest bits bits (see
+ * radixsort_64), e.g. 42 for 3D codes of 14 bit coordinates. Returns 1 on
+ * success, or 0 if a parameter is out of range or the memory is too small.
+ * Call lsm_destroy when the index isn't needed any more.
+ *
+ * Complexity: O(nlevels)
+ */
+static inline int lsm_init(struct lsm *s, size_t buffer, size_t fanout, unsigned nlevels,
+                           unsigned bits, void *mem, size_t size)
+{
+    size_t total = lsm_entries(buffer, fanout, nlevels), runcap = buffer;
+    uint64_t *k = (uint64_t *)mem;
+    uint32_t *v;
+    unsigned i;
+
+    if (buffer == 0 || fanout < 2 || fanout > LSM_MAXFANOUT || nlevels == 0 ||
+        nlevels > LSM_MAXLEVELS || size < lsm_size(buffer, fanout, nlevels)) {
+        return 0;
+    }
+    s->buffer = buffer;
+    s->fanout = fanout;
+    s->nlevels = nlevels;
+    s->bits = bits;
+
+    /* All keys first, then all values, to keep the keys 8 byte aligned. */
+    v = (uint32_t *)(k + 3 * buffer + total);
+    s->bkeys = k;
+    s->fkeys = k + buffer;
+    s->tkeys = k + 2 * buffer;
+    s->bvals = v;
+    s->fvals = v + buffer;
+    s->tvals = v + 2 * buffer;
+    k += 3 * buffer;
+    v += 3 * buffer;
+    for (i = 0; i < nlevels; ++i) {
+        s->keys[i] = k;
+        s->vals[i] = v;
+        s->runcap[i] = runcap;
+        s->nruns[i] = 0;
+        k += fanout * runcap;
+        v += fanout * runcap;
+        runcap *= fanout;
+    }
+    s->bcount = s->fcount = 0;
+    s->inserted = s->written = s->queries = s->searched = 0;
+    s->background = 0;
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->work, NULL);
+    pthread_cond_init(&s->done, NULL);
+    s->requested = s->refused = 0;
+    s->stop = s->failed = 0;
+#endif
+    return 1;
+}
+
+/**
+ * Release the resources of an index other than its memory, i.e. its lock with
+ * BITLIB_EXEC_THREADS. The compactor must have been stopped.
+ *
+ * Complexity: O(1)
+ */
+static inline void lsm_destroy(struct lsm *s)
+{
+#ifdef BITLIB_EXEC_THREADS
+    pthread_cond_destroy(&s->done);
+    pthread_cond_destroy(&s->work);
+    pthread_mutex_destroy(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static inline void lsm_lock(struct lsm *s)
+{
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_lock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+static inline void lsm_unlock(struct lsm *s)
+{
+#ifdef BITLIB_EXEC_THREADS
+    pthread_mutex_unlock(&s->lock);
+#else
+    (void)s;
+#endif
+}
+
+/**
+ * Merge the k sorted runs keys[j], vals[j] of len[j] entries (k at most
+ * LSM_MAXFANOUT) into outk and outv. The smallest head is kept at the top of a
+ * binary heap of the runs; entries with equal keys come out in run order.
+ * Returns the number of entries written.
+ *
+ * Complexity: O(n * log k) where n is the total number of entries
+ */
+static inline size_t lsm_merge_64(const uint64_t *const *keys, const uint32_t *const *vals,
+                                  const size_t *len, size_t k, uint64_t *outk, uint32_t *outv)
+{
+    size_t heap[LSM_MAXFANOUT], pos[LSM_MAXFANOUT];
+    size_t n = 0, count = 0, i;
+
+    /* (run, position) pairs are compared by key, then by run. */
+#define LSM_LESS(a, b) (keys[a][pos[a]] < keys[b][pos[b]] || \
+                        (keys[a][pos[a]] == keys[b][pos[b]] && (a) < (b)))
+
+    for (i = 0; i < k; ++i) {
+        pos[i] = 0;
+        if (len[i] > 0) {
+            /* Sift the new run up. */
+            size_t c = n++;
+            while (c > 0 && LSM_LESS(i, heap[(c - 1) / 2])) {
+                heap[c] = heap[(c - 1) / 2];
+                c = (c - 1) / 2;
+            }
+            heap[c] = i;
+        }
+    }
+    while (n > 0) {
+        size_t r = heap[0], c = 0;
+
+        outk[count] = keys[r][pos[r]];
+        outv[count] = vals[r][pos[r]];
+        ++count;
+        if (++pos[r] == len[r]) {
+            r = heap[--n];
+        }
+        /* Sift r down from the root. */
+        while (2 * c + 1 < n) {
+            size_t child = 2 * c + 1;
+            if (child + 1 < n && LSM_LESS(heap[child + 1], heap[child])) {
+                ++child;
+            }
+            if (!LSM_LESS(heap[child], r)) {
+                break;
+            }
+            heap[c] = heap[child];
+            c = child;
+        }
+        if (n > 0) {
+            heap[c] = r;
+        }
+    }
+#undef LSM_LESS
+    return count;
+}
+
+/**
+ * Merge all runs of the given level into a new run of the next level,
+ * compacting the next level first if it is full, with the lock held. With a
+ * compactor, which is then the only thread adding runs, the runs are merged
+ * without the lock into a slot of the next level that queries don't read
+ * yet, and swapped in under it. Returns 1 on success, or 0 if the level is the
+ * last one.
+ *
+ * Complexity: O(n * log fanout) where n is the number of entries of the level,
+ *     plus the compactions of the next levels
+ */
+static inline int lsm_compact_locked(struct lsm *s, unsigned level)
+{
+    const uint64_t *keys[LSM_MAXFANOUT];
+    const uint32_t *vals[LSM_MAXFANOUT];
+    size_t j, r, n, nruns;
+
+    if (level + 1 >= s->nlevels) {
+        return 0;
+    }
+    if (s->nruns[level] == 0) {
+        return 1;
+    }
+    if (s->nruns[level + 1] == s->fanout && !lsm_compact_locked(s, level + 1)) {
+        return 0;
+    }
+    nruns = s->nruns[level];
+    for (j = 0; j < nruns; ++j) {
+        keys[j] = s->keys[level] + j * s->runcap[level];
+        vals[j] = s->vals[level] + j * s->runcap[level];
+    }
+    r = s->nruns[level + 1];
+    if (s->background) {
+        lsm_unlock(s);
+    }
+    n = lsm_merge_64(keys, vals, s->len[level], nruns,
+                     s->keys[level + 1] + r * s->runcap[level + 1],
+                     s->vals[level + 1] + r * s->runcap[level + 1]);
+    if (s->background) {
+        lsm_lock(s);
+    }
+    s->len[level + 1][r] = n;
+    ++s->nruns[level + 1];
+    s->nruns[level] = 0;
+    s->written += n;
+    return 1;
+}
+
+/**
+ * Sort the n entries keys, vals into a new run of level 0, compacting level 0
+ * first if it is full, with the lock held. The entries are copied into a slot
+ * that queries don't read yet and sorted there, without the lock if a
+ * compactor does this. Returns 1 on success, or 0 if the index is full.
+ *
+ * Complexity: O(n * bits / 8) plus the compactions
+ */
+static inline int lsm_flush_locked(struct lsm *s, const uint64_t *keys, const uint32_t *vals,
+                                   size_t n)
+{
+    size_t r, i;
+    uint64_t *rk;
+    uint32_t *rv;
+
+    if (s->nruns[0] == s->fanout && !lsm_compact_locked(s, 0)) {
+        return 0;
+    }
+    r = s->nruns[0];
+    rk = s->keys[0] + r * s->runcap[0];
+    rv = s->vals[0] + r * s->runcap[0];
+    if (s->background) {
+        lsm_unlock(s);
+    }
+    for (i = 0; i < n; ++i) {
+        rk[i] = keys[i];
+        rv[i] = vals[i];
+    }
+    radixsort_64(rk, rv, n, s->tkeys, s->tvals, s->bits);
+    if (s->background) {
+        lsm_lock(s);
+    }
+    s->len[0][r] = n;
+    ++s->nruns[0];
+    s->written += n;
+    return 1;
+}
+
+#ifdef BITLIB_EXEC_THREADS
+
+static inline void *lsm_compactor(void *arg)
+{
+    struct lsm *s = (struct lsm *)arg;
+    unsigned level;
+
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        if (s->fcount > 0 && !s->failed) {
+            if (lsm_flush_locked(s, s->fkeys, s->fvals, s->fcount)) {
+                s->fcount = 0;
+                /* Free level 0 for the next flush while the buffer fills up */
+                if (s->nruns[0] == s->fanout) {
+                    lsm_compact_locked(s, 0);
+                }
+            } else {
+                s->failed = 1;
+            }
+        } else if (s->requested != 0) {
+            for (level = 0; !(s->requested >> level & 1); ++level) {
+            }
+            if (!lsm_compact_locked(s, level)) {
+                s->refused |= 1u << level;
+            }
+            s->requested &= ~(1u << level);
+        } else if (s->stop) {
+            break;
+        } else {
+            pthread_cond_wait(&s->work, &s->lock);
+            continue;
+        }
+        pthread_cond_broadcast(&s->done);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+/**
+ * Start a thread that does the flushes and compactions of the index s from
+ * now on (see the top of this file). Returns 1 on success, or 0 if the thread
+ * couldn't be started, in which case the work stays on the calling threads.
+ *
+ * Complexity: 1 thread start
+ */
+static inline int lsm_compactor_start(struct lsm *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->stop = s->failed = 0;
+    s->requested = s->refused = 0;
+    s->background = pthread_create(&s->thread, NULL, lsm_compactor, s) == 0;
+    pthread_mutex_unlock(&s->lock);
+    return s->background;
+}
+
+/**
+ * Finish the pending flush and compactions, and stop the compactor thread.
+ * The buffer isn't flushed; see lsm_flush. If the index filled up, the
+ * entries the compactor couldn't flush stay in its buffer, where queries
+ * still find them.
+ *
+ * Complexity: the pending work, plus 1 thread join
+ */
+static inline void lsm_compactor_stop(struct lsm *s)
+{
+    if (!s->background) {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_cond_signal(&s->work);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+    s->background = 0;
+}
+
+/* Freeze the full insert buffer for the compactor, waiting until the
+ * previous one has been flushed; the lock must be held. Returns 0 if the
+ * index is full. */
+static inline int lsm_freeze(struct lsm *s)
+{
+    uint64_t *k;
+    uint32_t *v;
+
+    while (s->fcount > 0 && !s->failed) {
+        pthread_cond_wait(&s->done, &s->lock);
+    }
+    if (s->failed) {
+        return 0;
+    }
+    k = s->fkeys;
+    v = s->fvals;
+    s->fkeys = s->bkeys;
+    s->fvals = s->bvals;
+    s->fcount = s->bcount;
+    s->bkeys = k;
+    s->bvals = v;
+    s->bcount = 0;
+    pthread_cond_signal(&s->work);
+    return 1;
+}
+
+#endif
+
+/* Empty the full insert buffer with the lock held: flush it, or hand it to
+ * the compactor. Returns 0 if the index is full. */
+static inline int lsm_drain(struct lsm *s)
+{
+#ifdef BITLIB_EXEC_THREADS
+    if (s->background) {
+        return lsm_freeze(s);
+    }
+#endif
+    if (!lsm_flush_locked(s, s->bkeys, s->bvals, s->bcount)) {
+        return 0;
+    }
+    s->bcount = 0;
+    return 1;
+}
+
+/**
+ * Merge all runs of the given level into a new run of the next level,
+ * compacting the next level first if it is full. With a compactor, the work is
+ * handed to it and this waits until it is done. Returns 1 on success, or 0 if
+ * the level is the last one and thus can't be compacted.
+ *
+ * Complexity: O(n * log fanout) where n is the number of entries of the level,
+ *     plus the compactions of the next levels
+ */
+static inline int lsm_compact(struct lsm *s, unsigned level)
+{
+    int ok;
+
+    if (level + 1 >= s->nlevels) {
+        return 0;
+    }
+    lsm_lock(s);
+#ifdef BITLIB_EXEC_THREADS
+    if (s->background) {
+        s->requested |= 1u << level;
+        pthread_cond_signal(&s->work);
+        while (s->requested >> level & 1) {
+            pthread_cond_wait(&s->done, &s->lock);
+        }
+        ok = !(s->refused >> level & 1);
+        s->refused &= ~(1u << level);
+        pthread_mutex_unlock(&s->lock);
+        return ok;
+    }
+#endif
+    ok = lsm_compact_locked(s, level);
+    lsm_unlock(s);
+    return ok;
+}
+
+/**
+ * Sort the buffered entries into a new run of level 0, compacting level 0
+ * first if it is full. With a compactor, this waits until it has flushed the
+ * buffer. Returns 1 on success (also if the buffer is empty), or 0 if the
+ * index is full.
+ *
+ * Complexity: O(buffer * bits / 8) plus the compactions
+ */
+static inline int lsm_flush(struct lsm *s)
+{
+    int ok;
+
+    lsm_lock(s);
+    ok = s->bcount == 0 || lsm_drain(s);
+#ifdef BITLIB_EXEC_THREADS
+    while (ok && s->fcount > 0 && !s->failed) {
+        pthread_cond_wait(&s->done, &s->lock);
+    }
+    ok = ok && !s->failed;
+#endif
+    lsm_unlock(s);
+    return ok;
+}
+
+/**
+ * Insert the Morton code key with the payload val, flushing the buffer if it
+ * is full. With a compactor, a full buffer is handed to it instead, and the
+ * insert only waits if the previous buffer hasn't been flushed yet. Returns 1
+ * on success, or 0 if the index is full.
+ *
+ * Complexity: O(1) amortized per flush of the buffer
+ */
+static inline int lsm_insert_64(struct lsm *s, uint64_t key, uint32_t val)
+{
+    lsm_lock(s);
+    if (s->bcount == s->buffer && !lsm_drain(s)) {
+        lsm_unlock(s);
+        return 0;
+    }
+    s->bkeys[s->bcount] = key;
+    s->bvals[s->bcount] = val;
+    ++s->bcount;
+    ++s->inserted;
+    lsm_unlock(s);
+    return 1;
+}
+
+/**
+ * Find the first of the keys in [i; n) that is not less than key, or n.
+ *
+ * Complexity: O(log(n - i))
+ */
+static inline size_t lsm_lower_bound_64(const uint64_t *keys, size_t i, size_t n, uint64_t key)
+{
+    while (i < n) {
+        size_t mid = i + (n - i) / 2;
+        if (keys[mid] < key) {
+            i = mid + 1;
+        } else {
+            n = mid;
+        }
+    }
+    return i;
+}
+
+/**
+ * Append the payloads of the entries of a sorted run that lie inside the box
+ * spanned by the codes lo and hi to out, counting matches beyond cap without
+ * writing them. Every run of codes outside of the box is skipped with a BIGMIN
+ * jump and a binary search. three selects 3D instead of 2D codes. Returns the
+ * new number of matches.
+ *
+ * Complexity: O((m + j) * log n) where m is the number of matches and j the
+ *     number of jumps
+ */
+static inline size_t lsm_search_64(const uint64_t *keys, const uint32_t *vals, size_t n,
+                                   uint64_t lo, uint64_t hi, int three,
+                                   uint32_t *out, size_t cap, size_t found)
+{
+    size_t i = lsm_lower_bound_64(keys, 0, n, lo);
+
+    while (i < n && keys[i] <= hi) {
+        uint64_t z;
+        if (three ? morton3_in_box_64(keys[i], lo, hi) : morton_in_box_64(keys[i], lo, hi)) {
+            if (found < cap) {
+                out[found] = vals[i];
+            }
+            ++found;
+            ++i;
+            continue;
+        }
+        z = three ? mortonbigmin3_64(keys[i], lo, hi) : mortonbigmin_64(keys[i], lo, hi);
+        if (z == 0) {
+            break;
+        }
+        i = lsm_lower_bound_64(keys, i + 1, n, z);
+    }
+    return found;
+}
+
+/* Append the payloads of the unsorted entries inside the box to out */
+static inline size_t lsm_scan_64(const uint64_t *keys, const uint32_t *vals, size_t n,
+                                 uint64_t lo, uint64_t hi, int three,
+                                 uint32_t *out, size_t cap, size_t found)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        uint64_t k = keys[i];
+        if (three ? morton3_in_box_64(k, lo, hi) : morton_in_box_64(k, lo, hi)) {
+            if (found < cap) {
+                out[found] = vals[i];
+            }
+            ++found;
+        }
+    }
+    return found;
+}
+
+/**
+ * Search the buffers and all runs for the entries inside the box spanned by
+ * the codes lo and hi, with the lock held. See lsm_query_64.
+ *
+ * Complexity: O(buffer) plus lsm_search_64 for every run
+ */
+static inline size_t lsm_query_codes_64(struct lsm *s, uint64_t lo, uint64_t hi, int three,
+                                        uint32_t *out, size_t cap)
+{
+    size_t found, j;
+    unsigned l;
+
+    lsm_lock(s);
+    found = lsm_scan_64(s->bkeys, s->bvals, s->bcount, lo, hi, three, out, cap, 0);
+    found = lsm_scan_64(s->fkeys, s->fvals, s->fcount, lo, hi, three, out, cap, found);
+    for (l = 0; l < s->nlevels; ++l) {
+        for (j = 0; j < s->nruns[l]; ++j) {
+            found = lsm_search_64(s->keys[l] + j * s->runcap[l], s->vals[l] + j * s->runcap[l],
+                                  s->len[l][j], lo, hi, three, out, cap, found);
+        }
+        s->searched += s->nruns[l];
+    }
+    ++s->queries;
+    lsm_unlock(s);
+    return found;
+}
+
+/**
+ * Find the entries whose 2D Morton codes (morton_64) lie inside the box
+ * [xmin; xmax] x [ymin; ymax] (bounds inclusive). Their payloads are written
+ * to out, in no particular order. Returns the number of matches; if it exceeds
+ * cap, only the first cap are written.
+ *
+ * Complexity: see lsm_query_codes_64
+ */
+static inline size_t lsm_query_64(struct lsm *s, uint64_t xmin, uint64_t ymin,
+                                  uint64_t xmax, uint64_t ymax, uint32_t *out, size_t cap)
+{
+    return lsm_query_codes_64(s, morton_64(xmin, ymin), morton_64(xmax, ymax), 0, out, cap);
+}
+
+/**
+ * Find the entries whose 3D Morton codes (morton3_64) lie inside the box
+ * [xmin; xmax] x [ymin; ymax] x [zmin; zmax] (bounds inclusive). See
+ * lsm_query_64.
+ *
+ * Complexity: see lsm_query_codes_64
+ */
+static inline size_t lsm_query3_64(struct lsm *s, uint64_t xmin, uint64_t ymin, uint64_t zmin,
+                                   uint64_t xmax, uint64_t ymax, uint64_t zmax,
+                                   uint32_t *out, size_t cap)
+{
+    return lsm_query_codes_64(s, morton3_64(xmin, ymin, zmin), morton3_64(xmax, ymax, zmax), 1,
+                              out, cap);
+}
+
+/**
+ * Calculate the write amplification of the index: the number of entries
+ * written to runs (by flushes and compactions) per inserted entry.
+ *
+ * Complexity: 1 divide
+ */
+static inline double lsm_write_amplification(const struct lsm *s)
+{
+    return s->inserted == 0 ? 0.0 : (double)s->written / (double)s->inserted;
+}
+
+/**
+ * Calculate the query fan-out of the index: the average number of runs a
+ * query had to search.
+ *
+ * Complexity: 1 divide
+ */
+static inline double lsm_fanout(const struct lsm *s)
+{
+    return s->queries == 0 ? 0.0 : (double)s->searched / (double)s->queries;
+}
+
+#endif //BITLIB_LSM_H
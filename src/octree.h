@@ -0,0 +1,439 @@
+/**
+ * Tools for working with linear octrees, i.e. octrees stored as a sorted array
+ * of their leaves. Every octant is identified by a 64 bit key that holds the 3D
+ * Morton code of its anchor (the corner with the smallest coordinates) in the
+ * upper bits and its level in the lowest 5 bits. Anchor coordinates are
+ * measured in units of the finest level, OCTREE_MAXLEVEL. Sorting the keys as
+ * plain integers puts the octants in Z-order, with ancestors directly preceding
+ * their descendants.
+ *
+ * Function families in this file:
+ * octant: create an octant key from anchor coordinates and level
+ * octant_parent, octant_child: step up or down one level
+ * octant_neighbor: same-level face neighbor of an octant
+ * octree_closure: collect the octants a 2:1 balanced tree has to contain
+ * octree_merge: merge two sorted key arrays
+ * octree_refine: turn a sorted set of overlapping octants into a linear octree
+ * octree_coarsen: replace complete sibling groups with their parent
+ * octree_balance: 2:1 balance a linear octree
+ */
+
+#ifndef BITLIB_OCTREE_H
+#define BITLIB_OCTREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "morton.h"
+
+/**
+ * The finest level an octant can have. Anchor coordinates use this many bits
+ * per axis, which leaves the lowest 5 bits of a 64 bit key for the level.
+ */
+#define OCTREE_MAXLEVEL 19
+
+/**
+ * Calculate the key of the octant at the given level whose anchor is (x; y; z).
+ * The coordinates must be multiples of the octant size at that level, or the
+ * result is undefined.
+ *
+ * Complexity: 51 bit ops
+ */
+static inline uint64_t octant_64(uint64_t x, uint64_t y, uint64_t z, unsigned level)
+{
+    return (morton3_64(x, y, z) << 5) | level;
+}
+
+/**
+ * Extract the level of octant k.
+ *
+ * Complexity: 1 bit op
+ */
+static inline unsigned octant_level_64(uint64_t k)
+{
+    return k & 0x1f;
+}
+
+/**
+ * Extract the Morton code of the anchor of octant k.
+ *
+ * Complexity: 1 bit op
+ */
+static inline uint64_t octant_code_64(uint64_t k)
+{
+    return k >> 5;
+}
+
+/**
+ * Calculate the Morton code of the last finest-level cell inside octant k.
+ *
+ * Complexity: 5 bit ops, 2 add/subs, 1 multiply
+ */
+static inline uint64_t octant_last_64(uint64_t k)
+{
+    unsigned s = 3 * (OCTREE_MAXLEVEL - octant_level_64(k));
+    return octant_code_64(k) | (((uint64_t)1 << s) - 1);
+}
+
+/**
+ * Calculate the key of the parent of octant k. The level of k must be greater
+ * than 0, or the result is undefined.
+ *
+ * Complexity: 6 bit ops, 3 add/subs, 1 multiply
+ */
+static inline uint64_t octant_parent_64(uint64_t k)
+{
+    unsigned level = octant_level_64(k);
+    unsigned s = 3 * (OCTREE_MAXLEVEL - level) + 3;
+    return ((k >> 5 >> s) << s << 5) | (level - 1);
+}
+
+/**
+ * Calculate the key of child c (0 to 7, in Z-order) of octant k. The level of k
+ * must be less than OCTREE_MAXLEVEL, or the result is undefined.
+ *
+ * Complexity: 5 bit ops, 3 add/subs, 1 multiply
+ */
+static inline uint64_t octant_child_64(uint64_t k, unsigned c)
+{
+    unsigned level = octant_level_64(k);
+    unsigned s = 3 * (OCTREE_MAXLEVEL - level) - 3;
+    return ((k & ~(uint64_t)0x1f) | ((uint64_t)c << s << 5)) | (level + 1);
+}
+
+/**
+ * Decide whether octant a is a proper ancestor of octant b.
+ *
+ * Complexity: 6 bit ops, 1 add/subs, 1 multiply, 2 compare
+ */
+static inline int octant_is_ancestor_64(uint64_t a, uint64_t b)
+{
+    unsigned s = 3 * (OCTREE_MAXLEVEL - octant_level_64(a));
+    return octant_level_64(a) < octant_level_64(b) &&
+           (a >> 5 >> s) == (b >> 5 >> s);
+}
+
+/**
+ * Calculate the key of the same-level neighbor of octant k across the given
+ * face. Faces are numbered -x, +x, -y, +y, -z, +z from 0 to 5. The neighbor is
+ * written to n and 1 is returned, unless it lies outside of the root octant,
+ * in which case n is left untouched and 0 is returned.
+ *
+ * The neighbor is found by applying the matching Morton neighbor step to the
+ * anchor code shifted down to the level of k, so octants of any size take the
+ * same number of operations.
+ *
+ * Complexity: 12 bit ops, 2 add/subs, 2 multiply, 2 compare, 2 branch
+ */
+static inline int octant_neighbor_64(uint64_t k, unsigned face, uint64_t *n)
+{
+    unsigned level = octant_level_64(k);
+    unsigned s = 3 * (OCTREE_MAXLEVEL - level);
+    uint64_t m = octant_code_64(k) >> s;
+
+    switch (face) {
+    case 0: m = mortonxm3_64(m); break;
+    case 1: m = mortonxp3_64(m); break;
+    case 2: m = mortonym3_64(m); break;
+    case 3: m = mortonyp3_64(m); break;
+    case 4: m = mortonzm3_64(m); break;
+    default: m = mortonzp3_64(m); break;
+    }
+
+    /* Stepping out of the root carries or borrows into the unused bits. */
+    if (m >> (3 * level) != 0) {
+        return 0;
+    }
+    *n = (m << s << 5) | level;
+    return 1;
+}
+
+/**
+ * qsort comparator for octant keys.
+ */
+static inline int octant_cmp_64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sort the n keys in place and remove duplicates. Returns the number of
+ * remaining keys.
+ *
+ * Complexity: O(n log n)
+ */
+static inline size_t octree_sort_64(uint64_t *keys, size_t n)
+{
+    size_t i, w;
+
+    if (n == 0) {
+        return 0;
+    }
+    qsort(keys, n, sizeof(uint64_t), octant_cmp_64);
+    for (i = 1, w = 1; i < n; ++i) {
+        if (keys[i] != keys[w - 1]) {
+            keys[w++] = keys[i];
+        }
+    }
+    return w;
+}
+
+/**
+ * Merge the sorted key arrays a and b into out, dropping duplicates. out must
+ * have room for na + nb keys and must not overlap the inputs. Returns the
+ * number of keys written.
+ *
+ * This is the merge step of a partitioned balance: every partition computes
+ * the closure of its own range, then the closures are merged pairwise and
+ * refined once.
+ *
+ * Complexity: O(na + nb)
+ */
+static inline size_t octree_merge_64(const uint64_t *a, size_t na,
+                                     const uint64_t *b, size_t nb, uint64_t *out)
+{
+    size_t i = 0, j = 0, w = 0;
+
+    while (i < na || j < nb) {
+        uint64_t k;
+        if (j == nb || (i < na && a[i] <= b[j])) {
+            k = a[i++];
+        } else {
+            k = b[j++];
+        }
+        if (w == 0 || out[w - 1] != k) {
+            out[w++] = k;
+        }
+    }
+    return w;
+}
+
+/**
+ * Collect every octant that has to exist (or be subdivided) in the 2:1 balanced
+ * version of a tree containing the n given octants. The keys don't need to be
+ * sorted. The result is written to out sorted and without duplicates, and its
+ * length is returned. out also serves as scratch space; if cap is too small, 0
+ * is returned.
+ *
+ * Levels are processed from finest to coarsest. Every octant at the current
+ * level adds its parent and the face neighbors of its parent one level up, so
+ * the ripple effect of refinement propagates towards the root in a single
+ * sweep. Since every octant contributes independently, the closure of a union
+ * is the union of the closures: the input can be split into contiguous code
+ * ranges that are processed by separate threads without any communication, and
+ * the partial results combined with octree_merge_64 (see octree_balance_ex_64
+ * in bulk.h).
+ *
+ * Complexity: O(OCTREE_MAXLEVEL * m + m log m) where m is the output size
+ */
+static inline size_t octree_closure_64(const uint64_t *keys, size_t n,
+                                       uint64_t *out, size_t cap)
+{
+    size_t i, count, start;
+    unsigned level, face;
+
+    if (n > cap) {
+        return 0;
+    }
+    for (i = 0; i < n; ++i) {
+        out[i] = keys[i];
+    }
+    count = octree_sort_64(out, n);
+
+    for (level = OCTREE_MAXLEVEL; level > 0; --level) {
+        start = count;
+        for (i = 0; i < start; ++i) {
+            uint64_t p;
+            if (octant_level_64(out[i]) != level) {
+                continue;
+            }
+            if (cap - count < 7) {
+                return 0;
+            }
+            p = octant_parent_64(out[i]);
+            out[count++] = p;
+            for (face = 0; face < 6; ++face) {
+                count += octant_neighbor_64(p, face, out + count);
+            }
+        }
+        count = start + octree_sort_64(out + start, count - start);
+    }
+
+    return octree_sort_64(out, count);
+}
+
+/**
+ * Helper of octree_refine_64: emit octant k, subdividing it as long as the
+ * following keys lie inside of it.
+ */
+static inline int octree_emit_64(uint64_t k, const uint64_t *keys, size_t n, size_t *i,
+                                 uint64_t *out, size_t cap, size_t *w)
+{
+    unsigned c;
+
+    while (*i < n && keys[*i] == k) {
+        ++*i;
+    }
+    if (*i < n && octant_is_ancestor_64(k, keys[*i])) {
+        for (c = 0; c < 8; ++c) {
+            uint64_t child = octant_child_64(k, c);
+            if (*i < n && (keys[*i] == child || octant_is_ancestor_64(child, keys[*i]))) {
+                if (!octree_emit_64(child, keys, n, i, out, cap, w)) {
+                    return 0;
+                }
+            } else {
+                if (*w == cap) {
+                    return 0;
+                }
+                out[(*w)++] = child;
+            }
+        }
+        return 1;
+    }
+    if (*w == cap) {
+        return 0;
+    }
+    out[(*w)++] = k;
+    return 1;
+}
+
+/**
+ * Turn a sorted set of possibly overlapping octants into a linear octree:
+ * every octant that contains others is replaced by its children, recursively,
+ * until no two octants overlap. The result covers the same region as the input
+ * and is written to out in sorted order. Returns the number of octants written,
+ * or 0 if cap is too small. out must not overlap keys.
+ *
+ * Complexity: O(n + m) where m is the output size
+ */
+static inline size_t octree_refine_64(const uint64_t *keys, size_t n,
+                                      uint64_t *out, size_t cap)
+{
+    size_t i = 0, w = 0;
+
+    while (i < n) {
+        if (!octree_emit_64(keys[i], keys, n, &i, out, cap, &w)) {
+            return 0;
+        }
+    }
+    return w;
+}
+
+/**
+ * Replace every group of 8 sibling leaves in the sorted linear octree with their
+ * parent, in place. Only one level is coarsened per call and the result stays
+ * sorted. Returns the new number of octants.
+ *
+ * Coarsening may break the 2:1 balance; run octree_balance_64 afterwards if it
+ * has to be maintained.
+ *
+ * Complexity: O(n)
+ */
+static inline size_t octree_coarsen_64(uint64_t *keys, size_t n)
+{
+    size_t i = 0, w = 0;
+
+    while (i < n) {
+        uint64_t k = keys[i];
+        unsigned level = octant_level_64(k);
+        size_t c = 0;
+
+        if (level > 0 && i + 8 <= n) {
+            uint64_t p = octant_parent_64(k);
+            while (c < 8 && keys[i + c] == octant_child_64(p, c)) {
+                ++c;
+            }
+            if (c == 8) {
+                keys[w++] = p;
+                i += 8;
+                continue;
+            }
+        }
+        keys[w++] = k;
+        ++i;
+    }
+    return w;
+}
+
+/**
+ * Find the octant of the sorted linear octree that contains or equals k.
+ * Returns its index, or n if k isn't covered by a single leaf.
+ *
+ * Complexity: O(log n)
+ */
+static inline size_t octree_find_64(const uint64_t *keys, size_t n, uint64_t k)
+{
+    size_t lo = 0, hi = n;
+
+    /* Find the last key that is not greater than k. */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid] <= k) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo > 0 && (keys[lo - 1] == k || octant_is_ancestor_64(keys[lo - 1], k))) {
+        return lo - 1;
+    }
+    return n;
+}
+
+/**
+ * Decide whether the sorted linear octree is 2:1 balanced, i.e. the levels of
+ * face-adjacent leaves differ by at most one.
+ *
+ * It's enough to look at the same-level neighbors of every leaf: if one of them
+ * lies inside a leaf that is more than one level coarser, the tree is
+ * unbalanced. Finer leaves on the other side are checked from their own
+ * perspective.
+ *
+ * Complexity: O(n log n)
+ */
+static inline int octree_is_balanced_64(const uint64_t *keys, size_t n)
+{
+    size_t i, j;
+    unsigned face;
+
+    for (i = 0; i < n; ++i) {
+        for (face = 0; face < 6; ++face) {
+            uint64_t q;
+            if (!octant_neighbor_64(keys[i], face, &q)) {
+                continue;
+            }
+            j = octree_find_64(keys, n, q);
+            if (j < n && octant_level_64(keys[j]) + 1 < octant_level_64(keys[i])) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * 2:1 balance the sorted linear octree of n leaves, writing the result to out.
+ * Returns the number of leaves written, or 0 if cap is too small. scratch must
+ * be able to hold the closure of the tree (see octree_closure_64); scratch_cap
+ * is its capacity. None of the buffers may overlap.
+ *
+ * octree_balance_ex_64 in bulk.h computes the closure of contiguous ranges of
+ * keys in parallel and merges them with octree_merge_64.
+ *
+ * Complexity: O(OCTREE_MAXLEVEL * m + m log m) where m is the closure size
+ */
+static inline size_t octree_balance_64(const uint64_t *keys, size_t n,
+                                       uint64_t *scratch, size_t scratch_cap,
+                                       uint64_t *out, size_t cap)
+{
+    size_t m = octree_closure_64(keys, n, scratch, scratch_cap);
+
+    if (m == 0) {
+        return 0;
+    }
+    return octree_refine_64(scratch, m, out, cap);
+}
+
+#endif //BITLIB_OCTREE_H
@@ -0,0 +1,347 @@
+/**
+ * Particle-to-grid deposition and grid-to-particle interpolation (gather) for
+ * particle-in-cell codes, with the grid stored in Z-order. The periodic grid
+ * has 2^level nodes per axis (level at most 10), and node (i; j; k) is stored
+ * at index morton3_32(i, j, k). Positions are given in grid units, in
+ * [0; 2^level) on every axis.
+ *
+ * Cloud-in-cell (CIC) spreads a particle over the 8 nodes of its cell,
+ * triangular-shaped cloud (TSC) over the 27 nodes around its nearest node. The
+ * nodes are addressed with Morton neighbor steps from the cell's code, which
+ * wrap around the periodic boundaries when the code is masked to the grid.
+ * With the particles sorted by cell code (see pic_keys_32) consecutive
+ * particles update nearby nodes, so the grid is accessed almost sequentially.
+ *
+ * Threads can deposit without atomics by owning ranges of node codes: with
+ * particles sorted, each thread takes the particles of one code range, updates
+ * the nodes inside its range directly and collects the updates of nodes outside
+ * of it (at the seams of the range) in a seam buffer, which is added to the
+ * grid afterwards with pic_seam_apply. pic_deposit_cic_ex_32 and
+ * pic_deposit_tsc_ex_32 in bulk.h deposit this way on an executor.
+ *
+ * Weights are computed for chunks of PIC_CHUNK particles at a time by
+ * branch-free loops, which compilers vectorize.
+ *
+ * Function families in this file:
+ * pic_keys: cell codes of particles, to sort them by
+ * pic_cic_weights, pic_tsc_weights: per-axis interpolation weights
+ * pic_deposit_cic, pic_deposit_tsc: scatter particle charges to the grid
+ * pic_seam_apply: add collected seam updates to the grid
+ * pic_gather_cic, pic_gather_tsc: interpolate the grid at particle positions
+ */
+
+#ifndef BITLIB_PIC_H
+#define BITLIB_PIC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton.h"
+
+/**
+ * The number of particles whose weights are computed at once.
+ */
+#define PIC_CHUNK 64
+
+/**
+ * A buffer of grid updates outside of a thread's code range. code and value
+ * have room for cap updates, count of which are in use.
+ */
+struct pic_seam {
+    uint32_t *code;
+    float *value;
+    size_t count;
+    size_t cap;
+};
+
+/**
+ * Calculate the keys of n particles for sorting: the 3D Morton codes of their
+ * cells. idx receives the particle indices, ready to be sorted along with the
+ * keys by radixsort_64(keys, idx, n, tk, tv, 30).
+ *
+ * Complexity: n times morton3_32
+ */
+static inline void pic_keys_32(const float *x, const float *y, const float *z, size_t n,
+                               uint64_t *keys, uint32_t *idx)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        keys[i] = morton3_32((uint32_t)x[i], (uint32_t)y[i], (uint32_t)z[i]);
+        idx[i] = (uint32_t)i;
+    }
+}
+
+/**
+ * Calculate the CIC weights of n positions along one axis: cell[i] receives the
+ * lower node and w[i] the weight of the upper node; the lower node has weight
+ * 1 - w[i].
+ *
+ * Complexity: n times 1 add/subs, 1 convert
+ */
+static inline void pic_cic_weights(const float *x, size_t n, uint32_t *cell, float *w)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        uint32_t c = (uint32_t)x[i];
+        cell[i] = c;
+        w[i] = x[i] - (float)c;
+    }
+}
+
+/**
+ * Calculate the TSC weights of n positions along one axis: cell[i] receives the
+ * nearest node, and wm[i], w0[i] and wp[i] the weights of the node before it,
+ * itself and the node after it.
+ *
+ * Complexity: n times 5 add/subs, 5 multiply, 1 convert
+ */
+static inline void pic_tsc_weights(const float *x, size_t n, uint32_t *cell,
+                                   float *wm, float *w0, float *wp)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        uint32_t c = (uint32_t)(x[i] + 0.5f);
+        float d = x[i] - (float)c;
+        cell[i] = c;
+        wm[i] = 0.5f * (0.5f - d) * (0.5f - d);
+        w0[i] = 0.75f - d * d;
+        wp[i] = 0.5f * (0.5f + d) * (0.5f + d);
+    }
+}
+
+/**
+ * Add v to node m of the grid, or to the seam if m is outside of [lo; hi) and
+ * seam isn't NULL.
+ *
+ * Complexity: 2 compare, 1 add/subs, 1 branch
+ */
+static inline void pic_add(float *grid, uint32_t m, float v, uint32_t lo, uint32_t hi,
+                           struct pic_seam *seam)
+{
+    if (seam == NULL || (m >= lo && m < hi)) {
+        grid[m] += v;
+    } else {
+        seam->code[seam->count] = m;
+        seam->value[seam->count] = v;
+        ++seam->count;
+    }
+}
+
+/**
+ * Deposit the charges q of n particles on the grid with CIC weights. With seam
+ * NULL, all nodes are updated directly. Otherwise only the nodes with codes in
+ * [lo; hi) are, and the other updates are appended to seam. Returns the number
+ * of particles deposited, which is less than n if the seam buffer fills up;
+ * apply the seam and continue with the remaining particles then.
+ *
+ * Complexity: n times 3 * 10 bit ops, 8 multiply and 8 pic_add
+ */
+static inline size_t pic_deposit_cic_32(const float *x, const float *y, const float *z,
+                                        const float *q, size_t n, unsigned level,
+                                        uint32_t lo, uint32_t hi, float *grid,
+                                        struct pic_seam *seam)
+{
+    uint32_t mask = ((uint32_t)1 << (3 * level)) - 1;
+    uint32_t cx[PIC_CHUNK], cy[PIC_CHUNK], cz[PIC_CHUNK];
+    float fx[PIC_CHUNK], fy[PIC_CHUNK], fz[PIC_CHUNK];
+    size_t b, i, c;
+    unsigned j;
+
+    for (b = 0; b < n; b += PIC_CHUNK) {
+        c = n - b < PIC_CHUNK ? n - b : PIC_CHUNK;
+        pic_cic_weights(x + b, c, cx, fx);
+        pic_cic_weights(y + b, c, cy, fy);
+        pic_cic_weights(z + b, c, cz, fz);
+        for (i = 0; i < c; ++i) {
+            uint32_t m = morton3_32(cx[i], cy[i], cz[i]) & mask;
+            /* The x, y and z bits of the lower and upper nodes */
+            uint32_t mx[2], my[2], mz[2];
+            float wx[2], wy[2], wz[2];
+
+            if (seam != NULL && seam->cap - seam->count < 8) {
+                return b + i;
+            }
+            mx[0] = m & 0x49249249;
+            mx[1] = mortonxp3_32(m) & 0x49249249 & mask;
+            my[0] = m & 0x92492492;
+            my[1] = mortonyp3_32(m) & 0x92492492 & mask;
+            mz[0] = m & 0x24924924;
+            mz[1] = mortonzp3_32(m) & 0x24924924 & mask;
+            wx[0] = 1.0f - fx[i];
+            wx[1] = fx[i];
+            wy[0] = 1.0f - fy[i];
+            wy[1] = fy[i];
+            wz[0] = (1.0f - fz[i]) * q[b + i];
+            wz[1] = fz[i] * q[b + i];
+            for (j = 0; j < 8; ++j) {
+                pic_add(grid, mx[j & 1] | my[(j >> 1) & 1] | mz[j >> 2],
+                        wx[j & 1] * wy[(j >> 1) & 1] * wz[j >> 2], lo, hi, seam);
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * Deposit the charges q of n particles on the grid with TSC weights. See
+ * pic_deposit_cic_32 for lo, hi, seam and the result.
+ *
+ * Complexity: n times 6 * 10 bit ops, 27 multiply and 27 pic_add
+ */
+static inline size_t pic_deposit_tsc_32(const float *x, const float *y, const float *z,
+                                        const float *q, size_t n, unsigned level,
+                                        uint32_t lo, uint32_t hi, float *grid,
+                                        struct pic_seam *seam)
+{
+    uint32_t mask = ((uint32_t)1 << (3 * level)) - 1;
+    uint32_t cx[PIC_CHUNK], cy[PIC_CHUNK], cz[PIC_CHUNK];
+    float wx[3][PIC_CHUNK], wy[3][PIC_CHUNK], wz[3][PIC_CHUNK];
+    size_t b, i, c;
+    unsigned a, d, e;
+
+    for (b = 0; b < n; b += PIC_CHUNK) {
+        c = n - b < PIC_CHUNK ? n - b : PIC_CHUNK;
+        pic_tsc_weights(x + b, c, cx, wx[0], wx[1], wx[2]);
+        pic_tsc_weights(y + b, c, cy, wy[0], wy[1], wy[2]);
+        pic_tsc_weights(z + b, c, cz, wz[0], wz[1], wz[2]);
+        for (i = 0; i < c; ++i) {
+            uint32_t m = morton3_32(cx[i], cy[i], cz[i]) & mask;
+            uint32_t mx[3], my[3], mz[3];
+
+            if (seam != NULL && seam->cap - seam->count < 27) {
+                return b + i;
+            }
+            mx[0] = mortonxm3_32(m) & 0x49249249 & mask;
+            mx[1] = m & 0x49249249;
+            mx[2] = mortonxp3_32(m) & 0x49249249 & mask;
+            my[0] = mortonym3_32(m) & 0x92492492 & mask;
+            my[1] = m & 0x92492492;
+            my[2] = mortonyp3_32(m) & 0x92492492 & mask;
+            mz[0] = mortonzm3_32(m) & 0x24924924 & mask;
+            mz[1] = m & 0x24924924;
+            mz[2] = mortonzp3_32(m) & 0x24924924 & mask;
+            for (e = 0; e < 3; ++e) {
+                for (d = 0; d < 3; ++d) {
+                    float wyz = wy[d][i] * wz[e][i] * q[b + i];
+                    for (a = 0; a < 3; ++a) {
+                        pic_add(grid, mx[a] | my[d] | mz[e], wx[a][i] * wyz, lo, hi, seam);
+                    }
+                }
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * Add the updates collected in seam to the grid and empty it. Seams of
+ * different threads are applied one after another.
+ *
+ * Complexity: O(seam->count)
+ */
+static inline void pic_seam_apply(struct pic_seam *seam, float *grid)
+{
+    size_t i;
+
+    for (i = 0; i < seam->count; ++i) {
+        grid[seam->code[i]] += seam->value[i];
+    }
+    seam->count = 0;
+}
+
+/**
+ * Interpolate the grid at the positions of n particles with CIC weights,
+ * writing the values to out.
+ *
+ * Complexity: n times 3 * 10 bit ops, 8 multiply, 8 add/subs
+ */
+static inline void pic_gather_cic_32(const float *x, const float *y, const float *z, size_t n,
+                                     unsigned level, const float *grid, float *out)
+{
+    uint32_t mask = ((uint32_t)1 << (3 * level)) - 1;
+    uint32_t cx[PIC_CHUNK], cy[PIC_CHUNK], cz[PIC_CHUNK];
+    float fx[PIC_CHUNK], fy[PIC_CHUNK], fz[PIC_CHUNK];
+    size_t b, i, c;
+    unsigned j;
+
+    for (b = 0; b < n; b += PIC_CHUNK) {
+        c = n - b < PIC_CHUNK ? n - b : PIC_CHUNK;
+        pic_cic_weights(x + b, c, cx, fx);
+        pic_cic_weights(y + b, c, cy, fy);
+        pic_cic_weights(z + b, c, cz, fz);
+        for (i = 0; i < c; ++i) {
+            uint32_t m = morton3_32(cx[i], cy[i], cz[i]) & mask;
+            uint32_t mx[2], my[2], mz[2];
+            float wx[2], wy[2], wz[2], sum = 0.0f;
+
+            mx[0] = m & 0x49249249;
+            mx[1] = mortonxp3_32(m) & 0x49249249 & mask;
+            my[0] = m & 0x92492492;
+            my[1] = mortonyp3_32(m) & 0x92492492 & mask;
+            mz[0] = m & 0x24924924;
+            mz[1] = mortonzp3_32(m) & 0x24924924 & mask;
+            wx[0] = 1.0f - fx[i];
+            wx[1] = fx[i];
+            wy[0] = 1.0f - fy[i];
+            wy[1] = fy[i];
+            wz[0] = 1.0f - fz[i];
+            wz[1] = fz[i];
+            for (j = 0; j < 8; ++j) {
+                sum += grid[mx[j & 1] | my[(j >> 1) & 1] | mz[j >> 2]] *
+                       wx[j & 1] * wy[(j >> 1) & 1] * wz[j >> 2];
+            }
+            out[b + i] = sum;
+        }
+    }
+}
+
+/**
+ * Interpolate the grid at the positions of n particles with TSC weights,
+ * writing the values to out.
+ *
+ * Complexity: n times 6 * 10 bit ops, 36 multiply, 27 add/subs
+ */
+static inline void pic_gather_tsc_32(const float *x, const float *y, const float *z, size_t n,
+                                     unsigned level, const float *grid, float *out)
+{
+    uint32_t mask = ((uint32_t)1 << (3 * level)) - 1;
+    uint32_t cx[PIC_CHUNK], cy[PIC_CHUNK], cz[PIC_CHUNK];
+    float wx[3][PIC_CHUNK], wy[3][PIC_CHUNK], wz[3][PIC_CHUNK];
+    size_t b, i, c;
+    unsigned a, d, e;
+
+    for (b = 0; b < n; b += PIC_CHUNK) {
+        c = n - b < PIC_CHUNK ? n - b : PIC_CHUNK;
+        pic_tsc_weights(x + b, c, cx, wx[0], wx[1], wx[2]);
+        pic_tsc_weights(y + b, c, cy, wy[0], wy[1], wy[2]);
+        pic_tsc_weights(z + b, c, cz, wz[0], wz[1], wz[2]);
+        for (i = 0; i < c; ++i) {
+            uint32_t m = morton3_32(cx[i], cy[i], cz[i]) & mask;
+            uint32_t mx[3], my[3], mz[3];
+            float sum = 0.0f;
+
+            mx[0] = mortonxm3_32(m) & 0x49249249 & mask;
+            mx[1] = m & 0x49249249;
+            mx[2] = mortonxp3_32(m) & 0x49249249 & mask;
+            my[0] = mortonym3_32(m) & 0x92492492 & mask;
+            my[1] = m & 0x92492492;
+            my[2] = mortonyp3_32(m) & 0x92492492 & mask;
+            mz[0] = mortonzm3_32(m) & 0x24924924 & mask;
+            mz[1] = m & 0x24924924;
+            mz[2] = mortonzp3_32(m) & 0x24924924 & mask;
+            for (e = 0; e < 3; ++e) {
+                for (d = 0; d < 3; ++d) {
+                    float wyz = wy[d][i] * wz[e][i];
+                    for (a = 0; a < 3; ++a) {
+                        sum += grid[mx[a] | my[d] | mz[e]] * wx[a][i] * wyz;
+                    }
+                }
+            }
+            out[b + i] = sum;
+        }
+    }
+}
+
+#endif //BITLIB_PIC_H
@@ -11,6 +11,7 @@
 #define BITLIB_POPCOUNT_H
 
 #include <stdint.h>
+#include "profile.h"
 
 /**
  * Calculates the Hamming weight of x.
@@ -19,6 +20,7 @@
  */
 static inline uint8_t popcount_8(uint8_t x)
 {
+    PROFILE_CALL(popcount_8, x, 0);
     x -= (x >> 1) & 0x55;
     x = (x & 0x33) + ((x >> 2) & 0x33);
     x = (x + (x >> 4)) & 0x0f;
@@ -32,6 +34,7 @@ static inline uint8_t popcount_8(uint8_t x)
  */
 static inline uint16_t popcount_16(uint16_t x)
 {
+    PROFILE_CALL(popcount_16, x, 0);
     x -= (x >> 1) & 0x5555;
     x = (x & 0x3333) + ((x >> 2) & 0x3333);
     x = (x + (x >> 4)) & 0x0f0f;
@@ -46,6 +49,7 @@ static inline uint16_t popcount_16(uint16_t x)
  */
 static inline uint32_t popcount_32(uint32_t x)
 {
+    PROFILE_CALL(popcount_32, x, 0);
     x -= (x >> 1) & 0x55555555;
     x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
     x = (x + (x >> 4)) & 0x0f0f0f0f;
@@ -61,6 +65,7 @@ static inline uint32_t popcount_32(uint32_t x)
  */
 static inline uint64_t popcount_64(uint64_t x)
 {
+    PROFILE_CALL(popcount_64, x, 0);
     x -= (x >> 1) & 0x5555555555555555;
     x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
     x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
@@ -78,6 +83,7 @@ static inline uint64_t popcount_64(uint64_t x)
  */
 static inline uint32_t popcount_mul_32(uint32_t x)
 {
+    PROFILE_CALL(popcount_mul_32, x, 0);
     x -= (x >> 1) & 0x55555555;
     x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
     x = (x + (x >> 4)) & 0x0f0f0f0f;
@@ -92,6 +98,7 @@ static inline uint32_t popcount_mul_32(uint32_t x)
  */
 static inline uint64_t popcount_mul_64(uint64_t x)
 {
+    PROFILE_CALL(popcount_mul_64, x, 0);
     x -= (x >> 1) & 0x5555555555555555;
     x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
     x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
@@ -107,6 +114,8 @@ static inline uint64_t popcount_mul_64(uint64_t x)
 static inline uint32_t popcount_iter_32(uint32_t x)
 {
     uint32_t c;
+
+    PROFILE_CALL(popcount_iter_32, x, 0);
     for (c=0; x > 0; ++c) {
         x &= x - 1;
     }
@@ -122,10 +131,19 @@ static inline uint32_t popcount_iter_32(uint32_t x)
 static inline uint64_t popcount_iter_64(uint64_t x)
 {
     uint64_t c;
+
+    PROFILE_CALL(popcount_iter_64, x, 0);
     for (c=0; x > 0; ++c) {
         x &= x - 1;
     }
     return c;
 }
 
+/* Let a header written by bitlib_tune remap the unflavored names above to the
+ * fastest flavors on the build machine */
+#define BITLIB_POPCOUNT_DONE
+#ifdef BITLIB_TUNED
+#include BITLIB_TUNED
+#endif
+
 #endif //BITLIB_POPCOUNT_H
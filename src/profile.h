@@ -0,0 +1,229 @@
+/**
+ * Opt-in call profiling of the functions that applications tend to call in
+ * their inner loops, to find out which of them are worth faster backends and
+ * what their inputs look like.
+ *
+ * Building with -DBITLIB_PROFILE makes every popcount, ctz, bsr, merge, merge3,
+ * separate and separate3 function count its calls in counters of the calling
+ * thread. Every BITLIB_PROFILE_SAMPLE-th call (64 unless defined otherwise, a
+ * power of 2) also records the bit density of the input: x for popcount, ctz
+ * and bsr, n for separate and the OR of the operands for merge. Calls that
+ * break the function's input contract (ctz and bsr of 0, merge operands with
+ * bits set above the used ones) are counted on every call as flagged. scatter
+ * and gather aren't profiled since bitlib calls them internally.
+ *
+ * A report is written at exit to stderr, or appended to the file named by
+ * BITLIB_PROFILE_FILE if that is defined. The counters are static, so every
+ * translation unit that includes a profiled header keeps its own and writes its
+ * own report. The profiling mode needs thread local storage and the __atomic
+ * builtins of GCC and Clang. Without BITLIB_PROFILE, PROFILE_CALL expands to
+ * nothing and this header defines nothing else.
+ *
+ * Function families in this file:
+ * profile_sum: sum up the counters of all threads
+ * profile_write: write a report of the counters
+ */
+
+#ifndef BITLIB_PROFILE_H
+#define BITLIB_PROFILE_H
+
+#ifdef BITLIB_PROFILE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef BITLIB_PROFILE_SAMPLE
+#define BITLIB_PROFILE_SAMPLE 64
+#endif
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define PROFILE_TLS _Thread_local
+#else
+#define PROFILE_TLS __thread
+#endif
+
+#ifdef __BASE_FILE__
+#define PROFILE_UNIT __BASE_FILE__
+#else
+#define PROFILE_UNIT __FILE__
+#endif
+
+/**
+ * The profiled functions and the widths of their inputs.
+ */
+#define PROFILE_FUNCTIONS(X) \
+    X(popcount_8, 8) X(popcount_16, 16) X(popcount_32, 32) X(popcount_64, 64) \
+    X(popcount_mul_32, 32) X(popcount_mul_64, 64) \
+    X(popcount_iter_32, 32) X(popcount_iter_64, 64) \
+    X(ctz_32, 32) X(ctz_64, 64) X(ctz_mul_32, 32) X(ctz_mul_64, 64) \
+    X(bsr_32, 32) X(bsr_64, 64) \
+    X(merge_8, 8) X(merge_nwe_8, 8) X(merge_16, 16) X(merge_nwe_16, 16) \
+    X(merge_32, 32) X(merge_nwe_32, 32) X(merge_64, 64) \
+    X(merge3_8, 8) X(merge3_16, 16) X(merge3_32, 32) X(merge3_64, 64) \
+    X(separate_8, 8) X(separate_nwe_8, 8) X(separate_16, 16) X(separate_nwe_16, 16) \
+    X(separate_32, 32) X(separate_nwe_32, 32) X(separate_64, 64) \
+    X(separate3_8, 8) X(separate3_16, 16) X(separate3_32, 32) X(separate3_64, 64)
+
+#define PROFILE_ID(f, w) PROFILE_##f,
+#define PROFILE_NAME(f, w) #f,
+#define PROFILE_WIDTH(f, w) w,
+
+enum profile_id { PROFILE_FUNCTIONS(PROFILE_ID) PROFILE_NFUNCTIONS };
+
+static const char *const profile_names[] = {PROFILE_FUNCTIONS(PROFILE_NAME)};
+static const unsigned profile_widths[] = {PROFILE_FUNCTIONS(PROFILE_WIDTH)};
+
+/**
+ * Sampled densities fall into 5 buckets: no bit set, at most a quarter, at
+ * most half, at most three quarters and more than three quarters of the bits.
+ */
+#define PROFILE_BUCKETS 5
+
+struct profile_counts {
+    uint64_t calls, flagged, samples, ones;
+    uint64_t density[PROFILE_BUCKETS];
+};
+
+struct profile_thread {
+    struct profile_thread *next;
+    struct profile_counts counts[PROFILE_NFUNCTIONS];
+};
+
+static PROFILE_TLS struct profile_thread *profile_self;
+static struct profile_thread *profile_threads;
+/* Shared by the threads whose counters couldn't be allocated */
+static struct profile_thread profile_spare;
+static int profile_spare_used, profile_registered;
+
+/* popcount.h includes this header, so it has a popcount of its own */
+static inline unsigned profile_ones(uint64_t x)
+{
+    x -= (x >> 1) & 0x5555555555555555;
+    x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+    return (unsigned)((x * 0x0101010101010101) >> 56);
+}
+
+/**
+ * Sum up the counters of all threads into total, which must have room for
+ * PROFILE_NFUNCTIONS entries. Counters of threads that are still running may
+ * be slightly behind. Returns the number of threads that made profiled calls.
+ *
+ * Complexity: O(threads * PROFILE_NFUNCTIONS)
+ */
+static inline size_t profile_sum(struct profile_counts *total)
+{
+    const struct profile_thread *t = __atomic_load_n(&profile_threads, __ATOMIC_ACQUIRE);
+    size_t threads = 0;
+    unsigned f, b;
+
+    memset(total, 0, PROFILE_NFUNCTIONS * sizeof(struct profile_counts));
+    for (; t != NULL; t = t->next) {
+        for (f = 0; f < PROFILE_NFUNCTIONS; ++f) {
+            total[f].calls += t->counts[f].calls;
+            total[f].flagged += t->counts[f].flagged;
+            total[f].samples += t->counts[f].samples;
+            total[f].ones += t->counts[f].ones;
+            for (b = 0; b < PROFILE_BUCKETS; ++b) {
+                total[f].density[b] += t->counts[f].density[b];
+            }
+        }
+        threads += t != &profile_spare;
+    }
+    return threads;
+}
+
+/**
+ * Write a report of the calls of every function that was called to out: the
+ * number of calls and flagged calls, the mean density of the sampled inputs
+ * and their distribution over the density buckets.
+ *
+ * Complexity: O(threads * PROFILE_NFUNCTIONS)
+ */
+static inline void profile_write(FILE *out)
+{
+    struct profile_counts total[PROFILE_NFUNCTIONS];
+    size_t threads = profile_sum(total);
+    unsigned f, b;
+
+    fprintf(out, "bitlib profile of %s: %zu threads, 1 in %d calls sampled\n", PROFILE_UNIT,
+            threads, BITLIB_PROFILE_SAMPLE);
+    fprintf(out, "%-17s %14s %12s %8s   %s\n", "function", "calls", "flagged", "density",
+            "0 / <=1/4 / <=1/2 / <=3/4 / >3/4");
+    for (f = 0; f < PROFILE_NFUNCTIONS; ++f) {
+        const struct profile_counts *c = &total[f];
+        double samples = c->samples > 0 ? (double)c->samples : 1.0;
+        if (c->calls == 0) {
+            continue;
+        }
+        fprintf(out, "%-17s %14llu %12llu %7.1f%%  ", profile_names[f],
+                (unsigned long long)c->calls, (unsigned long long)c->flagged,
+                100.0 * (double)c->ones / (samples * profile_widths[f]));
+        for (b = 0; b < PROFILE_BUCKETS; ++b) {
+            fprintf(out, " %5.1f%%", 100.0 * (double)c->density[b] / samples);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static inline void profile_atexit(void)
+{
+#ifdef BITLIB_PROFILE_FILE
+    FILE *out = fopen(BITLIB_PROFILE_FILE, "a");
+    if (out != NULL) {
+        profile_write(out);
+        fclose(out);
+        return;
+    }
+#endif
+    profile_write(stderr);
+}
+
+/* Allocate the counters of the calling thread on its first profiled call */
+static inline struct profile_thread *profile_register(void)
+{
+    struct profile_thread *t = (struct profile_thread *)calloc(1, sizeof(struct profile_thread));
+
+    if (t == NULL) {
+        t = &profile_spare;
+        if (__atomic_exchange_n(&profile_spare_used, 1, __ATOMIC_ACQ_REL)) {
+            profile_self = t;
+            return t;
+        }
+    }
+    t->next = __atomic_load_n(&profile_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&profile_threads, &t->next, t, 1, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+    if (!__atomic_exchange_n(&profile_registered, 1, __ATOMIC_ACQ_REL)) {
+        atexit(profile_atexit);
+    }
+    profile_self = t;
+    return t;
+}
+
+static inline void profile_call(enum profile_id f, uint64_t value, int flagged)
+{
+    struct profile_thread *t = profile_self != NULL ? profile_self : profile_register();
+    struct profile_counts *c = &t->counts[f];
+
+    c->flagged += flagged != 0;
+    if ((c->calls++ & (BITLIB_PROFILE_SAMPLE - 1)) == 0) {
+        unsigned ones = profile_ones(value), width = profile_widths[f];
+        ++c->samples;
+        c->ones += ones;
+        ++c->density[(ones * (PROFILE_BUCKETS - 1) + width - 1) / width];
+    }
+}
+
+#define PROFILE_CALL(f, value, flagged) profile_call(PROFILE_##f, (uint64_t)(value), (flagged))
+
+#else
+
+#define PROFILE_CALL(f, value, flagged) ((void)0)
+
+#endif
+
+#endif //BITLIB_PROFILE_H
@@ -0,0 +1,476 @@
+/**
+ * A storage format for point sets sorted by 3D Morton code (morton3_64) that is
+ * used in place, e.g. straight from a memory-mapped file, without a
+ * deserialization step. Points are stored in blocks of a fixed number of rows.
+ * A sparse index holding the first code of every block is searched to find the
+ * blocks a lookup or a box query has to read, so only their pages are touched.
+ * Every block holds its attribute columns (32 bit values, e.g. float bit
+ * patterns or indices) followed by its codes, which are either stored plainly
+ * or as delta-encoded varints.
+ *
+ * All values use the byte order of the writing machine, which the magic number
+ * at the start of the file detects. The layout, in 64 bit words unless noted:
+ *
+ *     header:  magic, count, block, nblocks, nattrs, flags, size, 0
+ *     first:   nblocks first codes
+ *     offset:  nblocks + 1 byte offsets of the blocks from the start of the file
+ *     block b: nattrs columns of rows(b) 32 bit values, padded to 8 bytes,
+ *              then the codes: rows(b) words, or with PSTORE_DELTA the
+ *              rows(b) - 1 differences to the previous code as varints,
+ *              padded to 8 bytes
+ *
+ * Function families in this file:
+ * pstore_size, pstore_write: serialize sorted points
+ * pstore_open: attach to serialized points without copying them
+ * pstore_map, pstore_unmap: memory-map a file of serialized points (POSIX only)
+ * pstore_rows, pstore_codes, pstore_attr: access the contents of a block
+ * pstore_block: find the block that may contain a code
+ * pstore_find: look up a code
+ * pstore_query: find the points inside a box
+ */
+
+#ifndef BITLIB_PSTORE_H
+#define BITLIB_PSTORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "morton.h"
+#include "range.h"
+#include "compare.h"
+
+/**
+ * The first word of a serialized point store, "BITLPTS1" in little-endian byte
+ * order.
+ */
+#define PSTORE_MAGIC 0x315354504c544942
+
+/**
+ * Flag for pstore_write_64: store the codes of every block as varint deltas.
+ */
+#define PSTORE_DELTA 1
+
+/**
+ * A view of serialized points. All pointers refer into the serialized data,
+ * which must stay valid while the view is in use.
+ */
+struct pstore {
+    const uint8_t *base;
+    uint64_t size;
+    uint64_t count;
+    uint64_t block;
+    uint64_t nblocks;
+    uint64_t nattrs;
+    uint64_t flags;
+    const uint64_t *first;
+    const uint64_t *offset;
+};
+
+/**
+ * Calculate the number of bytes taken by the varint encoding of v.
+ *
+ * Complexity: 1 bit op, 1 add/subs, 1 compare per 7 bits
+ */
+static inline size_t pstore_varint_size_64(uint64_t v)
+{
+    size_t n = 1;
+
+    while (v >= 0x80) {
+        v >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * Calculate the number of bytes of the codes section of a block of rows codes.
+ *
+ * Complexity: O(rows)
+ */
+static inline size_t pstore_codes_size_64(const uint64_t *codes, size_t rows, uint64_t flags)
+{
+    size_t i, n = 0;
+
+    if (!(flags & PSTORE_DELTA)) {
+        return 8 * rows;
+    }
+    for (i = 1; i < rows; ++i) {
+        n += pstore_varint_size_64(codes[i] - codes[i - 1]);
+    }
+    return (n + 7) & ~(size_t)7;
+}
+
+/**
+ * Calculate the number of bytes pstore_write_64 needs to serialize the n
+ * sorted codes with nattrs attribute columns in blocks of block rows.
+ *
+ * Complexity: O(n) with PSTORE_DELTA, O(n / block) otherwise
+ */
+static inline size_t pstore_size_64(const uint64_t *codes, size_t n, size_t block,
+                                    size_t nattrs, uint64_t flags)
+{
+    size_t nblocks = (n + block - 1) / block, b, size;
+
+    size = 8 * (8 + nblocks + nblocks + 1);
+    for (b = 0; b < nblocks; ++b) {
+        size_t rows = n - b * block < block ? n - b * block : block;
+        size += ((4 * nattrs * rows + 7) & ~(size_t)7) +
+                pstore_codes_size_64(codes + b * block, rows, flags);
+    }
+    return size;
+}
+
+/**
+ * Serialize the n codes, which must be sorted, and their nattrs attribute
+ * columns (cols[a][i] is attribute a of point i) in blocks of block rows to
+ * buf, which must be 8 byte aligned. flags is 0 or PSTORE_DELTA. Returns the
+ * number of bytes written, or 0 if they would exceed cap or block is 0.
+ *
+ * Blocks are independent once their offsets are known, so a writer for very
+ * large point sets can fill them from several threads.
+ *
+ * Complexity: O(n * (nattrs + 1))
+ */
+static inline size_t pstore_write_64(const uint64_t *codes, const uint32_t *const *cols,
+                                     size_t n, size_t block, size_t nattrs, uint64_t flags,
+                                     void *buf, size_t cap)
+{
+    size_t nblocks, size, pos, b, a, i;
+    uint64_t *words = (uint64_t *)buf;
+    uint8_t *bytes = (uint8_t *)buf;
+
+    if (block == 0) {
+        return 0;
+    }
+    size = pstore_size_64(codes, n, block, nattrs, flags);
+    if (size > cap) {
+        return 0;
+    }
+    nblocks = (n + block - 1) / block;
+
+    words[0] = PSTORE_MAGIC;
+    words[1] = n;
+    words[2] = block;
+    words[3] = nblocks;
+    words[4] = nattrs;
+    words[5] = flags;
+    words[6] = size;
+    words[7] = 0;
+
+    pos = 8 * (8 + nblocks + nblocks + 1);
+    for (b = 0; b < nblocks; ++b) {
+        const uint64_t *c = codes + b * block;
+        size_t rows = n - b * block < block ? n - b * block : block;
+        size_t end;
+
+        words[8 + b] = c[0];
+        words[8 + nblocks + b] = pos;
+
+        for (a = 0; a < nattrs; ++a) {
+            memcpy(bytes + pos, cols[a] + b * block, 4 * rows);
+            pos += 4 * rows;
+        }
+        pos = (pos + 7) & ~(size_t)7;
+
+        if (!(flags & PSTORE_DELTA)) {
+            memcpy(bytes + pos, c, 8 * rows);
+            pos += 8 * rows;
+            continue;
+        }
+        end = pos + pstore_codes_size_64(c, rows, flags);
+        for (i = 1; i < rows; ++i) {
+            uint64_t d = c[i] - c[i - 1];
+            while (d >= 0x80) {
+                bytes[pos++] = (uint8_t)(d | 0x80);
+                d >>= 7;
+            }
+            bytes[pos++] = (uint8_t)d;
+        }
+        while (pos < end) {
+            bytes[pos++] = 0;
+        }
+    }
+    words[8 + nblocks + nblocks] = pos;
+    return size;
+}
+
+/**
+ * Attach the view s to the size bytes of serialized points at buf, which must
+ * be 8 byte aligned. The header and the index are checked: every block has to
+ * start on an 8 byte boundary after the index, end before the next one starts
+ * and hold at least its attribute columns and the smallest possible codes
+ * section, and the last one has to end within size. The block data itself
+ * isn't read, and nothing is copied. Returns 1 on success, or 0 if buf
+ * doesn't hold a valid point store (e.g. one written on a machine with the
+ * other byte order).
+ *
+ * Complexity: O(nblocks)
+ */
+static inline int pstore_open_64(const void *buf, size_t size, struct pstore *s)
+{
+    const uint64_t *words = (const uint64_t *)buf;
+    uint64_t nblocks, count, block, nattrs, end, b;
+
+    if (size < 64 || words[0] != PSTORE_MAGIC || words[6] > size || words[2] == 0) {
+        return 0;
+    }
+    count = words[1];
+    block = words[2];
+    nblocks = words[3];
+    nattrs = words[4];
+    end = words[6];
+    /* The index must fit into the data, which also keeps its size from
+     * overflowing */
+    if (end < 72 || nblocks != count / block + (count % block != 0) ||
+        nblocks > (end / 8 - 9) / 2 ||
+        words[8 + 2 * nblocks] > end) {
+        return 0;
+    }
+    for (b = 0; b < nblocks; ++b) {
+        uint64_t lo = words[8 + nblocks + b], hi = words[8 + nblocks + b + 1];
+        uint64_t rows = b + 1 < nblocks ? block : count - b * block, need;
+
+        if (lo % 8 != 0 || lo < 8 * (9 + 2 * nblocks) || hi < lo || hi > end ||
+            rows - 1 > hi - lo || nattrs > (hi - lo) / 4 / rows) {
+            return 0;
+        }
+        need = ((4 * nattrs * rows + 7) & ~(uint64_t)7) +
+               (words[5] & PSTORE_DELTA ? (rows - 1 + 7) & ~(uint64_t)7 : 8 * rows);
+        if (need > hi - lo) {
+            return 0;
+        }
+    }
+    s->base = (const uint8_t *)buf;
+    s->size = words[6];
+    s->count = words[1];
+    s->block = words[2];
+    s->nblocks = nblocks;
+    s->nattrs = words[4];
+    s->flags = words[5];
+    s->first = words + 8;
+    s->offset = words + 8 + nblocks;
+    return 1;
+}
+
+/**
+ * Calculate the number of rows of block b.
+ *
+ * Complexity: 2 add/subs, 1 multiply, 1 compare
+ */
+static inline size_t pstore_rows_64(const struct pstore *s, uint64_t b)
+{
+    uint64_t left = s->count - b * s->block;
+    return (size_t)(left < s->block ? left : s->block);
+}
+
+/**
+ * Access the codes of block b. Plainly stored codes are returned in place;
+ * delta-encoded ones are decoded into scratch, which needs room for s->block
+ * codes, and scratch is returned. Decoding stops at the end of the block, so
+ * corrupt varints give wrong codes but no reads past the block.
+ *
+ * Complexity: O(1), or O(rows) with PSTORE_DELTA
+ */
+static inline const uint64_t *pstore_codes_64(const struct pstore *s, uint64_t b,
+                                              uint64_t *scratch)
+{
+    size_t rows = pstore_rows_64(s, b), i;
+    const uint8_t *p = s->base + s->offset[b] + ((4 * s->nattrs * rows + 7) & ~(size_t)7);
+    const uint8_t *end = s->base + s->offset[b + 1];
+    uint64_t c = s->first[b];
+
+    if (!(s->flags & PSTORE_DELTA)) {
+        return (const uint64_t *)p;
+    }
+    scratch[0] = c;
+    for (i = 1; i < rows; ++i) {
+        uint64_t d = 0;
+        unsigned shift = 0;
+        while (p < end && *p & 0x80 && shift < 63) {
+            d |= (uint64_t)(*p++ & 0x7f) << shift;
+            shift += 7;
+        }
+        d |= p < end ? (uint64_t)*p++ << shift : 0;
+        c += d;
+        scratch[i] = c;
+    }
+    return scratch;
+}
+
+/**
+ * Access attribute column a of block b in place.
+ *
+ * Complexity: 2 add/subs, 1 multiply
+ */
+static inline const uint32_t *pstore_attr_32(const struct pstore *s, uint64_t b, size_t a)
+{
+    return (const uint32_t *)(s->base + s->offset[b]) + a * pstore_rows_64(s, b);
+}
+
+/**
+ * Find the first block whose first code is not less than code, or s->nblocks
+ * if there is none. The search reads O(log nblocks) index entries.
+ *
+ * Complexity: O(log nblocks)
+ */
+static inline uint64_t pstore_block_64(const struct pstore *s, uint64_t code)
+{
+    uint64_t lo = 0, hi = s->nblocks;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (s->first[mid] < code) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Look up code. If it is stored, the index of its first row is written to row
+ * and 1 is returned; otherwise 0 is returned. scratch is used as in
+ * pstore_codes_64. At most one block is decoded.
+ *
+ * Complexity: O(log nblocks + block)
+ */
+static inline int pstore_find_64(const struct pstore *s, uint64_t code, uint64_t *scratch,
+                                 uint64_t *row)
+{
+    uint64_t b = pstore_block_64(s, code);
+    const uint64_t *c;
+    size_t rows, i;
+
+    /* Earlier occurrences may end the previous block. */
+    if (b > 0) {
+        c = pstore_codes_64(s, b - 1, scratch);
+        rows = pstore_rows_64(s, b - 1);
+        for (i = 0; i < rows; ++i) {
+            if (c[i] == code) {
+                *row = (b - 1) * s->block + i;
+                return 1;
+            }
+        }
+    }
+    if (b < s->nblocks && s->first[b] == code) {
+        *row = b * s->block;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Find the points inside the box [xmin; xmax] x [ymin; ymax] x [zmin; zmax]
+ * (bounds inclusive, 21 bit coordinates). The box is covered with at most
+ * maxranges code ranges (see morton3_ranges_64; ranges needs room for
+ * 2 * maxranges values), and only the blocks overlapping those ranges are
+ * read. The row indices of the matches are written to rows in ascending order.
+ * Returns the number of matches; if it exceeds cap, only the first cap are
+ * written. scratch is used as in pstore_codes_64.
+ *
+ * Complexity: that of morton3_ranges_64, plus O(r * log nblocks + m * block)
+ *     where r is the number of ranges and m the number of blocks read
+ */
+static inline size_t pstore_query_64(const struct pstore *s,
+                                     uint64_t xmin, uint64_t ymin, uint64_t zmin,
+                                     uint64_t xmax, uint64_t ymax, uint64_t zmax,
+                                     uint64_t *ranges, size_t maxranges, uint64_t *scratch,
+                                     uint64_t *rows, size_t cap)
+{
+    uint64_t lo = morton3_64(xmin, ymin, zmin), hi = morton3_64(xmax, ymax, zmax);
+    uint64_t next = 0, last = s->nblocks;
+    const uint64_t *c = NULL;
+    size_t nr, r, found = 0;
+
+    nr = morton3_ranges_64(xmin, ymin, zmin, xmax, ymax, zmax, 0, ranges, maxranges);
+    for (r = 0; r < nr; ++r) {
+        uint64_t rlo = ranges[2 * r], rhi = ranges[2 * r + 1];
+        uint64_t b = pstore_block_64(s, rlo);
+
+        /* The range may start inside the previous block. */
+        b = b > 0 ? b - 1 : 0;
+        b = b < next ? next : b;
+        for (; b < s->nblocks && s->first[b] <= rhi; ++b) {
+            size_t n = pstore_rows_64(s, b), i;
+
+            /* A block that ends one range often starts the next one; it is
+             * decoded only once. */
+            if (b != last) {
+                c = pstore_codes_64(s, b, scratch);
+                last = b;
+            }
+            for (i = 0; i < n; ++i) {
+                if (c[i] >= rlo && c[i] <= rhi && morton3_in_box_64(c[i], lo, hi)) {
+                    if (found < cap) {
+                        rows[found] = b * s->block + i;
+                    }
+                    ++found;
+                }
+            }
+            if (c[n - 1] > rhi) {
+                break;
+            }
+        }
+        next = b;
+    }
+    return found;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Memory-map the point store file at path read-only and attach s to it. Opening
+ * reads the header and the index; the pages of a block are only read from disk
+ * when the block is accessed. Returns 1 on success, or 0 if the file can't be
+ * mapped or doesn't hold a valid point store. Release the mapping with
+ * pstore_unmap_64.
+ *
+ * Complexity: O(nblocks)
+ */
+static inline int pstore_map_64(const char *path, struct pstore *s)
+{
+    struct stat st;
+    void *p;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return 0;
+    }
+    if (!pstore_open_64(p, (size_t)st.st_size, s)) {
+        munmap(p, (size_t)st.st_size);
+        return 0;
+    }
+    /* Keep the whole mapping, even if the file has trailing bytes. */
+    s->size = (uint64_t)st.st_size;
+    return 1;
+}
+
+/**
+ * Release a mapping created by pstore_map_64.
+ *
+ * Complexity: O(1)
+ */
+static inline void pstore_unmap_64(struct pstore *s)
+{
+    munmap((void *)s->base, (size_t)s->size);
+    s->base = NULL;
+}
+
+#endif
+
+#endif //BITLIB_PSTORE_H
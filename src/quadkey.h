@@ -0,0 +1,275 @@
+/**
+ * Tools for working with web map tile pyramids ("slippy maps"). The tile
+ * (x; y) at zoom level z has the quadkey whose digits are the 2D Morton code
+ * morton_64(x, y) in base 4, most significant digit first. Tiles are handled
+ * here as 64 bit tile keys holding that Morton code below a single set bit at
+ * position 2 * z, so one integer carries both the zoom level and the tile.
+ * Zoom levels range from 0 to 31. The x axis wraps around the antimeridian,
+ * the y axis ends at the top and bottom of the map.
+ *
+ * Function families in this file:
+ * tile_key: tile key of (z; x; y)
+ * tile_zoom, tile_morton, tile_xy: unpack a tile key
+ * tile_key_bulk, tile_xy_bulk: the same for arrays
+ * tile_parent, tile_child: step up or down one zoom level
+ * tile_neighbor: same-level neighbor of a tile
+ * quadkey_format, quadkey_parse: convert between tile keys and quadkey strings
+ * quadkey_format_bulk: format many tiles of one zoom level
+ * tile_box: enumerate the tiles of a bounding box in Morton order
+ */
+
+#ifndef BITLIB_QUADKEY_H
+#define BITLIB_QUADKEY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton.h"
+#include "compare.h"
+
+/**
+ * Calculate the tile key of tile (x; y) at zoom level z (0 to 31). x and y must
+ * be less than 2^z.
+ *
+ * Complexity: 33 bit ops
+ */
+static inline uint64_t tile_key_64(unsigned z, uint64_t x, uint64_t y)
+{
+    return ((uint64_t)1 << (2 * z)) | morton_64(x, y);
+}
+
+/**
+ * Extract the zoom level of tile key k, i.e. half the index of its highest set
+ * bit.
+ *
+ * Complexity: 5 bit ops, 5 add/subs, 5 compare, 5 branch
+ */
+static inline unsigned tile_zoom_64(uint64_t k)
+{
+    unsigned z = 0;
+    if (k >> 32 != 0) { z += 16; k >>= 32; }
+    if (k >> 16 != 0) { z += 8; k >>= 16; }
+    if (k >> 8 != 0) { z += 4; k >>= 8; }
+    if (k >> 4 != 0) { z += 2; k >>= 4; }
+    if (k >> 2 != 0) { z += 1; }
+    return z;
+}
+
+/**
+ * Extract the Morton code (the integer quadkey) of tile key k.
+ *
+ * Complexity: 2 bit ops, 1 add/subs, 1 multiply and tile_zoom_64
+ */
+static inline uint64_t tile_morton_64(uint64_t k)
+{
+    return k ^ ((uint64_t)1 << (2 * tile_zoom_64(k)));
+}
+
+/**
+ * Place the tile coordinates of tile key k into x and y.
+ *
+ * Complexity: 31 bit ops and tile_morton_64
+ */
+static inline void tile_xy_64(uint64_t k, uint64_t *x, uint64_t *y)
+{
+    invmorton_64(tile_morton_64(k), x, y);
+}
+
+/**
+ * Calculate the tile keys of the n tiles (x[i]; y[i]) at zoom level z into
+ * keys.
+ *
+ * The loop is branch-free, so compilers can vectorize it when a SIMD
+ * instruction set is enabled.
+ *
+ * Complexity: n times tile_key_64
+ */
+static inline void tile_key_bulk_64(unsigned z, const uint64_t *x, const uint64_t *y, size_t n,
+                                    uint64_t *keys)
+{
+    uint64_t top = (uint64_t)1 << (2 * z);
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        keys[i] = top | morton_64(x[i], y[i]);
+    }
+}
+
+/**
+ * Place the tile coordinates of the n tile keys into x and y. The keys may
+ * belong to different zoom levels.
+ *
+ * Complexity: n times tile_xy_64
+ */
+static inline void tile_xy_bulk_64(const uint64_t *keys, size_t n, uint64_t *x, uint64_t *y)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        tile_xy_64(keys[i], x + i, y + i);
+    }
+}
+
+/**
+ * Calculate the tile key of the parent of tile k. The zoom level of k must be
+ * greater than 0, or the result is undefined.
+ *
+ * Complexity: 1 bit op
+ */
+static inline uint64_t tile_parent_64(uint64_t k)
+{
+    return k >> 2;
+}
+
+/**
+ * Calculate the tile key of child c (0 to 3, in quadkey digit order: top left,
+ * top right, bottom left, bottom right) of tile k. The zoom level of k must be
+ * less than 31, or the result is undefined.
+ *
+ * Complexity: 2 bit ops
+ */
+static inline uint64_t tile_child_64(uint64_t k, unsigned c)
+{
+    return (k << 2) | c;
+}
+
+/**
+ * Calculate the tile key of the same-level neighbor of tile k in the given
+ * direction: 0 west (x-1), 1 east (x+1), 2 north (y-1), 3 south (y+1). The
+ * neighbor is written to n and 1 is returned. x wraps around the antimeridian;
+ * stepping over the top or bottom of the map returns 0 and leaves n untouched.
+ *
+ * The neighbor is the matching Morton neighbor step applied to the Morton code
+ * of k. Carries and borrows out of the x bits end up above the 2 * z code bits
+ * and are masked off, which makes x wrap.
+ *
+ * Complexity: 10 bit ops, 2 add/subs, 1 multiply, 1 compare, 2 branch and
+ *     tile_zoom_64
+ */
+static inline int tile_neighbor_64(uint64_t k, unsigned dir, uint64_t *n)
+{
+    uint64_t top = (uint64_t)1 << (2 * tile_zoom_64(k));
+    uint64_t m = k ^ top;
+
+    switch (dir) {
+    case 0: m = mortonxm_64(m); break;
+    case 1: m = mortonxp_64(m); break;
+    case 2: m = mortonym_64(m); break;
+    default: m = mortonyp_64(m); break;
+    }
+
+    /* Leaving the map in y carries or borrows out of the y bits. */
+    if (dir >= 2 && (m & 0xaaaaaaaaaaaaaaaa & ~(top - 1)) != 0) {
+        return 0;
+    }
+    *n = top | (m & (top - 1));
+    return 1;
+}
+
+/**
+ * Write the quadkey of tile k to s, which needs room for as many characters as
+ * the zoom level of k. No terminating zero is written. Returns the number of
+ * characters, i.e. the zoom level.
+ *
+ * Complexity: 3 bit ops, 1 add/subs per character and tile_zoom_64
+ */
+static inline unsigned quadkey_format_64(uint64_t k, char *s)
+{
+    unsigned z = tile_zoom_64(k), i;
+
+    for (i = 0; i < z; ++i) {
+        s[i] = (char)('0' + ((k >> (2 * (z - 1 - i))) & 3));
+    }
+    return z;
+}
+
+/**
+ * Parse the quadkey s of len characters (at most 31) into the tile key k.
+ * Returns 1 on success, or 0 if s contains a character other than '0' to '3',
+ * in which case k is left untouched.
+ *
+ * All characters are checked without branching, so the loop can be
+ * vectorized.
+ *
+ * Complexity: 3 bit ops, 2 add/subs, 1 compare per character
+ */
+static inline int quadkey_parse_64(const char *s, size_t len, uint64_t *k)
+{
+    uint64_t m = 1;
+    unsigned bad = 0;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        unsigned d = (unsigned)(unsigned char)s[i] - '0';
+        bad |= d > 3;
+        m = (m << 2) | (d & 3);
+    }
+    if (bad) {
+        return 0;
+    }
+    *k = m;
+    return 1;
+}
+
+/**
+ * Write the quadkeys of n tile keys, all at zoom level z, to s as fixed-width
+ * records of z characters each, so s needs room for n * z characters.
+ *
+ * Complexity: n times quadkey_format_64 without tile_zoom_64
+ */
+static inline void quadkey_format_bulk_64(const uint64_t *keys, size_t n, unsigned z, char *s)
+{
+    size_t i;
+    unsigned j;
+
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < z; ++j) {
+            s[i * z + j] = (char)('0' + ((keys[i] >> (2 * (z - 1 - j))) & 3));
+        }
+    }
+}
+
+/**
+ * Enumerate the tiles of the box [xmin; xmax] x [ymin; ymax] (bounds inclusive)
+ * at zoom level z in Morton order, starting at tile key start. At most cap
+ * tile keys are written to keys; the number written is returned. Pass 0 as
+ * start to begin with the first tile; to continue after a full batch, pass the
+ * last key returned plus 1. The box must not cross the antimeridian
+ * (xmin <= xmax); split it in two if it does.
+ *
+ * Runs of codes outside of the box are skipped with mortonbigmin_64, so the
+ * cost depends on the number of tiles in the box, not on the size of its
+ * Morton code range.
+ *
+ * Complexity: O(t + j * 32) where t is the number of tiles written and j the
+ *     number of jumps out of the box
+ */
+static inline size_t tile_box_64(unsigned z, uint64_t xmin, uint64_t ymin,
+                                 uint64_t xmax, uint64_t ymax, uint64_t start,
+                                 uint64_t *keys, size_t cap)
+{
+    uint64_t top = (uint64_t)1 << (2 * z);
+    uint64_t lo = morton_64(xmin, ymin), hi = morton_64(xmax, ymax);
+    uint64_t m = start > top ? start - top : 0;
+    size_t count = 0;
+
+    if (xmin > xmax || ymin > ymax) {
+        return 0;
+    }
+    if (m < lo) {
+        m = lo;
+    }
+    while (count < cap && m <= hi) {
+        if (morton_in_box_64(m, lo, hi)) {
+            keys[count++] = top | m;
+            ++m;
+        } else {
+            m = mortonbigmin_64(m, lo, hi);
+            if (m == 0) {
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+#endif //BITLIB_QUADKEY_H
@@ -0,0 +1,298 @@
+/**
+ * Tools for translating axis-aligned query boxes into sets of contiguous Morton
+ * code ranges, so that a box query on a Morton-sorted index turns into a few
+ * sequential scans. Ranges are written as pairs of inclusive bounds (lo, hi)
+ * into caller-provided arrays; no memory is allocated.
+ *
+ * Function families in this file:
+ * morton_ranges, morton3_ranges: cover a 2D or 3D box with at most a given
+ *     number of code ranges
+ * morton_ranges_bulk, morton3_ranges_bulk: cover many boxes at once
+ */
+
+#ifndef BITLIB_RANGE_H
+#define BITLIB_RANGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton.h"
+
+/**
+ * Append the code range [lo; hi] to the sorted list of count ranges. The new
+ * range is merged into the last one if the gap between them is at most gap.
+ * If the list already holds maxranges ranges, the two neighbors with the
+ * smallest gap are merged to make room. Since merging never changes the other
+ * gaps, the final list keeps exactly the largest gaps seen, which minimizes the
+ * number of false positive codes for the given budget. Returns the new count.
+ *
+ * Complexity: O(maxranges) once the list is full, O(1) otherwise
+ */
+static inline size_t range_push_64(uint64_t *ranges, size_t count, size_t maxranges,
+                                   uint64_t gap, uint64_t lo, uint64_t hi)
+{
+    size_t i, best;
+    uint64_t g, bestgap;
+
+    if (count > 0 && lo - ranges[2 * count - 1] - 1 <= gap) {
+        ranges[2 * count - 1] = hi;
+        return count;
+    }
+    if (count < maxranges) {
+        ranges[2 * count] = lo;
+        ranges[2 * count + 1] = hi;
+        return count + 1;
+    }
+
+    /* The list is full: drop the smallest gap, which may be the new one. */
+    best = count - 1;
+    bestgap = lo - ranges[2 * count - 1] - 1;
+    for (i = 0; i + 1 < count; ++i) {
+        g = ranges[2 * i + 2] - ranges[2 * i + 1] - 1;
+        if (g < bestgap) {
+            bestgap = g;
+            best = i;
+        }
+    }
+    if (best == count - 1) {
+        ranges[2 * count - 1] = hi;
+        return count;
+    }
+    ranges[2 * best + 1] = ranges[2 * best + 3];
+    for (i = best + 1; i + 1 < count; ++i) {
+        ranges[2 * i] = ranges[2 * i + 2];
+        ranges[2 * i + 1] = ranges[2 * i + 3];
+    }
+    ranges[2 * count - 2] = lo;
+    ranges[2 * count - 1] = hi;
+    return count;
+}
+
+/**
+ * Cover the box [xmin; xmax] x [ymin; ymax] (bounds inclusive, 32 bit
+ * coordinates) with Morton code ranges as produced by morton_64. At most
+ * maxranges ranges are written to ranges as (lo, hi) pairs in ascending order,
+ * so the array must have room for 2 * maxranges values. Ranges separated by at
+ * most gap codes are merged. Returns the number of ranges written, which is 0
+ * if maxranges is 0.
+ *
+ * The cover is found by a depth-first walk of the quadtree, starting at the
+ * smallest quadrant that holds the box, that emits every quadrant fully inside
+ * the box as a single range. A quadrant that overlaps the box only partly is
+ * split as long as the ranges written so far, the quadrants waiting on the
+ * stack and its overlapping children fit into maxranges, and at most
+ * 2 * 32 * maxranges quadrants are split in total; otherwise it is emitted
+ * whole, trimmed to the codes between the corners of its overlap with the box.
+ * When the budget is exceeded, the pair of neighboring ranges with the
+ * smallest gap is merged, trading false positive codes for fewer seeks. So
+ * the walk costs the same for a box of any size, and yields the exact cover
+ * whenever that fits into the budget.
+ *
+ * Complexity: O(32 * maxranges^2)
+ */
+static inline size_t morton_ranges_64(uint64_t xmin, uint64_t ymin, uint64_t xmax, uint64_t ymax,
+                                      uint64_t gap, uint64_t *ranges, size_t maxranges)
+{
+    /* 3 pending siblings per level plus the children of the current node */
+    uint64_t sx[100], sy[100];
+    unsigned sl[100];
+    size_t top = 0, count = 0, splits;
+    unsigned l = 0;
+
+    if (maxranges == 0 || xmin > xmax || ymin > ymax) {
+        return 0;
+    }
+    splits = maxranges > SIZE_MAX / 64 ? SIZE_MAX : 64 * maxranges;
+
+    /* The smallest quadrant that holds the box */
+    while (l < 32 && ((xmin ^ xmax) | (ymin ^ ymax)) >> l != 0) {
+        ++l;
+    }
+    sx[0] = xmin >> l << l;
+    sy[0] = ymin >> l << l;
+    sl[0] = l;
+    top = 1;
+    while (top > 0) {
+        uint64_t x0, y0, x1, y1, half;
+        int ox[2], oy[2];
+        unsigned c, k;
+
+        --top;
+        x0 = sx[top];
+        y0 = sy[top];
+        l = sl[top];
+        x1 = x0 + (((uint64_t)1 << l) - 1);
+        y1 = y0 + (((uint64_t)1 << l) - 1);
+
+        if (x0 > xmax || x1 < xmin || y0 > ymax || y1 < ymin) {
+            continue;
+        }
+        if (x0 >= xmin && x1 <= xmax && y0 >= ymin && y1 <= ymax) {
+            uint64_t lo = morton_64(x0, y0);
+            uint64_t span = l == 32 ? UINT64_MAX : ((uint64_t)1 << (2 * l)) - 1;
+            count = range_push_64(ranges, count, maxranges, gap, lo, lo + span);
+            continue;
+        }
+
+        /* Which halves of the quadrant overlap the box along each axis */
+        half = (uint64_t)1 << (l - 1);
+        ox[0] = xmin < x0 + half;
+        ox[1] = xmax >= x0 + half;
+        oy[0] = ymin < y0 + half;
+        oy[1] = ymax >= y0 + half;
+        k = (unsigned)(ox[0] + ox[1]) * (unsigned)(oy[0] + oy[1]);
+        if (splits == 0 || count + top + k > maxranges) {
+            /* Morton order is monotonic in every coordinate, so the overlap lies
+             * between the codes of its corners */
+            count = range_push_64(ranges, count, maxranges, gap,
+                                  morton_64(x0 > xmin ? x0 : xmin, y0 > ymin ? y0 : ymin),
+                                  morton_64(x1 < xmax ? x1 : xmax, y1 < ymax ? y1 : ymax));
+            continue;
+        }
+        --splits;
+
+        /* Push the children in reverse Z-order so that child 0 is popped first. */
+        for (c = 4; c-- > 0;) {
+            if (ox[c & 1] && oy[c >> 1]) {
+                sx[top] = x0 + (c & 1) * half;
+                sy[top] = y0 + (c >> 1) * half;
+                sl[top] = l - 1;
+                ++top;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Cover the box [xmin; xmax] x [ymin; ymax] x [zmin; zmax] (bounds inclusive,
+ * 21 bit coordinates) with Morton code ranges as produced by morton3_64. See
+ * morton_ranges_64 for the meaning of the other parameters and the walk, which
+ * splits at most 2 * 21 * maxranges octants here.
+ *
+ * Complexity: O(21 * maxranges^2)
+ */
+static inline size_t morton3_ranges_64(uint64_t xmin, uint64_t ymin, uint64_t zmin,
+                                       uint64_t xmax, uint64_t ymax, uint64_t zmax,
+                                       uint64_t gap, uint64_t *ranges, size_t maxranges)
+{
+    /* 7 pending siblings per level plus the children of the current node */
+    uint64_t sx[156], sy[156], sz[156];
+    unsigned sl[156];
+    size_t top = 0, count = 0, splits;
+    unsigned l = 0;
+
+    if (maxranges == 0 || xmin > xmax || ymin > ymax || zmin > zmax) {
+        return 0;
+    }
+    splits = maxranges > SIZE_MAX / 42 ? SIZE_MAX : 42 * maxranges;
+
+    while (l < 21 && ((xmin ^ xmax) | (ymin ^ ymax) | (zmin ^ zmax)) >> l != 0) {
+        ++l;
+    }
+    sx[0] = xmin >> l << l;
+    sy[0] = ymin >> l << l;
+    sz[0] = zmin >> l << l;
+    sl[0] = l;
+    top = 1;
+    while (top > 0) {
+        uint64_t x0, y0, z0, x1, y1, z1, half;
+        int ox[2], oy[2], oz[2];
+        unsigned c, k;
+
+        --top;
+        x0 = sx[top];
+        y0 = sy[top];
+        z0 = sz[top];
+        l = sl[top];
+        x1 = x0 + (((uint64_t)1 << l) - 1);
+        y1 = y0 + (((uint64_t)1 << l) - 1);
+        z1 = z0 + (((uint64_t)1 << l) - 1);
+
+        if (x0 > xmax || x1 < xmin || y0 > ymax || y1 < ymin || z0 > zmax || z1 < zmin) {
+            continue;
+        }
+        if (x0 >= xmin && x1 <= xmax && y0 >= ymin && y1 <= ymax && z0 >= zmin && z1 <= zmax) {
+            uint64_t lo = morton3_64(x0, y0, z0);
+            count = range_push_64(ranges, count, maxranges, gap,
+                                  lo, lo + (((uint64_t)1 << (3 * l)) - 1));
+            continue;
+        }
+
+        half = (uint64_t)1 << (l - 1);
+        ox[0] = xmin < x0 + half;
+        ox[1] = xmax >= x0 + half;
+        oy[0] = ymin < y0 + half;
+        oy[1] = ymax >= y0 + half;
+        oz[0] = zmin < z0 + half;
+        oz[1] = zmax >= z0 + half;
+        k = (unsigned)(ox[0] + ox[1]) * (unsigned)(oy[0] + oy[1]) * (unsigned)(oz[0] + oz[1]);
+        if (splits == 0 || count + top + k > maxranges) {
+            count = range_push_64(ranges, count, maxranges, gap,
+                                  morton3_64(x0 > xmin ? x0 : xmin, y0 > ymin ? y0 : ymin,
+                                             z0 > zmin ? z0 : zmin),
+                                  morton3_64(x1 < xmax ? x1 : xmax, y1 < ymax ? y1 : ymax,
+                                             z1 < zmax ? z1 : zmax));
+            continue;
+        }
+        --splits;
+
+        for (c = 8; c-- > 0;) {
+            if (ox[c & 1] && oy[(c >> 1) & 1] && oz[c >> 2]) {
+                sx[top] = x0 + (c & 1) * half;
+                sy[top] = y0 + ((c >> 1) & 1) * half;
+                sz[top] = z0 + (c >> 2) * half;
+                sl[top] = l - 1;
+                ++top;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Cover n 2D boxes with Morton code ranges. boxes holds 4 values per box in the
+ * order xmin, ymin, xmax, ymax. The ranges of box i are written to
+ * ranges + 2 * maxranges * i and their number to counts[i], so ranges must
+ * have room for 2 * maxranges * n values. Returns the total number of ranges.
+ *
+ * Boxes are planned independently, so the work can be split between threads
+ * by box index, as morton_ranges_bulk_ex_64 in bulk.h does.
+ *
+ * Complexity: n times the complexity of morton_ranges_64
+ */
+static inline size_t morton_ranges_bulk_64(const uint64_t *boxes, size_t n, uint64_t gap,
+                                           uint64_t *ranges, size_t maxranges, size_t *counts)
+{
+    size_t i, total = 0;
+
+    for (i = 0; i < n; ++i) {
+        const uint64_t *b = boxes + 4 * i;
+        counts[i] = morton_ranges_64(b[0], b[1], b[2], b[3], gap,
+                                     ranges + 2 * maxranges * i, maxranges);
+        total += counts[i];
+    }
+    return total;
+}
+
+/**
+ * Cover n 3D boxes with Morton code ranges. boxes holds 6 values per box in the
+ * order xmin, ymin, zmin, xmax, ymax, zmax. See morton_ranges_bulk_64 for the
+ * layout of the output.
+ *
+ * Complexity: n times the complexity of morton3_ranges_64
+ */
+static inline size_t morton3_ranges_bulk_64(const uint64_t *boxes, size_t n, uint64_t gap,
+                                            uint64_t *ranges, size_t maxranges, size_t *counts)
+{
+    size_t i, total = 0;
+
+    for (i = 0; i < n; ++i) {
+        const uint64_t *b = boxes + 6 * i;
+        counts[i] = morton3_ranges_64(b[0], b[1], b[2], b[3], b[4], b[5], gap,
+                                      ranges + 2 * maxranges * i, maxranges);
+        total += counts[i];
+    }
+    return total;
+}
+
+#endif //BITLIB_RANGE_H
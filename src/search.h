@@ -0,0 +1,536 @@
+/**
+ * Static search layouts for sorted arrays of codes (e.g. Morton codes of cells
+ * or leaves), which answer lower_bound queries with fewer cache misses than a
+ * binary search. All queries return positions in the sorted array, so the
+ * layouts can be searched in place of it while the payloads stay in sorted
+ * order.
+ *
+ * The Eytzinger layout stores the array as an implicit binary search tree in
+ * breadth-first order: e[1] is the root and the children of e[k] are e[2k] and
+ * e[2k + 1]. The top levels share a few cache lines, and the line holding the
+ * descendants a few levels down is prefetched while the current level is
+ * compared.
+ *
+ * The S-tree (static B+ tree) stores 16 keys per node, so every level fits into
+ * one or two cache lines and narrows the search by a factor of 17. Its lowest
+ * layer is the sorted array itself, padded to full nodes, followed by the
+ * layers of separator keys. The 16 comparisons per node are done without
+ * branches, so compilers turn them into a few SIMD instructions.
+ *
+ * Both layouts are built from the sorted array with every entry computed
+ * independently, so construction can be split between threads by index range;
+ * eytzinger_build_ex and stree_build_ex in bulk.h do this on an executor.
+ *
+ * Function families in this file:
+ * eytzinger_rank: sorted position of an Eytzinger index
+ * eytzinger_build, stree_build: build a layout from a sorted array
+ * eytzinger_lower_bound, stree_lower_bound: first position not less than a key
+ * eytzinger_lower_bound_bulk, stree_lower_bound_bulk: many interleaved queries
+ * eytzinger_range, stree_range: positions of the keys inside a range
+ * stree_init: calculate the layout of an S-tree
+ */
+
+#ifndef BITLIB_SEARCH_H
+#define BITLIB_SEARCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "bitscan.h"
+
+#if defined(__GNUC__)
+#define SEARCH_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define SEARCH_PREFETCH(p) ((void)0)
+#endif
+
+/**
+ * The number of keys of an S-tree node.
+ */
+#define STREE_B 16
+
+/**
+ * The largest number of layers of an S-tree.
+ */
+#define STREE_MAXHEIGHT 16
+
+/**
+ * The number of queries eytzinger_lower_bound_bulk and stree_lower_bound_bulk
+ * interleave.
+ */
+#define SEARCH_BATCH 8
+
+/**
+ * The layout of an S-tree over n keys: layer h (0 being the sorted keys)
+ * occupies positions [offset[h]; offset[h + 1]) of the tree array.
+ */
+struct stree {
+    size_t n;
+    unsigned height;
+    size_t offset[STREE_MAXHEIGHT + 1];
+};
+
+/**
+ * Calculate the position in the sorted array of the key at Eytzinger index k
+ * (1 to n) of an array of n keys.
+ *
+ * In a perfect tree of height h, the node at index j of level d has the sorted
+ * position (2j + 1) * 2^(h - 1 - d) - 1; the nodes missing from the last level
+ * to the left of it are subtracted.
+ *
+ * Complexity: 8 bit ops, 9 add/subs, 1 compare and 2 times bsr_64
+ */
+static inline size_t eytzinger_rank(size_t n, size_t k)
+{
+    unsigned h = (unsigned)bsr_64(n) + 1, d = (unsigned)bsr_64(k);
+    size_t j = k - ((size_t)1 << d);
+    size_t pos = ((2 * j + 1) << (h - 1 - d)) - 1;
+    size_t last = n - (((size_t)1 << (h - 1)) - 1);
+    size_t before = (pos + 1) / 2;
+
+    return pos - (before - (before < last ? before : last));
+}
+
+/**
+ * Fill the entries [begin; end) of the Eytzinger layout e of the n sorted keys
+ * (1 <= begin, end <= n + 1). e needs room for n + 1 keys, e[0] is unused.
+ * Aligning e to 64 bytes makes the prefetches of eytzinger_lower_bound_32 hit
+ * whole cache lines.
+ *
+ * Complexity: O(end - begin)
+ */
+static inline void eytzinger_build_32(const uint32_t *sorted, size_t n, uint32_t *e,
+                                      size_t begin, size_t end)
+{
+    size_t k;
+
+    for (k = begin; k < end; ++k) {
+        e[k] = sorted[eytzinger_rank(n, k)];
+    }
+}
+
+/**
+ * Fill the entries [begin; end) of the Eytzinger layout e of the n sorted keys.
+ * See eytzinger_build_32.
+ *
+ * Complexity: O(end - begin)
+ */
+static inline void eytzinger_build_64(const uint64_t *sorted, size_t n, uint64_t *e,
+                                      size_t begin, size_t end)
+{
+    size_t k;
+
+    for (k = begin; k < end; ++k) {
+        e[k] = sorted[eytzinger_rank(n, k)];
+    }
+}
+
+/**
+ * Find the position of the first of the n sorted keys that is not less than x,
+ * or n if there is none, in their Eytzinger layout e. The descent doesn't
+ * branch on the comparisons; a branch-free step leaves the tree below the
+ * answer, which is recovered by dropping the trailing 1 bits of the index.
+ * Every step prefetches the 16 descendants 4 levels down, which share a cache
+ * line.
+ *
+ * Complexity: O(log n)
+ */
+static inline size_t eytzinger_lower_bound_32(const uint32_t *e, size_t n, uint32_t x)
+{
+    size_t k = 1;
+
+    while (k <= n) {
+        SEARCH_PREFETCH(e + 16 * k);
+        k = 2 * k + (e[k] < x);
+    }
+    k >>= ctz_64(~(uint64_t)k) + 1;
+    return k == 0 ? n : eytzinger_rank(n, k);
+}
+
+/**
+ * Find the position of the first of the n sorted keys that is not less than x,
+ * or n if there is none, in their Eytzinger layout e. See
+ * eytzinger_lower_bound_32; with 64 bit keys the 8 descendants 3 levels down
+ * share a cache line.
+ *
+ * Complexity: O(log n)
+ */
+static inline size_t eytzinger_lower_bound_64(const uint64_t *e, size_t n, uint64_t x)
+{
+    size_t k = 1;
+
+    while (k <= n) {
+        SEARCH_PREFETCH(e + 8 * k);
+        k = 2 * k + (e[k] < x);
+    }
+    k >>= ctz_64(~(uint64_t)k) + 1;
+    return k == 0 ? n : eytzinger_rank(n, k);
+}
+
+/**
+ * Find the lower bounds of the m keys xs in the Eytzinger layout e of n sorted
+ * keys, writing them to out. Groups of SEARCH_BATCH queries descend the tree in
+ * lockstep, so the cache misses of one query overlap with those of the others.
+ *
+ * Complexity: O(m * log n)
+ */
+static inline void eytzinger_lower_bound_bulk_32(const uint32_t *e, size_t n, const uint32_t *xs,
+                                                 size_t m, size_t *out)
+{
+    size_t k[SEARCH_BATCH], b, q, cnt, steps, s;
+
+    steps = n == 0 ? 0 : bsr_64(n) + 1;
+    for (b = 0; b < m; b += SEARCH_BATCH) {
+        cnt = m - b < SEARCH_BATCH ? m - b : SEARCH_BATCH;
+        for (q = 0; q < cnt; ++q) {
+            k[q] = 1;
+        }
+        for (s = 0; s < steps; ++s) {
+            for (q = 0; q < cnt; ++q) {
+                /* The last level may be incomplete; queries past it wait. */
+                size_t kk = k[q] <= n ? k[q] : 0;
+                SEARCH_PREFETCH(e + 16 * k[q]);
+                k[q] = kk ? 2 * kk + (e[kk] < xs[b + q]) : k[q];
+            }
+        }
+        for (q = 0; q < cnt; ++q) {
+            size_t kk = k[q] >> (ctz_64(~(uint64_t)k[q]) + 1);
+            out[b + q] = kk == 0 ? n : eytzinger_rank(n, kk);
+        }
+    }
+}
+
+/**
+ * Find the lower bounds of the m keys xs in the Eytzinger layout e of n sorted
+ * keys. See eytzinger_lower_bound_bulk_32.
+ *
+ * Complexity: O(m * log n)
+ */
+static inline void eytzinger_lower_bound_bulk_64(const uint64_t *e, size_t n, const uint64_t *xs,
+                                                 size_t m, size_t *out)
+{
+    size_t k[SEARCH_BATCH], b, q, cnt, steps, s;
+
+    steps = n == 0 ? 0 : bsr_64(n) + 1;
+    for (b = 0; b < m; b += SEARCH_BATCH) {
+        cnt = m - b < SEARCH_BATCH ? m - b : SEARCH_BATCH;
+        for (q = 0; q < cnt; ++q) {
+            k[q] = 1;
+        }
+        for (s = 0; s < steps; ++s) {
+            for (q = 0; q < cnt; ++q) {
+                size_t kk = k[q] <= n ? k[q] : 0;
+                SEARCH_PREFETCH(e + 8 * k[q]);
+                k[q] = kk ? 2 * kk + (e[kk] < xs[b + q]) : k[q];
+            }
+        }
+        for (q = 0; q < cnt; ++q) {
+            size_t kk = k[q] >> (ctz_64(~(uint64_t)k[q]) + 1);
+            out[b + q] = kk == 0 ? n : eytzinger_rank(n, kk);
+        }
+    }
+}
+
+/**
+ * Find the positions [*first; *first + count) of the keys inside [lo; hi] among
+ * the n sorted keys with the Eytzinger layout e. Returns count.
+ *
+ * Complexity: 2 times eytzinger_lower_bound_32
+ */
+static inline size_t eytzinger_range_32(const uint32_t *e, size_t n, uint32_t lo, uint32_t hi,
+                                        size_t *first)
+{
+    size_t a = eytzinger_lower_bound_32(e, n, lo);
+    size_t b = hi == UINT32_MAX ? n : eytzinger_lower_bound_32(e, n, hi + 1);
+
+    *first = a;
+    return b > a ? b - a : 0;
+}
+
+/**
+ * Find the positions [*first; *first + count) of the keys inside [lo; hi] among
+ * the n sorted keys with the Eytzinger layout e. Returns count.
+ *
+ * Complexity: 2 times eytzinger_lower_bound_64
+ */
+static inline size_t eytzinger_range_64(const uint64_t *e, size_t n, uint64_t lo, uint64_t hi,
+                                        size_t *first)
+{
+    size_t a = eytzinger_lower_bound_64(e, n, lo);
+    size_t b = hi == UINT64_MAX ? n : eytzinger_lower_bound_64(e, n, hi + 1);
+
+    *first = a;
+    return b > a ? b - a : 0;
+}
+
+/**
+ * Calculate the layout t of an S-tree over n keys. Returns the number of keys
+ * the tree array needs.
+ *
+ * Complexity: O(log n)
+ */
+static inline size_t stree_init(struct stree *t, size_t n)
+{
+    size_t m = n, off = 0;
+    unsigned h = 0;
+
+    t->n = n;
+    for (;;) {
+        t->offset[h++] = off;
+        off += (m + STREE_B - 1) / STREE_B * STREE_B;
+        if (m <= STREE_B) {
+            break;
+        }
+        /* One separator for all but the first child of every parent node */
+        m = ((m + STREE_B - 1) / STREE_B + STREE_B) / (STREE_B + 1) * STREE_B;
+    }
+    t->height = h;
+    t->offset[h] = off;
+    return off;
+}
+
+/**
+ * Calculate the position of the leaf layer key the separator at position g
+ * (in layer h > 0) of an S-tree is a copy of: the first key of the leftmost
+ * leaf below the child to the right of the separator.
+ *
+ * Complexity: O(h)
+ */
+static inline size_t stree_source(const struct stree *t, unsigned h, size_t g)
+{
+    size_t i = g - t->offset[h];
+    size_t k = i / STREE_B * (STREE_B + 1) + i % STREE_B + 1;
+    unsigned l;
+
+    for (l = 1; l < h; ++l) {
+        k *= STREE_B + 1;
+    }
+    return k * STREE_B;
+}
+
+/**
+ * Fill the entries [begin; end) of the S-tree tree with the layout t (see
+ * stree_init) from the t->n sorted keys; end must not exceed the size returned
+ * by stree_init. Padding keys are set to UINT32_MAX.
+ * Aligning tree to 64 bytes makes every node a single cache line.
+ *
+ * Complexity: O((end - begin) * t->height)
+ */
+static inline void stree_build_32(const struct stree *t, const uint32_t *sorted, uint32_t *tree,
+                                  size_t begin, size_t end)
+{
+    unsigned h = 0;
+    size_t g;
+
+    for (g = begin; g < end; ++g) {
+        size_t src;
+        while (g >= t->offset[h + 1]) {
+            ++h;
+        }
+        src = h == 0 ? g : stree_source(t, h, g);
+        tree[g] = src < t->n ? sorted[src] : UINT32_MAX;
+    }
+}
+
+/**
+ * Fill the entries [begin; end) of the S-tree tree with the layout t from the
+ * t->n sorted keys. Padding keys are set to UINT64_MAX. See stree_build_32.
+ *
+ * Complexity: O((end - begin) * t->height)
+ */
+static inline void stree_build_64(const struct stree *t, const uint64_t *sorted, uint64_t *tree,
+                                  size_t begin, size_t end)
+{
+    unsigned h = 0;
+    size_t g;
+
+    for (g = begin; g < end; ++g) {
+        size_t src;
+        while (g >= t->offset[h + 1]) {
+            ++h;
+        }
+        src = h == 0 ? g : stree_source(t, h, g);
+        tree[g] = src < t->n ? sorted[src] : UINT64_MAX;
+    }
+}
+
+/**
+ * Count the keys of an S-tree node that are less than x.
+ *
+ * Complexity: 16 compare, 16 add/subs
+ */
+static inline size_t stree_rank_32(const uint32_t *node, uint32_t x)
+{
+    size_t r = 0, i;
+
+    for (i = 0; i < STREE_B; ++i) {
+        r += node[i] < x;
+    }
+    return r;
+}
+
+/**
+ * Count the keys of an S-tree node that are less than x.
+ *
+ * Complexity: 16 compare, 16 add/subs
+ */
+static inline size_t stree_rank_64(const uint64_t *node, uint64_t x)
+{
+    size_t r = 0, i;
+
+    for (i = 0; i < STREE_B; ++i) {
+        r += node[i] < x;
+    }
+    return r;
+}
+
+/**
+ * Find the position of the first of the t->n sorted keys that is not less than
+ * x, or t->n if there is none, in the S-tree tree. Every layer costs one node
+ * of branch-free comparisons.
+ *
+ * Complexity: t->height times stree_rank_32
+ */
+static inline size_t stree_lower_bound_32(const struct stree *t, const uint32_t *tree, uint32_t x)
+{
+    size_t k = 0, pos;
+    unsigned h;
+
+    if (t->n == 0) {
+        return 0;
+    }
+    for (h = t->height - 1; h > 0; --h) {
+        k = k * (STREE_B + 1) + stree_rank_32(tree + t->offset[h] + k * STREE_B, x);
+    }
+    pos = k * STREE_B + stree_rank_32(tree + k * STREE_B, x);
+    return pos < t->n ? pos : t->n;
+}
+
+/**
+ * Find the position of the first of the t->n sorted keys that is not less than
+ * x, or t->n if there is none, in the S-tree tree. See stree_lower_bound_32.
+ *
+ * Complexity: t->height times stree_rank_64
+ */
+static inline size_t stree_lower_bound_64(const struct stree *t, const uint64_t *tree, uint64_t x)
+{
+    size_t k = 0, pos;
+    unsigned h;
+
+    if (t->n == 0) {
+        return 0;
+    }
+    for (h = t->height - 1; h > 0; --h) {
+        k = k * (STREE_B + 1) + stree_rank_64(tree + t->offset[h] + k * STREE_B, x);
+    }
+    pos = k * STREE_B + stree_rank_64(tree + k * STREE_B, x);
+    return pos < t->n ? pos : t->n;
+}
+
+/**
+ * Find the lower bounds of the m keys xs in the S-tree tree, writing them to
+ * out. Groups of SEARCH_BATCH queries descend the layers in lockstep, and the
+ * node every query visits next is prefetched, so the cache misses overlap.
+ *
+ * Complexity: m times stree_lower_bound_32
+ */
+static inline void stree_lower_bound_bulk_32(const struct stree *t, const uint32_t *tree,
+                                             const uint32_t *xs, size_t m, size_t *out)
+{
+    size_t k[SEARCH_BATCH], b, q, cnt;
+    unsigned h;
+
+    for (b = 0; b < m; b += SEARCH_BATCH) {
+        cnt = m - b < SEARCH_BATCH ? m - b : SEARCH_BATCH;
+        if (t->n == 0) {
+            for (q = 0; q < cnt; ++q) {
+                out[b + q] = 0;
+            }
+            continue;
+        }
+        for (q = 0; q < cnt; ++q) {
+            k[q] = 0;
+        }
+        for (h = t->height - 1; h > 0; --h) {
+            for (q = 0; q < cnt; ++q) {
+                k[q] = k[q] * (STREE_B + 1) +
+                       stree_rank_32(tree + t->offset[h] + k[q] * STREE_B, xs[b + q]);
+                SEARCH_PREFETCH(tree + t->offset[h - 1] + k[q] * STREE_B);
+            }
+        }
+        for (q = 0; q < cnt; ++q) {
+            size_t pos = k[q] * STREE_B + stree_rank_32(tree + k[q] * STREE_B, xs[b + q]);
+            out[b + q] = pos < t->n ? pos : t->n;
+        }
+    }
+}
+
+/**
+ * Find the lower bounds of the m keys xs in the S-tree tree, writing them to
+ * out. See stree_lower_bound_bulk_32.
+ *
+ * Complexity: m times stree_lower_bound_64
+ */
+static inline void stree_lower_bound_bulk_64(const struct stree *t, const uint64_t *tree,
+                                             const uint64_t *xs, size_t m, size_t *out)
+{
+    size_t k[SEARCH_BATCH], b, q, cnt;
+    unsigned h;
+
+    for (b = 0; b < m; b += SEARCH_BATCH) {
+        cnt = m - b < SEARCH_BATCH ? m - b : SEARCH_BATCH;
+        if (t->n == 0) {
+            for (q = 0; q < cnt; ++q) {
+                out[b + q] = 0;
+            }
+            continue;
+        }
+        for (q = 0; q < cnt; ++q) {
+            k[q] = 0;
+        }
+        for (h = t->height - 1; h > 0; --h) {
+            for (q = 0; q < cnt; ++q) {
+                k[q] = k[q] * (STREE_B + 1) +
+                       stree_rank_64(tree + t->offset[h] + k[q] * STREE_B, xs[b + q]);
+                SEARCH_PREFETCH(tree + t->offset[h - 1] + k[q] * STREE_B);
+            }
+        }
+        for (q = 0; q < cnt; ++q) {
+            size_t pos = k[q] * STREE_B + stree_rank_64(tree + k[q] * STREE_B, xs[b + q]);
+            out[b + q] = pos < t->n ? pos : t->n;
+        }
+    }
+}
+
+/**
+ * Find the positions [*first; *first + count) of the keys inside [lo; hi] among
+ * the sorted keys of the S-tree tree. Returns count.
+ *
+ * Complexity: 2 times stree_lower_bound_32
+ */
+static inline size_t stree_range_32(const struct stree *t, const uint32_t *tree,
+                                    uint32_t lo, uint32_t hi, size_t *first)
+{
+    size_t a = stree_lower_bound_32(t, tree, lo);
+    size_t b = hi == UINT32_MAX ? t->n : stree_lower_bound_32(t, tree, hi + 1);
+
+    *first = a;
+    return b > a ? b - a : 0;
+}
+
+/**
+ * Find the positions [*first; *first + count) of the keys inside [lo; hi] among
+ * the sorted keys of the S-tree tree. Returns count.
+ *
+ * Complexity: 2 times stree_lower_bound_64
+ */
+static inline size_t stree_range_64(const struct stree *t, const uint64_t *tree,
+                                    uint64_t lo, uint64_t hi, size_t *first)
+{
+    size_t a = stree_lower_bound_64(t, tree, lo);
+    size_t b = hi == UINT64_MAX ? t->n : stree_lower_bound_64(t, tree, hi + 1);
+
+    *first = a;
+    return b > a ? b - a : 0;
+}
+
+#endif //BITLIB_SEARCH_H
@@ -12,6 +12,7 @@
 #define BITLIB_SHIFT_H
 
 #include <stdint.h>
+#include "profile.h"
 
 /**
  * Shifts the lower 4 bits of x such that they take up the odd positions of the
@@ -85,6 +86,8 @@ static inline uint64_t scatter_64(uint64_t x)
 static inline uint8_t merge_8(uint8_t x, uint8_t y)
 {
     uint16_t m = (uint16_t)x | ((uint16_t)y << 8);
+
+    PROFILE_CALL(merge_8, x | y, ((x | y) >> 4) != 0);
     m = scatter_16(m);
     return m | (m >> 7);
 }
@@ -101,6 +104,7 @@ static inline uint8_t merge_8(uint8_t x, uint8_t y)
  */
 static inline uint8_t merge_nwe_8(uint8_t x, uint8_t y)
 {
+    PROFILE_CALL(merge_nwe_8, x | y, ((x | y) >> 4) != 0);
     x = scatter_8(x);
     y = scatter_8(y);
     return x | (y << 1);
@@ -116,6 +120,8 @@ static inline uint8_t merge_nwe_8(uint8_t x, uint8_t y)
 static inline uint16_t merge_16(uint16_t x, uint16_t y)
 {
     uint32_t m = (uint32_t)x | ((uint32_t)y << 16);
+
+    PROFILE_CALL(merge_16, x | y, ((x | y) >> 8) != 0);
     m = scatter_32(m);
     return m | (m >> 15);
 }
@@ -132,6 +138,7 @@ static inline uint16_t merge_16(uint16_t x, uint16_t y)
  */
 static inline uint16_t merge_nwe_16(uint16_t x, uint16_t y)
 {
+    PROFILE_CALL(merge_nwe_16, x | y, ((x | y) >> 8) != 0);
     x = scatter_16(x);
     y = scatter_16(y);
     return x | (y << 1);
@@ -147,6 +154,8 @@ static inline uint16_t merge_nwe_16(uint16_t x, uint16_t y)
 static inline uint32_t merge_32(uint32_t x, uint32_t y)
 {
     uint64_t m = (uint64_t)x | ((uint64_t)y << 32);
+
+    PROFILE_CALL(merge_32, x | y, ((x | y) >> 16) != 0);
     m = scatter_64(m);
     return m | (m >> 31);
 }
@@ -163,6 +172,7 @@ static inline uint32_t merge_32(uint32_t x, uint32_t y)
  */
 static inline uint32_t merge_nwe_32(uint32_t x, uint32_t y)
 {
+    PROFILE_CALL(merge_nwe_32, x | y, ((x | y) >> 16) != 0);
     x = scatter_32(x);
     y = scatter_32(y);
     return x | (y << 1);
@@ -177,6 +187,7 @@ static inline uint32_t merge_nwe_32(uint32_t x, uint32_t y)
  */
 static inline uint64_t merge_64(uint64_t x, uint64_t y)
 {
+    PROFILE_CALL(merge_64, x | y, ((x | y) >> 32) != 0);
     x = scatter_64(x);
     y = scatter_64(y);
     return x | (y << 1);
@@ -249,6 +260,8 @@ static inline uint64_t gather_64(uint64_t x)
 static inline void separate_8(uint8_t n, uint8_t *x, uint8_t *y)
 {
     uint16_t m = ((uint16_t) n | ((uint16_t) n << 7)) & 0x5555;
+
+    PROFILE_CALL(separate_8, n, 0);
     m = gather_16(m);
     *x = m & 0x0f;
     *y = m >> 4;
@@ -265,6 +278,7 @@ static inline void separate_8(uint8_t n, uint8_t *x, uint8_t *y)
  */
 static inline void separate_nwe_8(uint8_t n, uint8_t *x, uint8_t *y)
 {
+    PROFILE_CALL(separate_nwe_8, n, 0);
     *x = gather_8(n & 0x55);
     *y = gather_8((n & 0xaa) >> 1);
 }
@@ -278,6 +292,8 @@ static inline void separate_nwe_8(uint8_t n, uint8_t *x, uint8_t *y)
 static inline void separate_16(uint16_t n, uint16_t *x, uint16_t *y)
 {
     uint32_t m = ((uint32_t) n | ((uint32_t) n << 15)) & 0x55555555;
+
+    PROFILE_CALL(separate_16, n, 0);
     m = gather_32(m);
     *x = m & 0x00ff;
     *y = m >> 8;
@@ -293,6 +309,7 @@ static inline void separate_16(uint16_t n, uint16_t *x, uint16_t *y)
  */
 static inline void separate_nwe_16(uint16_t n, uint16_t *x, uint16_t *y)
 {
+    PROFILE_CALL(separate_nwe_16, n, 0);
     *x = gather_16(n & 0x5555);
     *y = gather_16((n & 0xaaaa) >> 1);
 }
@@ -306,6 +323,8 @@ static inline void separate_nwe_16(uint16_t n, uint16_t *x, uint16_t *y)
 static inline void separate_32(uint32_t n, uint32_t *x, uint32_t *y)
 {
     uint64_t m = ((uint64_t) n | ((uint64_t) n << 31)) & 0x5555555555555555;
+
+    PROFILE_CALL(separate_32, n, 0);
     m = gather_64(m);
     *x = m & 0x0000ffff;
     *y = m >> 16;
@@ -319,6 +338,7 @@ static inline void separate_32(uint32_t n, uint32_t *x, uint32_t *y)
  */
 static inline void separate_nwe_32(uint32_t n, uint32_t *x, uint32_t *y)
 {
+    PROFILE_CALL(separate_nwe_32, n, 0);
     *x = gather_32(n & 0x55555555);
     *y = gather_32((n & 0xaaaaaaaa) >> 1);
 }
@@ -330,6 +350,7 @@ static inline void separate_nwe_32(uint32_t n, uint32_t *x, uint32_t *y)
  */
 static inline void separate_64(uint64_t n, uint64_t *x, uint64_t *y)
 {
+    PROFILE_CALL(separate_64, n, 0);
     *x = gather_64(n & 0x5555555555555555);
     *y = gather_64((n & 0xaaaaaaaaaaaaaaaa) >> 1);
 }
@@ -402,9 +423,10 @@ static inline uint64_t scatter3_64(uint64_t x)
  */
 static inline uint8_t merge3_8(uint8_t x, uint8_t y, uint8_t z)
 {
+    PROFILE_CALL(merge3_8, x | y | z, (x >> 3 | y >> 3 | z >> 2) != 0);
     x = scatter3_8(x);
     y = scatter3_8(y);
-    z = (z | (z << 4)) & 0xc7;
+    z = (z | (z << 2)) & 0x09;
 
     return x | (y << 1) | (z << 2);
 }
@@ -422,6 +444,7 @@ static inline uint8_t merge3_8(uint8_t x, uint8_t y, uint8_t z)
  */
 static inline uint16_t merge3_16(uint16_t x, uint16_t y, uint16_t z)
 {
+    PROFILE_CALL(merge3_16, x | y | z, (x >> 6 | y >> 5 | z >> 5) != 0);
     x = scatter3_16(x);
     y = scatter3_16(y);
     z = scatter3_16(z);
@@ -439,6 +462,7 @@ static inline uint16_t merge3_16(uint16_t x, uint16_t y, uint16_t z)
  */
 static inline uint32_t merge3_32(uint32_t x, uint32_t y, uint32_t z)
 {
+    PROFILE_CALL(merge3_32, x | y | z, (x >> 11 | y >> 11 | z >> 10) != 0);
     x = scatter3_32(x);
     y = scatter3_32(y);
     z = scatter3_32(z);
@@ -456,6 +480,7 @@ static inline uint32_t merge3_32(uint32_t x, uint32_t y, uint32_t z)
  */
 static inline uint64_t merge3_64(uint64_t x, uint64_t y, uint64_t z)
 {
+    PROFILE_CALL(merge3_64, x | y | z, (x >> 22 | y >> 21 | z >> 21) != 0);
     x = scatter3_64(x);
     y = scatter3_64(y);
     z = scatter3_64(z);
@@ -530,6 +555,7 @@ static inline uint64_t gather3_64(uint64_t x)
  */
 static inline void separate3_8(uint8_t n, uint8_t *x, uint8_t *y, uint8_t *z)
 {
+    PROFILE_CALL(separate3_8, n, 0);
     *x = gather3_8(n & 0x49);
     *y = gather3_8((n >> 1) & 0x49);
     *z = gather3_8((n >> 2) & 0x49);
@@ -543,6 +569,7 @@ static inline void separate3_8(uint8_t n, uint8_t *x, uint8_t *y, uint8_t *z)
  */
 static inline void separate3_16(uint16_t n, uint16_t *x, uint16_t *y, uint16_t *z)
 {
+    PROFILE_CALL(separate3_16, n, 0);
     *x = gather3_16(n & 0x9249);
     *y = gather3_16((n >> 1) & 0x9249);
     *z = gather3_16((n >> 2) & 0x9249);
@@ -556,6 +583,7 @@ static inline void separate3_16(uint16_t n, uint16_t *x, uint16_t *y, uint16_t *
  */
 static inline void separate3_32(uint32_t n, uint32_t *x, uint32_t *y, uint32_t *z)
 {
+    PROFILE_CALL(separate3_32, n, 0);
     *x = gather3_32(n & 0x49249249);
     *y = gather3_32((n >> 1) & 0x49249249);
     *z = gather3_32((n >> 2) & 0x49249249);
@@ -569,9 +597,17 @@ static inline void separate3_32(uint32_t n, uint32_t *x, uint32_t *y, uint32_t *
  */
 static inline void separate3_64(uint64_t n, uint64_t *x, uint64_t *y, uint64_t *z)
 {
+    PROFILE_CALL(separate3_64, n, 0);
     *x = gather3_64(n & 0x9249249249249249);
     *y = gather3_64((n >> 1) & 0x9249249249249249);
     *z = gather3_64((n >> 2) & 0x9249249249249249);
 }
 
+/* Let a header written by bitlib_tune remap the unflavored names above to the
+ * fastest flavors on the build machine */
+#define BITLIB_SHIFT_DONE
+#ifdef BITLIB_TUNED
+#include BITLIB_TUNED
+#endif
+
 #endif
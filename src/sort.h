@@ -0,0 +1,119 @@
+/**
+ * Radix sorting of 64 bit keys (e.g. Morton codes) with 32 bit payloads (e.g.
+ * row or point indices). The sort is a stable LSD radix sort with 8 bit digits
+ * that skips digits in which all keys agree, so keys that only use their
+ * lowest bits cost fewer passes. All buffers are provided by the caller.
+ *
+ * Function families in this file:
+ * radixsort: sort keys with payloads by their lowest bits
+ * radixsort_split: partition by the top digit for independent bucket sorts
+ */
+
+#ifndef BITLIB_SORT_H
+#define BITLIB_SORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Scatter the n keys and values into tk and tv, ordered stably by the 8 bit
+ * digit at the given shift. count holds the 256 digit counts on entry and is
+ * overwritten with the bucket offsets.
+ *
+ * Complexity: O(n)
+ */
+static inline void radix_scatter_64(const uint64_t *keys, const uint32_t *vals, size_t n,
+                                    uint64_t *tk, uint32_t *tv, unsigned shift, size_t *count)
+{
+    size_t i, sum = 0, c;
+
+    for (i = 0; i < 256; ++i) {
+        c = count[i];
+        count[i] = sum;
+        sum += c;
+    }
+    for (i = 0; i < n; ++i) {
+        size_t d = count[(keys[i] >> shift) & 0xff]++;
+        tk[d] = keys[i];
+        tv[d] = vals[i];
+    }
+}
+
+/**
+ * Sort the n keys and their values in place by the lowest bits of the keys,
+ * which is rounded up to a multiple of 8. Higher bits are ignored; keys that
+ * only differ there keep their order. tk and tv are scratch buffers of n
+ * elements. The result is stable.
+ *
+ * All digit histograms are counted in a single read pass, and digits in which
+ * every key agrees are skipped.
+ *
+ * Complexity: O(n * bits / 8)
+ */
+static inline void radixsort_64(uint64_t *keys, uint32_t *vals, size_t n,
+                                uint64_t *tk, uint32_t *tv, unsigned bits)
+{
+    size_t count[8][256] = {{0}};
+    unsigned digits = (bits + 7) / 8, d;
+    size_t i;
+    int swapped = 0;
+
+    if (digits > 8) {
+        digits = 8;
+    }
+    for (i = 0; i < n; ++i) {
+        uint64_t k = keys[i];
+        for (d = 0; d < digits; ++d) {
+            ++count[d][(k >> (8 * d)) & 0xff];
+        }
+    }
+
+    for (d = 0; d < digits; ++d) {
+        uint64_t *sk = swapped ? tk : keys, *dk = swapped ? keys : tk;
+        uint32_t *sv = swapped ? tv : vals, *dv = swapped ? vals : tv;
+
+        if (n == 0 || count[d][(sk[0] >> (8 * d)) & 0xff] == n) {
+            continue;
+        }
+        radix_scatter_64(sk, sv, n, dk, dv, 8 * d, count[d]);
+        swapped = !swapped;
+    }
+
+    if (swapped) {
+        for (i = 0; i < n; ++i) {
+            keys[i] = tk[i];
+            vals[i] = tv[i];
+        }
+    }
+}
+
+/**
+ * Partition the n keys and values into tk and tv by the top digit of their
+ * lowest bits (bits must be a multiple of 8, at least 8). bounds receives the
+ * 257 bucket boundaries: bucket b occupies [bounds[b]; bounds[b + 1]).
+ *
+ * This is the first pass of a parallel sort. Afterwards the buckets are
+ * independent and can be finished by separate threads with
+ * radixsort_64(tk + bounds[b], tv + bounds[b], bounds[b + 1] - bounds[b],
+ * keys + bounds[b], vals + bounds[b], bits - 8), which leaves the fully sorted
+ * data in tk and tv. radixsort_ex_64 in bulk.h sorts this way on an executor.
+ *
+ * Complexity: O(n)
+ */
+static inline void radixsort_split_64(const uint64_t *keys, const uint32_t *vals, size_t n,
+                                      uint64_t *tk, uint32_t *tv, unsigned bits, size_t *bounds)
+{
+    unsigned shift = bits - 8;
+    size_t i;
+
+    for (i = 0; i < 257; ++i) {
+        bounds[i] = 0;
+    }
+    for (i = 0; i < n; ++i) {
+        ++bounds[((keys[i] >> shift) & 0xff) + 1];
+    }
+    /* The counts in bounds + 1 turn into the bucket ends, i.e. the next starts. */
+    radix_scatter_64(keys, vals, n, tk, tv, shift, bounds + 1);
+}
+
+#endif //BITLIB_SORT_H
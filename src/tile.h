@@ -0,0 +1,257 @@
+/**
+ * Tools for scheduling the tiles of a 2D or 3D iteration space (e.g. the tile
+ * pairs of an all-pairs computation or a tiled matrix product) along a
+ * space-filling curve, so that consecutively processed tiles share operands in
+ * cache.
+ *
+ * The grid is embedded into the smallest enclosing power of two square (cube),
+ * and the curve positions of that square are cut into contiguous segments.
+ * Segments are the unit of work, and every worker enumerates the in-range
+ * tiles of its segments with ztile_segment. This file has no scheduler of its
+ * own: run a task over the segment indices with exec_for on an exec_pool (see
+ * exec.h), which hands out chunks of segments in order and lets idle threads
+ * steal, or use any other dynamic schedule. Curve positions outside of a
+ * rectangular grid are skipped with BIGMIN in Z-order and by whole aligned
+ * subquadrants along the Hilbert curve, instead of being tested one by one.
+ *
+ * 3D grids are traversed in Z-order only: there is no 3D Hilbert curve in the
+ * library, and no triangular mode for 3D iteration spaces.
+ *
+ * Function families in this file:
+ * ztile_span, ztile3_span: number of curve positions covering a grid
+ * ztile_segment: enumerate the tiles of a 2D curve segment
+ * ztile3_segment: enumerate the tiles of a 3D curve segment
+ */
+
+#ifndef BITLIB_TILE_H
+#define BITLIB_TILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton.h"
+#include "compare.h"
+#include "cursor.h"
+#include "hilbert.h"
+
+/**
+ * Traverse the grid in Z-order.
+ */
+#define ZTILE_MORTON 0
+
+/**
+ * Traverse the grid along the Hilbert curve.
+ */
+#define ZTILE_HILBERT 1
+
+/**
+ * Flag to combine with either order: only visit tiles (i; j) with j >= i.
+ */
+#define ZTILE_TRIANGULAR 2
+
+/**
+ * Calculate the number of bits per axis of the power of two square that
+ * encloses n tiles.
+ *
+ * Complexity: 1 bit op, 1 compare, 1 branch per bit
+ */
+static inline unsigned ztile_order(uint64_t n)
+{
+    unsigned order = 0;
+
+    while (((uint64_t)1 << order) < n) {
+        ++order;
+    }
+    return order;
+}
+
+/**
+ * Calculate the number of curve positions covering a grid of nx x ny tiles.
+ * Every position in [0; span) belongs to exactly one segment. nx and ny must
+ * not exceed 2^31.
+ *
+ * Complexity: 2 times ztile_order
+ */
+static inline uint64_t ztile_span_64(uint32_t nx, uint32_t ny)
+{
+    unsigned order = ztile_order(nx > ny ? nx : ny);
+    return (uint64_t)1 << (2 * order);
+}
+
+/**
+ * Calculate the number of curve positions covering a grid of nx x ny x nz
+ * tiles. nx, ny and nz must not exceed 2^21.
+ *
+ * Complexity: 3 times ztile_order
+ */
+static inline uint64_t ztile3_span_64(uint32_t nx, uint32_t ny, uint32_t nz)
+{
+    uint32_t n = nx > ny ? nx : ny;
+    unsigned order = ztile_order(n > nz ? n : nz);
+    return (uint64_t)1 << (3 * order);
+}
+
+/**
+ * Find the size of the largest aligned quadrant starting at Morton code m
+ * (with coordinates (x; y)) that lies entirely below the diagonal (y < x).
+ * Returns 0 if (x; y) itself is on or above the diagonal.
+ *
+ * Complexity: 6 bit ops, 3 add/subs, 3 compare, 2 branch per level
+ */
+static inline uint64_t ztile_below_64(uint64_t m, uint64_t x, uint64_t y)
+{
+    unsigned l = 0;
+
+    if (y >= x) {
+        return 0;
+    }
+    while (l < 31 && (m & (((uint64_t)4 << (2 * l)) - 1)) == 0 &&
+           y + ((uint64_t)2 << l) - 1 < x) {
+        ++l;
+    }
+    return (uint64_t)1 << (2 * l);
+}
+
+/**
+ * Find the number of positions of the largest aligned Hilbert curve block that
+ * starts at position m, with first tile (x; y), and holds no tile of an nx x ny
+ * grid, or in triangular mode only tiles below the diagonal. An aligned block
+ * of 4^l positions covers an aligned square of 2^l x 2^l tiles, so the test
+ * looks at the corner of the square alone. (x; y) must be out of range itself.
+ *
+ * Complexity: 8 bit ops, 4 add/subs, 5 compare, 1 branch per level
+ */
+static inline uint64_t ztile_hilbert_skip_64(uint64_t m, uint64_t x, uint64_t y, uint32_t nx,
+                                             uint32_t ny, int tri, unsigned order)
+{
+    unsigned l = 0;
+
+    while (l < order && (m & (((uint64_t)4 << (2 * l)) - 1)) == 0) {
+        uint64_t s = (uint64_t)2 << l, x0 = x & ~(s - 1), y0 = y & ~(s - 1);
+        if (x0 < nx && y0 < ny && (!tri || y0 + s - 1 >= x0)) {
+            break;
+        }
+        ++l;
+    }
+    return (uint64_t)1 << (2 * l);
+}
+
+/**
+ * Enumerate the tiles of an nx x ny grid whose curve positions lie in
+ * [begin; end), in curve order. The tile coordinates are written to ti and tj,
+ * which must have room for end - begin values. Returns the number of tiles
+ * written. mode is ZTILE_MORTON or ZTILE_HILBERT, optionally combined with
+ * ZTILE_TRIANGULAR.
+ *
+ * In Morton order, the coordinates are tracked with mortonnext_64 while the
+ * codes are consecutive, out-of-range runs are skipped with mortonbigmin_64,
+ * and aligned quadrants below the diagonal are skipped as a whole in triangular
+ * mode. In Hilbert order, in-range positions are decoded with invhilbert_64
+ * one by one, and out-of-range ones are skipped by the largest aligned block
+ * of the curve that holds no tile (see ztile_hilbert_skip_64).
+ *
+ * Complexity: O(t + s * 64) where t is the number of in-range positions and s
+ * the number of skipped runs or blocks
+ */
+static inline size_t ztile_segment_64(uint64_t begin, uint64_t end, uint32_t nx, uint32_t ny,
+                                      unsigned mode, uint32_t *ti, uint32_t *tj)
+{
+    unsigned order = ztile_order(nx > ny ? nx : ny);
+    int tri = (mode & ZTILE_TRIANGULAR) != 0;
+    uint64_t m = begin, x, y, lo, hi, skip;
+    size_t count = 0;
+
+    if (nx == 0 || ny == 0 || begin >= end) {
+        return 0;
+    }
+
+    if (mode & ZTILE_HILBERT) {
+        while (m < end) {
+            invhilbert_64(m, order, &x, &y);
+            if (x < nx && y < ny && (!tri || y >= x)) {
+                ti[count] = (uint32_t)x;
+                tj[count] = (uint32_t)y;
+                ++count;
+                ++m;
+            } else {
+                m += ztile_hilbert_skip_64(m, x, y, nx, ny, tri, order);
+            }
+        }
+        return count;
+    }
+
+    lo = 0;
+    hi = morton_64((uint64_t)nx - 1, (uint64_t)ny - 1);
+    invmorton_64(m, &x, &y);
+    while (m < end) {
+        if (!morton_in_box_64(m, lo, hi)) {
+            m = mortonbigmin_64(m, lo, hi);
+            if (m == 0 || m >= end) {
+                break;
+            }
+            invmorton_64(m, &x, &y);
+            continue;
+        }
+        if (tri && (skip = ztile_below_64(m, x, y)) != 0) {
+            m += skip;
+            if (m < skip || m >= end) {
+                break;
+            }
+            invmorton_64(m, &x, &y);
+            continue;
+        }
+        ti[count] = (uint32_t)x;
+        tj[count] = (uint32_t)y;
+        ++count;
+        if (m + 1 >= end) {
+            break;
+        }
+        m = mortonnext_64(m, &x, &y);
+    }
+    return count;
+}
+
+/**
+ * Enumerate the tiles of an nx x ny x nz grid whose Morton codes lie in
+ * [begin; end), in Z-order. The tile coordinates are written to ti, tj and tk,
+ * which must have room for end - begin values. Returns the number of tiles
+ * written. See ztile_segment_64.
+ *
+ * Complexity: O(t + s * 64) where t is the number of codes visited and s the
+ * number of skipped runs
+ */
+static inline size_t ztile3_segment_64(uint64_t begin, uint64_t end,
+                                       uint32_t nx, uint32_t ny, uint32_t nz,
+                                       uint32_t *ti, uint32_t *tj, uint32_t *tk)
+{
+    uint64_t m = begin, x, y, z, lo, hi;
+    size_t count = 0;
+
+    if (nx == 0 || ny == 0 || nz == 0 || begin >= end) {
+        return 0;
+    }
+
+    lo = 0;
+    hi = morton3_64((uint64_t)nx - 1, (uint64_t)ny - 1, (uint64_t)nz - 1);
+    invmorton3_64(m, &x, &y, &z);
+    while (m < end) {
+        if (!morton3_in_box_64(m, lo, hi)) {
+            m = mortonbigmin3_64(m, lo, hi);
+            if (m == 0 || m >= end) {
+                break;
+            }
+            invmorton3_64(m, &x, &y, &z);
+            continue;
+        }
+        ti[count] = (uint32_t)x;
+        tj[count] = (uint32_t)y;
+        tk[count] = (uint32_t)z;
+        ++count;
+        if (m + 1 >= end) {
+            break;
+        }
+        m = mortonnext3_64(m, &x, &y, &z);
+    }
+    return count;
+}
+
+#endif //BITLIB_TILE_H
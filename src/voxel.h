@@ -0,0 +1,236 @@
+/**
+ * Tools for voxel grid filtering of point clouds: keeping one representative
+ * per occupied voxel. Every point gets the 3D Morton code of its voxel index as
+ * a key, the keys are radix sorted along with the point indices, and every run
+ * of equal keys is reduced to its representative. Since Morton codes of coarser
+ * grids are prefixes of the finer ones, the same sorted keys yield the voxels
+ * of every coarser level (voxel size times a power of 2) by comparing the keys
+ * shifted right by a multiple of 3.
+ *
+ * The points are given as separate x, y and z arrays (structure of arrays).
+ * All steps work on independent ranges: keys on ranges of points, the sort by
+ * radixsort_split_64 buckets and the reductions on ranges of runs, so they can
+ * be split between threads; voxel_downsample_ex_64 in bulk.h runs the filter
+ * this way on an executor.
+ *
+ * Function families in this file:
+ * voxel_keys: Morton keys of the voxels of points
+ * voxel_runs: boundaries of the runs of sorted keys at a level
+ * voxel_first, voxel_centroid, voxel_medoid: representatives of runs
+ * voxel_average: average of an attribute column per run
+ * voxel_downsample: the whole filter in one call
+ */
+
+#ifndef BITLIB_VOXEL_H
+#define BITLIB_VOXEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton.h"
+#include "sort.h"
+
+/**
+ * Representative modes of voxel_downsample_64
+ */
+#define VOXEL_FIRST 0
+#define VOXEL_CENTROID 1
+#define VOXEL_MEDOID 2
+
+/**
+ * Calculate the voxel index of coordinate v along an axis starting at origin,
+ * clamped to 21 bits. NaN gives index 0.
+ *
+ * Complexity: 1 add/subs, 1 multiply, 2 compare
+ */
+static inline uint64_t voxel_index(float v, float origin, float inv)
+{
+    float q = (v - origin) * inv;
+
+    /* Written so that NaN fails the first test, since converting it is undefined */
+    return !(q >= 0.0f) ? 0 : q >= 2097151.0f ? 2097151 : (uint64_t)q;
+}
+
+/**
+ * Calculate the keys of the n points (x[i]; y[i]; z[i]): the 3D Morton codes of
+ * their voxel indices for voxels of the given size with a corner at origin.
+ * Coordinates below the origin or beyond 2^21 voxels are clamped, and NaN
+ * coordinates go to voxel index 0. idx receives
+ * the point indices, ready to be sorted along with the keys by
+ * radixsort_64(keys, idx, n, tk, tv, 63).
+ *
+ * Complexity: n times 3 voxel_index and morton3_64
+ */
+static inline void voxel_keys_64(const float *x, const float *y, const float *z, size_t n,
+                                 const float *origin, float size, uint64_t *keys, uint32_t *idx)
+{
+    float inv = 1.0f / size;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        keys[i] = morton3_64(voxel_index(x[i], origin[0], inv),
+                             voxel_index(y[i], origin[1], inv),
+                             voxel_index(z[i], origin[2], inv));
+        idx[i] = (uint32_t)i;
+    }
+}
+
+/**
+ * Find the runs of the n sorted keys that share a voxel at the given level,
+ * i.e. that agree in all but their lowest 3 * level bits. The start of run r is
+ * written to starts[r] and n to starts[count], so starts needs room for n + 1
+ * values. Returns the number of runs count.
+ *
+ * Complexity: O(n)
+ */
+static inline size_t voxel_runs_64(const uint64_t *keys, size_t n, unsigned level, size_t *starts)
+{
+    unsigned shift = 3 * level;
+    size_t i, count = 0;
+
+    for (i = 0; i < n; ++i) {
+        if (i == 0 || keys[i] >> shift != keys[i - 1] >> shift) {
+            starts[count++] = i;
+        }
+    }
+    starts[count] = n;
+    return count;
+}
+
+/**
+ * Select the first point of each of the count runs given by starts (see
+ * voxel_runs_64), writing its index to out. After the stable radixsort_64, this
+ * is the point of the voxel that came first in the input.
+ *
+ * Complexity: O(count)
+ */
+static inline void voxel_first(const uint32_t *idx, const size_t *starts, size_t count,
+                               uint32_t *out)
+{
+    size_t r;
+
+    for (r = 0; r < count; ++r) {
+        out[r] = idx[starts[r]];
+    }
+}
+
+/**
+ * Average the attribute column col over the points of each of the count runs
+ * given by starts (see voxel_runs_64), writing the averages to out. idx maps
+ * sorted positions to point indices. Coordinates are averaged this way too,
+ * which gives the centroids.
+ *
+ * Complexity: O(starts[count] - starts[0])
+ */
+static inline void voxel_average(const float *col, const uint32_t *idx, const size_t *starts,
+                                 size_t count, float *out)
+{
+    size_t r, i;
+
+    for (r = 0; r < count; ++r) {
+        double sum = 0.0;
+        for (i = starts[r]; i < starts[r + 1]; ++i) {
+            sum += col[idx[i]];
+        }
+        out[r] = (float)(sum / (double)(starts[r + 1] - starts[r]));
+    }
+}
+
+/**
+ * Calculate the centroid of the points of each of the count runs given by
+ * starts, writing it to (cx[r]; cy[r]; cz[r]).
+ *
+ * Complexity: 3 times voxel_average
+ */
+static inline void voxel_centroid(const float *x, const float *y, const float *z,
+                                  const uint32_t *idx, const size_t *starts, size_t count,
+                                  float *cx, float *cy, float *cz)
+{
+    voxel_average(x, idx, starts, count, cx);
+    voxel_average(y, idx, starts, count, cy);
+    voxel_average(z, idx, starts, count, cz);
+}
+
+/**
+ * Select the medoid of each of the count runs given by starts, writing its
+ * point index to out. The medoid is taken as the point closest to the
+ * centroid, which unlike the exact medoid takes linear time; ties go to the
+ * first point.
+ *
+ * Complexity: O(starts[count] - starts[0])
+ */
+static inline void voxel_medoid(const float *x, const float *y, const float *z,
+                                const uint32_t *idx, const size_t *starts, size_t count,
+                                uint32_t *out)
+{
+    size_t r, i;
+
+    for (r = 0; r < count; ++r) {
+        double sx = 0.0, sy = 0.0, sz = 0.0, best = -1.0, n;
+        for (i = starts[r]; i < starts[r + 1]; ++i) {
+            sx += x[idx[i]];
+            sy += y[idx[i]];
+            sz += z[idx[i]];
+        }
+        n = (double)(starts[r + 1] - starts[r]);
+        sx /= n;
+        sy /= n;
+        sz /= n;
+        for (i = starts[r]; i < starts[r + 1]; ++i) {
+            double dx = x[idx[i]] - sx, dy = y[idx[i]] - sy, dz = z[idx[i]] - sz;
+            double d = dx * dx + dy * dy + dz * dz;
+            if (best < 0.0 || d < best) {
+                best = d;
+                out[r] = idx[i];
+            }
+        }
+    }
+}
+
+/**
+ * Reduce the n points (x[i]; y[i]; z[i]) to one per voxel of the given size
+ * with a corner at origin. mode selects the representative: VOXEL_FIRST the
+ * first point in input order, VOXEL_CENTROID the average of the points,
+ * VOXEL_MEDOID the point closest to the average. The representatives are
+ * written to (ox[r]; oy[r]; oz[r]) in Morton order of their voxels, and for
+ * VOXEL_FIRST and VOXEL_MEDOID their point indices to rep (for VOXEL_CENTROID
+ * rep receives the first point of the voxel, e.g. to copy attributes from;
+ * voxel_average gives averaged attributes). Returns the number of voxels.
+ *
+ * keys, idx, tk and tv are scratch buffers of n elements and starts of n + 1.
+ * Afterwards keys and idx hold the sorted keys and point indices and starts
+ * the runs, so coarser levels can be reduced with voxel_runs_64 and the
+ * representative functions without sorting again.
+ *
+ * Complexity: O(n)
+ */
+static inline size_t voxel_downsample_64(const float *x, const float *y, const float *z,
+                                         size_t n, const float *origin, float size, int mode,
+                                         uint64_t *keys, uint32_t *idx, uint64_t *tk,
+                                         uint32_t *tv, size_t *starts,
+                                         float *ox, float *oy, float *oz, uint32_t *rep)
+{
+    size_t count, r;
+
+    voxel_keys_64(x, y, z, n, origin, size, keys, idx);
+    radixsort_64(keys, idx, n, tk, tv, 63);
+    count = voxel_runs_64(keys, n, 0, starts);
+
+    if (mode == VOXEL_CENTROID) {
+        voxel_first(idx, starts, count, rep);
+        voxel_centroid(x, y, z, idx, starts, count, ox, oy, oz);
+        return count;
+    }
+    if (mode == VOXEL_MEDOID) {
+        voxel_medoid(x, y, z, idx, starts, count, rep);
+    } else {
+        voxel_first(idx, starts, count, rep);
+    }
+    for (r = 0; r < count; ++r) {
+        ox[r] = x[rep[r]];
+        oy[r] = y[rep[r]];
+        oz[r] = z[rep[r]];
+    }
+    return count;
+}
+
+#endif //BITLIB_VOXEL_H
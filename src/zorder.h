@@ -0,0 +1,274 @@
+/**
+ * Tools for clustering table rows by several columns at once ("Z-ORDER BY").
+ * Every column value is mapped to an unsigned key with the same sort order,
+ * stretched over a fixed number of bits according to the column's value range
+ * and interleaved with the other columns into a single 64 bit sort key. Rows
+ * sorted by that key are stored in blocks, and per-block min/max zone maps let
+ * range filters on any of the columns skip whole blocks.
+ *
+ * Function families in this file:
+ * zkey_i32, zkey_i64, zkey_f32, zkey_f64, zkey_prefix: order-preserving
+ *     unsigned keys of column values
+ * zkey_minmax: value range of a key column
+ * zkey_bits: number of key bits per column
+ * zkey_range, zkey_range_f64: stretch a key or floating point value over a fixed
+ *     number of bits
+ * zkey_merge: interleave the keys of k columns
+ * zkey_build: build the sort keys of a table
+ * zonemap_build: per-block min/max of a column
+ * zonemap_filter: select the blocks a multi-column range filter has to scan
+ */
+
+#ifndef BITLIB_ZORDER_H
+#define BITLIB_ZORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "shift.h"
+
+/**
+ * Map a signed 32 bit integer to an unsigned key with the same order.
+ *
+ * Complexity: 1 bit op
+ */
+static inline uint32_t zkey_i32(int32_t v)
+{
+    return (uint32_t)v ^ 0x80000000;
+}
+
+/**
+ * Map a signed 64 bit integer to an unsigned key with the same order.
+ *
+ * Complexity: 1 bit op
+ */
+static inline uint64_t zkey_i64(int64_t v)
+{
+    return (uint64_t)v ^ 0x8000000000000000;
+}
+
+/**
+ * Map a float to an unsigned key with the same order. Negative numbers have
+ * all bits flipped, positive ones only the sign bit. NaNs sort above positive
+ * (or below negative) infinity.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+static inline uint32_t zkey_f32(float v)
+{
+    uint32_t b;
+    memcpy(&b, &v, sizeof(b));
+    return b ^ ((0 - (b >> 31)) | 0x80000000);
+}
+
+/**
+ * Map a double to an unsigned key with the same order. See zkey_f32.
+ *
+ * Complexity: 4 bit ops, 1 add/subs
+ */
+static inline uint64_t zkey_f64(double v)
+{
+    uint64_t b;
+    memcpy(&b, &v, sizeof(b));
+    return b ^ ((0 - (b >> 63)) | 0x8000000000000000);
+}
+
+/**
+ * Map the first 4 bytes of the string s of length len to an unsigned key that
+ * orders like the strings (bytewise). Shorter strings are padded with zeros.
+ *
+ * Complexity: 4 bit ops, 4 compare, 4 branch
+ */
+static inline uint32_t zkey_prefix_32(const char *s, size_t len)
+{
+    uint32_t k = 0;
+    size_t i;
+
+    for (i = 0; i < 4; ++i) {
+        k = (k << 8) | (i < len ? (unsigned char)s[i] : 0);
+    }
+    return k;
+}
+
+/**
+ * Find the smallest and largest of the n keys in col.
+ *
+ * Complexity: O(n)
+ */
+static inline void zkey_minmax_32(const uint32_t *col, size_t n, uint32_t *lo, uint32_t *hi)
+{
+    uint32_t mn = UINT32_MAX, mx = 0;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        mn = col[i] < mn ? col[i] : mn;
+        mx = col[i] > mx ? col[i] : mx;
+    }
+    *lo = mn;
+    *hi = mx;
+}
+
+/**
+ * Stretch key v from the range [lo; hi] linearly over [0; 2^bits), keeping its
+ * order. Keys outside of the range are clamped. bits must be at most 32.
+ *
+ * A column whose values only use a narrow part of their type would otherwise
+ * waste most of its share of the interleaved key on constant high bits.
+ *
+ * Complexity: 1 bit op, 3 add/subs, 1 divide, 2 compare
+ */
+static inline uint32_t zkey_range_32(uint32_t v, uint32_t lo, uint32_t hi, unsigned bits)
+{
+    v = v < lo ? lo : v > hi ? hi : v;
+    return (uint32_t)((((uint64_t)(v - lo)) << bits) / ((uint64_t)(hi - lo) + 1));
+}
+
+/**
+ * Stretch the floating point value v from the range [lo; hi] linearly over
+ * [0; 2^bits), keeping its order. Values outside of the range are clamped,
+ * and NaN gives 0. bits must be at most 32 and lo must be less than hi.
+ *
+ * Floating point columns are stretched by value rather than through their
+ * zkey_f32/zkey_f64 keys, since the bit patterns are spaced logarithmically and
+ * would spend most of the available bits on the exponent.
+ *
+ * Complexity: 2 add/subs, 2 multiply, 1 divide, 3 compare
+ */
+static inline uint32_t zkey_range_f64(double v, double lo, double hi, unsigned bits)
+{
+    double scale = (double)((uint64_t)1 << bits);
+    double r = (v - lo) / (hi - lo) * scale;
+    /* Converting NaN to an integer is undefined, so it takes the first branch */
+    return !(r > 0) ? 0 : r >= scale - 1 ? (uint32_t)(scale - 1) : (uint32_t)r;
+}
+
+/**
+ * Calculate the number of bits every one of k columns (1 to 64) contributes to
+ * the interleaved key.
+ *
+ * Complexity: 1 divide, 1 compare
+ */
+static inline unsigned zkey_bits(unsigned k)
+{
+    return 64 / k > 32 ? 32 : 64 / k;
+}
+
+/**
+ * Interleave the keys of k columns (1 to 64) into a single sort key. Every
+ * column contributes its lowest zkey_bits(k) bits, which must hold the whole
+ * key; column 0 takes the most significant position of every group.
+ * 2, 3 and 4 columns use merge_64/merge3_64, other counts fall back to a loop
+ * over the bits.
+ *
+ * Complexity: 32 bit ops (k = 2), 49 bit ops (k = 3), 54 bit ops (k = 4),
+ *     4 * k * (64 / k) bit ops otherwise
+ */
+static inline uint64_t zkey_merge_64(const uint32_t *cols, unsigned k)
+{
+    unsigned bits, b, c;
+    uint64_t key = 0;
+
+    switch (k) {
+    case 1:
+        return cols[0];
+    case 2:
+        return merge_64(cols[1], cols[0]);
+    case 3:
+        return merge3_64(cols[2], cols[1], cols[0]);
+    case 4:
+        return merge_64(merge_32(cols[3], cols[1]), merge_32(cols[2], cols[0]));
+    default:
+        break;
+    }
+    bits = 64 / k;
+    for (b = bits; b-- > 0;) {
+        for (c = 0; c < k; ++c) {
+            key = (key << 1) | ((cols[c] >> b) & 1);
+        }
+    }
+    return key;
+}
+
+/**
+ * Build the sort keys of n rows from k stretched key columns (cols[c][i] is the
+ * key of row i in column c, stretched over zkey_bits(k) bits with zkey_range_32
+ * or zkey_range_f64). The columns are interleaved with zkey_merge_64. k must be
+ * between 1 and 64.
+ *
+ * Rows are independent, so the table can be split between threads;
+ * zkey_build_ex_64 in bulk.h does this on an executor.
+ *
+ * Complexity: O(n * k)
+ */
+static inline void zkey_build_64(const uint32_t *const *cols, unsigned k, size_t n,
+                                 uint64_t *keys)
+{
+    uint32_t row[64];
+    unsigned c;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        for (c = 0; c < k; ++c) {
+            row[c] = cols[c][i];
+        }
+        keys[i] = zkey_merge_64(row, k);
+    }
+}
+
+/**
+ * Calculate the zone map of a column stored in blocks of the given number of
+ * rows: min[b] and max[b] receive the smallest and largest key of block b. rows
+ * lists the row indices in storage order (e.g. the payload of the sorted keys),
+ * or is NULL if col is already in storage order.
+ *
+ * Complexity: O(n)
+ */
+static inline void zonemap_build_32(const uint32_t *col, const uint32_t *rows, size_t n,
+                                    size_t block, uint32_t *min, uint32_t *max)
+{
+    size_t i, b;
+
+    for (b = 0; b * block < n; ++b) {
+        uint32_t mn = UINT32_MAX, mx = 0;
+        size_t end = (b + 1) * block < n ? (b + 1) * block : n;
+        for (i = b * block; i < end; ++i) {
+            uint32_t v = col[rows ? rows[i] : i];
+            mn = v < mn ? v : mn;
+            mx = v > mx ? v : mx;
+        }
+        min[b] = mn;
+        max[b] = mx;
+    }
+}
+
+/**
+ * Select the blocks that may contain rows matching the filter
+ * qlo[c] <= key <= qhi[c] for every column c of k. min[c] and max[c] are the
+ * zone maps of column c (see zonemap_build_32). Bit b % 64 of mask[b / 64] is
+ * set if block b has to be scanned; mask must have room for
+ * (nblocks + 63) / 64 words. Returns the number of blocks to scan.
+ *
+ * Complexity: O(nblocks * k)
+ */
+static inline size_t zonemap_filter_32(const uint32_t *const *min, const uint32_t *const *max,
+                                       unsigned k, size_t nblocks,
+                                       const uint32_t *qlo, const uint32_t *qhi, uint64_t *mask)
+{
+    size_t b, count = 0;
+    unsigned c;
+
+    for (b = 0; b < nblocks; b += 64) {
+        mask[b / 64] = 0;
+    }
+    for (b = 0; b < nblocks; ++b) {
+        int hit = 1;
+        for (c = 0; c < k; ++c) {
+            hit &= (min[c][b] <= qhi[c]) & (max[c][b] >= qlo[c]);
+        }
+        mask[b / 64] |= (uint64_t)hit << (b % 64);
+        count += hit;
+    }
+    return count;
+}
+
+#endif //BITLIB_ZORDER_H
@@ -0,0 +1,144 @@
+#include "bitlib.hpp"
+
+extern "C" {
+#include "common.h"
+}
+
+#include <assert.h>
+
+/* Computed at compile time: the 8 bit values spread out to the odd bits */
+static constexpr auto bitlib_test_spread = [] {
+    std::array<std::uint16_t, 256> t{};
+    for (unsigned i = 0; i < 256; ++i) {
+        t[i] = bitlib::merge<std::uint16_t>(std::uint16_t(i), 0);
+    }
+    return t;
+}();
+
+static_assert(bitlib::popcount<std::uint8_t>(0xff) == 8);
+static_assert(bitlib::popcount<std::uint64_t>(0x8000000000000001) == 2);
+static_assert(bitlib::morton<std::uint32_t>(1, 0) == 1 && bitlib::morton<std::uint32_t>(0, 1) == 2);
+static_assert(bitlib::morton3<std::uint64_t>(1, 0, 0) == 1);
+static_assert(bitlib::morton3<std::uint64_t>(0, 1, 0) == 2);
+static_assert(bitlib::morton3<std::uint64_t>(0, 0, 1) == 4);
+static_assert(bitlib::morton3<std::uint64_t>(0x3fffff, 0x1fffff, 0x1fffff) == ~std::uint64_t(0));
+static_assert(bitlib::invmorton3<std::uint32_t>(bitlib::morton3<std::uint32_t>(3, 5, 7))[2] == 7);
+static_assert(bitlib::mortonxp3<std::uint32_t>(bitlib::morton3<std::uint32_t>(3, 5, 7)) ==
+              bitlib::morton3<std::uint32_t>(4, 5, 7));
+static_assert(bitlib::mortonym<std::uint16_t>(bitlib::morton<std::uint16_t>(9, 8)) ==
+              bitlib::morton<std::uint16_t>(9, 7));
+static_assert(bitlib_test_spread[0xff] == 0x5555);
+/* The span overloads fall back to the loops during constant evaluation */
+static_assert([] {
+    std::array<std::uint64_t, 3> x{1, 3, 7}, y{0, 1, 2}, m{}, a{}, b{};
+    bitlib::morton<std::uint64_t>(x, y, m);
+    bitlib::invmorton<std::uint64_t>(m, a, b);
+    return bitlib::popcount(std::span<const std::uint64_t>(m)) == 8 && a == x && b == y;
+}());
+
+static std::uint64_t bitlib_test_rand(std::uint64_t *s)
+{
+    *s = *s * 6364136223846793005 + 1442695040888963407;
+    return *s ^ (*s >> 29);
+}
+
+/* The constant evaluation code paths must agree with the C functions */
+template <bitlib::word T>
+static void test_bitlib_width(T (*c_merge)(T, T), T (*c_merge3)(T, T, T),
+                              void (*c_separate)(T, T *, T *),
+                              void (*c_separate3)(T, T *, T *, T *), T (*c_ym)(T), T (*c_zp3)(T))
+{
+    const unsigned bits = 8 * sizeof(T);
+    std::uint64_t s = 1;
+
+    for (unsigned i = 0; i < 10000; ++i) {
+        T r = T(bitlib_test_rand(&s)), x = T(r & ((T(1) << bits / 2) - 1));
+        T y = T((r >> bits / 2) & ((T(1) << bits / 2) - 1)), a, b, c;
+        T x3 = T(r % (T(1) << (bits + 2) / 3)), y3 = T(r / 3 % (T(1) << bits / 3));
+        T z3 = T(r / 7 % (T(1) << bits / 3));
+
+        assert(T(bitlib::detail::popcount(r)) == bitlib::popcount(r));
+        assert(T(bitlib::detail::scatter(x) | (bitlib::detail::scatter(y) << 1)) == c_merge(x, y));
+        assert(bitlib::merge(x, y) == c_merge(x, y));
+        assert(T(bitlib::detail::scatter3(x3) | (bitlib::detail::scatter3(y3) << 1) |
+                 (bitlib::detail::scatter3(z3) << 2)) == c_merge3(x3, y3, z3));
+        assert(bitlib::morton3(x3, y3, z3) == c_merge3(x3, y3, z3));
+
+        c_separate(r, &a, &b);
+        assert(T(bitlib::detail::gather(r)) == a && T(bitlib::detail::gather(r >> 1)) == b);
+        assert(bitlib::separate(r) == std::make_pair(a, b));
+        c_separate3(r, &a, &b, &c);
+        assert(T(bitlib::detail::gather3(r)) == a && T(bitlib::detail::gather3(r >> 1)) == b &&
+               T(bitlib::detail::gather3(r >> 2)) == c);
+        assert(bitlib::invmorton3(r) == (std::array<T, 3>{a, b, c}));
+
+        assert(bitlib::mortonym(r) == c_ym(r) && bitlib::mortonzp3(r) == c_zp3(r));
+        (void)x, (void)y, (void)x3, (void)y3, (void)z3;
+    }
+    (void)c_merge, (void)c_merge3, (void)c_ym, (void)c_zp3;
+}
+
+static void test_bitlib_span()
+{
+    std::uint64_t x[100], y[100], z[100], m[100], mask[2], s = 3;
+    std::uint64_t a[100], b[100], c[100];
+    std::uint64_t lo = morton3_64(10, 10, 10), hi = morton3_64(20, 20, 20);
+    std::size_t i, count = 0;
+
+    for (i = 0; i < 100; ++i) {
+        x[i] = bitlib_test_rand(&s) % 32;
+        y[i] = bitlib_test_rand(&s) % 32;
+        z[i] = bitlib_test_rand(&s) % 32;
+        count += popcount_64(x[i]);
+    }
+    assert(bitlib::popcount(std::span<const std::uint64_t>(x)) == count);
+
+    bitlib::morton3<std::uint64_t>(x, y, z, m);
+    bitlib::invmorton3<std::uint64_t>(m, a, b, c);
+    for (i = 0; i < 100; ++i) {
+        assert(m[i] == morton3_64(x[i], y[i], z[i]));
+        assert(a[i] == x[i] && b[i] == y[i] && c[i] == z[i]);
+    }
+
+    bitlib::morton3_in_box<std::uint64_t>(m, lo, hi, mask);
+    for (i = 0; i < 100; ++i) {
+        assert((mask[i / 64] >> i % 64 & 1) == std::uint64_t(morton3_in_box_64(m[i], lo, hi)));
+    }
+
+    bitlib::morton<std::uint64_t>(x, y, m);
+    bitlib::invmorton<std::uint64_t>(m, a, b);
+    for (i = 0; i < 100; ++i) {
+        assert(m[i] == morton_64(x[i], y[i]) && a[i] == x[i] && b[i] == y[i]);
+    }
+
+    /* 32 bit spans go to the _32 kernels */
+    std::uint32_t x32[100], y32[100], m32[100], a32[100], b32[100];
+    for (i = 0; i < 100; ++i) {
+        x32[i] = std::uint32_t(x[i]);
+        y32[i] = std::uint32_t(y[i]);
+    }
+    bitlib::morton<std::uint32_t>(x32, y32, m32);
+    bitlib::invmorton<std::uint32_t>(m32, a32, b32);
+    for (i = 0; i < 100; ++i) {
+        assert(m32[i] == morton_32(x32[i], y32[i]) && a32[i] == x32[i] && b32[i] == y32[i]);
+    }
+    (void)count, (void)lo, (void)hi;
+}
+
+extern "C" void test_bitlib()
+{
+    std::uint16_t i;
+
+    for (i = 0; i < 256; ++i) {
+        assert(bitlib_test_spread[i] == merge_16(i, 0));
+    }
+    test_bitlib_width<std::uint8_t>(merge_8, merge3_8, separate_8, separate3_8, mortonym_8,
+                                    mortonzp3_8);
+    test_bitlib_width<std::uint16_t>(merge_16, merge3_16, separate_16, separate3_16, mortonym_16,
+                                     mortonzp3_16);
+    test_bitlib_width<std::uint32_t>(merge_32, merge3_32, separate_32, separate3_32, mortonym_32,
+                                     mortonzp3_32);
+    test_bitlib_width<std::uint64_t>(merge_64, merge3_64, separate_64, separate3_64, mortonym_64,
+                                     mortonzp3_64);
+    test_bitlib_span();
+}
@@ -0,0 +1,61 @@
+#include "bitscan.h"
+#include "common.h"
+
+#include <assert.h>
+
+void test_ctz_32()
+{
+    uint32_t i;
+
+    assert(ctz_32(0x00000001) == 0);
+    assert(ctz_32(0x80000000) == 31);
+    assert(ctz_32(0x00f00000) == 20);
+    assert(ctz_32(0xffffffff) == 0);
+
+    for (i = 0; i < 32; ++i) {
+        assert(ctz_32((uint32_t)1 << i) == i);
+        assert(ctz_mul_32((uint32_t)1 << i) == i);
+        assert(ctz_mul_32(0xffffffff << i) == i);
+    }
+}
+
+void test_ctz_64()
+{
+    uint64_t i;
+
+    assert(ctz_64(0x0000000000000001) == 0);
+    assert(ctz_64(0x8000000000000000) == 63);
+    assert(ctz_64(0x0000f00000000000) == 44);
+    assert(ctz_64(0xffffffffffffffff) == 0);
+
+    for (i = 0; i < 64; ++i) {
+        assert(ctz_64((uint64_t)1 << i) == i);
+        assert(ctz_mul_64((uint64_t)1 << i) == i);
+        assert(ctz_mul_64(0xffffffffffffffff << i) == i);
+    }
+}
+
+void test_bsr()
+{
+    uint64_t i;
+
+    assert(bsr_32(0x00000001) == 0);
+    assert(bsr_32(0xffffffff) == 31);
+    assert(bsr_32(0x00f00000) == 23);
+    assert(bsr_64(0x0000000000000001) == 0);
+    assert(bsr_64(0xffffffffffffffff) == 63);
+    assert(bsr_64(0x0000f00000000000) == 47);
+
+    for (i = 0; i < 64; ++i) {
+        assert(bsr_64((uint64_t)1 << i) == i);
+        assert(bsr_64(((uint64_t)1 << i) | 1) == i);
+        assert(i >= 32 || bsr_32(((uint32_t)1 << i) | 1) == i);
+    }
+}
+
+void test_bitscan()
+{
+    test_ctz_32();
+    test_ctz_64();
+    test_bsr();
+}
@@ -0,0 +1,251 @@
+#define BITLIB_EXEC_THREADS
+
+#include "bstore.h"
+#include "common.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+/* 64 bricks of 4^3 one byte voxels, i.e. a 16^3 volume */
+static uint8_t bstore_test_file[64 * 64];
+
+static int bstore_test_read(void *ctx, uint64_t offset, void *buf, size_t size)
+{
+    (void)ctx;
+    memcpy(buf, bstore_test_file + offset, size);
+    return 1;
+}
+
+static int bstore_test_write(void *ctx, uint64_t offset, const void *buf, size_t size)
+{
+    (void)ctx;
+    memcpy(bstore_test_file + offset, buf, size);
+    return 1;
+}
+
+void test_bstore_cache()
+{
+    struct bstore_io io = {bstore_test_read, bstore_test_write, NULL};
+    static uint64_t mem[1024];
+    struct bstore s;
+    uint8_t *p, *q;
+    uint64_t m, n, x, y, z;
+    size_t i;
+    int ok;
+
+    for (i = 0; i < sizeof(bstore_test_file); ++i) {
+        bstore_test_file[i] = (uint8_t)i;
+    }
+    assert(bstore_size(2, 1, 4, 8) <= sizeof(mem));
+    ok = bstore_init(&s, io, 2, 1, 64, 4, 8, 0, mem, bstore_size(2, 1, 4, 8) - 1);
+    assert(!ok);
+    ok = bstore_init(&s, io, 2, 1, 64, 4, 8, 0, mem, sizeof(mem));
+    assert(ok);
+
+    /* The voxel with global code m is byte m of the file. */
+    m = morton3_64(5, 9, 2);
+    p = bstore_voxel_64(&s, m, 0);
+    assert(p && *p == (uint8_t)m);
+    assert(s.misses == 1 && s.reads == 1);
+    q = bstore_voxel_64(&s, m + 1, 0);
+    assert(q == p + 1);
+    assert(s.hits == 1);
+
+    /* Neighbor steps cross brick boundaries: x = 7 -> 8 changes the brick. */
+    m = morton3_64(7, 9, 2);
+    p = bstore_neighbor_64(&s, m, 1, 0, &n);
+    invmorton3_64(n, &x, &y, &z);
+    assert(x == 8 && y == 9 && z == 2);
+    assert(p && *p == (uint8_t)n);
+    p = bstore_neighbor_64(&s, morton3_64(0, 3, 3), 0, 0, &n);
+    assert(p == NULL);
+    p = bstore_neighbor_64(&s, morton3_64(3, 15, 3), 3, 0, &n);
+    assert(p == NULL);
+
+    /* Least recently used bricks are evicted first, pinned ones never. */
+    p = bstore_pin(&s, 10);
+    assert(p);
+    for (i = 20; i < 30; ++i) {
+        p = bstore_get(&s, i);
+        assert(p);
+    }
+    assert(bstore_lookup(&s, 10) != BSTORE_NONE);
+    assert(bstore_lookup(&s, 20) == BSTORE_NONE);
+    assert(bstore_lookup(&s, 29) != BSTORE_NONE);
+    for (i = 11; i < 14; ++i) {
+        p = bstore_pin(&s, i);
+        assert(p);
+    }
+    p = bstore_get(&s, 14);
+    assert(p == NULL);
+    bstore_unpin(&s, 12);
+    p = bstore_get(&s, 14);
+    assert(p);
+    assert(bstore_lookup(&s, 12) == BSTORE_NONE);
+    bstore_unpin(&s, 10);
+    bstore_unpin(&s, 11);
+    bstore_unpin(&s, 13);
+
+    /* Dirty bricks are written back on eviction and flush. */
+    p = bstore_voxel_64(&s, 40 * 64 + 3, 1);
+    *p = 0xee;
+    q = bstore_get(&s, 41);
+    q[0] = 0xdd;
+    bstore_mark(&s, 41);
+    assert(bstore_test_file[41 * 64] != 0xdd);
+    for (i = 50; i < 54; ++i) {
+        p = bstore_get(&s, i);
+        assert(p);
+    }
+    assert(bstore_test_file[40 * 64 + 3] == 0xee && bstore_test_file[41 * 64] == 0xdd);
+    assert(s.writes == 2);
+    p = bstore_get(&s, 53);
+    p[1] = 0xcc;
+    bstore_mark(&s, 53);
+    ok = bstore_flush(&s);
+    assert(ok);
+    assert(bstore_test_file[53 * 64 + 1] == 0xcc && s.writes == 3);
+    ok = bstore_flush(&s);
+    assert(ok && s.writes == 3);
+    (void)ok;
+    bstore_destroy(&s);
+}
+
+void test_bstore_prefetch()
+{
+    struct bstore_io io = {bstore_test_read, bstore_test_write, NULL};
+    static uint64_t mem[1024];
+    struct bstore s;
+    uint8_t *p, *q;
+    size_t i, n;
+    int ok;
+
+    ok = bstore_init(&s, io, 2, 1, 64, 6, 4, 2, mem, sizeof(mem));
+    assert(ok);
+    ok = bstore_prefetch(&s, 5);
+    assert(ok);
+    ok = bstore_prefetch(&s, 64);
+    assert(!ok);
+    n = bstore_pump(&s, 10);
+    assert(n == 1);
+    p = bstore_get(&s, 5);
+    assert(p && s.hits == 1 && s.misses == 0);
+
+    /* Sequential misses read ahead along the curve. */
+    p = bstore_get(&s, 20);
+    q = bstore_get(&s, 21);
+    assert(p && q);
+    assert(s.qcount == 2);
+    n = bstore_pump(&s, 1);
+    assert(n == 1);
+    n = bstore_pump(&s, 1);
+    assert(n == 1);
+    p = bstore_get(&s, 22);
+    q = bstore_get(&s, 23);
+    assert(p && q);
+    assert(s.misses == 2 && s.hits == 3);
+
+    /* The queue drops requests when it is full and skips cached bricks. */
+    for (i = 30; i < 40; ++i) {
+        bstore_prefetch(&s, i);
+    }
+    assert(s.qcount == 4);
+    ok = bstore_prefetch(&s, 22);
+    assert(!ok);
+    p = bstore_get(&s, 31);
+    assert(p);
+    n = bstore_pump(&s, 10);
+    assert(n == 3);
+    (void)p, (void)q, (void)n, (void)ok;
+    bstore_destroy(&s);
+}
+
+static int bstore_test_stop;
+
+static void *bstore_test_pump(void *arg)
+{
+    struct bstore *s = (struct bstore *)arg;
+
+    while (!__atomic_load_n(&bstore_test_stop, __ATOMIC_ACQUIRE)) {
+        bstore_pump(s, 4);
+    }
+    return NULL;
+}
+
+void test_bstore_threads()
+{
+    struct bstore_io io = {bstore_test_read, bstore_test_write, NULL};
+    static uint64_t mem[1024];
+    struct bstore s;
+    pthread_t pump;
+    size_t i, j;
+    int ok;
+
+    for (i = 0; i < sizeof(bstore_test_file); ++i) {
+        bstore_test_file[i] = (uint8_t)(i / 64);
+    }
+    ok = bstore_init(&s, io, 2, 1, 64, 6, 16, 2, mem, sizeof(mem));
+    assert(ok);
+    ok = pthread_create(&pump, NULL, bstore_test_pump, &s) == 0;
+    assert(ok);
+
+    /* Pinned bricks hold their data while the pump loads and evicts others. */
+    for (i = 0; i < 2000; ++i) {
+        uint64_t k = (i * 7) % 64;
+        uint8_t *p;
+        bstore_prefetch(&s, (k + 13) % 64);
+        bstore_prefetch(&s, (k + 29) % 64);
+        p = bstore_pin(&s, k);
+        assert(p);
+        for (j = 0; j < 64; ++j) {
+            assert(p[j] == (uint8_t)k);
+        }
+        (void)p;
+        bstore_unpin(&s, k);
+    }
+    __atomic_store_n(&bstore_test_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(pump, NULL);
+    assert(s.reads > 0 && s.hits + s.misses == 2000);
+    (void)ok;
+    bstore_destroy(&s);
+}
+
+void test_bstore_stdio()
+{
+    FILE *f = tmpfile();
+    struct bstore_io io = {bstore_stdio_read, bstore_stdio_write, NULL};
+    static uint64_t mem[1024];
+    struct bstore s;
+    uint8_t *p;
+    int ok;
+
+    assert(f);
+    io.ctx = f;
+    ok = bstore_init(&s, io, 2, 2, 64, 4, 4, 0, mem, sizeof(mem));
+    assert(ok);
+    /* Bricks past the end of the file read as zeros. */
+    p = bstore_voxel_64(&s, 1000, 1);
+    assert(p && p[0] == 0 && p[1] == 0);
+    p[0] = 42;
+    ok = bstore_flush(&s);
+    assert(ok);
+    bstore_destroy(&s);
+
+    ok = bstore_init(&s, io, 2, 2, 64, 4, 4, 0, mem, sizeof(mem));
+    assert(ok);
+    p = bstore_voxel_64(&s, 1000, 0);
+    assert(p && p[0] == 42);
+    (void)ok;
+    bstore_destroy(&s);
+    fclose(f);
+}
+
+void test_bstore()
+{
+    test_bstore_cache();
+    test_bstore_prefetch();
+    test_bstore_threads();
+    test_bstore_stdio();
+}
@@ -0,0 +1,102 @@
+#define BITLIB_EXEC_THREADS
+
+#include "buffer.h"
+#include "bulk.h"
+#include "common.h"
+
+#include <assert.h>
+
+void test_buffer_alloc()
+{
+    static const size_t sizes[] = {0, 1, 100, 4096, BUFFER_HUGE_MIN, 3 * BUFFER_HUGE_PAGE + 5};
+    static const size_t aligns[] = {0, 8, 32, 64, 4096};
+    static const unsigned flags[] = {0, BUFFER_HUGETLB, BUFFER_NOHUGE};
+    struct buffer b;
+    size_t s, a, f, i;
+    int ok;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (a = 0; a < sizeof(aligns) / sizeof(aligns[0]); ++a) {
+            for (f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+                ok = buffer_alloc(&b, sizes[s], aligns[a], flags[f]);
+                assert(ok);
+                assert((uintptr_t)b.data % (aligns[a] ? aligns[a] : BUFFER_ALIGN) == 0);
+                assert(b.size == sizes[s] && b.kind != BUFFER_NONE);
+                assert(sizes[s] >= BUFFER_HUGE_MIN || b.kind == BUFFER_HEAP);
+                assert(!(flags[f] & BUFFER_NOHUGE) || b.kind == BUFFER_HEAP);
+                for (i = 0; i < sizes[s]; i += 1000) {
+                    ((char *)b.data)[i] = (char)i;
+                }
+                if (sizes[s] > 0) {
+                    ((char *)b.data)[sizes[s] - 1] = 1;
+                }
+                buffer_free(&b);
+                assert(b.data == NULL && b.kind == BUFFER_NONE);
+            }
+        }
+    }
+    (void)ok;
+}
+
+void test_buffer_touch()
+{
+    struct exec_worker workers[3];
+    struct exec_pool pool;
+    struct buffer b;
+    uint64_t *x;
+    size_t n = 5 * BUFFER_HUGE_PAGE / sizeof(uint64_t) - 3, i;
+    int ok;
+
+    ok = exec_pool_init(&pool, 3, workers);
+    assert(ok);
+    ok = buffer_alloc(&b, n * sizeof(uint64_t), 0, 0);
+    assert(ok);
+    x = (uint64_t *)b.data;
+    for (i = 0; i < n; ++i) {
+        x[i] = i;
+    }
+    buffer_touch(&pool.exec, &b);
+    for (i = 0; i < n; ++i) {
+        assert(x[i] == 0);
+    }
+    x[n - 1] = 0xff;
+    x[7] = 1;
+    assert(popcount_bulk_ex_64(&pool.exec, x, n) == 9);
+    buffer_touch(NULL, &b);
+    assert(popcount_bulk_ex_64(&pool.exec, x, n) == 0);
+    (void)ok;
+    buffer_free(&b);
+    exec_pool_destroy(&pool);
+}
+
+void test_arena()
+{
+    struct arena a;
+    uint64_t *x;
+    uint32_t *y;
+    char *c;
+    int ok;
+
+    ok = arena_init(&a, 1000, 0);
+    assert(ok);
+    c = (char *)arena_alloc(&a, 3, 1);
+    x = (uint64_t *)arena_alloc(&a, 10 * sizeof(uint64_t), 0);
+    y = (uint32_t *)arena_alloc(&a, 10 * sizeof(uint32_t), 32);
+    assert(c == a.buf.data && (uintptr_t)c % BUFFER_ALIGN == 0);
+    assert((char *)x == c + 64 && (uintptr_t)y % 32 == 0 && (char *)y == c + 160);
+    assert(arena_alloc(&a, 1000, 1) == NULL);
+    assert(arena_alloc(&a, 1000 - 200, 1) == c + 200);
+    assert(arena_alloc(&a, 1, 1) == NULL);
+    assert(arena_alloc(&a, 0, 1) == c + 1000);
+    arena_reset(&a);
+    assert(arena_alloc(&a, 1000, 0) == c);
+    (void)ok, (void)c, (void)x, (void)y;
+    arena_destroy(&a);
+}
+
+void test_buffer()
+{
+    test_buffer_alloc();
+    test_buffer_touch();
+    test_arena();
+}
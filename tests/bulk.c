@@ -0,0 +1,396 @@
+#define BITLIB_EXEC_THREADS
+
+#include "bulk.h"
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define BULK_TEST_N 10000
+#define BULK_TEST_BOXES 40
+#define BULK_TEST_RANGES 64
+#define BULK_TEST_OCTANTS 40
+#define BULK_TEST_OCTREE_CAP (1 << 18)
+
+/* Runs the chunks of a call backwards, one at a time */
+static void bulk_test_reverse(struct exec *e, exec_task task, void *arg, size_t n, size_t grain)
+{
+    size_t chunk = (n - 1) / grain + 1;
+
+    (void)e;
+    while (chunk-- > 0) {
+        size_t begin = chunk * grain;
+        task(arg, begin, n - begin < grain ? n : begin + grain);
+    }
+}
+
+static uint64_t bulk_test_rand(uint64_t *s)
+{
+    *s = *s * 6364136223846793005 + 1442695040888963407;
+    return *s ^ (*s >> 29);
+}
+
+static void test_bulk_exec(struct exec *e)
+{
+    static uint64_t x[BULK_TEST_N], y[BULK_TEST_N], z[BULK_TEST_N], m[BULK_TEST_N];
+    static uint64_t a[BULK_TEST_N], b[BULK_TEST_N], c[BULK_TEST_N];
+    static uint64_t nb[6 * BULK_TEST_N], mask[BULK_TEST_N / 64 + 1];
+    static uint32_t x32[BULK_TEST_N], y32[BULK_TEST_N], z32[BULK_TEST_N], m32[BULK_TEST_N];
+    static uint32_t a32[BULK_TEST_N], b32[BULK_TEST_N], c32[BULK_TEST_N];
+    static double lat[BULK_TEST_N], lon[BULK_TEST_N], lat2[BULK_TEST_N], lon2[BULK_TEST_N];
+    static char s[12 * BULK_TEST_N], s2[12 * BULK_TEST_N];
+    static uint64_t boxes[6 * BULK_TEST_BOXES], ranges[2 * BULK_TEST_RANGES * BULK_TEST_BOXES];
+    static uint64_t sorted[BULK_TEST_N], tree[2 * BULK_TEST_N], tree2[2 * BULK_TEST_N];
+    static uint32_t sorted32[BULK_TEST_N], tree32[2 * BULK_TEST_N];
+    size_t counts[BULK_TEST_BOXES], total, i, j, size;
+    static size_t out[BULK_TEST_N], out2[BULK_TEST_N];
+    uint64_t state = 5, count = 0;
+    struct stree t;
+
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        x[i] = bulk_test_rand(&state) & 0x1fffff;
+        y[i] = bulk_test_rand(&state) & 0x1fffff;
+        z[i] = bulk_test_rand(&state) & 0x1fffff;
+        x32[i] = (uint32_t)x[i] & 0x3ff;
+        y32[i] = (uint32_t)y[i] & 0x3ff;
+        z32[i] = (uint32_t)z[i] & 0x3ff;
+        lat[i] = (double)(bulk_test_rand(&state) % 180000) / 1000 - 90;
+        lon[i] = (double)(bulk_test_rand(&state) % 360000) / 1000 - 180;
+        sorted[i] = 3 * i + 1;
+        sorted32[i] = (uint32_t)sorted[i];
+        count += popcount_64(x[i] * 0x9e3779b97f4a7c15);
+        a[i] = x[i] * 0x9e3779b97f4a7c15;
+    }
+    assert(popcount_bulk_ex_64(e, a, BULK_TEST_N) == count);
+    assert(popcount_bulk_64(a, BULK_TEST_N) == count);
+
+    morton_bulk_ex_64(e, x, y, BULK_TEST_N, m);
+    invmorton_bulk_ex_64(e, m, BULK_TEST_N, a, b);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert(m[i] == morton_64(x[i], y[i]) && a[i] == x[i] && b[i] == y[i]);
+    }
+    morton_neighbors_bulk_ex_64(e, m, BULK_TEST_N, nb);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert(nb[4 * i] == mortonxm_64(m[i]) && nb[4 * i + 3] == mortonyp_64(m[i]));
+    }
+    morton_in_box_bulk_ex_64(e, m, BULK_TEST_N - 5, m[1], m[2], mask);
+    for (i = 0; i < BULK_TEST_N - 5; ++i) {
+        assert((int)(mask[i / 64] >> i % 64 & 1) == morton_in_box_64(m[i], m[1], m[2]));
+    }
+
+    morton3_bulk_ex_64(e, x, y, z, BULK_TEST_N, m);
+    invmorton3_bulk_ex_64(e, m, BULK_TEST_N, a, b, c);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert(m[i] == morton3_64(x[i], y[i], z[i]));
+        assert(a[i] == x[i] && b[i] == y[i] && c[i] == z[i]);
+    }
+    morton3_neighbors_bulk_ex_64(e, m, BULK_TEST_N, nb);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert(nb[6 * i + 1] == mortonxp3_64(m[i]) && nb[6 * i + 4] == mortonzm3_64(m[i]));
+    }
+    morton3_in_box_bulk_ex_64(e, m, BULK_TEST_N, m[3], m[4], mask);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert((int)(mask[i / 64] >> i % 64 & 1) == morton3_in_box_64(m[i], m[3], m[4]));
+    }
+
+    morton_bulk_ex_32(e, x32, y32, BULK_TEST_N, m32);
+    invmorton_bulk_ex_32(e, m32, BULK_TEST_N, a32, b32);
+    morton_in_box_bulk_ex_32(e, m32, BULK_TEST_N, m32[1], m32[2], mask);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert(m32[i] == morton_32(x32[i], y32[i]) && a32[i] == x32[i] && b32[i] == y32[i]);
+        assert((int)(mask[i / 64] >> i % 64 & 1) == morton_in_box_32(m32[i], m32[1], m32[2]));
+    }
+    morton3_bulk_ex_32(e, x32, y32, z32, BULK_TEST_N, m32);
+    invmorton3_bulk_ex_32(e, m32, BULK_TEST_N, a32, b32, c32);
+    morton3_in_box_bulk_ex_32(e, m32, BULK_TEST_N, m32[1], m32[2], mask);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert(m32[i] == morton3_32(x32[i], y32[i], z32[i]));
+        assert(a32[i] == x32[i] && b32[i] == y32[i] && c32[i] == z32[i]);
+        assert((int)(mask[i / 64] >> i % 64 & 1) == morton3_in_box_32(m32[i], m32[1], m32[2]));
+    }
+
+    geohash_encode_bulk_ex_64(e, lat, lon, BULK_TEST_N, 50, m);
+    geohash_encode_bulk_64(lat, lon, BULK_TEST_N, 50, a);
+    geohash_decode_bulk_ex_64(e, m, BULK_TEST_N, 50, lat, lon);
+    geohash_decode_bulk_64(a, BULK_TEST_N, 50, lat2, lon2);
+    assert(memcmp(m, a, sizeof(m)) == 0);
+    assert(memcmp(lat, lat2, sizeof(lat)) == 0 && memcmp(lon, lon2, sizeof(lon)) == 0);
+
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        x[i] &= 0xfff;
+        y[i] &= 0xfff;
+    }
+    tile_key_bulk_ex_64(e, 12, x, y, BULK_TEST_N, m);
+    tile_key_bulk_64(12, x, y, BULK_TEST_N, a);
+    assert(memcmp(m, a, sizeof(m)) == 0);
+    tile_xy_bulk_ex_64(e, m, BULK_TEST_N, a, b);
+    quadkey_format_bulk_ex_64(e, m, BULK_TEST_N, 12, s);
+    quadkey_format_bulk_64(m, BULK_TEST_N, 12, s2);
+    assert(memcmp(s, s2, sizeof(s)) == 0);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        assert(a[i] == x[i] && b[i] == y[i]);
+    }
+
+    for (i = 0; i < BULK_TEST_BOXES; ++i) {
+        for (j = 0; j < 3; ++j) {
+            boxes[6 * i + j] = bulk_test_rand(&state) % 1000;
+            boxes[6 * i + j + 3] = boxes[6 * i + j] + bulk_test_rand(&state) % 20;
+        }
+    }
+    total = morton_ranges_bulk_ex_64(e, boxes, BULK_TEST_BOXES, 0, ranges, BULK_TEST_RANGES,
+                                     counts);
+    for (i = 0; i < BULK_TEST_BOXES; ++i) {
+        const uint64_t *bx = boxes + 4 * i;
+        size_t k = morton_ranges_64(bx[0], bx[1], bx[2], bx[3], 0, a, BULK_TEST_RANGES);
+        assert(counts[i] == k);
+        assert(memcmp(ranges + 2 * BULK_TEST_RANGES * i, a, 2 * k * sizeof(uint64_t)) == 0);
+        total -= k;
+    }
+    assert(total == 0);
+    total = morton3_ranges_bulk_ex_64(e, boxes, BULK_TEST_BOXES, 0, ranges, BULK_TEST_RANGES,
+                                      counts);
+    for (i = 0; i < BULK_TEST_BOXES; ++i) {
+        const uint64_t *bx = boxes + 6 * i;
+        size_t k = morton3_ranges_64(bx[0], bx[1], bx[2], bx[3], bx[4], bx[5], 0, a,
+                                     BULK_TEST_RANGES);
+        assert(counts[i] == k);
+        assert(memcmp(ranges + 2 * BULK_TEST_RANGES * i, a, 2 * k * sizeof(uint64_t)) == 0);
+        total -= k;
+    }
+    assert(total == 0);
+
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        a[i] = bulk_test_rand(&state) % (3 * BULK_TEST_N + 10);
+        a32[i] = (uint32_t)a[i];
+    }
+    eytzinger_build_ex_64(e, sorted, BULK_TEST_N, tree2);
+    eytzinger_build_64(sorted, BULK_TEST_N, tree, 1, BULK_TEST_N + 1);
+    assert(memcmp(tree + 1, tree2 + 1, BULK_TEST_N * sizeof(uint64_t)) == 0);
+    eytzinger_lower_bound_bulk_ex_64(e, tree, BULK_TEST_N, a, BULK_TEST_N, out);
+    eytzinger_lower_bound_bulk_64(tree, BULK_TEST_N, a, BULK_TEST_N, out2);
+    assert(memcmp(out, out2, sizeof(out)) == 0);
+    eytzinger_build_ex_32(e, sorted32, BULK_TEST_N, tree32);
+    eytzinger_lower_bound_bulk_ex_32(e, tree32, BULK_TEST_N, a32, BULK_TEST_N, out);
+    assert(memcmp(out, out2, sizeof(out)) == 0);
+
+    size = stree_init(&t, BULK_TEST_N);
+    assert(size <= 2 * BULK_TEST_N);
+    stree_build_ex_64(e, &t, sorted, tree2, size);
+    stree_build_64(&t, sorted, tree, 0, size);
+    assert(memcmp(tree, tree2, size * sizeof(uint64_t)) == 0);
+    stree_lower_bound_bulk_ex_64(e, &t, tree2, a, BULK_TEST_N, out);
+    assert(memcmp(out, out2, sizeof(out)) == 0);
+    stree_build_ex_32(e, &t, sorted32, tree32, size);
+    stree_lower_bound_bulk_ex_32(e, &t, tree32, a32, BULK_TEST_N, out);
+    assert(memcmp(out, out2, sizeof(out)) == 0);
+
+    /* Full keys, keys whose top digits agree, and keys sorted by their low bits */
+    for (j = 0; j < 3; ++j) {
+        static const uint64_t masks[3] = {UINT64_MAX, 0xff00ff0f0f, UINT64_MAX};
+        static const unsigned bits[3] = {64, 40, 20};
+        for (i = 0; i < BULK_TEST_N; ++i) {
+            a[i] = b[i] = bulk_test_rand(&state) & masks[j] & ~(uint64_t)0xf0;
+            a32[i] = b32[i] = (uint32_t)i;
+        }
+        radixsort_ex_64(e, a, a32, BULK_TEST_N, c, c32, bits[j]);
+        radixsort_64(b, b32, BULK_TEST_N, m, m32, bits[j]);
+        assert(memcmp(a, b, sizeof(a)) == 0 && memcmp(a32, b32, sizeof(a32)) == 0);
+    }
+}
+
+static void test_bulk_cursor(struct exec *e)
+{
+    static uint64_t x[BULK_TEST_N], y[BULK_TEST_N], z[BULK_TEST_N];
+    static uint64_t x2[BULK_TEST_N], y2[BULK_TEST_N], z2[BULK_TEST_N];
+    static uint32_t x32[BULK_TEST_N], y32[BULK_TEST_N], z32[BULK_TEST_N];
+    static uint32_t x232[BULK_TEST_N], y232[BULK_TEST_N], z232[BULK_TEST_N];
+
+    invmorton_seq_ex_64(e, 0x123456789, BULK_TEST_N, x, y);
+    invmorton_seq_64(0x123456789, BULK_TEST_N, x2, y2);
+    assert(memcmp(x, x2, sizeof(x)) == 0 && memcmp(y, y2, sizeof(y)) == 0);
+    invmorton3_seq_ex_64(e, 0x123456789, BULK_TEST_N, x, y, z);
+    invmorton3_seq_64(0x123456789, BULK_TEST_N, x2, y2, z2);
+    assert(memcmp(x, x2, sizeof(x)) == 0 && memcmp(y, y2, sizeof(y)) == 0);
+    assert(memcmp(z, z2, sizeof(z)) == 0);
+    invmorton_seq_ex_32(e, 12345, BULK_TEST_N, x32, y32);
+    invmorton_seq_32(12345, BULK_TEST_N, x232, y232);
+    assert(memcmp(x32, x232, sizeof(x32)) == 0 && memcmp(y32, y232, sizeof(y32)) == 0);
+    invmorton3_seq_ex_32(e, 12345, BULK_TEST_N, x32, y32, z32);
+    invmorton3_seq_32(12345, BULK_TEST_N, x232, y232, z232);
+    assert(memcmp(x32, x232, sizeof(x32)) == 0 && memcmp(y32, y232, sizeof(y32)) == 0);
+    assert(memcmp(z32, z232, sizeof(z32)) == 0);
+}
+
+static void test_bulk_octree(struct exec *e)
+{
+    static uint64_t seeds[BULK_TEST_OCTANTS + 1], leaves[BULK_TEST_OCTREE_CAP];
+    static uint64_t scratch[BULK_TEST_OCTREE_CAP], out[BULK_TEST_OCTREE_CAP];
+    static uint64_t out2[BULK_TEST_OCTREE_CAP];
+    uint64_t state = 11;
+    size_t i, n, m;
+
+    /* An unbalanced tree around random deep octants */
+    seeds[0] = octant_64(0, 0, 0, 0);
+    for (i = 1; i <= BULK_TEST_OCTANTS; ++i) {
+        unsigned level = 3 + (unsigned)(bulk_test_rand(&state) % 7), s = OCTREE_MAXLEVEL - level;
+        uint64_t mask = ((uint64_t)1 << level) - 1;
+        seeds[i] = octant_64((bulk_test_rand(&state) & mask) << s,
+                             (bulk_test_rand(&state) & mask) << s,
+                             (bulk_test_rand(&state) & mask) << s, level);
+    }
+    n = octree_sort_64(seeds, BULK_TEST_OCTANTS + 1);
+    n = octree_refine_64(seeds, n, leaves, BULK_TEST_OCTREE_CAP);
+    assert(n > 1000);
+
+    m = octree_balance_64(leaves, n, scratch, BULK_TEST_OCTREE_CAP, out2, BULK_TEST_OCTREE_CAP);
+    assert(m > n);
+    i = octree_balance_ex_64(e, leaves, n, scratch, BULK_TEST_OCTREE_CAP, out,
+                             BULK_TEST_OCTREE_CAP);
+    assert(i == m);
+    assert(memcmp(out, out2, m * sizeof(uint64_t)) == 0);
+    /* Too little scratch for the closures of the ranges */
+    if (e != NULL) {
+        i = octree_balance_ex_64(e, leaves, n, scratch, n, out, BULK_TEST_OCTREE_CAP);
+        assert(i == 0);
+    }
+    (void)m;
+}
+
+static void test_bulk_voxel(struct exec *e)
+{
+    static float x[BULK_TEST_N], y[BULK_TEST_N], z[BULK_TEST_N];
+    static float ox[BULK_TEST_N], oy[BULK_TEST_N], oz[BULK_TEST_N];
+    static float ox2[BULK_TEST_N], oy2[BULK_TEST_N], oz2[BULK_TEST_N];
+    static uint64_t keys[BULK_TEST_N], keys2[BULK_TEST_N], tk[BULK_TEST_N];
+    static uint32_t idx[BULK_TEST_N], idx2[BULK_TEST_N], tv[BULK_TEST_N];
+    static uint32_t rep[BULK_TEST_N], rep2[BULK_TEST_N];
+    static size_t starts[BULK_TEST_N + 1], starts2[BULK_TEST_N + 1];
+    float origin[3] = {0.0f, 0.0f, 0.0f};
+    uint64_t state = 13;
+    size_t i, count, count2;
+    int mode, same;
+
+    /* Several points per voxel, and all points in one voxel */
+    for (same = 0; same < 2; ++same) {
+        for (i = 0; i < BULK_TEST_N; ++i) {
+            x[i] = (float)(bulk_test_rand(&state) % 1000) / (same ? 1000 : 10);
+            y[i] = (float)(bulk_test_rand(&state) % 1000) / (same ? 1000 : 10);
+            z[i] = (float)(bulk_test_rand(&state) % 1000) / (same ? 1000 : 10);
+        }
+        for (mode = VOXEL_FIRST; mode <= VOXEL_MEDOID; ++mode) {
+            count = voxel_downsample_64(x, y, z, BULK_TEST_N, origin, 5.0f, mode, keys2, idx2,
+                                        tk, tv, starts2, ox2, oy2, oz2, rep2);
+            count2 = voxel_downsample_ex_64(e, x, y, z, BULK_TEST_N, origin, 5.0f, mode, keys,
+                                            idx, tk, tv, starts, ox, oy, oz, rep);
+            assert(count2 == count);
+            assert(same ? count == 1 : count > 1000);
+            assert(memcmp(keys, keys2, sizeof(keys)) == 0);
+            assert(memcmp(idx, idx2, sizeof(idx)) == 0);
+            assert(memcmp(starts, starts2, (count + 1) * sizeof(size_t)) == 0);
+            assert(memcmp(rep, rep2, count * sizeof(uint32_t)) == 0);
+            assert(memcmp(ox, ox2, count * sizeof(float)) == 0);
+            assert(memcmp(oy, oy2, count * sizeof(float)) == 0);
+            assert(memcmp(oz, oz2, count * sizeof(float)) == 0);
+            (void)count, (void)count2;
+        }
+    }
+}
+
+static void test_bulk_pic(struct exec *e)
+{
+    static float x[BULK_TEST_N], y[BULK_TEST_N], z[BULK_TEST_N], q[BULK_TEST_N];
+    static float sx[BULK_TEST_N], sy[BULK_TEST_N], sz[BULK_TEST_N], sq[BULK_TEST_N];
+    static float grid[1 << 12], grid2[1 << 12], out[BULK_TEST_N], out2[BULK_TEST_N];
+    static uint64_t keys[BULK_TEST_N], tk[BULK_TEST_N];
+    static uint32_t idx[BULK_TEST_N], tv[BULK_TEST_N], codes[8][64];
+    static uint32_t cols[3][BULK_TEST_N];
+    static float values[8][64];
+    static uint64_t zk[BULK_TEST_N], zk2[BULK_TEST_N];
+    const uint32_t *colp[3] = {cols[0], cols[1], cols[2]};
+    struct pic_seam seams[8];
+    uint64_t state = 17;
+    size_t i;
+    int tsc;
+
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        x[i] = (float)(bulk_test_rand(&state) % 16000) / 1000;
+        y[i] = (float)(bulk_test_rand(&state) % 16000) / 1000;
+        z[i] = (float)(bulk_test_rand(&state) % 16000) / 1000;
+        q[i] = 1.0f + (float)(bulk_test_rand(&state) % 100) / 100;
+    }
+    /* Deposition works best on particles sorted by cell */
+    pic_keys_32(x, y, z, BULK_TEST_N, keys, idx);
+    radixsort_ex_64(e, keys, idx, BULK_TEST_N, tk, tv, 30);
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        sx[i] = x[idx[i]];
+        sy[i] = y[idx[i]];
+        sz[i] = z[idx[i]];
+        sq[i] = q[idx[i]];
+    }
+    for (i = 0; i < 8; ++i) {
+        seams[i].code = codes[i];
+        seams[i].value = values[i];
+        seams[i].cap = 64;
+    }
+    for (tsc = 0; tsc < 2; ++tsc) {
+        memset(grid, 0, sizeof(grid));
+        memset(grid2, 0, sizeof(grid2));
+        if (tsc) {
+            pic_deposit_tsc_ex_32(e, sx, sy, sz, sq, BULK_TEST_N, 4, grid, seams, 8);
+            pic_deposit_tsc_32(sx, sy, sz, sq, BULK_TEST_N, 4, 0, 0, grid2, NULL);
+        } else {
+            pic_deposit_cic_ex_32(e, sx, sy, sz, sq, BULK_TEST_N, 4, grid, seams, 8);
+            pic_deposit_cic_32(sx, sy, sz, sq, BULK_TEST_N, 4, 0, 0, grid2, NULL);
+        }
+        for (i = 0; i < 1 << 12; ++i) {
+            float d = grid[i] - grid2[i];
+            assert(d < 1e-3f && d > -1e-3f);
+            (void)d;
+        }
+    }
+
+    pic_gather_cic_ex_32(e, x, y, z, BULK_TEST_N, 4, grid, out);
+    pic_gather_cic_32(x, y, z, BULK_TEST_N, 4, grid, out2);
+    assert(memcmp(out, out2, sizeof(out)) == 0);
+    pic_gather_tsc_ex_32(e, x, y, z, BULK_TEST_N, 4, grid, out);
+    pic_gather_tsc_32(x, y, z, BULK_TEST_N, 4, grid, out2);
+    assert(memcmp(out, out2, sizeof(out)) == 0);
+
+    for (i = 0; i < BULK_TEST_N; ++i) {
+        cols[0][i] = (uint32_t)bulk_test_rand(&state);
+        cols[1][i] = (uint32_t)bulk_test_rand(&state);
+        cols[2][i] = (uint32_t)bulk_test_rand(&state);
+    }
+    zkey_build_ex_64(e, colp, 3, BULK_TEST_N, zk);
+    zkey_build_64(colp, 3, BULK_TEST_N, zk2);
+    assert(memcmp(zk, zk2, sizeof(zk)) == 0);
+}
+
+void test_bulk()
+{
+    struct exec reverse = {bulk_test_reverse};
+    struct exec_worker workers[3];
+    struct exec_pool pool;
+    int ok;
+
+    test_bulk_exec(NULL);
+    test_bulk_exec(&reverse);
+    test_bulk_cursor(NULL);
+    test_bulk_cursor(&reverse);
+    test_bulk_octree(NULL);
+    test_bulk_octree(&reverse);
+    test_bulk_voxel(NULL);
+    test_bulk_voxel(&reverse);
+    test_bulk_pic(NULL);
+    test_bulk_pic(&reverse);
+    ok = exec_pool_init(&pool, 3, workers);
+    assert(ok);
+    (void)ok;
+    test_bulk_exec(&pool.exec);
+    test_bulk_exec(&pool.exec);
+    test_bulk_cursor(&pool.exec);
+    test_bulk_octree(&pool.exec);
+    test_bulk_voxel(&pool.exec);
+    test_bulk_pic(&pool.exec);
+    exec_pool_destroy(&pool);
+}
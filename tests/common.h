@@ -7,6 +7,30 @@
 void test_shift();
 void test_popcount();
 void test_morton();
+void test_octree();
+void test_range();
+void test_compare();
+void test_bitscan();
+void test_cursor();
+void test_hilbert();
+void test_tile();
+void test_sort();
+void test_zorder();
+void test_geohash();
+void test_quadkey();
+void test_pstore();
+void test_bstore();
+void test_lsm();
+void test_search();
+void test_voxel();
+void test_pic();
+void test_dirty();
+void test_profile();
+void test_exec();
+void test_bulk();
+void test_buffer();
+void test_locality();
+void test_bitlib();
 
 #define PRINT_UINT(x) printf("%x\n", (uint32_t)(x))
 
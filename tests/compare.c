@@ -0,0 +1,131 @@
+#include "compare.h"
+#include "morton.h"
+#include "common.h"
+
+#include <assert.h>
+
+void test_morton_axis_compare()
+{
+    uint64_t a = morton_64(5, 9), b = morton_64(7, 3);
+    uint32_t c = morton3_32(4, 2, 9), d = morton3_32(4, 8, 1);
+
+    assert(mortonxlt_64(a, b) && !mortonxlt_64(b, a));
+    assert(mortonylt_64(b, a) && !mortonylt_64(a, b));
+    assert(mortonxle_64(a, a) && !mortonxlt_64(a, a));
+    assert(mortonxlt_32(morton_32(5, 9), morton_32(7, 3)));
+    assert(mortonyle_32(morton_32(7, 3), morton_32(5, 3)));
+
+    assert(!mortonxlt3_32(c, d) && mortonxle3_32(c, d));
+    assert(mortonylt3_32(c, d) && mortonzlt3_32(d, c));
+    assert(mortonzle3_64(morton3_64(1, 2, 3), morton3_64(0, 0, 3)));
+    assert(!mortonylt3_64(morton3_64(1, 2, 3), morton3_64(0, 0, 3)));
+
+    assert(mortonmin_64(a, b) == morton_64(5, 3));
+    assert(mortonmax_64(a, b) == morton_64(7, 9));
+    assert(mortonmin_32(morton_32(5, 9), morton_32(7, 3)) == morton_32(5, 3));
+    assert(mortonmin3_32(c, d) == morton3_32(4, 2, 1));
+    assert(mortonmax3_32(c, d) == morton3_32(4, 8, 9));
+    assert(mortonmax3_64(morton3_64(1, 20, 3), morton3_64(9, 0, 3)) == morton3_64(9, 20, 3));
+    (void)a, (void)b, (void)c, (void)d;
+}
+
+void test_morton_in_box()
+{
+    uint64_t lo = morton_64(2, 3), hi = morton_64(9, 6);
+    uint64_t codes[100], mask[2];
+    uint64_t x, y, z;
+    size_t i;
+
+    for (y = 0; y < 16; ++y) {
+        for (x = 0; x < 16; ++x) {
+            int inside = x >= 2 && x <= 9 && y >= 3 && y <= 6;
+            assert(morton_in_box_64(morton_64(x, y), lo, hi) == inside);
+            assert(morton_in_box_32(morton_32(x, y), morton_32(2, 3), morton_32(9, 6)) == inside);
+            (void)inside;
+        }
+    }
+    for (z = 0; z < 8; ++z) {
+        for (y = 0; y < 8; ++y) {
+            for (x = 0; x < 8; ++x) {
+                int inside = x >= 1 && x <= 4 && y >= 2 && y <= 7 && z >= 3 && z <= 5;
+                assert(morton3_in_box_64(morton3_64(x, y, z), morton3_64(1, 2, 3),
+                                         morton3_64(4, 7, 5)) == inside);
+                assert(morton3_in_box_32(morton3_32(x, y, z), morton3_32(1, 2, 3),
+                                         morton3_32(4, 7, 5)) == inside);
+                (void)inside;
+            }
+        }
+    }
+
+    for (i = 0; i < 100; ++i) {
+        codes[i] = i * 3;
+    }
+    morton_in_box_bulk_64(codes, 100, lo, hi, mask);
+    for (i = 0; i < 100; ++i) {
+        assert(((mask[i / 64] >> (i % 64)) & 1) == (uint64_t)morton_in_box_64(codes[i], lo, hi));
+    }
+    assert(mask[1] >> 36 == 0);
+}
+
+void test_morton_bigmin()
+{
+    uint64_t x0, y0, x1, y1, z, m, bigmin, litmax;
+
+    for (x0 = 0; x0 < 16; x0 += 3) {
+        for (y0 = 1; y0 < 16; y0 += 4) {
+            for (x1 = x0; x1 < 16; x1 += 5) {
+                for (y1 = y0; y1 < 16; y1 += 3) {
+                    uint64_t lo = morton_64(x0, y0), hi = morton_64(x1, y1);
+                    for (z = 0; z < 256; ++z) {
+                        bigmin = 0;
+                        for (m = z + 1; m < 256; ++m) {
+                            if (morton_in_box_64(m, lo, hi)) {
+                                bigmin = m;
+                                break;
+                            }
+                        }
+                        litmax = UINT64_MAX;
+                        for (m = z; m-- > 0;) {
+                            if (morton_in_box_64(m, lo, hi)) {
+                                litmax = m;
+                                break;
+                            }
+                        }
+                        assert(mortonbigmin_64(z, lo, hi) == bigmin);
+                        assert(mortonlitmax_64(z, lo, hi) == litmax);
+                    }
+                }
+            }
+        }
+    }
+
+    {
+        uint64_t lo = morton3_64(1, 2, 3), hi = morton3_64(4, 7, 5);
+        for (z = 0; z < 512; ++z) {
+            bigmin = 0;
+            for (m = z + 1; m < 512; ++m) {
+                if (morton3_in_box_64(m, lo, hi)) {
+                    bigmin = m;
+                    break;
+                }
+            }
+            litmax = UINT64_MAX;
+            for (m = z; m-- > 0;) {
+                if (morton3_in_box_64(m, lo, hi)) {
+                    litmax = m;
+                    break;
+                }
+            }
+            assert(mortonbigmin3_64(z, lo, hi) == bigmin);
+            assert(mortonlitmax3_64(z, lo, hi) == litmax);
+        }
+    }
+    (void)bigmin, (void)litmax;
+}
+
+void test_compare()
+{
+    test_morton_axis_compare();
+    test_morton_in_box();
+    test_morton_bigmin();
+}
@@ -0,0 +1,81 @@
+#include "cursor.h"
+#include "common.h"
+
+#include <assert.h>
+
+void test_mortonnext()
+{
+    uint32_t m32, x32, y32, z32, ex32, ey32, ez32;
+    uint64_t m64, x64, y64, z64, ex64, ey64, ez64;
+    uint32_t i;
+
+    m32 = 0xfff0;
+    invmorton_32(m32, &x32, &y32);
+    m64 = 0x3ffffffffff0;
+    invmorton_64(m64, &x64, &y64);
+    for (i = 0; i < 4096; ++i) {
+        m32 = mortonnext_32(m32, &x32, &y32);
+        invmorton_32(m32, &ex32, &ey32);
+        assert(x32 == ex32 && y32 == ey32);
+
+        m64 = mortonnext_64(m64, &x64, &y64);
+        invmorton_64(m64, &ex64, &ey64);
+        assert(x64 == ex64 && y64 == ey64);
+    }
+
+    m32 = 0x7fff0;
+    invmorton3_32(m32, &x32, &y32, &z32);
+    m64 = 0x1fffffffffff0;
+    invmorton3_64(m64, &x64, &y64, &z64);
+    for (i = 0; i < 4096; ++i) {
+        m32 = mortonnext3_32(m32, &x32, &y32, &z32);
+        invmorton3_32(m32, &ex32, &ey32, &ez32);
+        assert(x32 == ex32 && y32 == ey32 && z32 == ez32);
+
+        m64 = mortonnext3_64(m64, &x64, &y64, &z64);
+        invmorton3_64(m64, &ex64, &ey64, &ez64);
+        assert(x64 == ex64 && y64 == ey64 && z64 == ez64);
+    }
+
+    /* The carry into the top bits */
+    m64 = 0x7fffffffffffffff;
+    invmorton3_64(m64, &x64, &y64, &z64);
+    m64 = mortonnext3_64(m64, &x64, &y64, &z64);
+    assert(x64 == 0x200000 && y64 == 0 && z64 == 0);
+    m64 = 0x7fffffffffffffff;
+    invmorton_64(m64, &x64, &y64);
+    m64 = mortonnext_64(m64, &x64, &y64);
+    assert(x64 == 0 && y64 == 0x80000000);
+}
+
+void test_invmorton_seq()
+{
+    uint64_t x[300], y[300], z[300], ex, ey, ez;
+    uint32_t x32[300], y32[300], z32[300];
+    uint32_t ex32, ey32, ez32;
+    size_t i;
+
+    invmorton_seq_64(0x1234500, 300, x, y);
+    invmorton3_seq_64(0x1234500, 300, x, y, z);
+    invmorton3_seq_32(0x1234500, 300, x32, y32, z32);
+    for (i = 0; i < 300; ++i) {
+        invmorton3_64(0x1234500 + i, &ex, &ey, &ez);
+        assert(x[i] == ex && y[i] == ey && z[i] == ez);
+        invmorton3_32(0x1234500 + i, &ex32, &ey32, &ez32);
+        assert(x32[i] == ex32 && y32[i] == ey32 && z32[i] == ez32);
+    }
+    invmorton_seq_64(0x1234500, 300, x, y);
+    invmorton_seq_32(0x1234500, 300, x32, y32);
+    for (i = 0; i < 300; ++i) {
+        invmorton_64(0x1234500 + i, &ex, &ey);
+        assert(x[i] == ex && y[i] == ey);
+        invmorton_32(0x1234500 + i, &ex32, &ey32);
+        assert(x32[i] == ex32 && y32[i] == ey32);
+    }
+}
+
+void test_cursor()
+{
+    test_mortonnext();
+    test_invmorton_seq();
+}
@@ -0,0 +1,130 @@
+#include "dirty.h"
+#include "common.h"
+
+#include <assert.h>
+
+void test_dirty_mark()
+{
+    static uint64_t mem[4096 + 64 + 1];
+    static const uint64_t codes[] = {3, 64, 65, 4095, 4096, 100000, 262143};
+    struct dirty d;
+    uint64_t m, c;
+    size_t i, n;
+    int ok;
+
+    assert(dirty_size(6) == 8 && dirty_size(12) == 65 * 8);
+    assert(dirty_size(18) == sizeof(mem));
+    ok = dirty_init(&d, 18, mem, sizeof(mem) - 1);
+    assert(!ok);
+    ok = dirty_init(&d, 61, mem, sizeof(mem));
+    assert(!ok);
+    ok = dirty_init(&d, 18, mem, sizeof(mem));
+    assert(ok && d.nlevels == 3);
+    (void)ok;
+    assert(!dirty_any(&d) && !dirty_next_64(&d, 0, &c));
+
+    for (i = 7; i-- > 0;) {
+        dirty_mark_64(&d, codes[i]);
+    }
+    assert(dirty_any(&d));
+    assert(dirty_test_64(&d, 65) && !dirty_test_64(&d, 66));
+    n = 0;
+    for (m = 0; dirty_next_64(&d, m, &m); ++m) {
+        assert(m == codes[n++]);
+    }
+    assert(n == 7);
+    assert(dirty_next_64(&d, 4097, &c) && c == 100000);
+    assert(!dirty_next_64(&d, 262144, &c));
+
+    /* Blocks of 64 codes, e.g. the cells of a grid coarser by 3 levels in 2D */
+    n = 0;
+    for (m = 0; dirty_next_block_64(&d, m, 6, &c); m = (c + 1) << 6) {
+        ++n;
+    }
+    assert(n == 6);
+
+    dirty_clear(&d);
+    assert(!dirty_any(&d) && !dirty_next_64(&d, 0, &c));
+    for (i = 0; i < sizeof(mem) / sizeof(mem[0]); ++i) {
+        assert(mem[i] == 0);
+    }
+
+    dirty_mark_range_64(&d, 10, 20);
+    dirty_mark_range_64(&d, 60, 70000);
+    dirty_mark_range_64(&d, 5, 5);
+    for (m = 0; m < 80000; ++m) {
+        assert(dirty_test_64(&d, m) == ((m >= 10 && m < 20) || (m >= 60 && m < 70000)));
+    }
+    assert(dirty_next_64(&d, 20, &c) && c == 60);
+    assert(!dirty_next_64(&d, 70000, &c));
+    dirty_clear(&d);
+    for (i = 0; i < sizeof(mem) / sizeof(mem[0]); ++i) {
+        assert(mem[i] == 0);
+    }
+}
+
+void test_dirty_dilate()
+{
+    static uint64_t smem[65], dmem[65], cmem[5];
+    struct dirty src, dst, coarse;
+    uint32_t x, y, z;
+    uint64_t m, c, cx, cy;
+    size_t n;
+    int ok;
+
+    /* 2D: a 64 x 64 grid with cells in the middle and at a corner */
+    ok = dirty_init(&src, 12, smem, sizeof(smem));
+    ok &= dirty_init(&dst, 12, dmem, sizeof(dmem));
+    assert(ok);
+    dirty_mark_64(&src, morton_64(20, 30));
+    dirty_mark_64(&src, morton_64(63, 1));
+    dirty_dilate_64(&src, 2, &dst);
+    n = 0;
+    for (y = 0; y < 64; ++y) {
+        for (x = 0; x < 64; ++x) {
+            int near = (x >= 18 && x <= 22 && y >= 28 && y <= 32) || (x >= 61 && y <= 3);
+            assert(dirty_test_64(&dst, morton_64(x, y)) == near);
+            n += near;
+        }
+    }
+    assert(n == 25 + 12);
+
+    /* Coarser by 2 levels: 16 x 16 cells of 4 x 4 */
+    ok = dirty_init(&coarse, 8, cmem, sizeof(cmem));
+    assert(ok);
+    dirty_coarsen_64(&dst, 4, &coarse);
+    n = 0;
+    for (m = 0; dirty_next_64(&coarse, m, &m); ++m) {
+        invmorton_64(m, &cx, &cy);
+        assert((cx >= 4 && cx <= 5 && cy >= 7 && cy <= 8) || (cx == 15 && cy == 0));
+        ++n;
+    }
+    assert(n == 5);
+
+    /* 3D: a 16 x 16 x 16 grid */
+    dirty_clear(&src);
+    dirty_clear(&dst);
+    dirty_mark_64(&src, morton3_64(0, 15, 7));
+    dirty_mark_64(&src, morton3_64(8, 8, 8));
+    dirty_dilate3_64(&src, 1, &dst);
+    n = 0;
+    for (z = 0; z < 16; ++z) {
+        for (y = 0; y < 16; ++y) {
+            for (x = 0; x < 16; ++x) {
+                int near = (x <= 1 && y >= 14 && z >= 6 && z <= 8) ||
+                           (x >= 7 && x <= 9 && y >= 7 && y <= 9 && z >= 7 && z <= 9);
+                assert(dirty_test_64(&dst, morton3_64(x, y, z)) == near);
+                n += near;
+            }
+        }
+    }
+    assert(n == 12 + 27);
+    assert(dirty_next_64(&dst, 0, &c) && c == morton3_64(7, 7, 7));
+    (void)ok, (void)c;
+}
+
+void test_dirty()
+{
+    test_dirty_mark();
+    test_dirty_dilate();
+}
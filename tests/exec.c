@@ -0,0 +1,96 @@
+#define BITLIB_EXEC_THREADS
+
+#include "exec.h"
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define EXEC_TEST_N 100000
+
+struct exec_test_args {
+    unsigned char *seen;
+    size_t calls, grain;
+};
+
+static void exec_test_mark(void *arg, size_t begin, size_t end)
+{
+    struct exec_test_args *p = (struct exec_test_args *)arg;
+    size_t i;
+
+    for (i = begin; i < end; ++i) {
+        __atomic_fetch_add(&p->seen[i], 1, __ATOMIC_RELAXED);
+    }
+    assert(begin < end && end - begin <= p->grain);
+    __atomic_fetch_add(&p->calls, 1, __ATOMIC_RELAXED);
+}
+
+static void exec_test_check(const struct exec_test_args *p, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        assert(p->seen[i] == 1);
+    }
+    (void)p;
+}
+
+void test_exec_for()
+{
+    static unsigned char seen[EXEC_TEST_N];
+    struct exec_test_args p = {seen, 0, EXEC_TEST_N};
+
+    assert(exec_grain(1, 1) == EXEC_CHUNK_OPS);
+    assert(exec_grain(0, 1) == EXEC_CHUNK_OPS);
+    assert(exec_grain(3 * EXEC_CHUNK_OPS, 1) == 1);
+    assert(exec_grain(3 * EXEC_CHUNK_OPS, 8) == 8);
+    assert(exec_grain(100, 64) == 384);
+
+    exec_for(NULL, exec_test_mark, &p, 0, 10);
+    assert(p.calls == 0);
+    exec_for(NULL, exec_test_mark, &p, EXEC_TEST_N, 10);
+    assert(p.calls == 1);
+    exec_test_check(&p, EXEC_TEST_N);
+}
+
+void test_exec_pool()
+{
+    static unsigned char seen[EXEC_TEST_N];
+    static const size_t sizes[] = {1, 2, 7, 64, 1000, 4099, EXEC_TEST_N};
+    static const size_t grains[] = {1, 3, 64, 1000};
+    struct exec_test_args p = {.seen = seen};
+    struct exec_worker workers[4];
+    struct exec_pool pool;
+    size_t s, g;
+    int ok;
+
+    ok = exec_pool_init(&pool, 4, workers);
+    assert(ok && pool.nthreads == 4);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (g = 0; g < sizeof(grains) / sizeof(grains[0]); ++g) {
+            memset(seen, 0, sizes[s]);
+            p.calls = 0;
+            p.grain = sizes[s] <= grains[g] ? sizes[s] : grains[g];
+            exec_for(&pool.exec, exec_test_mark, &p, sizes[s], grains[g]);
+            exec_test_check(&p, sizes[s]);
+            assert(sizes[s] <= grains[g] || p.calls == (sizes[s] - 1) / grains[g] + 1);
+        }
+    }
+    exec_pool_destroy(&pool);
+
+    /* A pool of one thread runs everything on the caller */
+    ok = exec_pool_init(&pool, 0, workers);
+    assert(ok && pool.nthreads == 1);
+    (void)ok;
+    memset(seen, 0, EXEC_TEST_N);
+    p.grain = 7;
+    exec_for(&pool.exec, exec_test_mark, &p, EXEC_TEST_N, 7);
+    exec_test_check(&p, EXEC_TEST_N);
+    exec_pool_destroy(&pool);
+}
+
+void test_exec()
+{
+    test_exec_for();
+    test_exec_pool();
+}
@@ -0,0 +1,145 @@
+#include "geohash.h"
+#include "common.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+void test_geohash_encode()
+{
+    char s[12];
+    uint64_t code, codes[3];
+    double lat, lon, lats[3] = {57.64911, 42.605, -33.8688}, lons[3] = {10.40744, -5.603, 151.2093};
+    double dlat[3], dlon[3];
+    unsigned v;
+    int ok;
+
+    for (v = 0; v < 32; ++v) {
+        assert(geohash_value(geohash_char(v)) == (int)v);
+    }
+    assert(geohash_char(0) == '0' && geohash_char(10) == 'b' && geohash_char(31) == 'z');
+    assert(geohash_value('a') == -1 && geohash_value('i') == -1);
+    assert(geohash_value('l') == -1 && geohash_value('o') == -1 && geohash_value('A') == -1);
+
+    code = geohash_encode_64(57.64911, 10.40744, 55);
+    geohash_format_64(code, 11, s);
+    assert(memcmp(s, "u4pruydqqvj", 11) == 0);
+    ok = geohash_parse_64("u4pruydqqvj", 11, &code);
+    assert(ok && code == geohash_encode_64(57.64911, 10.40744, 55));
+    ok = geohash_parse_64("u4pa", 4, &code);
+    assert(!ok);
+
+    geohash_format_64(geohash_encode_64(42.605, -5.603, 25), 5, s);
+    assert(memcmp(s, "ezs42", 5) == 0);
+    geohash_parse_64("ezs42", 5, &code);
+    geohash_decode_64(code, 25, &lat, &lon);
+    assert(lat > 42.58 && lat < 42.63 && lon > -5.63 && lon < -5.58);
+
+    geohash_encode_bulk_64(lats, lons, 3, 40, codes);
+    geohash_decode_bulk_64(codes, 3, 40, dlat, dlon);
+    for (v = 0; v < 3; ++v) {
+        assert(codes[v] == geohash_encode_64(lats[v], lons[v], 40));
+        assert(dlat[v] - lats[v] < 1e-3 && lats[v] - dlat[v] < 1e-3);
+        assert(dlon[v] - lons[v] < 1e-3 && lons[v] - dlon[v] < 1e-3);
+    }
+    geohash_decode_64(geohash_encode_64(-33.8688, 151.2093, 64), 64, &lat, &lon);
+    assert(lat - -33.8688 < 1e-7 && -33.8688 - lat < 1e-7);
+
+    /* NaN coordinates quantize to 0, i.e. the south pole and the antimeridian */
+    assert(geohash_encode_64(NAN, NAN, 64) == 0);
+    assert(geohash_encode_64(NAN, 0.0, 64) == geohash_encode_64(-90.0, 0.0, 64));
+    (void)ok;
+}
+
+void test_geohash_neighbor()
+{
+    uint64_t code, n;
+    double lat, lon;
+    char s[5];
+    int ok;
+
+    /* Neighbors of "ezs42" */
+    geohash_parse_64("ezs42", 5, &code);
+    ok = geohash_neighbor_64(code, 25, 3, &n);
+    assert(ok);
+    geohash_format_64(n, 5, s);
+    assert(memcmp(s, "ezs48", 5) == 0);
+    ok = geohash_neighbor_64(code, 25, 1, &n);
+    assert(ok);
+    geohash_format_64(n, 5, s);
+    assert(memcmp(s, "ezs43", 5) == 0);
+    ok = geohash_neighbor_64(code, 25, 2, &n);
+    assert(ok);
+    geohash_format_64(n, 5, s);
+    assert(memcmp(s, "ezs40", 5) == 0);
+    ok = geohash_neighbor_64(code, 25, 0, &n);
+    assert(ok);
+    geohash_format_64(n, 5, s);
+    assert(memcmp(s, "ezefr", 5) == 0);
+
+    /* Even number of bits: compare with the cell one step away */
+    geohash_parse_64("ezs4", 4, &code);
+    geohash_decode_64(code, 20, &lat, &lon);
+    ok = geohash_neighbor_64(code, 20, 3, &n);
+    assert(ok);
+    assert(n == geohash_encode_64(lat + 180.0 / 1024, lon, 20));
+    ok = geohash_neighbor_64(code, 20, 2, &n);
+    assert(ok);
+    assert(n == geohash_encode_64(lat - 180.0 / 1024, lon, 20));
+    ok = geohash_neighbor_64(code, 20, 1, &n);
+    assert(ok);
+    assert(n == geohash_encode_64(lat, lon + 360.0 / 1024, 20));
+    ok = geohash_neighbor_64(code, 20, 0, &n);
+    assert(ok);
+    assert(n == geohash_encode_64(lat, lon - 360.0 / 1024, 20));
+
+    /* Wrap around the antimeridian, stop at the poles */
+    code = geohash_encode_64(10.0, 179.99, 25);
+    ok = geohash_neighbor_64(code, 25, 1, &n);
+    assert(ok);
+    assert(n == geohash_encode_64(10.0, -179.99, 25));
+    ok = geohash_neighbor_64(geohash_encode_64(89.99, 0.0, 25), 25, 3, &n);
+    assert(!ok);
+    ok = geohash_neighbor_64(geohash_encode_64(-89.99, 0.0, 24), 24, 2, &n);
+    assert(!ok);
+    ok = geohash_neighbor_64(geohash_encode_64(-89.99, 0.0, 24), 24, 3, &n);
+    assert(ok);
+    (void)ok;
+}
+
+void test_geohash_cover()
+{
+    uint64_t ranges[2 * 64], code;
+    double lat, lon;
+    size_t n, i;
+    unsigned bits;
+
+    for (bits = 19; bits <= 20; ++bits) {
+        n = geohash_cover_64(40.0, -10.0, 45.0, 0.0, bits, 0, ranges, 64);
+        assert(n > 0 && n <= 64);
+        for (lat = 40.01; lat < 45.0; lat += 0.1) {
+            for (lon = -9.99; lon < 0.0; lon += 0.1) {
+                int found = 0;
+                code = geohash_encode_64(lat, lon, bits);
+                for (i = 0; i < n; ++i) {
+                    found |= ranges[2 * i] <= code && code <= ranges[2 * i + 1];
+                }
+                assert(found);
+            }
+        }
+        /* Nothing far outside of the box is covered. */
+        for (i = 0; i < n; ++i) {
+            geohash_decode_64(ranges[2 * i], bits, &lat, &lon);
+            assert(lat > 39.0 && lat < 46.0 && lon > -11.0 && lon < 1.0);
+            geohash_decode_64(ranges[2 * i + 1], bits, &lat, &lon);
+            assert(lat > 39.0 && lat < 46.0 && lon > -11.0 && lon < 1.0);
+        }
+    }
+}
+
+void test_geohash()
+{
+    test_geohash_encode();
+    test_geohash_neighbor();
+    test_geohash_cover();
+}
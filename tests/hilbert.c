@@ -0,0 +1,38 @@
+#include "hilbert.h"
+#include "common.h"
+
+#include <assert.h>
+
+void test_hilbert_64()
+{
+    uint64_t d, x, y, px = 0, py = 0;
+    unsigned order;
+
+    assert(hilbert_64(0, 0, 1) == 0);
+    assert(hilbert_64(0, 1, 1) == 1);
+    assert(hilbert_64(1, 1, 1) == 2);
+    assert(hilbert_64(1, 0, 1) == 3);
+
+    for (order = 1; order <= 5; ++order) {
+        for (d = 0; d < ((uint64_t)1 << (2 * order)); ++d) {
+            invhilbert_64(d, order, &x, &y);
+            assert(x < ((uint64_t)1 << order) && y < ((uint64_t)1 << order));
+            assert(hilbert_64(x, y, order) == d);
+            if (d > 0) {
+                /* Consecutive indices are edge neighbors. */
+                assert((x > px ? x - px : px - x) + (y > py ? y - py : py - y) == 1);
+            }
+            px = x;
+            py = y;
+        }
+    }
+
+    invhilbert_64(0x123456789abcdef, 32, &x, &y);
+    assert(hilbert_64(x, y, 32) == 0x123456789abcdef);
+    (void)px, (void)py;
+}
+
+void test_hilbert()
+{
+    test_hilbert_64();
+}
@@ -0,0 +1,106 @@
+#include "locality.h"
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOCALITY_TEST_TSIZE 1024
+
+void test_locality_index()
+{
+    uint64_t x, y, z;
+
+    for (x = 0; x < 16; ++x) {
+        for (y = 0; y < 16; ++y) {
+            assert(locality_index_64(LOCALITY_ROWMAJOR, x, y, 4) == y * 16 + x);
+            assert(locality_index_64(LOCALITY_MORTON, x, y, 4) == morton_64(x, y));
+            assert(locality_index_64(LOCALITY_HILBERT, x, y, 4) == hilbert_64(x, y, 4));
+            for (z = 0; z < 16; z += 5) {
+                assert(locality_index3_64(LOCALITY_ROWMAJOR, x, y, z, 4) == (z * 16 + y) * 16 + x);
+                assert(locality_index3_64(LOCALITY_MORTON, x, y, z, 4) == morton3_64(x, y, z));
+            }
+        }
+    }
+}
+
+void test_reuse_exact()
+{
+    static uint64_t mem[LOCALITY_TEST_TSIZE * 8];
+    struct reuse r;
+    uint64_t i;
+    int ok;
+
+    assert(reuse_size(LOCALITY_TEST_TSIZE) <= sizeof(mem));
+    ok = reuse_init(&r, 6, 0, 1000, mem, sizeof(mem));
+    assert(!ok);
+    ok = reuse_init(&r, 6, 0, LOCALITY_TEST_TSIZE, mem, 100);
+    assert(!ok);
+    ok = reuse_init(&r, 6, 0, LOCALITY_TEST_TSIZE, mem, sizeof(mem));
+    assert(ok);
+    assert(reuse_miss_rate(&r, 1) == 0);
+
+    /* Lines a, b, c, a, a (the second a is 8 bytes into the line) */
+    reuse_access_64(&r, 0);
+    reuse_access_64(&r, 64);
+    reuse_access_64(&r, 128);
+    reuse_access_64(&r, 0);
+    reuse_access_64(&r, 8);
+    assert(r.accesses == 5 && r.weighted == 5 && r.cold == 3);
+    assert(r.hist[0] == 1 && r.hist[2] == 1);
+    assert(reuse_miss_rate(&r, 1) == 4.0 / 5);
+    assert(reuse_miss_rate(&r, 4) == 3.0 / 5);
+
+    /* Cycling over 100 lines gives distance 99, which a cache of 100 lines
+     * holds and a cache of 64 doesn't. Times wrap around several times. */
+    ok = reuse_init(&r, 6, 0, LOCALITY_TEST_TSIZE, mem, sizeof(mem));
+    assert(ok);
+    for (i = 0; i < 100 * 100; ++i) {
+        reuse_access_64(&r, 64 * (i % 100));
+    }
+    assert(r.cold == 100 && r.hist[7] == 9900 && r.rshift == 0);
+    assert(reuse_miss_rate(&r, 128) == 0.01);
+    assert(reuse_miss_rate(&r, 64) == 1.0);
+    (void)ok;
+}
+
+void test_reuse_sampled()
+{
+    struct reuse r, sum;
+    uint64_t *mem = malloc(reuse_size(LOCALITY_TEST_TSIZE));
+    uint64_t i, total = 0;
+    unsigned b;
+    int ok;
+
+    /* Cycling over 20000 lines doesn't fit into the table, so the sampling
+     * rate drops until it does */
+    assert(mem != NULL);
+    ok = reuse_init(&r, 6, 0, LOCALITY_TEST_TSIZE, mem, reuse_size(LOCALITY_TEST_TSIZE));
+    assert(ok);
+    for (i = 0; i < 20000 * 20; ++i) {
+        reuse_access_64(&r, 64 * (i % 20000));
+    }
+    assert(r.rshift >= 5 && r.accesses == 400000);
+    for (b = 0; b < REUSE_BUCKETS; ++b) {
+        total += r.hist[b];
+    }
+    /* Distances of about 19999, scaled */
+    assert(r.hist[15] > total * 9 / 10);
+    assert(reuse_miss_rate(&r, 1 << 12) > 0.95);
+    assert(reuse_miss_rate(&r, 1 << 16) < 0.2);
+
+    memset(&sum, 0, sizeof(sum));
+    reuse_merge(&sum, &r);
+    reuse_merge(&sum, &r);
+    assert(sum.accesses == 800000 && sum.hist[15] == 2 * r.hist[15]);
+    assert(reuse_miss_rate(&sum, 1 << 12) == reuse_miss_rate(&r, 1 << 12));
+    (void)ok, (void)total;
+    free(mem);
+}
+
+void test_locality()
+{
+    test_locality_index();
+    test_reuse_exact();
+    test_reuse_sampled();
+}
@@ -0,0 +1,203 @@
+#define BITLIB_EXEC_THREADS
+
+#include "lsm.h"
+#include "common.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+static int lsm_test_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+void test_lsm_merge()
+{
+    uint64_t a[3] = {1, 5, 9}, b[2] = {2, 5}, c[1] = {0}, ok[6];
+    uint32_t va[3] = {10, 11, 12}, vb[2] = {20, 21}, vc[1] = {30}, ov[6];
+    const uint64_t *keys[4] = {a, b, c, c};
+    const uint32_t *vals[4] = {va, vb, vc, vc};
+    size_t len[4] = {3, 2, 1, 0};
+    size_t n;
+
+    n = lsm_merge_64(keys, vals, len, 4, ok, ov);
+    assert(n == 6);
+    assert(ok[0] == 0 && ok[1] == 1 && ok[2] == 2 && ok[3] == 5 && ok[4] == 5 && ok[5] == 9);
+    assert(ov[0] == 30 && ov[2] == 20 && ov[3] == 11 && ov[4] == 21 && ov[5] == 12);
+    (void)n;
+}
+
+void test_lsm_index()
+{
+    static uint64_t mem[4096];
+    static uint64_t xs[1000], ys[1000];
+    static uint32_t out[1000], expect[1000];
+    uint64_t state = 99;
+    struct lsm s;
+    size_t i, n, count;
+    int ok;
+
+    /* buffer 16, fanout 4, 3 levels: 16 * (4 + 16 + 64) = 1344 entries */
+    assert(lsm_size(16, 4, 3) <= sizeof(mem));
+    ok = lsm_init(&s, 16, 1, 3, 64, mem, sizeof(mem));
+    assert(!ok);
+    ok = lsm_init(&s, 16, 4, 3, 64, mem, lsm_size(16, 4, 3) - 1);
+    assert(!ok);
+    ok = lsm_init(&s, 16, 4, 3, 20, mem, sizeof(mem));
+    assert(ok);
+
+    for (i = 0; i < 1000; ++i) {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        xs[i] = (state >> 30) & 1023;
+        ys[i] = (state >> 45) & 1023;
+        ok = lsm_insert_64(&s, morton_64(xs[i], ys[i]), (uint32_t)i);
+        assert(ok);
+
+        /* Query at several points of the insert stream. */
+        if (i % 97 == 0 || i == 999) {
+            count = 0;
+            for (n = 0; n <= i; ++n) {
+                if (xs[n] >= 100 && xs[n] <= 600 && ys[n] >= 200 && ys[n] <= 500) {
+                    expect[count++] = (uint32_t)n;
+                }
+            }
+            n = lsm_query_64(&s, 100, 200, 600, 500, out, 1000);
+            assert(n == count);
+            qsort(out, n, sizeof(uint32_t), lsm_test_cmp);
+            for (n = 0; n < count; ++n) {
+                assert(out[n] == expect[n]);
+            }
+        }
+    }
+    assert(s.nruns[2] > 0);
+    assert(lsm_write_amplification(&s) > 1.0 && lsm_write_amplification(&s) < 3.0);
+    assert(lsm_fanout(&s) > 1.0);
+
+    /* Compacting ahead of time reduces the number of runs to search. */
+    ok = lsm_flush(&s);
+    assert(ok && s.bcount == 0);
+    ok = lsm_compact(&s, 0);
+    assert(ok && s.nruns[0] == 0);
+    ok = lsm_compact(&s, 2);
+    assert(!ok);
+    assert(lsm_query_64(&s, 100, 200, 600, 500, out, 3) == count);
+    (void)ok, (void)expect;
+
+    /* The index fills up eventually. */
+    for (i = 0; lsm_insert_64(&s, morton_64(i & 1023, 0), 0); ++i) {
+    }
+    assert(i > 0 && i + 1000 <= lsm_entries(16, 4, 3) + 16);
+    lsm_destroy(&s);
+}
+
+void test_lsm_query3()
+{
+    static uint64_t mem[2048];
+    uint32_t out[64];
+    struct lsm s;
+    uint64_t x, y, z;
+    size_t n;
+    int ok;
+
+    ok = lsm_init(&s, 8, 2, 4, 63, mem, sizeof(mem));
+    assert(ok);
+    for (x = 0; x < 6; ++x) {
+        for (y = 0; y < 6; ++y) {
+            for (z = 0; z < 6; ++z) {
+                ok = lsm_insert_64(&s, morton3_64(x, y, z), (uint32_t)(36 * x + 6 * y + z));
+                assert(ok);
+            }
+        }
+    }
+    n = lsm_query3_64(&s, 1, 2, 3, 2, 4, 3, out, 64);
+    assert(n == 2 * 3 * 1);
+    qsort(out, n, sizeof(uint32_t), lsm_test_cmp);
+    assert(out[0] == 36 + 12 + 3 && out[5] == 72 + 24 + 3);
+    (void)ok;
+    lsm_destroy(&s);
+}
+
+#define LSM_TEST_N 15000
+
+static int lsm_test_stop;
+static size_t lsm_test_queries;
+
+/* Queries see a prefix of the insert stream, every entry exactly once, while
+ * the compactor flushes and merges */
+static void *lsm_test_query(void *arg)
+{
+    static uint32_t out[LSM_TEST_N];
+    struct lsm *s = (struct lsm *)arg;
+    size_t n, i;
+
+    while (!__atomic_load_n(&lsm_test_stop, __ATOMIC_ACQUIRE)) {
+        n = lsm_query_64(s, 0, 0, 1023, 1023, out, LSM_TEST_N);
+        assert(n <= LSM_TEST_N);
+        qsort(out, n, sizeof(uint32_t), lsm_test_cmp);
+        for (i = 0; i < n; ++i) {
+            assert(out[i] == i);
+        }
+        __atomic_add_fetch(&lsm_test_queries, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+void test_lsm_compactor()
+{
+    static uint64_t mem[1 << 16];
+    static uint32_t out[LSM_TEST_N];
+    uint64_t state = 7;
+    pthread_t query;
+    struct lsm s;
+    size_t i, n;
+    int ok;
+
+    assert(lsm_size(64, 4, 4) <= sizeof(mem));
+    ok = lsm_init(&s, 64, 4, 4, 20, mem, sizeof(mem));
+    assert(ok);
+    ok = lsm_compactor_start(&s);
+    assert(ok);
+    ok = pthread_create(&query, NULL, lsm_test_query, &s) == 0;
+    assert(ok);
+    for (i = 0; i < LSM_TEST_N; ++i) {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        ok = lsm_insert_64(&s, morton_64((state >> 30) & 1023, (state >> 45) & 1023),
+                           (uint32_t)i);
+        assert(ok);
+        /* Let a query in every now and then, also on a single core */
+        if (i % 1000 == 999) {
+            size_t q = __atomic_load_n(&lsm_test_queries, __ATOMIC_ACQUIRE);
+            while (__atomic_load_n(&lsm_test_queries, __ATOMIC_ACQUIRE) == q) {
+                sched_yield();
+            }
+        }
+    }
+    __atomic_store_n(&lsm_test_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(query, NULL);
+
+    ok = lsm_flush(&s);
+    assert(ok && s.bcount == 0 && s.fcount == 0);
+    ok = lsm_compact(&s, 0);
+    assert(ok && s.nruns[0] == 0);
+    ok = lsm_compact(&s, 3);
+    assert(!ok);
+    assert(s.nruns[2] > 0 && s.written > s.inserted);
+    n = lsm_query_64(&s, 0, 0, 1023, 1023, out, LSM_TEST_N);
+    assert(n == LSM_TEST_N);
+    lsm_compactor_stop(&s);
+    n = lsm_query_64(&s, 0, 0, 1023, 1023, out, LSM_TEST_N);
+    assert(n == LSM_TEST_N);
+    (void)ok, (void)n;
+    lsm_destroy(&s);
+}
+
+void test_lsm()
+{
+    test_lsm_merge();
+    test_lsm_index();
+    test_lsm_query3();
+    test_lsm_compactor();
+}
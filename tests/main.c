@@ -4,4 +4,30 @@ int main() {
     test_shift();
     test_popcount();
     test_morton();
+    test_octree();
+    test_range();
+    test_compare();
+    test_bitscan();
+    test_cursor();
+    test_hilbert();
+    test_tile();
+    test_sort();
+    test_zorder();
+    test_geohash();
+    test_quadkey();
+    test_pstore();
+    test_bstore();
+    test_lsm();
+    test_search();
+    test_voxel();
+    test_pic();
+    test_dirty();
+    test_profile();
+    test_exec();
+    test_bulk();
+    test_buffer();
+    test_locality();
+#ifdef BITLIB_TEST_CXX
+    test_bitlib();
+#endif
 }
@@ -0,0 +1,69 @@
+#include "morton.h"
+#include "common.h"
+
+#include <assert.h>
+
+void test_morton_2d()
+{
+    assert(morton_8(0x05, 0x0a) == 0x99);
+    assert(morton_64(0x0000000055555555, 0x00000000aaaaaaaa) == 0x9999999999999999);
+
+    /* (2; 1) -> neighbors (1; 1), (3; 1), (2; 0), (2; 2) */
+    assert(mortonxm_8(morton_8(2, 1)) == morton_8(1, 1));
+    assert(mortonxp_8(morton_8(2, 1)) == morton_8(3, 1));
+    assert(mortonym_8(morton_8(2, 1)) == morton_8(2, 0));
+    assert(mortonyp_8(morton_8(2, 1)) == morton_8(2, 2));
+
+    assert(mortonxm_16(morton_16(0x80, 0x13)) == morton_16(0x7f, 0x13));
+    assert(mortonxp_16(morton_16(0x7f, 0x13)) == morton_16(0x80, 0x13));
+    assert(mortonym_16(morton_16(0x13, 0x80)) == morton_16(0x13, 0x7f));
+    assert(mortonyp_16(morton_16(0x13, 0x7f)) == morton_16(0x13, 0x80));
+
+    assert(mortonxm_32(morton_32(0x8000, 0x1234)) == morton_32(0x7fff, 0x1234));
+    assert(mortonxp_32(morton_32(0x7fff, 0x1234)) == morton_32(0x8000, 0x1234));
+    assert(mortonym_32(morton_32(0x1234, 0x8000)) == morton_32(0x1234, 0x7fff));
+    assert(mortonyp_32(morton_32(0x1234, 0x7fff)) == morton_32(0x1234, 0x8000));
+
+    assert(mortonxm_64(morton_64(0x80000000, 0x12345678)) == morton_64(0x7fffffff, 0x12345678));
+    assert(mortonxp_64(morton_64(0x7fffffff, 0x12345678)) == morton_64(0x80000000, 0x12345678));
+    assert(mortonym_64(morton_64(0x12345678, 0x80000000)) == morton_64(0x12345678, 0x7fffffff));
+    assert(mortonyp_64(morton_64(0x12345678, 0x7fffffff)) == morton_64(0x12345678, 0x80000000));
+}
+
+void test_morton_3d()
+{
+    assert(morton3_32(0x00000555, 0x00000555, 0x00000155) == 0xc71c71c7);
+
+    assert(mortonxm3_16(morton3_16(0x20, 0x0b, 0x11)) == morton3_16(0x1f, 0x0b, 0x11));
+    assert(mortonxp3_16(morton3_16(0x1f, 0x0b, 0x11)) == morton3_16(0x20, 0x0b, 0x11));
+    assert(mortonym3_16(morton3_16(0x0b, 0x10, 0x11)) == morton3_16(0x0b, 0x0f, 0x11));
+    assert(mortonyp3_16(morton3_16(0x0b, 0x0f, 0x11)) == morton3_16(0x0b, 0x10, 0x11));
+    assert(mortonzm3_16(morton3_16(0x0b, 0x11, 0x10)) == morton3_16(0x0b, 0x11, 0x0f));
+    assert(mortonzp3_16(morton3_16(0x0b, 0x11, 0x0f)) == morton3_16(0x0b, 0x11, 0x10));
+
+    assert(mortonxm3_32(morton3_32(0x400, 0x123, 0x0ab)) == morton3_32(0x3ff, 0x123, 0x0ab));
+    assert(mortonxp3_32(morton3_32(0x3ff, 0x123, 0x0ab)) == morton3_32(0x400, 0x123, 0x0ab));
+    assert(mortonym3_32(morton3_32(0x123, 0x200, 0x0ab)) == morton3_32(0x123, 0x1ff, 0x0ab));
+    assert(mortonyp3_32(morton3_32(0x123, 0x1ff, 0x0ab)) == morton3_32(0x123, 0x200, 0x0ab));
+    assert(mortonzm3_32(morton3_32(0x123, 0x0ab, 0x200)) == morton3_32(0x123, 0x0ab, 0x1ff));
+    assert(mortonzp3_32(morton3_32(0x123, 0x0ab, 0x1ff)) == morton3_32(0x123, 0x0ab, 0x200));
+
+    assert(mortonxm3_64(morton3_64(0x100000, 0x12345, 0x0abcd)) ==
+           morton3_64(0x0fffff, 0x12345, 0x0abcd));
+    assert(mortonxp3_64(morton3_64(0x0fffff, 0x12345, 0x0abcd)) ==
+           morton3_64(0x100000, 0x12345, 0x0abcd));
+    assert(mortonym3_64(morton3_64(0x12345, 0x100000, 0x0abcd)) ==
+           morton3_64(0x12345, 0x0fffff, 0x0abcd));
+    assert(mortonyp3_64(morton3_64(0x12345, 0x0fffff, 0x0abcd)) ==
+           morton3_64(0x12345, 0x100000, 0x0abcd));
+    assert(mortonzm3_64(morton3_64(0x12345, 0x0abcd, 0x100000)) ==
+           morton3_64(0x12345, 0x0abcd, 0x0fffff));
+    assert(mortonzp3_64(morton3_64(0x12345, 0x0abcd, 0x0fffff)) ==
+           morton3_64(0x12345, 0x0abcd, 0x100000));
+}
+
+void test_morton()
+{
+    test_morton_2d();
+    test_morton_3d();
+}
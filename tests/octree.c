@@ -0,0 +1,138 @@
+#include "octree.h"
+#include "common.h"
+
+#include <assert.h>
+
+#define OCTREE_TEST_CAP 65536
+
+static uint64_t octree_test_in[OCTREE_TEST_CAP];
+static uint64_t octree_test_scratch[OCTREE_TEST_CAP];
+static uint64_t octree_test_out[OCTREE_TEST_CAP];
+
+void test_octant()
+{
+    uint64_t root = octant_64(0, 0, 0, 0);
+    uint64_t k = octant_64(1 << 18, 0, 1 << 17, 2);
+    uint64_t n;
+
+    assert(octant_level_64(k) == 2);
+    assert(octant_parent_64(k) == octant_64(1 << 18, 0, 0, 1));
+    assert(octant_parent_64(octant_parent_64(k)) == root);
+    assert(octant_child_64(octant_parent_64(k), 4) == k);
+    assert(octant_is_ancestor_64(root, k));
+    assert(!octant_is_ancestor_64(k, k));
+    assert(!octant_is_ancestor_64(octant_64(0, 0, 0, 1), k));
+    assert(octant_last_64(root) == (((uint64_t)1 << 57) - 1));
+
+    assert(octant_neighbor_64(k, 0, &n) && n == octant_64(1 << 17, 0, 1 << 17, 2));
+    assert(octant_neighbor_64(k, 1, &n) && n == octant_64(3 << 17, 0, 1 << 17, 2));
+    assert(!octant_neighbor_64(k, 2, &n));
+    assert(octant_neighbor_64(k, 3, &n) && n == octant_64(1 << 18, 1 << 17, 1 << 17, 2));
+    assert(octant_neighbor_64(k, 4, &n) && n == octant_64(1 << 18, 0, 0, 2));
+    assert(octant_neighbor_64(k, 5, &n) && n == octant_64(1 << 18, 0, 1 << 18, 2));
+    assert(!octant_neighbor_64(octant_64(3 << 17, 0, 0, 2), 1, &n));
+    assert(!octant_neighbor_64(root, 1, &n));
+    (void)root, (void)k, (void)n;
+}
+
+void test_octree_refine()
+{
+    uint64_t keys[2];
+    size_t n;
+
+    /* A single deep octant in the root yields 7 siblings per level. */
+    keys[0] = octant_64(0, 0, 0, 0);
+    keys[1] = octant_64(0, 0, 0, 3);
+    n = octree_refine_64(keys, 2, octree_test_out, OCTREE_TEST_CAP);
+    assert(n == 22);
+    assert(octree_test_out[0] == keys[1]);
+    assert(octree_test_out[21] == octant_64(1 << 18, 1 << 18, 1 << 18, 1));
+    assert(octree_refine_64(keys, 2, octree_test_out, 21) == 0);
+
+    assert(octree_coarsen_64(octree_test_out, n) == 15);
+    n = octree_coarsen_64(octree_test_out, 15);
+    n = octree_coarsen_64(octree_test_out, n);
+    assert(n == 1 && octree_test_out[0] == keys[0]);
+}
+
+static int octree_test_brute_balanced(const uint64_t *keys, size_t n)
+{
+    size_t i, j;
+
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < n; ++j) {
+            uint64_t a[3], b[3], sa, sb;
+            unsigned la = octant_level_64(keys[i]), lb = octant_level_64(keys[j]);
+            int d, touching = 0, overlapping = 0;
+
+            if (la <= lb + 1) {
+                continue;
+            }
+            separate3_64(octant_code_64(keys[i]), a, a + 1, a + 2);
+            separate3_64(octant_code_64(keys[j]), b, b + 1, b + 2);
+            sa = (uint64_t)1 << (OCTREE_MAXLEVEL - la);
+            sb = (uint64_t)1 << (OCTREE_MAXLEVEL - lb);
+            for (d = 0; d < 3; ++d) {
+                if (a[d] + sa == b[d] || b[d] + sb == a[d]) {
+                    ++touching;
+                } else if (a[d] < b[d] + sb && b[d] < a[d] + sa) {
+                    ++overlapping;
+                }
+            }
+            if (touching == 1 && overlapping == 2) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+void test_octree_balance()
+{
+    uint64_t seeds[3];
+    size_t n, m, half, na, nb;
+
+    /* Complete tree around a few deep octants. */
+    seeds[0] = octant_64(0, 0, 0, 0);
+    seeds[1] = octant_64(1 << 14, 3 << 14, 5 << 14, 5);
+    seeds[2] = octant_64(7 << 16, 1 << 16, 6 << 16, 3);
+    n = octree_sort_64(seeds, 3);
+    n = octree_refine_64(seeds, n, octree_test_in, OCTREE_TEST_CAP);
+    assert(n > 0);
+    assert(!octree_is_balanced_64(octree_test_in, n));
+    assert(!octree_test_brute_balanced(octree_test_in, n));
+
+    m = octree_balance_64(octree_test_in, n, octree_test_scratch, OCTREE_TEST_CAP,
+                          octree_test_out, OCTREE_TEST_CAP);
+    assert(m > n);
+    assert(octree_is_balanced_64(octree_test_out, m));
+    assert(octree_test_brute_balanced(octree_test_out, m));
+
+    /* Balancing is idempotent. */
+    n = octree_balance_64(octree_test_out, m, octree_test_scratch, OCTREE_TEST_CAP,
+                          octree_test_in, OCTREE_TEST_CAP);
+    assert(n == m);
+
+    /* Partitioned closures merge into the same result. */
+    n = octree_refine_64(seeds, 3, octree_test_in, OCTREE_TEST_CAP);
+    half = n / 2;
+    na = octree_closure_64(octree_test_in, half, octree_test_scratch, OCTREE_TEST_CAP / 2);
+    nb = octree_closure_64(octree_test_in + half, n - half,
+                           octree_test_scratch + OCTREE_TEST_CAP / 2, OCTREE_TEST_CAP / 2);
+    assert(na > 0 && nb > 0);
+    n = octree_merge_64(octree_test_scratch, na, octree_test_scratch + OCTREE_TEST_CAP / 2, nb,
+                        octree_test_in);
+    n = octree_refine_64(octree_test_in, n, octree_test_scratch, OCTREE_TEST_CAP);
+    assert(n == m);
+    for (half = 0; half < m; ++half) {
+        assert(octree_test_scratch[half] == octree_test_out[half]);
+    }
+    (void)octree_test_brute_balanced;
+}
+
+void test_octree()
+{
+    test_octant();
+    test_octree_refine();
+    test_octree_balance();
+}
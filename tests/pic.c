@@ -0,0 +1,219 @@
+#include "pic.h"
+#include "sort.h"
+#include "common.h"
+
+#include <assert.h>
+
+#define PIC_TEST_N 500
+#define PIC_TEST_LEVEL 3
+#define PIC_TEST_SIDE (1 << PIC_TEST_LEVEL)
+#define PIC_TEST_NODES (1 << (3 * PIC_TEST_LEVEL))
+
+static float pic_test_abs(float v)
+{
+    return v < 0.0f ? -v : v;
+}
+
+static float pic_test_rand(uint64_t *s)
+{
+    *s = *s * 6364136223846793005 + 1442695040888963407;
+    return (float)(*s >> 40) / (float)(1 << 24) * PIC_TEST_SIDE;
+}
+
+/* CIC deposit on a plain x-major grid, the reference */
+static void pic_test_cic(const float *x, const float *y, const float *z, const float *q,
+                         size_t n, float *grid)
+{
+    size_t p;
+    unsigned j;
+
+    for (p = 0; p < n; ++p) {
+        unsigned i[3] = {(unsigned)x[p], (unsigned)y[p], (unsigned)z[p]};
+        float f[3] = {x[p] - (float)i[0], y[p] - (float)i[1], z[p] - (float)i[2]};
+        for (j = 0; j < 8; ++j) {
+            unsigned a = (i[0] + (j & 1)) % PIC_TEST_SIDE;
+            unsigned b = (i[1] + (j >> 1 & 1)) % PIC_TEST_SIDE;
+            unsigned c = (i[2] + (j >> 2)) % PIC_TEST_SIDE;
+            grid[(c * PIC_TEST_SIDE + b) * PIC_TEST_SIDE + a] +=
+                q[p] * (j & 1 ? f[0] : 1.0f - f[0]) * (j >> 1 & 1 ? f[1] : 1.0f - f[1]) *
+                (j >> 2 ? f[2] : 1.0f - f[2]);
+        }
+    }
+}
+
+void test_pic_weights()
+{
+    float x[5] = {0.0f, 0.25f, 3.5f, 7.75f, 2.9f}, w[5], wm[5], w0[5], wp[5];
+    uint32_t cell[5];
+    size_t i;
+
+    pic_cic_weights(x, 5, cell, w);
+    assert(cell[0] == 0 && w[0] == 0.0f);
+    assert(cell[1] == 0 && w[1] == 0.25f);
+    assert(cell[3] == 7 && w[3] == 0.75f);
+
+    pic_tsc_weights(x, 5, cell, wm, w0, wp);
+    assert(cell[0] == 0 && w0[0] == 0.75f && wm[0] == 0.125f && wp[0] == 0.125f);
+    assert(cell[2] == 4 && wm[2] == 0.5f && w0[2] == 0.5f && wp[2] == 0.0f);
+    assert(cell[3] == 8);
+    for (i = 0; i < 5; ++i) {
+        assert(pic_test_abs(wm[i] + w0[i] + wp[i] - 1.0f) < 1e-6f);
+        /* The first moment is the offset from the node */
+        assert(pic_test_abs(wp[i] - wm[i] - (x[i] - (float)cell[i])) < 1e-6f);
+    }
+}
+
+void test_pic_deposit()
+{
+    static float x[PIC_TEST_N], y[PIC_TEST_N], z[PIC_TEST_N], q[PIC_TEST_N];
+    static float sx[PIC_TEST_N], sy[PIC_TEST_N], sz[PIC_TEST_N], sq[PIC_TEST_N];
+    static float grid[PIC_TEST_NODES], ref[PIC_TEST_NODES], split[PIC_TEST_NODES];
+    static uint64_t keys[PIC_TEST_N], tk[PIC_TEST_N];
+    static uint32_t idx[PIC_TEST_N], tv[PIC_TEST_N], code[64];
+    static float value[64];
+    struct pic_seam seam;
+    float total, sum;
+    uint32_t lo, hi;
+    size_t i, j, k, p, mid, done;
+    uint64_t s = 3;
+
+    /* A single particle near the corner wraps around on every axis */
+    x[0] = 7.5f;
+    y[0] = 7.5f;
+    z[0] = 0.25f;
+    q[0] = 8.0f;
+    for (i = 0; i < PIC_TEST_NODES; ++i) {
+        grid[i] = 0.0f;
+    }
+    done = pic_deposit_cic_32(x, y, z, q, 1, PIC_TEST_LEVEL, 0, 0, grid, NULL);
+    assert(done == 1);
+    assert(grid[morton3_32(7, 7, 0)] == 1.5f && grid[morton3_32(0, 0, 0)] == 1.5f);
+    assert(grid[morton3_32(0, 7, 1)] == 0.5f && grid[morton3_32(7, 0, 1)] == 0.5f);
+
+    total = 0.0f;
+    for (p = 0; p < PIC_TEST_N; ++p) {
+        x[p] = pic_test_rand(&s);
+        y[p] = pic_test_rand(&s);
+        z[p] = pic_test_rand(&s);
+        q[p] = 1.0f + (float)(p % 3);
+        total += q[p];
+    }
+    for (i = 0; i < PIC_TEST_NODES; ++i) {
+        grid[i] = ref[i] = split[i] = 0.0f;
+    }
+    pic_test_cic(x, y, z, q, PIC_TEST_N, ref);
+    done = pic_deposit_cic_32(x, y, z, q, PIC_TEST_N, PIC_TEST_LEVEL, 0, 0, grid, NULL);
+    assert(done == PIC_TEST_N);
+    for (k = 0; k < PIC_TEST_SIDE; ++k) {
+        for (j = 0; j < PIC_TEST_SIDE; ++j) {
+            for (i = 0; i < PIC_TEST_SIDE; ++i) {
+                float d = grid[morton3_32(i, j, k)] -
+                          ref[(k * PIC_TEST_SIDE + j) * PIC_TEST_SIDE + i];
+                assert(pic_test_abs(d) < 1e-4f);
+                (void)d;
+            }
+        }
+    }
+
+    /* Sorted by cell and split between two code ranges with a small seam
+     * buffer, as two threads would, applying the seams when they fill up */
+    pic_keys_32(x, y, z, PIC_TEST_N, keys, idx);
+    radixsort_64(keys, idx, PIC_TEST_N, tk, tv, 3 * PIC_TEST_LEVEL);
+    for (p = 0; p < PIC_TEST_N; ++p) {
+        sx[p] = x[idx[p]];
+        sy[p] = y[idx[p]];
+        sz[p] = z[idx[p]];
+        sq[p] = q[idx[p]];
+    }
+    mid = PIC_TEST_N / 2;
+    lo = (uint32_t)keys[mid];
+    seam.code = code;
+    seam.value = value;
+    seam.count = 0;
+    seam.cap = 64;
+    while (mid > 0 && keys[mid - 1] == lo) {
+        --mid;
+    }
+    for (p = 0; p < mid; p += done) {
+        done = pic_deposit_cic_32(sx + p, sy + p, sz + p, sq + p, mid - p, PIC_TEST_LEVEL,
+                                  0, lo, split, &seam);
+        pic_seam_apply(&seam, split);
+    }
+    hi = PIC_TEST_NODES;
+    for (p = mid; p < PIC_TEST_N; p += done) {
+        done = pic_deposit_cic_32(sx + p, sy + p, sz + p, sq + p, PIC_TEST_N - p, PIC_TEST_LEVEL,
+                                  lo, hi, split, &seam);
+        pic_seam_apply(&seam, split);
+    }
+    for (i = 0; i < PIC_TEST_NODES; ++i) {
+        assert(pic_test_abs(split[i] - grid[i]) < 1e-4f);
+    }
+
+    /* TSC conserves the total charge too */
+    for (i = 0; i < PIC_TEST_NODES; ++i) {
+        grid[i] = 0.0f;
+    }
+    seam.count = 0;
+    done = pic_deposit_tsc_32(x, y, z, q, PIC_TEST_N, PIC_TEST_LEVEL, 0, 100, grid, &seam);
+    assert(done >= 1 && done < PIC_TEST_N && seam.count > 64 - 27);
+    pic_seam_apply(&seam, grid);
+    p = pic_deposit_tsc_32(x + done, y + done, z + done, q + done, PIC_TEST_N - done,
+                           PIC_TEST_LEVEL, 0, 0, grid, NULL);
+    assert(p == PIC_TEST_N - done);
+    sum = 0.0f;
+    for (i = 0; i < PIC_TEST_NODES; ++i) {
+        assert(grid[i] >= 0.0f);
+        sum += grid[i];
+    }
+    assert(pic_test_abs(sum - total) < 1e-2f);
+    (void)sum, (void)total, (void)pic_test_abs;
+}
+
+void test_pic_gather()
+{
+    static float grid[PIC_TEST_NODES];
+    float x[PIC_TEST_N], y[PIC_TEST_N], z[PIC_TEST_N], out[PIC_TEST_N];
+    size_t i, j, k, p;
+    uint64_t s = 5;
+
+    /* Both schemes reproduce a linear field away from the periodic seam */
+    for (k = 0; k < PIC_TEST_SIDE; ++k) {
+        for (j = 0; j < PIC_TEST_SIDE; ++j) {
+            for (i = 0; i < PIC_TEST_SIDE; ++i) {
+                grid[morton3_32(i, j, k)] = (float)i + 2.0f * (float)j - (float)k;
+            }
+        }
+    }
+    for (p = 0; p < PIC_TEST_N; ++p) {
+        x[p] = 1.0f + pic_test_rand(&s) * (PIC_TEST_SIDE - 2.5f) / PIC_TEST_SIDE;
+        y[p] = 1.0f + pic_test_rand(&s) * (PIC_TEST_SIDE - 2.5f) / PIC_TEST_SIDE;
+        z[p] = 1.0f + pic_test_rand(&s) * (PIC_TEST_SIDE - 2.5f) / PIC_TEST_SIDE;
+    }
+    pic_gather_cic_32(x, y, z, PIC_TEST_N, PIC_TEST_LEVEL, grid, out);
+    for (p = 0; p < PIC_TEST_N; ++p) {
+        assert(pic_test_abs(out[p] - (x[p] + 2.0f * y[p] - z[p])) < 1e-4f);
+    }
+    pic_gather_tsc_32(x, y, z, PIC_TEST_N, PIC_TEST_LEVEL, grid, out);
+    for (p = 0; p < PIC_TEST_N; ++p) {
+        assert(pic_test_abs(out[p] - (x[p] + 2.0f * y[p] - z[p])) < 1e-4f);
+    }
+
+    /* A constant field everywhere, across the seam as well */
+    for (i = 0; i < PIC_TEST_NODES; ++i) {
+        grid[i] = 3.0f;
+    }
+    x[0] = 7.9f;
+    y[0] = 0.1f;
+    z[0] = 7.6f;
+    pic_gather_tsc_32(x, y, z, 1, PIC_TEST_LEVEL, grid, out);
+    assert(pic_test_abs(out[0] - 3.0f) < 1e-5f);
+    pic_gather_cic_32(x, y, z, 1, PIC_TEST_LEVEL, grid, out);
+    assert(pic_test_abs(out[0] - 3.0f) < 1e-5f);
+}
+
+void test_pic()
+{
+    test_pic_weights();
+    test_pic_deposit();
+    test_pic_gather();
+}
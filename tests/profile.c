@@ -0,0 +1,97 @@
+#define BITLIB_PROFILE
+#define BITLIB_PROFILE_SAMPLE 4
+#define BITLIB_PROFILE_FILE "bitlib_profile_test.txt"
+
+/* The counters are checked per flavor, so the unflavored names must not be
+ * remapped to the tuned flavors */
+#undef BITLIB_TUNED
+
+#include "popcount.h"
+#include "bitscan.h"
+#include "shift.h"
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+void test_profile_counts()
+{
+    struct profile_counts total[PROFILE_NFUNCTIONS];
+    uint32_t i, x, y;
+    uint16_t a, b, c;
+    uint64_t sum = 0;
+
+    assert(profile_sum(total) == 0 && total[PROFILE_popcount_32].calls == 0);
+
+    /* Every other value is 0 and the others have 8 bits set, so the sampled
+     * calls 0, 4, 8 and 12 only see 0 */
+    for (i = 0; i < 16; ++i) {
+        sum += popcount_32(i % 2 == 0 ? 0 : 0xff << (i % 4 * 8 - 8));
+    }
+    assert(sum == 64);
+    assert(profile_sum(total) == 1);
+    assert(total[PROFILE_popcount_32].calls == 16 && total[PROFILE_popcount_32].flagged == 0);
+    assert(total[PROFILE_popcount_32].samples == 4 && total[PROFILE_popcount_32].ones == 0);
+    assert(total[PROFILE_popcount_32].density[0] == 4);
+    assert(total[PROFILE_popcount_64].calls == 0);
+
+    assert(ctz_32(8) == 3 && bsr_64(8) == 3);
+    ctz_32(0);
+    assert(profile_sum(total) == 1);
+    assert(total[PROFILE_ctz_32].calls == 2 && total[PROFILE_ctz_32].flagged == 1);
+    assert(total[PROFILE_ctz_32].samples == 1 && total[PROFILE_ctz_32].ones == 1);
+    assert(total[PROFILE_ctz_32].density[1] == 1);
+    assert(total[PROFILE_bsr_64].calls == 1 && total[PROFILE_bsr_64].flagged == 0);
+
+    assert(merge_16(0xff, 0xff) == 0xffff);
+    merge_16(0x100, 0);
+    merge_nwe_8(0x0f, 0x10);
+    assert(merge3_32(0x7ff, 0x7ff, 0x3ff) == 0xffffffff);
+    merge3_32(0, 0, 0x400);
+    profile_sum(total);
+    assert(total[PROFILE_merge_16].calls == 2 && total[PROFILE_merge_16].flagged == 1);
+    assert(total[PROFILE_merge_16].ones == 8 && total[PROFILE_merge_16].density[2] == 1);
+    assert(total[PROFILE_merge_nwe_8].flagged == 1);
+    assert(total[PROFILE_merge3_32].calls == 2 && total[PROFILE_merge3_32].flagged == 1);
+    assert(total[PROFILE_merge3_32].ones == 11 && total[PROFILE_merge3_32].density[2] == 1);
+
+    separate_32(0xffffffff, &x, &y);
+    separate3_16(0, &a, &b, &c);
+    profile_sum(total);
+    assert(total[PROFILE_separate_32].calls == 1 && total[PROFILE_separate_32].ones == 32);
+    assert(total[PROFILE_separate_32].density[4] == 1);
+    assert(total[PROFILE_separate3_16].calls == 1 && total[PROFILE_separate3_16].density[0] == 1);
+}
+
+void test_profile_write()
+{
+    char line[256];
+    int found = 0;
+    FILE *f = tmpfile();
+
+    if (f == NULL) {
+        return;
+    }
+    popcount_64(0xffffffffffffffff);
+    profile_write(f);
+    rewind(f);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        found += strncmp(line, "popcount_64 ", 12) == 0 && strstr(line, " 100.0%") != NULL;
+        assert(strncmp(line, "popcount_8 ", 11) != 0);
+    }
+    assert(found == 1);
+    fclose(f);
+}
+
+void test_profile()
+{
+    /* The report of this file goes to BITLIB_PROFILE_FILE at exit; start it
+     * afresh instead of appending to the one of the last run */
+    FILE *f = fopen(BITLIB_PROFILE_FILE, "w");
+
+    if (f != NULL) {
+        fclose(f);
+    }
+    test_profile_counts();
+    test_profile_write();
+}
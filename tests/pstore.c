@@ -0,0 +1,177 @@
+#include "pstore.h"
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PSTORE_TEST_N 3000
+
+static uint64_t pstore_test_codes[PSTORE_TEST_N];
+static uint32_t pstore_test_a[PSTORE_TEST_N], pstore_test_b[PSTORE_TEST_N];
+
+static int pstore_test_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void pstore_test_fill()
+{
+    uint64_t state = 12345;
+    size_t i;
+
+    /* Points clustered in a 64^3 corner, with some duplicates. */
+    for (i = 0; i < PSTORE_TEST_N; ++i) {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        pstore_test_codes[i] = morton3_64((state >> 20) & 63, (state >> 30) & 63,
+                                          (state >> 40) & 63);
+    }
+    qsort(pstore_test_codes, PSTORE_TEST_N, sizeof(uint64_t), pstore_test_cmp);
+    for (i = 0; i < PSTORE_TEST_N; ++i) {
+        pstore_test_a[i] = (uint32_t)i;
+        pstore_test_b[i] = (uint32_t)pstore_test_codes[i] ^ 0xdeadbeef;
+    }
+}
+
+static void pstore_test_check(const struct pstore *s)
+{
+    static uint64_t scratch[256], rows[PSTORE_TEST_N], ranges[2 * 32];
+    uint64_t b, row, x, y, z;
+    size_t i, n, count;
+
+    assert(s->count == PSTORE_TEST_N);
+    for (b = 0; b < s->nblocks; ++b) {
+        const uint64_t *c = pstore_codes_64(s, b, scratch);
+        const uint32_t *a0 = pstore_attr_32(s, b, 0), *a1 = pstore_attr_32(s, b, 1);
+        for (i = 0; i < pstore_rows_64(s, b); ++i) {
+            assert(c[i] == pstore_test_codes[b * s->block + i]);
+            assert(a0[i] == b * s->block + i);
+            assert(a1[i] == ((uint32_t)c[i] ^ 0xdeadbeef));
+        }
+        (void)c, (void)a0, (void)a1;
+    }
+
+    for (i = 0; i < PSTORE_TEST_N; i += 7) {
+        int found = pstore_find_64(s, pstore_test_codes[i], scratch, &row);
+        assert(found);
+        assert(pstore_test_codes[row] == pstore_test_codes[i]);
+        assert(row == 0 || pstore_test_codes[row - 1] != pstore_test_codes[i]);
+        (void)found;
+    }
+    assert(!pstore_find_64(s, morton3_64(100, 0, 0), scratch, &row));
+
+    n = pstore_query_64(s, 10, 20, 5, 30, 40, 50, ranges, 32, scratch, rows, PSTORE_TEST_N);
+    count = 0;
+    for (i = 0; i < PSTORE_TEST_N; ++i) {
+        invmorton3_64(pstore_test_codes[i], &x, &y, &z);
+        if (x >= 10 && x <= 30 && y >= 20 && y <= 40 && z >= 5 && z <= 50) {
+            assert(count >= n || rows[count] == i);
+            ++count;
+        }
+    }
+    assert(n == count && n > 0);
+    assert(pstore_query_64(s, 10, 20, 5, 30, 40, 50, ranges, 32, scratch, rows, 3) == count);
+    assert(pstore_query_64(s, 100, 0, 0, 200, 63, 63, ranges, 32, scratch, rows, 3) == 0);
+    (void)n;
+}
+
+void test_pstore_buffer()
+{
+    const uint32_t *cols[2] = {pstore_test_a, pstore_test_b};
+    uint64_t *buf;
+    size_t size, plain, written;
+    struct pstore s;
+    int ok;
+
+    plain = pstore_size_64(pstore_test_codes, PSTORE_TEST_N, 256, 2, 0);
+    size = pstore_size_64(pstore_test_codes, PSTORE_TEST_N, 256, 2, PSTORE_DELTA);
+    assert(size < plain);
+    buf = malloc(plain);
+    assert(buf);
+
+    written = pstore_write_64(pstore_test_codes, cols, PSTORE_TEST_N, 256, 2, 0, buf, plain - 1);
+    assert(written == 0);
+    written = pstore_write_64(pstore_test_codes, cols, PSTORE_TEST_N, 256, 2, 0, buf, plain);
+    assert(written == plain);
+    ok = pstore_open_64(buf, plain, &s);
+    assert(ok && s.nblocks == 12);
+    pstore_test_check(&s);
+
+    written = pstore_write_64(pstore_test_codes, cols, PSTORE_TEST_N, 256, 2, PSTORE_DELTA,
+                              buf, plain);
+    assert(written == size);
+    ok = pstore_open_64(buf, size, &s);
+    assert(ok);
+    pstore_test_check(&s);
+
+    ok = pstore_open_64(buf, size - 8, &s);
+    assert(!ok);
+    /* Corrupt headers and indexes must not be accepted */
+    buf[3] = (uint64_t)1 << 61;
+    ok = pstore_open_64(buf, size, &s);
+    assert(!ok);
+    buf[3] = 12;
+    buf[4] = (uint64_t)1 << 62;
+    ok = pstore_open_64(buf, size, &s);
+    assert(!ok);
+    buf[4] = 2;
+    buf[8 + 12 + 5] += 4;
+    ok = pstore_open_64(buf, size, &s);
+    assert(!ok);
+    buf[8 + 12 + 5] = buf[8 + 12 + 6] + 8;
+    ok = pstore_open_64(buf, size, &s);
+    assert(!ok);
+    written = pstore_write_64(pstore_test_codes, cols, PSTORE_TEST_N, 256, 2, PSTORE_DELTA,
+                              buf, plain);
+    assert(written == size);
+    buf[8 + 12 + 1] = 1;
+    ok = pstore_open_64(buf, size, &s);
+    assert(!ok);
+    buf[0] = 0;
+    ok = pstore_open_64(buf, size, &s);
+    assert(!ok);
+    (void)ok;
+    (void)written;
+    free(buf);
+}
+
+void test_pstore_map()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const uint32_t *cols[2] = {pstore_test_a, pstore_test_b};
+    const char *path = "bitlib_pstore_test.bin";
+    size_t size = pstore_size_64(pstore_test_codes, PSTORE_TEST_N, 256, 2, PSTORE_DELTA);
+    uint64_t *buf = malloc(size);
+    struct pstore s = {0};
+    size_t written;
+    FILE *f;
+    int ok;
+
+    assert(buf);
+    pstore_write_64(pstore_test_codes, cols, PSTORE_TEST_N, 256, 2, PSTORE_DELTA, buf, size);
+    f = fopen(path, "wb");
+    assert(f);
+    written = fwrite(buf, 1, size, f);
+    assert(written == size);
+    fclose(f);
+    free(buf);
+
+    ok = pstore_map_64(path, &s);
+    assert(ok);
+    pstore_test_check(&s);
+    pstore_unmap_64(&s);
+    remove(path);
+    ok = pstore_map_64(path, &s);
+    assert(!ok);
+    (void)ok;
+    (void)written;
+#endif
+}
+
+void test_pstore()
+{
+    pstore_test_fill();
+    test_pstore_buffer();
+    test_pstore_map();
+}
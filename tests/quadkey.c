@@ -0,0 +1,106 @@
+#include "quadkey.h"
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+void test_tile_key()
+{
+    uint64_t x[3] = {3, 0, 7}, y[3] = {5, 0, 7}, keys[3], ox[3], oy[3], k, tx, ty;
+    char s[31];
+    unsigned len;
+    int i;
+
+    k = tile_key_64(3, 3, 5);
+    assert(tile_zoom_64(k) == 3);
+    assert(tile_morton_64(k) == morton_64(3, 5));
+    tile_xy_64(k, &tx, &ty);
+    assert(tx == 3 && ty == 5);
+    assert(tile_zoom_64(tile_key_64(0, 0, 0)) == 0);
+    assert(tile_zoom_64(tile_key_64(31, 0x7fffffff, 0x7fffffff)) == 31);
+
+    /* Bing's documentation example: tile (3; 5) at level 3 is "213". */
+    len = quadkey_format_64(k, s);
+    assert(len == 3);
+    assert(memcmp(s, "213", 3) == 0);
+    assert(quadkey_parse_64("213", 3, &k) && k == tile_key_64(3, 3, 5));
+    assert(quadkey_parse_64("", 0, &k) && k == tile_key_64(0, 0, 0));
+    assert(!quadkey_parse_64("214", 3, &k));
+    assert(!quadkey_parse_64("2/3", 3, &k));
+
+    tile_key_bulk_64(3, x, y, 3, keys);
+    tile_xy_bulk_64(keys, 3, ox, oy);
+    for (i = 0; i < 3; ++i) {
+        assert(keys[i] == tile_key_64(3, x[i], y[i]));
+        assert(ox[i] == x[i] && oy[i] == y[i]);
+    }
+    quadkey_format_bulk_64(keys, 3, 3, s);
+    assert(memcmp(s, "213000333", 9) == 0);
+    (void)len;
+}
+
+void test_tile_hierarchy()
+{
+    uint64_t k = tile_key_64(3, 3, 5), n, tx, ty;
+    int ok;
+
+    assert(tile_parent_64(k) == tile_key_64(2, 1, 2));
+    assert(tile_child_64(k, 0) == tile_key_64(4, 6, 10));
+    assert(tile_child_64(k, 3) == tile_key_64(4, 7, 11));
+    assert(tile_parent_64(tile_child_64(k, 2)) == k);
+
+    assert(tile_neighbor_64(k, 0, &n) && n == tile_key_64(3, 2, 5));
+    assert(tile_neighbor_64(k, 1, &n) && n == tile_key_64(3, 4, 5));
+    assert(tile_neighbor_64(k, 2, &n) && n == tile_key_64(3, 3, 4));
+    assert(tile_neighbor_64(k, 3, &n) && n == tile_key_64(3, 3, 6));
+
+    /* x wraps, y doesn't */
+    assert(tile_neighbor_64(tile_key_64(3, 0, 2), 0, &n) && n == tile_key_64(3, 7, 2));
+    assert(tile_neighbor_64(tile_key_64(3, 7, 2), 1, &n) && n == tile_key_64(3, 0, 2));
+    assert(!tile_neighbor_64(tile_key_64(3, 4, 0), 2, &n));
+    assert(!tile_neighbor_64(tile_key_64(3, 4, 7), 3, &n));
+    ok = tile_neighbor_64(tile_key_64(31, 0x7fffffff, 0), 1, &n);
+    assert(ok);
+    tile_xy_64(n, &tx, &ty);
+    assert(tile_zoom_64(n) == 31 && tx == 0 && ty == 0);
+    assert(!tile_neighbor_64(tile_key_64(0, 0, 0), 3, &n));
+    (void)ok, (void)k;
+}
+
+void test_tile_box()
+{
+    uint64_t keys[64], tx, ty, start;
+    size_t n, total, i;
+
+    n = tile_box_64(4, 3, 2, 9, 6, 0, keys, 64);
+    assert(n == 7 * 5);
+    for (i = 0; i < n; ++i) {
+        tile_xy_64(keys[i], &tx, &ty);
+        assert(tile_zoom_64(keys[i]) == 4);
+        assert(tx >= 3 && tx <= 9 && ty >= 2 && ty <= 6);
+        assert(i == 0 || keys[i] > keys[i - 1]);
+    }
+
+    /* Batches continue where the last one stopped. */
+    start = 0;
+    total = 0;
+    do {
+        n = tile_box_64(4, 3, 2, 9, 6, start, keys + total, 4);
+        total += n;
+        start = n > 0 ? keys[total - 1] + 1 : start;
+    } while (n == 4);
+    assert(total == 7 * 5);
+    for (i = 1; i < total; ++i) {
+        assert(keys[i] > keys[i - 1]);
+    }
+
+    assert(tile_box_64(4, 3, 2, 2, 6, 0, keys, 64) == 0);
+    assert(tile_box_64(0, 0, 0, 0, 0, 0, keys, 64) == 1 && keys[0] == tile_key_64(0, 0, 0));
+}
+
+void test_quadkey()
+{
+    test_tile_key();
+    test_tile_hierarchy();
+    test_tile_box();
+}
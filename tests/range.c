@@ -0,0 +1,132 @@
+#include "range.h"
+#include "common.h"
+
+#include <assert.h>
+
+static int range_test_covers(const uint64_t *ranges, size_t n, uint64_t m)
+{
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        if (ranges[2 * i] <= m && m <= ranges[2 * i + 1]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void test_morton_ranges()
+{
+    uint64_t ranges[2 * 64], total;
+    uint64_t x, y;
+    size_t n, i;
+
+    /* An aligned quadrant is a single range. */
+    n = morton_ranges_64(4, 4, 7, 7, 0, ranges, 64);
+    assert(n == 1 && ranges[0] == morton_64(4, 4) && ranges[1] == morton_64(7, 7));
+
+    /* Exact cover: the ranges hold exactly the codes of the box. */
+    n = morton_ranges_64(3, 2, 12, 9, 0, ranges, 64);
+    assert(n > 1 && n < 64);
+    for (i = 0, total = 0; i < n; ++i) {
+        assert(ranges[2 * i] <= ranges[2 * i + 1]);
+        assert(i == 0 || ranges[2 * i] > ranges[2 * i - 1] + 1);
+        total += ranges[2 * i + 1] - ranges[2 * i] + 1;
+    }
+    assert(total == 10 * 8);
+    for (y = 2; y <= 9; ++y) {
+        for (x = 3; x <= 12; ++x) {
+            assert(range_test_covers(ranges, n, morton_64(x, y)));
+        }
+    }
+
+    /* A budget only adds false positives. */
+    n = morton_ranges_64(3, 2, 12, 9, 0, ranges, 4);
+    assert(n == 4);
+    for (y = 2; y <= 9; ++y) {
+        for (x = 3; x <= 12; ++x) {
+            assert(range_test_covers(ranges, n, morton_64(x, y)));
+        }
+    }
+    assert(morton_ranges_64(3, 2, 12, 9, 0, ranges, 1) == 1);
+    assert(ranges[0] == morton_64(3, 2) && ranges[1] == morton_64(12, 9));
+
+    /* The whole domain */
+    assert(morton_ranges_64(0, 0, 0xffffffff, 0xffffffff, 0, ranges, 4) == 1);
+    assert(ranges[0] == 0 && ranges[1] == UINT64_MAX);
+
+    /* Huge unaligned boxes stop splitting at the budget; the ranges still
+     * cover the box and stay within the codes of its corners. */
+    n = morton_ranges_64(12345, 6789, 12345 + (1 << 24), 6789 + (1 << 24), 0, ranges, 8);
+    assert(n == 8);
+    assert(ranges[0] == morton_64(12345, 6789));
+    assert(ranges[15] == morton_64(12345 + (1 << 24), 6789 + (1 << 24)));
+    for (i = 0, total = 0x2545f4914f6cdd1d; i < 10000; ++i) {
+        total = total * 6364136223846793005 + 1442695040888963407;
+        x = 12345 + (total >> 20) % ((1 << 24) + 1);
+        y = 6789 + (total >> 40) % ((1 << 24) + 1);
+        assert(range_test_covers(ranges, n, morton_64(x, y)));
+    }
+    /* A large gap merges everything, which mustn't make the walk exhaustive */
+    assert(morton_ranges_64(1, 1, 0xfffffffe, 0xfffffffe, UINT64_MAX / 2, ranges, 8) == 1);
+    assert(ranges[0] == morton_64(1, 1) && ranges[1] == morton_64(0xfffffffe, 0xfffffffe));
+}
+
+void test_morton3_ranges()
+{
+    uint64_t ranges[2 * 256], total;
+    uint64_t x, y, z;
+    size_t n, i;
+
+    n = morton3_ranges_64(1, 2, 3, 6, 5, 9, 0, ranges, 256);
+    for (i = 0, total = 0; i < n; ++i) {
+        total += ranges[2 * i + 1] - ranges[2 * i] + 1;
+    }
+    assert(total == 6 * 4 * 7);
+    for (z = 3; z <= 9; ++z) {
+        for (y = 2; y <= 5; ++y) {
+            for (x = 1; x <= 6; ++x) {
+                assert(range_test_covers(ranges, n, morton3_64(x, y, z)));
+            }
+        }
+    }
+
+    n = morton3_ranges_64(1, 2, 3, 6, 5, 9, 16, ranges, 8);
+    assert(n <= 8);
+    for (z = 3; z <= 9; ++z) {
+        for (y = 2; y <= 5; ++y) {
+            for (x = 1; x <= 6; ++x) {
+                assert(range_test_covers(ranges, n, morton3_64(x, y, z)));
+            }
+        }
+    }
+
+    n = morton3_ranges_64(1000, 2000, 3000, 1000000, 1500000, 2000000, 0, ranges, 8);
+    assert(n > 1 && n <= 8 && ranges[0] == morton3_64(1000, 2000, 3000));
+    for (i = 0, total = 0x2545f4914f6cdd1d; i < 10000; ++i) {
+        total = total * 6364136223846793005 + 1442695040888963407;
+        x = 1000 + (total >> 10) % 999001;
+        y = 2000 + (total >> 30) % 1498001;
+        z = 3000 + (total >> 44) % 1997001;
+        assert(range_test_covers(ranges, n, morton3_64(x, y, z)));
+    }
+}
+
+void test_morton_ranges_bulk()
+{
+    uint64_t boxes[8] = {4, 4, 7, 7, 0, 0, 1, 0};
+    uint64_t ranges[2 * 2 * 4];
+    size_t counts[2], total;
+
+    total = morton_ranges_bulk_64(boxes, 2, 0, ranges, 4, counts);
+    assert(total == 2);
+    assert(counts[0] == 1 && ranges[0] == morton_64(4, 4));
+    assert(counts[1] == 1 && ranges[8] == 0 && ranges[9] == 1);
+    (void)total, (void)range_test_covers;
+}
+
+void test_range()
+{
+    test_morton_ranges();
+    test_morton3_ranges();
+    test_morton_ranges_bulk();
+}
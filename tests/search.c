@@ -0,0 +1,121 @@
+#include "search.h"
+#include "common.h"
+
+#include <assert.h>
+
+#define SEARCH_TEST_N 5000
+
+static size_t search_test_lower_bound(const uint64_t *keys, size_t n, uint64_t x)
+{
+    size_t i = 0;
+
+    while (i < n && keys[i] < x) {
+        ++i;
+    }
+    return i;
+}
+
+void test_eytzinger()
+{
+    static uint64_t sorted[SEARCH_TEST_N], e[SEARCH_TEST_N + 1], xs[64];
+    static uint32_t sorted32[SEARCH_TEST_N], e32[SEARCH_TEST_N + 1], xs32[64];
+    static const size_t sizes[] = {0, 1, 2, 3, 7, 8, 100, 1023, 1024, SEARCH_TEST_N};
+    size_t out[64], out32[64], s, i, n, first, count;
+    uint64_t state = 7;
+
+    /* Sorted keys with gaps and duplicates */
+    for (i = 0; i < SEARCH_TEST_N; ++i) {
+        sorted[i] = 3 * (i / 2) + 10;
+        sorted32[i] = (uint32_t)sorted[i];
+    }
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        n = sizes[s];
+        /* Built in two halves, as two threads would */
+        eytzinger_build_64(sorted, n, e, 1, n / 2 + 1);
+        eytzinger_build_64(sorted, n, e, n / 2 + 1, n + 1);
+        eytzinger_build_32(sorted32, n, e32, 1, n + 1);
+        for (i = 0; i < 64; ++i) {
+            state = state * 6364136223846793005 + 1442695040888963407;
+            xs[i] = (state >> 33) % (3 * n / 2 + 20);
+            xs32[i] = (uint32_t)xs[i];
+            assert(eytzinger_lower_bound_64(e, n, xs[i]) ==
+                   search_test_lower_bound(sorted, n, xs[i]));
+            assert(eytzinger_lower_bound_32(e32, n, xs32[i]) ==
+                   search_test_lower_bound(sorted, n, xs[i]));
+        }
+        eytzinger_lower_bound_bulk_64(e, n, xs, 61, out);
+        eytzinger_lower_bound_bulk_32(e32, n, xs32, 61, out32);
+        for (i = 0; i < 61; ++i) {
+            assert(out[i] == search_test_lower_bound(sorted, n, xs[i]));
+            assert(out32[i] == out[i]);
+        }
+    }
+
+    n = 100;
+    eytzinger_build_64(sorted, n, e, 1, n + 1);
+    count = eytzinger_range_64(e, n, 13, 19, &first);
+    assert(first == 2 && count == 6);
+    assert(eytzinger_range_64(e, n, 14, 15, &first) == 0);
+    assert(eytzinger_range_64(e, n, 0, UINT64_MAX, &first) == n && first == 0);
+    eytzinger_build_32(sorted32, n, e32, 1, n + 1);
+    assert(eytzinger_range_32(e32, n, 13, 19, &first) == 6 && first == 2);
+    (void)count, (void)search_test_lower_bound;
+}
+
+void test_stree()
+{
+    static uint64_t sorted[SEARCH_TEST_N], tree[2 * SEARCH_TEST_N], xs[64];
+    static uint32_t sorted32[SEARCH_TEST_N], tree32[2 * SEARCH_TEST_N], xs32[64];
+    static const size_t sizes[] = {0, 1, 15, 16, 17, 272, 273, 300, 4624, SEARCH_TEST_N};
+    size_t out[64], out32[64], s, i, n, size, first;
+    uint64_t state = 11;
+    struct stree t;
+
+    for (i = 0; i < SEARCH_TEST_N; ++i) {
+        sorted[i] = 3 * (i / 2) + 10;
+        sorted32[i] = (uint32_t)sorted[i];
+    }
+    size = stree_init(&t, 16);
+    assert(size == 16 && t.height == 1);
+    size = stree_init(&t, 17);
+    assert(size == 48 && t.height == 2);
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        n = sizes[s];
+        size = stree_init(&t, n);
+        assert(size <= 2 * SEARCH_TEST_N);
+        stree_build_64(&t, sorted, tree, 0, size / 3);
+        stree_build_64(&t, sorted, tree, size / 3, size);
+        stree_build_32(&t, sorted32, tree32, 0, size);
+        for (i = 0; i < 64; ++i) {
+            state = state * 6364136223846793005 + 1442695040888963407;
+            xs[i] = (state >> 33) % (3 * n / 2 + 20);
+            xs32[i] = (uint32_t)xs[i];
+            assert(stree_lower_bound_64(&t, tree, xs[i]) ==
+                   search_test_lower_bound(sorted, n, xs[i]));
+            assert(stree_lower_bound_32(&t, tree32, xs32[i]) ==
+                   search_test_lower_bound(sorted, n, xs[i]));
+        }
+        stree_lower_bound_bulk_64(&t, tree, xs, 61, out);
+        stree_lower_bound_bulk_32(&t, tree32, xs32, 61, out32);
+        for (i = 0; i < 61; ++i) {
+            assert(out[i] == search_test_lower_bound(sorted, n, xs[i]));
+            assert(out32[i] == out[i]);
+        }
+    }
+
+    size = stree_init(&t, 300);
+    stree_build_64(&t, sorted, tree, 0, size);
+    assert(stree_range_64(&t, tree, 13, 19, &first) == 6 && first == 2);
+    assert(stree_range_64(&t, tree, 0, UINT64_MAX, &first) == 300 && first == 0);
+    assert(stree_range_64(&t, tree, 1000, 2000, &first) == 0);
+    stree_build_32(&t, sorted32, tree32, 0, size);
+    assert(stree_range_32(&t, tree32, 13, 19, &first) == 6 && first == 2);
+    (void)first;
+}
+
+void test_search()
+{
+    test_eytzinger();
+    test_stree();
+}
@@ -95,6 +95,7 @@ void gather3_test()
 void merge3_test()
 {
     assert(merge3_8(0x05, 0x05, 0x01) == 0xc7);
+    assert(merge3_8(0x00, 0x00, 0x02) == 0x20);
     assert(merge3_16(0x0015, 0x0015, 0x0015) == 0x71c7);
     assert(merge3_32(0x00000555, 0x00000555, 0x00000155) == 0xc71c71c7);
     assert(merge3_64(0x0000000000155555, 0x0000000000155555, 0x0000000000155555) == 0x71c71c71c71c71c7);
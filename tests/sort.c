@@ -0,0 +1,70 @@
+#include "sort.h"
+#include "common.h"
+
+#include <assert.h>
+
+#define SORT_TEST_N 5000
+
+static uint64_t sort_test_keys[SORT_TEST_N], sort_test_tk[SORT_TEST_N];
+static uint32_t sort_test_vals[SORT_TEST_N], sort_test_tv[SORT_TEST_N];
+
+static void sort_test_fill(uint64_t mask)
+{
+    uint64_t s = 0x9e3779b97f4a7c15;
+    size_t i;
+
+    for (i = 0; i < SORT_TEST_N; ++i) {
+        s ^= s << 13;
+        s ^= s >> 7;
+        s ^= s << 17;
+        sort_test_keys[i] = s & mask;
+        sort_test_vals[i] = (uint32_t)i;
+    }
+}
+
+static void sort_test_check(const uint64_t *keys, const uint32_t *vals, size_t n, uint64_t mask)
+{
+    size_t i;
+
+    for (i = 1; i < n; ++i) {
+        assert((keys[i - 1] & mask) <= (keys[i] & mask));
+        /* stable */
+        assert((keys[i - 1] & mask) != (keys[i] & mask) || vals[i - 1] < vals[i]);
+    }
+    (void)keys, (void)vals, (void)mask;
+}
+
+void test_radixsort()
+{
+    size_t bounds[257], b;
+
+    sort_test_fill(UINT64_MAX);
+    radixsort_64(sort_test_keys, sort_test_vals, SORT_TEST_N, sort_test_tk, sort_test_tv, 64);
+    sort_test_check(sort_test_keys, sort_test_vals, SORT_TEST_N, UINT64_MAX);
+
+    /* Few distinct digits: skipped passes, duplicates */
+    sort_test_fill(0x0f0000000000000f);
+    radixsort_64(sort_test_keys, sort_test_vals, SORT_TEST_N, sort_test_tk, sort_test_tv, 64);
+    sort_test_check(sort_test_keys, sort_test_vals, SORT_TEST_N, UINT64_MAX);
+
+    /* Only the lowest bits */
+    sort_test_fill(UINT64_MAX);
+    radixsort_64(sort_test_keys, sort_test_vals, SORT_TEST_N, sort_test_tk, sort_test_tv, 20);
+    sort_test_check(sort_test_keys, sort_test_vals, SORT_TEST_N, 0xffffff);
+
+    /* Split, then sort the buckets independently. */
+    sort_test_fill(0xffffffffffff);
+    radixsort_split_64(sort_test_keys, sort_test_vals, SORT_TEST_N, sort_test_tk, sort_test_tv,
+                       48, bounds);
+    assert(bounds[0] == 0 && bounds[256] == SORT_TEST_N);
+    for (b = 0; b < 256; ++b) {
+        radixsort_64(sort_test_tk + bounds[b], sort_test_tv + bounds[b], bounds[b + 1] - bounds[b],
+                     sort_test_keys + bounds[b], sort_test_vals + bounds[b], 40);
+    }
+    sort_test_check(sort_test_tk, sort_test_tv, SORT_TEST_N, UINT64_MAX);
+}
+
+void test_sort()
+{
+    test_radixsort();
+}
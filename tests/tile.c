@@ -0,0 +1,105 @@
+#include "tile.h"
+#include "common.h"
+
+#include <assert.h>
+
+static void tile_test_2d(uint32_t nx, uint32_t ny, unsigned mode, uint64_t segment)
+{
+    static uint32_t ti[4096], tj[4096];
+    static unsigned char seen[64][64];
+    uint64_t span = ztile_span_64(nx, ny), begin, prev = 0;
+    size_t total = 0, expected = 0, n, k;
+    uint32_t i, j;
+
+    for (i = 0; i < 64; ++i) {
+        for (j = 0; j < 64; ++j) {
+            seen[i][j] = 0;
+        }
+    }
+    for (begin = 0; begin < span; begin += segment) {
+        uint64_t end = begin + segment < span ? begin + segment : span;
+        n = ztile_segment_64(begin, end, nx, ny, mode, ti, tj);
+        for (k = 0; k < n; ++k) {
+            uint64_t pos = (mode & ZTILE_HILBERT)
+                               ? hilbert_64(ti[k], tj[k], ztile_order(nx > ny ? nx : ny))
+                               : morton_64(ti[k], tj[k]);
+            assert(ti[k] < nx && tj[k] < ny);
+            assert(!(mode & ZTILE_TRIANGULAR) || tj[k] >= ti[k]);
+            assert(pos >= begin && pos < end);
+            assert(total + k == 0 || pos > prev);
+            assert(!seen[ti[k]][tj[k]]);
+            seen[ti[k]][tj[k]] = 1;
+            prev = pos;
+        }
+        total += n;
+    }
+    for (i = 0; i < nx; ++i) {
+        for (j = 0; j < ny; ++j) {
+            expected += !(mode & ZTILE_TRIANGULAR) || j >= i;
+        }
+    }
+    assert(total == expected);
+    (void)prev, (void)seen;
+}
+
+void test_ztile_segment()
+{
+    assert(ztile_span_64(5, 3) == 64);
+    assert(ztile_span_64(1, 1) == 1);
+    assert(ztile3_span_64(5, 3, 9) == 4096);
+
+    tile_test_2d(5, 3, ZTILE_MORTON, 7);
+    tile_test_2d(37, 50, ZTILE_MORTON, 100);
+    tile_test_2d(37, 50, ZTILE_MORTON, 4096);
+    tile_test_2d(37, 37, ZTILE_MORTON | ZTILE_TRIANGULAR, 33);
+    tile_test_2d(40, 23, ZTILE_MORTON | ZTILE_TRIANGULAR, 4096);
+    tile_test_2d(37, 50, ZTILE_HILBERT, 100);
+    tile_test_2d(37, 37, ZTILE_HILBERT | ZTILE_TRIANGULAR, 33);
+    tile_test_2d(3, 60, ZTILE_HILBERT | ZTILE_TRIANGULAR, 64);
+    tile_test_2d(60, 3, ZTILE_HILBERT, 4096);
+}
+
+void test_ztile_hilbert_skip()
+{
+    static uint32_t ti[1 << 16], tj[1 << 16];
+    uint64_t span = ztile_span_64(100000, 1), begin;
+    size_t total = 0, n, k;
+
+    /* A long thin grid: out-of-range quadrants are skipped as a whole. */
+    for (begin = 0; begin < span; begin += 1 << 16) {
+        n = ztile_segment_64(begin, begin + (1 << 16), 100000, 1, ZTILE_HILBERT, ti, tj);
+        for (k = 0; k < n; ++k) {
+            assert(ti[k] < 100000 && tj[k] == 0);
+            assert(hilbert_64(ti[k], 0, 17) >= begin);
+        }
+        total += n;
+    }
+    assert(total == 100000);
+}
+
+void test_ztile3_segment()
+{
+    static uint32_t ti[4096], tj[4096], tk[4096];
+    uint64_t span = ztile3_span_64(5, 3, 9), begin;
+    size_t total = 0, n, k;
+
+    for (begin = 0; begin < span; begin += 300) {
+        uint64_t end = begin + 300 < span ? begin + 300 : span;
+        n = ztile3_segment_64(begin, end, 5, 3, 9, ti, tj, tk);
+        for (k = 0; k < n; ++k) {
+            uint64_t m = morton3_64(ti[k], tj[k], tk[k]);
+            assert(ti[k] < 5 && tj[k] < 3 && tk[k] < 9);
+            assert(m >= begin && m < end);
+            (void)m;
+        }
+        total += n;
+    }
+    assert(total == 5 * 3 * 9);
+}
+
+void test_tile()
+{
+    test_ztile_segment();
+    test_ztile_hilbert_skip();
+    test_ztile3_segment();
+}
@@ -0,0 +1,109 @@
+#include "voxel.h"
+#include "common.h"
+
+#include <assert.h>
+#include <math.h>
+
+#define VOXEL_TEST_N 1000
+
+void test_voxel_keys()
+{
+    float x[3] = {0.5f, 1.5f, -3.0f}, y[3] = {0.5f, 0.2f, 2.5f}, z[3] = {0.1f, 0.9f, 3.9f};
+    float origin[3] = {0.0f, 0.0f, 0.0f};
+    uint64_t keys[3], sorted[4] = {0x00, 0x07, 0x08, 0x3f};
+    uint32_t idx[3];
+    size_t starts[5], n;
+
+    voxel_keys_64(x, y, z, 3, origin, 1.0f, keys, idx);
+    assert(keys[0] == 0 && keys[1] == morton3_64(1, 0, 0));
+    assert(keys[2] == morton3_64(0, 2, 3));
+    assert(idx[2] == 2);
+
+    /* NaN and out-of-range coordinates are clamped */
+    x[0] = NAN;
+    y[0] = -INFINITY;
+    z[0] = 1e30f;
+    voxel_keys_64(x, y, z, 1, origin, 1.0f, keys, idx);
+    assert(keys[0] == morton3_64(0, 0, 2097151));
+
+    n = voxel_runs_64(sorted, 4, 0, starts);
+    assert(n == 4);
+    n = voxel_runs_64(sorted, 4, 1, starts);
+    assert(n == 3);
+    assert(starts[0] == 0 && starts[1] == 2 && starts[2] == 3 && starts[3] == 4);
+    n = voxel_runs_64(sorted, 4, 2, starts);
+    assert(n == 1 && starts[1] == 4);
+    n = voxel_runs_64(sorted, 0, 0, starts);
+    assert(n == 0 && starts[0] == 0);
+    (void)n;
+}
+
+void test_voxel_downsample()
+{
+    static float x[VOXEL_TEST_N], y[VOXEL_TEST_N], z[VOXEL_TEST_N], a[VOXEL_TEST_N];
+    static float ox[VOXEL_TEST_N], oy[VOXEL_TEST_N], oz[VOXEL_TEST_N], oa[VOXEL_TEST_N];
+    static uint64_t keys[VOXEL_TEST_N], tk[VOXEL_TEST_N];
+    static uint32_t idx[VOXEL_TEST_N], tv[VOXEL_TEST_N], rep[VOXEL_TEST_N];
+    static size_t starts[VOXEL_TEST_N + 1];
+    float origin[3] = {-1.0f, -1.0f, -1.0f};
+    size_t i, r, count;
+
+    /* 10 points in each of 100 voxels of size 2 on a 10 x 10 x 1 grid, in
+     * scrambled order; point i sits at offset i / 100 inside voxel i % 100. */
+    for (i = 0; i < VOXEL_TEST_N; ++i) {
+        size_t v = (i * 37) % 100, k = i / 100;
+        x[i] = -1.0f + 2.0f * (float)(v % 10) + 0.1f + 0.1f * (float)k;
+        y[i] = -1.0f + 2.0f * (float)(v / 10) + 1.0f;
+        z[i] = -1.0f + 0.5f + 0.1f * (float)(k % 2);
+        a[i] = (float)k;
+    }
+
+    count = voxel_downsample_64(x, y, z, VOXEL_TEST_N, origin, 2.0f, VOXEL_FIRST,
+                                keys, idx, tk, tv, starts, ox, oy, oz, rep);
+    assert(count == 100);
+    for (r = 0; r < count; ++r) {
+        assert(starts[r + 1] - starts[r] == 10);
+        assert(rep[r] < 100);
+        assert(ox[r] == x[rep[r]] && oy[r] == y[rep[r]] && oz[r] == z[rep[r]]);
+        assert(r == 0 || keys[starts[r]] > keys[starts[r - 1]]);
+    }
+
+    count = voxel_downsample_64(x, y, z, VOXEL_TEST_N, origin, 2.0f, VOXEL_CENTROID,
+                                keys, idx, tk, tv, starts, ox, oy, oz, rep);
+    assert(count == 100);
+    voxel_average(a, idx, starts, count, oa);
+    for (r = 0; r < count; ++r) {
+        float fx = x[rep[r]] - 0.1f * (float)(rep[r] / 100);
+        assert(ox[r] > fx + 0.449f && ox[r] < fx + 0.451f);
+        (void)fx;
+        assert(oy[r] == y[rep[r]]);
+        assert(oz[r] > -0.451f && oz[r] < -0.449f);
+        assert(oa[r] == 4.5f);
+    }
+
+    /* The point closest to the centroid has offset 0.4 or 0.5: k = 4 or 5 */
+    count = voxel_downsample_64(x, y, z, VOXEL_TEST_N, origin, 2.0f, VOXEL_MEDOID,
+                                keys, idx, tk, tv, starts, ox, oy, oz, rep);
+    assert(count == 100);
+    for (r = 0; r < count; ++r) {
+        assert(rep[r] / 100 == 4 || rep[r] / 100 == 5);
+    }
+
+    /* Coarser levels from the same sorted keys: 5 x 5, 3 x 3, 2 x 2, 1 voxels */
+    count = voxel_runs_64(keys, VOXEL_TEST_N, 1, starts);
+    assert(count == 25);
+    count = voxel_runs_64(keys, VOXEL_TEST_N, 2, starts);
+    assert(count == 9);
+    count = voxel_runs_64(keys, VOXEL_TEST_N, 3, starts);
+    assert(count == 4);
+    count = voxel_runs_64(keys, VOXEL_TEST_N, 4, starts);
+    assert(count == 1);
+    voxel_first(idx, starts, 1, rep);
+    assert(rep[0] == 0);
+}
+
+void test_voxel()
+{
+    test_voxel_keys();
+    test_voxel_downsample();
+}
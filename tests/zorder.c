@@ -0,0 +1,101 @@
+#include "zorder.h"
+#include "sort.h"
+#include "common.h"
+
+#include <assert.h>
+#include <math.h>
+
+void test_zkey()
+{
+    uint32_t cols[5] = {0x3, 0x0, 0x1, 0x2, 0x1};
+
+    assert(zkey_i32(-5) < zkey_i32(-4));
+    assert(zkey_i32(-1) < zkey_i32(0));
+    assert(zkey_i32(0x7fffffff) == 0xffffffff);
+    assert(zkey_i64(-1) < zkey_i64(1));
+    assert(zkey_f32(-2.5f) < zkey_f32(-1.0f));
+    assert(zkey_f32(-0.5f) < zkey_f32(0.0f));
+    assert(zkey_f32(0.0f) < zkey_f32(1e-30f));
+    assert(zkey_f32(3.0f) < zkey_f32(3.5f));
+    assert(zkey_f64(-1e300) < zkey_f64(-1e-300));
+    assert(zkey_f64(1e-300) < zkey_f64(1e300));
+    assert(zkey_prefix_32("ab", 2) < zkey_prefix_32("abc", 3));
+    assert(zkey_prefix_32("abcd", 4) == zkey_prefix_32("abcdz", 5));
+    assert(zkey_prefix_32("b", 1) > zkey_prefix_32("azzz", 4));
+
+    assert(zkey_range_32(100, 100, 199, 8) == 0);
+    assert(zkey_range_32(199, 100, 199, 8) == 253);
+    assert(zkey_range_32(500, 100, 199, 8) == 253);
+    assert(zkey_range_32(0xffffffff, 0, 0xffffffff, 32) == 0xffffffff);
+    assert(zkey_range_f64(-1.0, 0.0, 1.0, 8) == 0);
+    assert(zkey_range_f64(0.5, 0.0, 1.0, 8) == 128);
+    assert(zkey_range_f64(1.0, 0.0, 1.0, 8) == 255);
+    assert(zkey_range_f64(0.25, -1.0, 1.0, 32) == 0xa0000000);
+    assert(zkey_range_f64(NAN, 0.0, 1.0, 8) == 0);
+
+    assert(zkey_bits(1) == 32 && zkey_bits(2) == 32);
+    assert(zkey_bits(3) == 21 && zkey_bits(5) == 12);
+
+    /* Column 0 takes the top bit of every group. */
+    assert(zkey_merge_64(cols, 1) == 0x3);
+    assert(zkey_merge_64(cols, 2) == 0xa);
+    assert(zkey_merge_64(cols, 3) == 0x25);
+    assert(zkey_merge_64(cols, 4) == 0x9a);
+    assert(zkey_merge_64(cols, 5) == 0x255);
+    (void)cols;
+}
+
+void test_zonemap()
+{
+    enum { N = 4096, BLOCK = 256 };
+    static uint32_t c0[N], c1[N], s0[N], s1[N], rows[N], tv[N];
+    static uint64_t keys[N], tk[N];
+    uint32_t min0[N / BLOCK], max0[N / BLOCK], min1[N / BLOCK], max1[N / BLOCK];
+    const uint32_t *cols[2] = {s0, s1};
+    const uint32_t *mins[2] = {min0, min1}, *maxs[2] = {max0, max1};
+    uint32_t lo[2], hi[2], qlo[2] = {10, 20}, qhi[2] = {13, 27};
+    uint64_t mask[1];
+    size_t i, scan;
+
+    for (i = 0; i < N; ++i) {
+        c0[i] = (uint32_t)(i * 37 % 64);
+        c1[i] = (uint32_t)(i * 11 % 64);
+        rows[i] = (uint32_t)i;
+    }
+    zkey_minmax_32(c0, N, lo, hi);
+    zkey_minmax_32(c1, N, lo + 1, hi + 1);
+    assert(lo[0] == 0 && hi[0] == 63);
+
+    /* Insertion order: every block holds every value. */
+    zonemap_build_32(c0, NULL, N, BLOCK, min0, max0);
+    zonemap_build_32(c1, NULL, N, BLOCK, min1, max1);
+    scan = zonemap_filter_32(mins, maxs, 2, N / BLOCK, qlo, qhi, mask);
+    assert(scan == N / BLOCK);
+
+    for (i = 0; i < N; ++i) {
+        s0[i] = zkey_range_32(c0[i], lo[0], hi[0], zkey_bits(2));
+        s1[i] = zkey_range_32(c1[i], lo[1], hi[1], zkey_bits(2));
+    }
+    zkey_build_64(cols, 2, N, keys);
+    radixsort_64(keys, rows, N, tk, tv, 64);
+    for (i = 1; i < N; ++i) {
+        assert(keys[i - 1] <= keys[i]);
+    }
+    zonemap_build_32(c0, rows, N, BLOCK, min0, max0);
+    zonemap_build_32(c1, rows, N, BLOCK, min1, max1);
+    scan = zonemap_filter_32(mins, maxs, 2, N / BLOCK, qlo, qhi, mask);
+    assert(scan > 0 && scan <= 2);
+    for (i = 0; i < N; ++i) {
+        uint32_t r = rows[i];
+        if (c0[r] >= qlo[0] && c0[r] <= qhi[0] && c1[r] >= qlo[1] && c1[r] <= qhi[1]) {
+            assert((mask[0] >> (i / BLOCK)) & 1);
+        }
+    }
+    (void)scan;
+}
+
+void test_zorder()
+{
+    test_zkey();
+    test_zonemap();
+}
@@ -0,0 +1,493 @@
+#define _FILE_OFFSET_BITS 64
+#define BITLIB_EXEC_THREADS
+
+#include "locality.h"
+#include "exec.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * bitlib_locality [-3] [-i] [-B] [-b BITS] [-e BYTES] [-l BYTES] [-p BYTES]
+ *                 [-r RATE] [-m BLOCKS] [-j THREADS] [-s SEGMENTS] TRACE
+ *
+ * Compares the locality of row-major, Morton and Hilbert layouts of a grid of
+ * 2^BITS cells per axis (10 by default) of BYTES bytes each (8 by default) on
+ * an access trace. TRACE holds the coordinates of one accessed cell per line
+ * (x y, or x y z with -3), or with -i its row-major index, e.g. from a stencil
+ * or a query log; with -B it holds native 64 bit integers instead of text.
+ * Accesses outside of the grid are skipped and counted. The grid must fit
+ * into a 64 bit address space, i.e. 2^(BITS * dimensions) * BYTES < 2^64.
+ *
+ * Every layout is analyzed for cache lines of -l bytes (64) and pages of -p
+ * bytes (4096) by reuse analyzers of -m blocks (1M) that start sampling at a
+ * rate of 1/2^RATE (0) and lower it as needed, so the memory use doesn't grow
+ * with the trace. The analyzers run on -j threads (all cores by default), one
+ * of which reads the next chunk of the trace in the meantime. A long trace is
+ * cut into -s segments, each with analyzers of its own, whose results are
+ * added up with reuse_merge; reuses across the cut count as first accesses,
+ * which is negligible for long segments. A segment takes reuse_size(BLOCKS)
+ * bytes per analyzer, 56 MB with the defaults, plus 48 MB of chunk buffers:
+ * 384 MB for a 2D and 272 MB for a 3D grid. By default there are enough
+ * segments to keep the threads busy, but no segment is shorter than
+ * LOCALITY_SEGMENT bytes and all of them take at most LOCALITY_MEMORY bytes,
+ * so the memory use doesn't grow with the core count either. The miss
+ * rates of LRU caches and TLBs of common sizes and the reuse distance
+ * histograms of the cache lines are written to stdout. 3D grids have no
+ * Hilbert layout.
+ */
+
+#define LOCALITY_CHUNK ((size_t)1 << 20)
+#define LOCALITY_MAXLINE 256
+#define LOCALITY_SEGMENT ((size_t)1 << 26)
+#define LOCALITY_MAXSEGMENTS 64
+#define LOCALITY_MEMORY ((size_t)4 << 30)
+
+struct locality_input {
+    const char *data;
+    size_t size, pos, skipped;
+    int binary;
+};
+
+/* A segment of the trace: its current chunk and the analyzers it goes
+ * through, and the next chunk, which is read at the same time */
+struct locality_segment {
+    struct locality_input in;
+    const uint64_t *coord[3];
+    uint64_t *next[3];
+    uint64_t *chunks;           /* room for two chunks of 3 coordinates */
+    size_t n, nnext;
+    struct reuse *analyzers;
+};
+
+struct locality_job {
+    unsigned dims, bits, index, nanalyzers;
+    uint64_t elemsize;
+    struct locality_segment *segments;
+    size_t nsegments;
+    enum locality_order *orders;
+};
+
+static const char *const locality_order_names[LOCALITY_NORDERS] = {
+    "row-major", "morton", "hilbert"
+};
+
+static double locality_wall()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1e-9 * (double)t.tv_nsec;
+}
+
+/* Read up to cap accesses of k values each into the k arrays of v */
+static size_t locality_read(struct locality_input *in, unsigned k, uint64_t *const *v, size_t cap)
+{
+    size_t n = 0, j;
+
+    if (in->binary) {
+        while (n < cap && in->size - in->pos >= k * sizeof(uint64_t)) {
+            for (j = 0; j < k; ++j) {
+                memcpy(v[j] + n, in->data + in->pos + j * sizeof(uint64_t), sizeof(uint64_t));
+            }
+            in->pos += k * sizeof(uint64_t);
+            ++n;
+        }
+        return n;
+    }
+    while (n < cap && in->pos < in->size) {
+        char line[LOCALITY_MAXLINE], *p, *end;
+        const char *s = in->data + in->pos;
+        const char *nl = memchr(s, '\n', in->size - in->pos);
+        size_t len = nl != NULL ? (size_t)(nl - s) : in->size - in->pos;
+
+        in->pos += len + (nl != NULL);
+        len = len < LOCALITY_MAXLINE - 1 ? len : LOCALITY_MAXLINE - 1;
+        memcpy(line, s, len);
+        line[len] = '\0';
+        p = line;
+        for (j = 0; j < k; ++j) {
+            v[j][n] = strtoull(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            p = end + strspn(end, " \t,;");
+        }
+        if (j == k) {
+            ++n;
+        } else {
+            ++in->skipped;
+        }
+    }
+    return n;
+}
+
+/* Read the next chunk of a segment as coordinates, skipping accesses outside
+ * of the grid */
+static void locality_next(const struct locality_job *job, struct locality_segment *seg)
+{
+    uint64_t mask = ((uint64_t)1 << job->bits) - 1;
+    unsigned a, shift = job->dims * job->bits;
+    size_t n, i, m = 0;
+
+    n = locality_read(&seg->in, job->index ? 1 : job->dims, seg->next, LOCALITY_CHUNK);
+    for (i = 0; i < n; ++i) {
+        uint64_t cell = seg->next[0][i], out = 0;
+        if (job->index) {
+            /* Row-major indices to coordinates */
+            out = shift < 64 ? cell >> shift : 0;
+            for (a = 0; a < job->dims; ++a) {
+                seg->next[a][m] = cell & mask;
+                cell >>= job->bits;
+            }
+        } else {
+            for (a = 0; a < job->dims; ++a) {
+                out |= seg->next[a][i] & ~mask;
+                seg->next[a][m] = seg->next[a][i];
+            }
+        }
+        if (out == 0) {
+            ++m;
+        } else {
+            ++seg->in.skipped;
+        }
+    }
+    seg->nnext = m;
+}
+
+/* Item a runs segment a / (nanalyzers + 1): items below nanalyzers run its
+ * chunk through one of its analyzers, the last one reads its next chunk */
+static void locality_task(void *arg, size_t begin, size_t end)
+{
+    struct locality_job *job = (struct locality_job *)arg;
+    size_t a, i;
+
+    for (a = begin; a < end; ++a) {
+        struct locality_segment *seg = job->segments + a / (job->nanalyzers + 1);
+        size_t k = a % (job->nanalyzers + 1);
+        struct reuse *r = seg->analyzers + k;
+        enum locality_order o = job->orders[k / 2 < LOCALITY_NORDERS ? k / 2 : 0];
+        if (k == job->nanalyzers) {
+            locality_next(job, seg);
+            continue;
+        }
+        for (i = 0; i < seg->n; ++i) {
+            uint64_t cell = job->dims == 3 ?
+                locality_index3_64(o, seg->coord[0][i], seg->coord[1][i], seg->coord[2][i],
+                                   job->bits) :
+                locality_index_64(o, seg->coord[0][i], seg->coord[1][i], job->bits);
+            reuse_access_64(r, cell * job->elemsize);
+        }
+    }
+}
+
+/* Cut the trace into nseg segments of about the same size at record
+ * boundaries: lines of text, or k integers */
+static void locality_split(const struct locality_input *in, unsigned k, size_t nseg,
+                           struct locality_segment *segments)
+{
+    size_t s, start = 0, rec = k * sizeof(uint64_t);
+
+    for (s = 0; s < nseg; ++s) {
+        size_t end = in->size;
+        if (s + 1 < nseg && in->binary) {
+            end = in->size / rec * (s + 1) / nseg * rec;
+        } else if (s + 1 < nseg) {
+            const char *nl;
+            end = in->size / nseg * (s + 1);
+            end = end > start ? end : start;
+            nl = memchr(in->data + end, '\n', in->size - end);
+            end = nl != NULL ? (size_t)(nl - in->data) + 1 : in->size;
+        }
+        end = end > start ? end : start;
+        segments[s].in = *in;
+        segments[s].in.data = in->data + start;
+        segments[s].in.size = end - start;
+        start = end;
+    }
+}
+
+static unsigned locality_log2(const char *arg)
+{
+    unsigned long long v = strtoull(arg, NULL, 10);
+
+    if (v == 0 || (v & (v - 1)) != 0) {
+        fprintf(stderr, "%s is not a power of 2\n", arg);
+        exit(2);
+    }
+    return (unsigned)bsr_64(v);
+}
+
+static void locality_usage()
+{
+    fprintf(stderr, "usage: bitlib_locality [-3] [-i] [-B] [-b BITS] [-e BYTES] [-l BYTES] "
+                    "[-p BYTES] [-r RATE] [-m BLOCKS] [-j THREADS] [-s SEGMENTS] TRACE\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static const uint64_t caches[] = {32 << 10, 1 << 20, 32 << 20};
+    static const uint64_t tlbs[] = {64, 1536};
+    struct locality_input in = {NULL};
+    struct locality_job job;
+    struct locality_segment *segments;
+    struct reuse *analyzers;
+    enum locality_order orders[LOCALITY_NORDERS];
+    struct exec_worker workers[EXEC_MAXTHREADS];
+    struct exec_pool pool;
+    uint64_t total = 0;
+    unsigned dims = 2, bits = 10, lineshift = 6, pageshift = 12, rshift = 0, nthreads;
+    unsigned norders, a, b, c, index = 0, lshift = 0, pshift = 0;
+    size_t tsize = (size_t)1 << 20, nseg = 0, skipped = 0, s, active;
+    void **mem;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double t0 = locality_wall();
+    int fd, arg;
+    struct stat st;
+
+    nthreads = cores > 0 ? (unsigned)cores : 1;
+    job.elemsize = 8;
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; ++arg) {
+        const char *opt = argv[arg], *val = arg + 1 < argc ? argv[arg + 1] : NULL;
+        if (strcmp(opt, "-3") == 0) {
+            dims = 3;
+        } else if (strcmp(opt, "-i") == 0) {
+            index = 1;
+        } else if (strcmp(opt, "-B") == 0) {
+            in.binary = 1;
+        } else if (val == NULL) {
+            locality_usage();
+        } else if (strcmp(opt, "-b") == 0) {
+            bits = (unsigned)strtoul(val, NULL, 10);
+            ++arg;
+        } else if (strcmp(opt, "-e") == 0) {
+            job.elemsize = strtoull(val, NULL, 10);
+            ++arg;
+        } else if (strcmp(opt, "-l") == 0) {
+            lineshift = locality_log2(val);
+            ++arg;
+        } else if (strcmp(opt, "-p") == 0) {
+            pageshift = locality_log2(val);
+            ++arg;
+        } else if (strcmp(opt, "-r") == 0) {
+            rshift = (unsigned)strtoul(val, NULL, 10);
+            ++arg;
+        } else if (strcmp(opt, "-m") == 0) {
+            tsize = (size_t)1 << locality_log2(val);
+            ++arg;
+        } else if (strcmp(opt, "-j") == 0) {
+            nthreads = (unsigned)strtoul(val, NULL, 10);
+            ++arg;
+        } else if (strcmp(opt, "-s") == 0) {
+            nseg = strtoul(val, NULL, 10);
+            if (nseg == 0 || nseg > LOCALITY_MAXSEGMENTS) {
+                locality_usage();
+            }
+            ++arg;
+        } else {
+            locality_usage();
+        }
+    }
+    if (argc - arg != 1 || bits == 0 || bits > (dims == 3 ? 21 : 32) || job.elemsize == 0 ||
+        rshift > REUSE_SAMPLE_BITS) {
+        locality_usage();
+    }
+    /* Addresses of cells, cell * elemsize, must not overflow */
+    if (dims * bits >= 64 || job.elemsize > UINT64_MAX >> (dims * bits)) {
+        fprintf(stderr, "a grid of 2^%u cells of %llu bytes doesn't fit into 64 bit "
+                        "addresses\n", dims * bits, (unsigned long long)job.elemsize);
+        return 2;
+    }
+
+    fd = open(argv[arg], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(argv[arg]);
+        return 1;
+    }
+    in.size = (size_t)st.st_size;
+    if (in.size > 0) {
+        in.data = mmap(NULL, in.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (in.data == MAP_FAILED) {
+            perror(argv[arg]);
+            return 1;
+        }
+        madvise((void *)in.data, in.size, MADV_SEQUENTIAL);
+    }
+
+    norders = 0;
+    orders[norders++] = LOCALITY_ROWMAJOR;
+    orders[norders++] = LOCALITY_MORTON;
+    if (dims == 2) {
+        orders[norders++] = LOCALITY_HILBERT;
+    }
+    /* Enough segments for every thread to have an analyzer or a chunk to
+     * read, as far as the trace is long enough and the memory budget allows */
+    if (nseg == 0) {
+        size_t segmem = 2 * norders * reuse_size(tsize) + 2 * 3 * LOCALITY_CHUNK * sizeof(uint64_t);
+        nseg = (nthreads + 2 * norders) / (2 * norders + 1);
+        nseg = nseg < in.size / LOCALITY_SEGMENT ? nseg : in.size / LOCALITY_SEGMENT;
+        nseg = nseg < LOCALITY_MEMORY / segmem ? nseg : LOCALITY_MEMORY / segmem;
+        nseg = nseg < 1 ? 1 : nseg > LOCALITY_MAXSEGMENTS ? LOCALITY_MAXSEGMENTS : nseg;
+    }
+    segments = calloc(nseg, sizeof(*segments));
+    analyzers = calloc(2 * norders * nseg, sizeof(*analyzers));
+    mem = calloc(2 * norders * nseg, sizeof(*mem));
+    if (segments == NULL || analyzers == NULL || mem == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    locality_split(&in, index ? 1 : dims, nseg, segments);
+    for (s = 0; s < nseg; ++s) {
+        segments[s].analyzers = analyzers + 2 * norders * s;
+        /* The chunk being analyzed and the one being read */
+        segments[s].chunks = malloc(2 * 3 * LOCALITY_CHUNK * sizeof(uint64_t));
+        if (segments[s].chunks == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        for (a = 0; a < 3; ++a) {
+            segments[s].next[a] = segments[s].chunks + a * LOCALITY_CHUNK;
+        }
+    }
+    for (a = 0; a < 2 * norders * nseg; ++a) {
+        mem[a] = malloc(reuse_size(tsize));
+        if (mem[a] == NULL || !reuse_init(&analyzers[a], a % 2 ? pageshift : lineshift, rshift,
+                                          tsize, mem[a], reuse_size(tsize))) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+    exec_pool_init(&pool, nthreads, workers);
+
+    job.dims = dims;
+    job.bits = bits;
+    job.index = index;
+    job.nanalyzers = 2 * norders;
+    job.segments = segments;
+    job.nsegments = nseg;
+    job.orders = orders;
+    for (s = 0; s < nseg; ++s) {
+        locality_next(&job, &segments[s]);
+    }
+    for (c = 1, active = 1; active; c = !c) {
+        active = 0;
+        for (s = 0; s < nseg; ++s) {
+            struct locality_segment *seg = &segments[s];
+            seg->n = seg->nnext;
+            if (seg->nnext == 0) {
+                continue;
+            }
+            for (a = 0; a < 3; ++a) {
+                seg->coord[a] = seg->next[a];
+                seg->next[a] = seg->chunks + (3 * c + a) * LOCALITY_CHUNK;
+            }
+            total += seg->n;
+            active = 1;
+        }
+        if (active) {
+            exec_for(&pool.exec, locality_task, &job, nseg * (job.nanalyzers + 1), 1);
+        }
+    }
+    exec_pool_destroy(&pool);
+
+    /* Add up the segments in the analyzers of the first one */
+    for (s = 0; s < nseg; ++s) {
+        for (a = 0; a < 2 * norders; ++a) {
+            if (s > 0) {
+                reuse_merge(&analyzers[a], &segments[s].analyzers[a]);
+            }
+        }
+        b = segments[s].analyzers[0].rshift;
+        lshift = b > lshift ? b : lshift;
+        b = segments[s].analyzers[1].rshift;
+        pshift = b > pshift ? b : pshift;
+        skipped += segments[s].in.skipped;
+    }
+
+    printf("%llu accesses", (unsigned long long)total);
+    if (skipped > 0) {
+        printf(", %zu skipped (unreadable or outside of the grid)", skipped);
+    }
+    if (nseg > 1) {
+        printf(", %zu segments", nseg);
+    }
+    printf(", %.3f s, sampling 1/%llu of the lines and 1/%llu of the pages\n\n",
+           locality_wall() - t0, 1ull << lshift, 1ull << pshift);
+
+    printf("%-10s", "miss rate");
+    for (b = 0; b < sizeof(caches) / sizeof(caches[0]); ++b) {
+        char label[24];
+        snprintf(label, sizeof(label), "%lluK", (unsigned long long)(caches[b] >> 10));
+        printf(" %10s", label);
+    }
+    for (b = 0; b < sizeof(tlbs) / sizeof(tlbs[0]); ++b) {
+        char label[24];
+        snprintf(label, sizeof(label), "TLB %llu", (unsigned long long)tlbs[b]);
+        printf(" %10s", label);
+    }
+    printf("\n");
+    for (a = 0; a < norders; ++a) {
+        printf("%-10s", locality_order_names[orders[a]]);
+        for (b = 0; b < sizeof(caches) / sizeof(caches[0]); ++b) {
+            printf(" %9.2f%%", 100 * reuse_miss_rate(&analyzers[2 * a], caches[b] >> lineshift));
+        }
+        for (b = 0; b < sizeof(tlbs) / sizeof(tlbs[0]); ++b) {
+            printf(" %9.2f%%", 100 * reuse_miss_rate(&analyzers[2 * a + 1], tlbs[b]));
+        }
+        printf("\n");
+    }
+
+    printf("\n%-10s", "distance");
+    for (a = 0; a < norders; ++a) {
+        printf(" %10s", locality_order_names[orders[a]]);
+    }
+    printf("\n%-10s", "cold");
+    for (a = 0; a < norders; ++a) {
+        const struct reuse *r = &analyzers[2 * a];
+        printf(" %9.2f%%", r->weighted ? 100.0 * (double)r->cold / (double)r->weighted : 0.0);
+    }
+    printf("\n");
+    for (b = 0; b < REUSE_BUCKETS; ++b) {
+        int used = 0;
+        for (a = 0; a < norders; ++a) {
+            used |= analyzers[2 * a].hist[b] != 0;
+        }
+        if (!used) {
+            continue;
+        }
+        if (b == 0) {
+            printf("%-10s", "0");
+        } else {
+            char label[24];
+            snprintf(label, sizeof(label), "<2^%u", b);
+            printf("%-10s", label);
+        }
+        for (a = 0; a < norders; ++a) {
+            const struct reuse *r = &analyzers[2 * a];
+            printf(" %9.2f%%", 100.0 * (double)r->hist[b] / (double)r->weighted);
+        }
+        printf("\n");
+    }
+
+    for (a = 0; a < 2 * norders * nseg; ++a) {
+        free(mem[a]);
+    }
+    for (s = 0; s < nseg; ++s) {
+        free(segments[s].chunks);
+    }
+    free(mem);
+    free(analyzers);
+    free(segments);
+    if (in.size > 0) {
+        munmap((void *)in.data, in.size);
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,486 @@
+#define _FILE_OFFSET_BITS 64
+
+#include "morton.h"
+#include "sort.h"
+#include "zorder.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * bitlib_pointsort [-t] [-c POINTS] [-b XMIN,YMIN,ZMIN,XMAX,YMAX,ZMAX] INPUT OUTPUT
+ *
+ * Sorts the 3D points of INPUT by their Morton codes. INPUT holds x, y, z as
+ * native doubles, 24 bytes per point, or with -t (or a .xyz name) one point per
+ * line as text, with any further columns ignored. OUTPUT gets one 32 byte record
+ * per point: the 64 bit Morton code followed by x, y and z as doubles.
+ *
+ * The coordinates are quantized to 21 bits each within the bounding box given
+ * with -b, or else found by a first pass over the input. INPUT is memory-mapped
+ * and read in chunks of POINTS points (1M by default); every chunk is
+ * quantized, encoded with morton3_64 and radix sorted into a run, which a writer
+ * thread writes out while the next chunk is processed. If there is more than
+ * one run, the runs are merged into OUTPUT with a k-way merge. Memory use is
+ * bounded by the chunk size (about 112 bytes per point) and the number of runs,
+ * not by the size of INPUT. The time and throughput of every stage is written
+ * to stderr.
+ */
+
+#define POINTSORT_BITS 21
+#define POINTSORT_CHUNK ((size_t)1 << 20)
+#define POINTSORT_MAXLINE 256
+
+/* The records of OUTPUT and of the runs */
+struct pointsort_rec {
+    uint64_t code;
+    double xyz[3];
+};
+
+struct pointsort_input {
+    const char *data;
+    size_t size, pos, skipped;
+    int text;
+};
+
+/* Writes buffers on a thread of its own, one at a time, while the caller fills
+ * the next buffer */
+struct pointsort_writer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    FILE *f;
+    const void *buf;
+    size_t len;
+    int pending, stop, error;
+    double seconds;
+};
+
+enum pointsort_stage {
+    STAGE_BOUNDS, STAGE_READ, STAGE_QUANTIZE, STAGE_ENCODE, STAGE_SORT, STAGE_WRITE,
+    STAGE_MERGE, STAGE_TOTAL, STAGE_COUNT
+};
+
+static const char *const pointsort_stage_names[STAGE_COUNT] = {
+    "bounds", "read", "quantize", "encode", "sort", "write", "merge", "total"
+};
+
+static double pointsort_wall()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1e-9 * (double)t.tv_nsec;
+}
+
+static int pointsort_done(const struct pointsort_input *in)
+{
+    return in->pos >= in->size || (!in->text && in->size - in->pos < 3 * sizeof(double));
+}
+
+/* Read up to cap points into xyz, asking the kernel to page in the chunk after
+ * them in the background. Returns the number of points read. */
+static size_t pointsort_read(struct pointsort_input *in, double *xyz, size_t cap)
+{
+    size_t n = 0, start = in->pos;
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (!in->text) {
+        n = (in->size - in->pos) / (3 * sizeof(double));
+        n = n < cap ? n : cap;
+        memcpy(xyz, in->data + in->pos, n * 3 * sizeof(double));
+        in->pos += n * 3 * sizeof(double);
+    } else {
+        char line[POINTSORT_MAXLINE];
+        while (n < cap && in->pos < in->size) {
+            const char *p = in->data + in->pos;
+            const char *end = memchr(p, '\n', in->size - in->pos);
+            size_t len = end != NULL ? (size_t)(end - p) : in->size - in->pos, i;
+
+            in->pos += len + (end != NULL);
+            len = len < POINTSORT_MAXLINE - 1 ? len : POINTSORT_MAXLINE - 1;
+            for (i = 0; i < len; ++i) {
+                line[i] = p[i] == ',' ? ' ' : p[i];
+            }
+            line[len] = '\0';
+            if (sscanf(line, "%lf %lf %lf", xyz + 3 * n, xyz + 3 * n + 1, xyz + 3 * n + 2) == 3) {
+                ++n;
+            } else {
+                ++in->skipped;
+            }
+        }
+    }
+    if (in->pos < in->size && page > 0) {
+        size_t from = in->pos & ~((size_t)page - 1), len = in->pos - start;
+        madvise((void *)(in->data + from), len < in->size - from ? len : in->size - from,
+                MADV_WILLNEED);
+    }
+    return n;
+}
+
+static void *pointsort_writer_thread(void *arg)
+{
+    struct pointsort_writer *w = (struct pointsort_writer *)arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->pending && !w->stop) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (!w->pending) {
+            break;
+        }
+        pthread_mutex_unlock(&w->lock);
+        {
+            double t = pointsort_wall();
+            int failed = fwrite(w->buf, 1, w->len, w->f) != w->len;
+            t = pointsort_wall() - t;
+            pthread_mutex_lock(&w->lock);
+            w->error |= failed;
+            w->seconds += t;
+        }
+        w->pending = 0;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* Wait for the previous buffer to be written; returns nonzero if any write
+ * so far has failed */
+static int pointsort_writer_wait(struct pointsort_writer *w)
+{
+    int error;
+
+    pthread_mutex_lock(&w->lock);
+    while (w->pending) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    error = w->error;
+    pthread_mutex_unlock(&w->lock);
+    return error;
+}
+
+/* Hand len bytes of buf to the writer; buf must stay untouched until the next
+ * call returns */
+static void pointsort_writer_put(struct pointsort_writer *w, FILE *f, const void *buf, size_t len)
+{
+    pthread_mutex_lock(&w->lock);
+    while (w->pending) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    w->f = f;
+    w->buf = buf;
+    w->len = len;
+    w->pending = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* Find the bounding box of all points */
+static void pointsort_bounds(struct pointsort_input *in, double *xyz, size_t cap, double *box)
+{
+    size_t n, i;
+    unsigned d;
+
+    for (d = 0; d < 3; ++d) {
+        box[d] = 1e308;
+        box[d + 3] = -1e308;
+    }
+    while ((n = pointsort_read(in, xyz, cap)) > 0) {
+        for (i = 0; i < n; ++i) {
+            for (d = 0; d < 3; ++d) {
+                box[d] = xyz[3 * i + d] < box[d] ? xyz[3 * i + d] : box[d];
+                box[d + 3] = xyz[3 * i + d] > box[d + 3] ? xyz[3 * i + d] : box[d + 3];
+            }
+        }
+    }
+    in->pos = 0;
+    in->skipped = 0;
+}
+
+/* Merge the runs of len[j] records at runs + start[j] into out through the
+ * writer, keeping the run with the smallest head code at the top of a heap.
+ * Records with equal codes come out in run order. */
+static void pointsort_merge(const struct pointsort_rec *runs, const size_t *start,
+                            const size_t *len, size_t k, struct pointsort_rec *buf[2],
+                            size_t cap, FILE *out, struct pointsort_writer *w)
+{
+    size_t *heap = malloc(k * sizeof(size_t)), *pos = malloc(k * sizeof(size_t));
+    size_t n = 0, count = 0, i;
+    int cur = 0;
+
+    if (heap == NULL || pos == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+#define POINTSORT_LESS(a, b) (runs[start[a] + pos[a]].code < runs[start[b] + pos[b]].code || \
+                              (runs[start[a] + pos[a]].code == runs[start[b] + pos[b]].code && \
+                               (a) < (b)))
+    for (i = 0; i < k; ++i) {
+        size_t c = n++;
+        pos[i] = 0;
+        while (c > 0 && POINTSORT_LESS(i, heap[(c - 1) / 2])) {
+            heap[c] = heap[(c - 1) / 2];
+            c = (c - 1) / 2;
+        }
+        heap[c] = i;
+    }
+    while (n > 0) {
+        size_t r = heap[0], c = 0;
+
+        buf[cur][count++] = runs[start[r] + pos[r]];
+        if (count == cap) {
+            pointsort_writer_put(w, out, buf[cur], count * sizeof(struct pointsort_rec));
+            cur = !cur;
+            count = 0;
+        }
+        if (++pos[r] == len[r]) {
+            r = heap[--n];
+        }
+        while (2 * c + 1 < n) {
+            size_t child = 2 * c + 1;
+            if (child + 1 < n && POINTSORT_LESS(heap[child + 1], heap[child])) {
+                ++child;
+            }
+            if (!POINTSORT_LESS(heap[child], r)) {
+                break;
+            }
+            heap[c] = heap[child];
+            c = child;
+        }
+        if (n > 0) {
+            heap[c] = r;
+        }
+    }
+#undef POINTSORT_LESS
+    pointsort_writer_put(w, out, buf[cur], count * sizeof(struct pointsort_rec));
+    pointsort_writer_wait(w);
+    free(heap);
+    free(pos);
+}
+
+static void pointsort_usage()
+{
+    fprintf(stderr, "usage: bitlib_pointsort [-t] [-c POINTS] "
+                    "[-b XMIN,YMIN,ZMIN,XMAX,YMAX,ZMAX] INPUT OUTPUT\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct pointsort_input in = {NULL};
+    struct pointsort_writer w = {0};
+    struct pointsort_rec *rec[2], *runs = NULL;
+    double box[6], *xyz, seconds[STAGE_COUNT] = {0}, t, t0 = pointsort_wall();
+    uint64_t *keys, *tk;
+    uint32_t *qx, *qy, *qz, *vals, *tv;
+    size_t chunk = POINTSORT_CHUNK, total = 0, nruns = 0, maxruns = 0, n, i;
+    size_t *start = NULL, *len = NULL;
+    const char *input, *output;
+    int have_box = 0, cur = 0, a, fd;
+    FILE *out, *tmp = NULL;
+    struct stat st;
+
+    for (a = 1; a < argc && argv[a][0] == '-'; ++a) {
+        if (strcmp(argv[a], "-t") == 0) {
+            in.text = 1;
+        } else if (strcmp(argv[a], "-c") == 0 && a + 1 < argc) {
+            chunk = (size_t)strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc) {
+            have_box = sscanf(argv[++a], "%lf,%lf,%lf,%lf,%lf,%lf", box, box + 1, box + 2,
+                              box + 3, box + 4, box + 5) == 6;
+            if (!have_box) {
+                pointsort_usage();
+            }
+        } else {
+            pointsort_usage();
+        }
+    }
+    if (argc - a != 2 || chunk == 0 || chunk > UINT32_MAX) {
+        pointsort_usage();
+    }
+    input = argv[a];
+    output = argv[a + 1];
+    n = strlen(input);
+    in.text |= n >= 4 && strcmp(input + n - 4, ".xyz") == 0;
+
+    fd = open(input, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(input);
+        return 1;
+    }
+    in.size = (size_t)st.st_size;
+    if (in.size > 0) {
+        in.data = mmap(NULL, in.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (in.data == MAP_FAILED) {
+            perror(input);
+            return 1;
+        }
+        madvise((void *)in.data, in.size, MADV_SEQUENTIAL);
+    }
+    out = fopen(output, "wb");
+    if (out == NULL) {
+        perror(output);
+        return 1;
+    }
+
+    xyz = malloc(chunk * 3 * sizeof(double));
+    keys = malloc(chunk * sizeof(uint64_t));
+    tk = malloc(chunk * sizeof(uint64_t));
+    qx = malloc(chunk * sizeof(uint32_t));
+    qy = malloc(chunk * sizeof(uint32_t));
+    qz = malloc(chunk * sizeof(uint32_t));
+    vals = malloc(chunk * sizeof(uint32_t));
+    tv = malloc(chunk * sizeof(uint32_t));
+    rec[0] = malloc(chunk * sizeof(struct pointsort_rec));
+    rec[1] = malloc(chunk * sizeof(struct pointsort_rec));
+    if (!xyz || !keys || !tk || !qx || !qy || !qz || !vals || !tv || !rec[0] || !rec[1]) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    pthread_mutex_init(&w.lock, NULL);
+    pthread_cond_init(&w.cond, NULL);
+    if (pthread_create(&w.thread, NULL, pointsort_writer_thread, &w) != 0) {
+        fprintf(stderr, "can't start the writer thread\n");
+        return 1;
+    }
+
+    if (!have_box) {
+        t = pointsort_wall();
+        pointsort_bounds(&in, xyz, chunk, box);
+        seconds[STAGE_BOUNDS] = pointsort_wall() - t;
+    }
+    for (i = 0; i < 3; ++i) {
+        /* Keep degenerate axes from dividing by zero */
+        if (!(box[i + 3] > box[i])) {
+            box[i + 3] = box[i] + 1;
+        }
+    }
+
+    for (;;) {
+        t = pointsort_wall();
+        n = pointsort_read(&in, xyz, chunk);
+        seconds[STAGE_READ] += pointsort_wall() - t;
+        if (n == 0) {
+            break;
+        }
+
+        t = pointsort_wall();
+        for (i = 0; i < n; ++i) {
+            qx[i] = zkey_range_f64(xyz[3 * i], box[0], box[3], POINTSORT_BITS);
+            qy[i] = zkey_range_f64(xyz[3 * i + 1], box[1], box[4], POINTSORT_BITS);
+            qz[i] = zkey_range_f64(xyz[3 * i + 2], box[2], box[5], POINTSORT_BITS);
+        }
+        seconds[STAGE_QUANTIZE] += pointsort_wall() - t;
+
+        t = pointsort_wall();
+        for (i = 0; i < n; ++i) {
+            keys[i] = morton3_64(qx[i], qy[i], qz[i]);
+            vals[i] = (uint32_t)i;
+        }
+        seconds[STAGE_ENCODE] += pointsort_wall() - t;
+
+        t = pointsort_wall();
+        radixsort_64(keys, vals, n, tk, tv, 3 * POINTSORT_BITS);
+        for (i = 0; i < n; ++i) {
+            rec[cur][i].code = keys[i];
+            memcpy(rec[cur][i].xyz, xyz + 3 * (size_t)vals[i], sizeof(rec[cur][i].xyz));
+        }
+        seconds[STAGE_SORT] += pointsort_wall() - t;
+
+        /* A single run is the output; otherwise runs go to a temporary file */
+        if (nruns == 0 && pointsort_done(&in)) {
+            pointsort_writer_put(&w, out, rec[cur], n * sizeof(struct pointsort_rec));
+        } else {
+            if (tmp == NULL && (tmp = tmpfile()) == NULL) {
+                perror("tmpfile");
+                return 1;
+            }
+            if (nruns == maxruns) {
+                maxruns = maxruns ? 2 * maxruns : 64;
+                start = realloc(start, maxruns * sizeof(size_t));
+                len = realloc(len, maxruns * sizeof(size_t));
+                if (start == NULL || len == NULL) {
+                    fprintf(stderr, "out of memory\n");
+                    return 1;
+                }
+            }
+            start[nruns] = total;
+            len[nruns++] = n;
+            pointsort_writer_put(&w, tmp, rec[cur], n * sizeof(struct pointsort_rec));
+        }
+        cur = !cur;
+        total += n;
+    }
+    if (nruns > 0) {
+        struct stat st;
+
+        t = pointsort_wall();
+        /* Mapping more than a short write left in the file would raise SIGBUS
+         * on the first access past its end */
+        if (pointsort_writer_wait(&w) != 0 || fflush(tmp) != 0 || fstat(fileno(tmp), &st) != 0 ||
+            (uint64_t)st.st_size < total * sizeof(struct pointsort_rec)) {
+            fprintf(stderr, "tmpfile: writing the sorted runs failed\n");
+            return 1;
+        }
+        runs = mmap(NULL, total * sizeof(struct pointsort_rec), PROT_READ, MAP_PRIVATE,
+                    fileno(tmp), 0);
+        if (runs == MAP_FAILED) {
+            perror("tmpfile");
+            return 1;
+        }
+        pointsort_merge(runs, start, len, nruns, rec, chunk, out, &w);
+        munmap(runs, total * sizeof(struct pointsort_rec));
+        fclose(tmp);
+        seconds[STAGE_MERGE] = pointsort_wall() - t;
+    }
+
+    pthread_mutex_lock(&w.lock);
+    w.stop = 1;
+    pthread_cond_broadcast(&w.cond);
+    pthread_mutex_unlock(&w.lock);
+    pthread_join(w.thread, NULL);
+    if (w.error || fclose(out) != 0) {
+        perror(output);
+        return 1;
+    }
+    seconds[STAGE_WRITE] = w.seconds;
+    seconds[STAGE_TOTAL] = pointsort_wall() - t0;
+
+    fprintf(stderr, "%zu points, %zu sorted runs", total, nruns > 0 ? nruns : (size_t)(total > 0));
+    if (in.skipped > 0) {
+        fprintf(stderr, ", %zu lines skipped", in.skipped);
+    }
+    fprintf(stderr, "\n%-10s %10s %12s\n", "stage", "seconds", "Mpoints/s");
+    for (a = 0; a < STAGE_COUNT; ++a) {
+        if (seconds[a] > 0) {
+            fprintf(stderr, "%-10s %10.3f %12.2f\n", pointsort_stage_names[a], seconds[a],
+                    (double)total / seconds[a] / 1e6);
+        }
+    }
+
+    if (in.size > 0) {
+        munmap((void *)in.data, in.size);
+    }
+    close(fd);
+    free(start);
+    free(len);
+    free(xyz);
+    free(keys);
+    free(tk);
+    free(qx);
+    free(qy);
+    free(qz);
+    free(vals);
+    free(tv);
+    free(rec[0]);
+    free(rec[1]);
+    return 0;
+}